@@ -0,0 +1,643 @@
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+
+#include "archive.hpp"
+#include "logger.hpp"
+
+using namespace Logging;
+
+namespace {
+
+const QString FAC_ARCHIVE("ARCHIVE");
+const QString ZIP_SUFFIX(".zip");
+const QString GZIP_SUFFIX(".gz");
+
+// Zip: the end of central directory record (followed by a comment of up to 64 KB), the central directory entries and
+// the local header in front of the data of each file.
+const quint32 EOCD_SIGNATURE = 0x06054B50;
+const int EOCD_SIZE = 22;
+const int MAX_COMMENT_SIZE = 0xFFFF;
+const quint32 CENTRAL_SIGNATURE = 0x02014B50;
+const int CENTRAL_HEADER_SIZE = 46;
+const quint32 LOCAL_SIGNATURE = 0x04034B50;
+const int LOCAL_HEADER_SIZE = 30;
+const ushort FLAG_ENCRYPTED = 0x0001;
+const ushort FLAG_UTF8 = 0x0800;
+const ushort METHOD_STORED = 0;
+const ushort METHOD_DEFLATED = 8;
+
+// Gzip: the header (with optional fields after it, by the flags) and the CRC and size of the contents at the end.
+const int GZIP_HEADER_SIZE = 10;
+const int GZIP_TRAILER_SIZE = 8;
+const uchar GZIP_FLAG_HEADER_CRC = 0x02;
+const uchar GZIP_FLAG_EXTRA = 0x04;
+const uchar GZIP_FLAG_NAME = 0x08;
+const uchar GZIP_FLAG_COMMENT = 0x10;
+
+// Sizes are taken from the archive, what is reserved for the decompressed data in advance is limited.
+const int MAX_RESERVE = 16 * 1024 * 1024;
+
+
+ushort le16(const uchar* pBytes)
+{
+	return pBytes[0] bitor (pBytes[1] << 8);
+} // le16
+
+
+quint32 le32(const uchar* pBytes)
+{
+	return le16(pBytes) bitor (quint32(le16(pBytes + 2)) << 16);
+} // le32
+
+
+const uchar* bytes(const QByteArray& data)
+{
+	return reinterpret_cast<const uchar*>(data.constData());
+} // bytes
+
+
+struct Crc32Table
+{
+	Crc32Table()
+	{
+		for(quint32 i = 0; i < 256; ++i) {
+			quint32 crc = i;
+			for(int bit = 0; bit < 8; ++bit)
+				crc = crc bitand 1 ? 0xEDB88320 xor (crc >> 1) : crc >> 1;
+			table[i] = crc;
+		}
+	}
+
+	quint32 table[256];
+};
+
+
+// Deflate decoding. The Huffman codes are canonical, so they are decoded from the number of codes of each length and
+// the symbols in code order.
+enum {
+	MAX_BITS = 15,
+	MAX_LENGTH_CODES = 288,
+	MAX_DISTANCE_CODES = 30,
+	END_OF_BLOCK = 256
+};
+
+struct Huffman
+{
+	short count[MAX_BITS + 1];
+	short symbol[MAX_LENGTH_CODES];
+};
+
+
+// Makes the code from the code length of each symbol. Returns 0 for a complete code, > 0 if it is incomplete and < 0
+// if there are too many codes of some length.
+int construct(Huffman& huffman, const short* pLengths, int symbols)
+{
+	for(int length = 0; length <= MAX_BITS; ++length)
+		huffman.count[length] = 0;
+	for(int symbol = 0; symbol < symbols; ++symbol)
+		++huffman.count[pLengths[symbol]];
+	if(symbols == huffman.count[0])
+		return 0;
+
+	int left = 1;
+	for(int length = 1; length <= MAX_BITS; ++length) {
+		left = (left << 1) - huffman.count[length];
+		if(left < 0)
+			return left;
+	}
+
+	short offsets[MAX_BITS + 1];
+	offsets[1] = 0;
+	for(int length = 1; length < MAX_BITS; ++length)
+		offsets[length + 1] = offsets[length] + huffman.count[length];
+	for(int symbol = 0; symbol < symbols; ++symbol)
+		if(0 not_eq pLengths[symbol])
+			huffman.symbol[offsets[pLengths[symbol]]++] = symbol;
+
+	return left;
+} // construct
+
+
+// The codes of the blocks compressed with fixed codes.
+struct FixedCodes
+{
+	FixedCodes()
+	{
+		short lengths[MAX_LENGTH_CODES];
+		int symbol = 0;
+		while(symbol < 144)
+			lengths[symbol++] = 8;
+		while(symbol < 256)
+			lengths[symbol++] = 9;
+		while(symbol < 280)
+			lengths[symbol++] = 7;
+		while(symbol < MAX_LENGTH_CODES)
+			lengths[symbol++] = 8;
+		construct(lengthCode, lengths, MAX_LENGTH_CODES);
+		for(symbol = 0; symbol < MAX_DISTANCE_CODES; ++symbol)
+			lengths[symbol] = 5;
+		construct(distanceCode, lengths, MAX_DISTANCE_CODES);
+	}
+
+	Huffman lengthCode;
+	Huffman distanceCode;
+};
+
+
+// Decodes a deflate stream block by block.
+class Inflater
+{
+public:
+	Inflater(const uchar* pData, int length, QByteArray& decompressed, qint64 maxSize)
+		: m_pData(pData), m_length(length), m_pos(0), m_bitBuffer(0), m_bitCount(0), m_error(false),
+			m_decompressed(decompressed), m_maxSize(maxSize)
+	{
+	}
+
+	bool run()
+	{
+		bool last;
+		do {
+			last = bits(1);
+			const int type = bits(2);
+			bool ok;
+			switch(type) {
+				case 0:
+					ok = stored();
+					break;
+				case 1:
+					ok = fixed();
+					break;
+				case 2:
+					ok = dynamic();
+					break;
+				default:
+					ok = false;
+					break;
+			}
+			if(not ok or m_error)
+				return false;
+		} while(not last);
+
+		return true;
+	} // run
+
+private:
+	int bits(int count)
+	{
+		while(m_bitCount < count) {
+			if(m_pos >= m_length) {
+				m_error = true;
+				return 0;
+			}
+			m_bitBuffer or_eq quint32(m_pData[m_pos++]) << m_bitCount;
+			m_bitCount += 8;
+		}
+		const int value = m_bitBuffer bitand ((1 << count) - 1);
+		m_bitBuffer >>= count;
+		m_bitCount -= count;
+
+		return value;
+	} // bits
+
+	// The next symbol, -1 for an invalid code.
+	int decode(const Huffman& huffman)
+	{
+		int code = 0;
+		int first = 0;
+		int index = 0;
+		for(int length = 1; length <= MAX_BITS; ++length) {
+			code or_eq bits(1);
+			const int count = huffman.count[length];
+			if(code - count < first)
+				return huffman.symbol[index + (code - first)];
+			index += count;
+			first = (first + count) << 1;
+			code <<= 1;
+		}
+
+		return -1;
+	} // decode
+
+	// Whether the given number of bytes more stays within the size of the contents. Stopping here rather than after
+	// decoding keeps a crafted stream (a few KB can expand to gigabytes) from exhausting the memory.
+	bool fits(int count) const
+	{
+		return m_decompressed.size() + qint64(count) <= m_maxSize;
+	} // fits
+
+	bool stored()
+	{
+		// The rest of the current byte is skipped, the length and its complement follow.
+		m_bitBuffer = 0;
+		m_bitCount = 0;
+		if(m_pos + 4 > m_length)
+			return false;
+		const int length = le16(m_pData + m_pos);
+		if(length not_eq (le16(m_pData + m_pos + 2) xor 0xFFFF))
+			return false;
+		m_pos += 4;
+		if(m_pos + length > m_length or not fits(length))
+			return false;
+		m_decompressed.append(reinterpret_cast<const char*>(m_pData + m_pos), length);
+		m_pos += length;
+
+		return true;
+	} // stored
+
+	bool codes(const Huffman& lengthCode, const Huffman& distanceCode)
+	{
+		static const short lengthBase[29] = {
+			3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+		};
+		static const short lengthExtra[29] = {
+			0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+		};
+		static const short distanceBase[30] = {
+			1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+			8193, 12289, 16385, 24577
+		};
+		static const short distanceExtra[30] = {
+			0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+		};
+
+		forever {
+			int symbol = decode(lengthCode);
+			if(symbol < 0 or m_error)
+				return false;
+			if(symbol < END_OF_BLOCK) {
+				if(not fits(1))
+					return false;
+				m_decompressed.append(char(symbol));
+				continue;
+			}
+			if(END_OF_BLOCK == symbol)
+				return true;
+
+			symbol -= END_OF_BLOCK + 1;
+			if(symbol >= 29)
+				return false;
+			const int length = lengthBase[symbol] + bits(lengthExtra[symbol]);
+			symbol = decode(distanceCode);
+			if(symbol < 0 or symbol >= MAX_DISTANCE_CODES)
+				return false;
+			const int distance = distanceBase[symbol] + bits(distanceExtra[symbol]);
+			if(m_error or distance > m_decompressed.size() or not fits(length))
+				return false;
+			// The copy may overlap what it adds, so it goes a byte at a time.
+			int from = m_decompressed.size() - distance;
+			for(int i = 0; i < length; ++i)
+				m_decompressed.append(m_decompressed.at(from++));
+		}
+	} // codes
+
+	bool fixed()
+	{
+		static const FixedCodes fixedCodes;
+		return codes(fixedCodes.lengthCode, fixedCodes.distanceCode);
+	} // fixed
+
+	bool dynamic()
+	{
+		// The order the code lengths of the code length code come in.
+		static const short order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+		const int lengthCount = bits(5) + 257;
+		const int distanceCount = bits(5) + 1;
+		const int codeLengthCount = bits(4) + 4;
+		if(m_error or lengthCount > MAX_LENGTH_CODES or distanceCount > MAX_DISTANCE_CODES)
+			return false;
+
+		short lengths[MAX_LENGTH_CODES + MAX_DISTANCE_CODES];
+		int index;
+		for(index = 0; index < codeLengthCount; ++index)
+			lengths[order[index]] = bits(3);
+		for(; index < 19; ++index)
+			lengths[order[index]] = 0;
+		Huffman lengthCode;
+		if(0 not_eq construct(lengthCode, lengths, 19))
+			return false;
+
+		// The lengths of both codes, with runs of the previous length or of zeros.
+		index = 0;
+		while(index < lengthCount + distanceCount) {
+			int symbol = decode(lengthCode);
+			if(symbol < 0 or m_error)
+				return false;
+			if(symbol < 16) {
+				lengths[index++] = symbol;
+				continue;
+			}
+			short length = 0;
+			int repeat;
+			if(16 == symbol) {
+				if(0 == index)
+					return false;
+				length = lengths[index - 1];
+				repeat = 3 + bits(2);
+			}
+			else if(17 == symbol)
+				repeat = 3 + bits(3);
+			else
+				repeat = 11 + bits(7);
+			if(index + repeat > lengthCount + distanceCount)
+				return false;
+			while(repeat--)
+				lengths[index++] = length;
+		}
+		// Without an end of block code there is no end.
+		if(0 == lengths[END_OF_BLOCK])
+			return false;
+
+		// Incomplete codes are only allowed for a single code.
+		Huffman distanceCode;
+		int left = construct(lengthCode, lengths, lengthCount);
+		if(left < 0 or (left > 0 and lengthCount - lengthCode.count[0] not_eq 1))
+			return false;
+		left = construct(distanceCode, lengths + lengthCount, distanceCount);
+		if(left < 0 or (left > 0 and distanceCount - distanceCode.count[0] not_eq 1))
+			return false;
+
+		return codes(lengthCode, distanceCode);
+	} // dynamic
+
+	const uchar* m_pData;
+	const int m_length;
+	int m_pos;
+	quint32 m_bitBuffer;
+	int m_bitCount;
+	bool m_error;
+	QByteArray& m_decompressed;
+	const qint64 m_maxSize;
+};
+
+} // anonymous
+
+
+bool Archive::isZip(const QString& path)
+{
+	return path.endsWith(ZIP_SUFFIX, Qt::CaseInsensitive);
+} // isZip
+
+
+bool Archive::isGzip(const QString& path)
+{
+	return path.endsWith(GZIP_SUFFIX, Qt::CaseInsensitive);
+} // isGzip
+
+
+QString Archive::withoutGzip(const QString& name)
+{
+	return isGzip(name) ? name.left(name.length() - GZIP_SUFFIX.length()) : name;
+} // withoutGzip
+
+
+bool Archive::splitPath(const QString& path, QString& hostPath, QString& name)
+{
+	if(isGzip(path) and QFileInfo(path).isFile()) {
+		hostPath = path;
+		name = withoutGzip(QFileInfo(path).fileName());
+		return true;
+	}
+
+	// The first directory of the path that is a zip archive.
+	const QString separated(QDir::fromNativeSeparators(path));
+	for(int slash = separated.indexOf('/'); slash >= 0; slash = separated.indexOf('/', slash + 1)) {
+		const QString archivePath(separated.left(slash));
+		if(isZip(archivePath) and QFileInfo(archivePath).isFile()) {
+			hostPath = archivePath;
+			name = separated.mid(slash + 1);
+			return true;
+		}
+	}
+
+	return false;
+} // splitPath
+
+
+QByteArray Archive::readFile(const QString& path)
+{
+	QString hostPath;
+	QString name;
+	if(not splitPath(path, hostPath, name)) {
+		QFile file(path);
+		if(not file.open(QIODevice::ReadOnly))
+			return QByteArray();
+		return file.readAll();
+	}
+
+	if(isZip(hostPath)) {
+		ZipArchive archive;
+		if(not archive.open(hostPath))
+			return QByteArray();
+		const int index = archive.find(name);
+		return index < 0 ? QByteArray() : archive.extract(archive.entries().at(index));
+	}
+
+	QFile file(hostPath);
+	if(not file.open(QIODevice::ReadOnly))
+		return QByteArray();
+	const QByteArray contents(gunzip(file.readAll()));
+	if(contents.isNull())
+		Log(FAC_ARCHIVE, error, QString("%1 is not a valid gzip file.").arg(hostPath));
+
+	return contents;
+} // readFile
+
+
+bool Archive::inflate(const uchar* pData, int length, QByteArray& decompressed, quint32 size)
+{
+	decompressed.clear();
+	// The size may still be a lie, only what is actually decoded is allocated beyond this.
+	decompressed.reserve(int(qMin(qint64(size), qint64(MAX_RESERVE))));
+	Inflater inflater(pData, length, decompressed, size);
+
+	return inflater.run();
+} // inflate
+
+
+QByteArray Archive::gunzip(const QByteArray& gzipped)
+{
+	const uchar* pData = bytes(gzipped);
+	const int size = gzipped.size();
+	if(size < GZIP_HEADER_SIZE + GZIP_TRAILER_SIZE or 0x1F not_eq pData[0] or 0x8B not_eq pData[1]
+		 or METHOD_DEFLATED not_eq pData[2])
+		return QByteArray();
+
+	// Skip the optional fields.
+	const uchar flags = pData[3];
+	const int end = size - GZIP_TRAILER_SIZE;
+	int pos = GZIP_HEADER_SIZE;
+	if(flags bitand GZIP_FLAG_EXTRA)
+		pos += 2 + (pos + 2 <= end ? le16(pData + pos) : 0);
+	if(flags bitand GZIP_FLAG_NAME) {
+		while(pos < end and 0 not_eq pData[pos])
+			++pos;
+		++pos;
+	}
+	if(flags bitand GZIP_FLAG_COMMENT) {
+		while(pos < end and 0 not_eq pData[pos])
+			++pos;
+		++pos;
+	}
+	if(flags bitand GZIP_FLAG_HEADER_CRC)
+		pos += 2;
+	if(pos > end)
+		return QByteArray();
+
+	const quint32 crc = le32(pData + end);
+	const quint32 contentsSize = le32(pData + end + 4);
+	QByteArray contents;
+	if(not inflate(pData + pos, end - pos, contents, contentsSize) or quint32(contents.size()) not_eq contentsSize
+		 or crc32(contents.constData(), contents.size()) not_eq crc)
+		return QByteArray();
+
+	return contents;
+} // gunzip
+
+
+quint32 Archive::crc32(const char* pData, int length)
+{
+	static const Crc32Table crcTable;
+	quint32 crc = 0xFFFFFFFF;
+	for(int i = 0; i < length; ++i)
+		crc = crcTable.table[(crc xor uchar(pData[i])) bitand 0xFF] xor (crc >> 8);
+
+	return crc xor 0xFFFFFFFF;
+} // crc32
+
+
+bool Archive::ZipArchive::open(const QString& path)
+{
+	close();
+	QFile file(path);
+	if(not file.open(QIODevice::ReadOnly))
+		return false;
+
+	// The end of central directory record is the last thing in the archive but for a comment.
+	const qint64 tailSize = qMin(file.size(), qint64(EOCD_SIZE + MAX_COMMENT_SIZE));
+	if(not file.seek(file.size() - tailSize))
+		return false;
+	const QByteArray tail(file.read(tailSize));
+	int eocd = tail.size() - EOCD_SIZE;
+	while(eocd >= 0 and EOCD_SIGNATURE not_eq le32(bytes(tail) + eocd))
+		--eocd;
+	if(eocd < 0)
+		return false;
+
+	const uchar* pEocd = bytes(tail) + eocd;
+	const int count = le16(pEocd + 10);
+	const quint32 directorySize = le32(pEocd + 12);
+	const quint32 directoryOffset = le32(pEocd + 16);
+	if(not file.seek(directoryOffset))
+		return false;
+	const QByteArray directory(file.read(directorySize));
+	if(quint32(directory.size()) not_eq directorySize)
+		return false;
+
+	const uchar* pDirectory = bytes(directory);
+	int pos = 0;
+	m_entries.reserve(count);
+	for(int i = 0; i < count; ++i) {
+		const uchar* pEntry = pDirectory + pos;
+		if(pos + CENTRAL_HEADER_SIZE > directory.size() or CENTRAL_SIGNATURE not_eq le32(pEntry))
+			break;
+		const ushort flags = le16(pEntry + 8);
+		const int nameLength = le16(pEntry + 28);
+		if(pos + CENTRAL_HEADER_SIZE + nameLength > directory.size())
+			break;
+
+		const char* pName = reinterpret_cast<const char*>(pEntry + CENTRAL_HEADER_SIZE);
+		Entry entry;
+		entry.name = flags bitand FLAG_UTF8 ? QString::fromUtf8(pName, nameLength) : QString::fromLatin1(pName, nameLength);
+		entry.name.replace('\\', '/');
+		entry.method = le16(pEntry + 10);
+		entry.crc = le32(pEntry + 16);
+		entry.compressedSize = le32(pEntry + 20);
+		entry.size = le32(pEntry + 24);
+		entry.localHeaderOffset = le32(pEntry + 42);
+		// Encrypted files can't be read, so they aren't there.
+		if(0 == (flags bitand FLAG_ENCRYPTED))
+			m_entries.append(entry);
+		pos += CENTRAL_HEADER_SIZE + nameLength + le16(pEntry + 30) + le16(pEntry + 32);
+	}
+	m_path = path;
+
+	return true;
+} // open
+
+
+void Archive::ZipArchive::close()
+{
+	m_path.clear();
+	m_entries.clear();
+} // close
+
+
+int Archive::ZipArchive::find(const QString& name) const
+{
+	for(int i = 0; i < m_entries.size(); ++i)
+		if(m_entries.at(i).name == name)
+			return i;
+	for(int i = 0; i < m_entries.size(); ++i)
+		if(0 == m_entries.at(i).name.compare(name, Qt::CaseInsensitive))
+			return i;
+
+	return -1;
+} // find
+
+
+bool Archive::ZipArchive::findDirectory(QString& dir) const
+{
+	if(dir.isEmpty())
+		return true;
+	foreach(const Entry& entry, m_entries)
+		if(entry.name.startsWith(dir))
+			return true;
+	foreach(const Entry& entry, m_entries) {
+		if(entry.name.startsWith(dir, Qt::CaseInsensitive)) {
+			dir = entry.name.left(dir.length());
+			return true;
+		}
+	}
+
+	return false;
+} // findDirectory
+
+
+QByteArray Archive::ZipArchive::extract(const Entry& entry) const
+{
+	QFile file(m_path);
+	if(not file.open(QIODevice::ReadOnly) or not file.seek(entry.localHeaderOffset))
+		return QByteArray();
+	const QByteArray header(file.read(LOCAL_HEADER_SIZE));
+	if(LOCAL_HEADER_SIZE not_eq header.size() or LOCAL_SIGNATURE not_eq le32(bytes(header)))
+		return QByteArray();
+	// The name and extra field in the local header may differ from the ones in the central directory.
+	const qint64 dataOffset = qint64(entry.localHeaderOffset) + LOCAL_HEADER_SIZE + le16(bytes(header) + 26)
+			+ le16(bytes(header) + 28);
+	if(not file.seek(dataOffset))
+		return QByteArray();
+	const QByteArray compressed(file.read(entry.compressedSize));
+	if(quint32(compressed.size()) not_eq entry.compressedSize)
+		return QByteArray();
+
+	QByteArray contents;
+	if(METHOD_STORED == entry.method)
+		contents = compressed;
+	else if(METHOD_DEFLATED not_eq entry.method) {
+		Log(FAC_ARCHIVE, error, QString("%1 in %2 is compressed with an unsupported method (%3).")
+				.arg(entry.name, m_path).arg(entry.method));
+		return QByteArray();
+	}
+	else if(not inflate(bytes(compressed), compressed.size(), contents, entry.size))
+		contents.clear();
+
+	if(quint32(contents.size()) not_eq entry.size or crc32(contents.constData(), contents.size()) not_eq entry.crc) {
+		Log(FAC_ARCHIVE, error, QString("%1 in %2 is broken.").arg(entry.name, m_path));
+		return QByteArray();
+	}
+
+	return contents;
+} // extract
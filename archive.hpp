@@ -0,0 +1,75 @@
+#ifndef ARCHIVE_HPP
+#define ARCHIVE_HPP
+
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+
+// Images kept compressed: zip archives, which are browsed as directories, and gzipped images (.d64.gz, .t64.gz). A file
+// in a zip archive has the path of the archive followed by its name in there, e.g. /games/disks.zip/sports/game.d64.
+// Of an archive only the central directory (the names and sizes) and the compressed bytes of the wanted file are read.
+// The decompression (deflate, RFC 1951) is done here as well, without any library.
+namespace Archive {
+
+// By the name: a zip archive, or a gzipped file.
+bool isZip(const QString& path);
+bool isGzip(const QString& path);
+// The name of a gzipped file without the ".gz", other names as they are.
+QString withoutGzip(const QString& name);
+
+// Splits the path of a compressed file into the file that is on the host (the zip archive, or the .gz) and the name of
+// the file in it (for a .gz its name without the ".gz"). False if the path is no compressed file.
+bool splitPath(const QString& path, QString& hostPath, QString& name);
+// The contents of the file, decompressed if it is a compressed one. A null QByteArray if it can't be read.
+QByteArray readFile(const QString& path);
+
+// Decompresses deflated data of the size given by its container (the size of the zip entry or the gzip trailer). False
+// if the data is broken or decompresses to more than that, which is checked while decoding.
+bool inflate(const uchar* pData, int length, QByteArray& decompressed, quint32 size);
+// The contents of a gzip file, a null QByteArray if it isn't one or is broken.
+QByteArray gunzip(const QByteArray& gzipped);
+quint32 crc32(const char* pData, int length);
+
+
+class ZipArchive
+{
+public:
+	struct Entry
+	{
+		// With the path in the archive, '/' separated. Directories end with a '/'.
+		QString name;
+		quint32 size;
+		quint32 compressedSize;
+		quint32 crc;
+		quint32 localHeaderOffset;
+		ushort method;
+	};
+
+	// Reads the names and sizes of all files from the central directory at the end of the archive. False if it isn't
+	// a zip archive.
+	bool open(const QString& path);
+	void close();
+	const QString& path() const
+	{
+		return m_path;
+	}
+	const QVector<Entry>& entries() const
+	{
+		return m_entries;
+	}
+
+	// The entry of a file by its name in the archive, matched without case if it isn't there as it is. -1 if none.
+	int find(const QString& name) const;
+	// Whether there are any files in the directory (given with the trailing '/'), the real name of it goes into dir.
+	bool findDirectory(QString& dir) const;
+	// The decompressed contents of the file, a null QByteArray if it can't be read.
+	QByteArray extract(const Entry& entry) const;
+
+private:
+	QString m_path;
+	QVector<Entry> m_entries;
+};
+
+} // namespace Archive
+
+#endif // ARCHIVE_HPP
@@ -0,0 +1,79 @@
+#-------------------------------------------------
+#
+# The headless core: Interface, file system drivers, DOS commands and the serial host.
+# No QtWidgets here, it is shared by the GUI (rpi2iec) and the console daemon (uno2iecd).
+#
+#-------------------------------------------------
+
+QT       = core serialport
+
+TARGET = uno2iec-core
+TEMPLATE = lib
+CONFIG += staticlib
+
+include(../uno2iec-common.pri)
+
+SOURCES += \
+				../t64driver.cpp \
+				../m2idriver.cpp \
+				../d64driver.cpp \
+				../diskgeometry.cpp \
+				../g64driver.cpp \
+				../gcrcodec.cpp \
+				../archive.cpp \
+				../filedriverbase.cpp \
+				../interface.cpp \
+				../nativefs.cpp \
+				../dircache.cpp \
+				../logger.cpp \
+				../x00fs.cpp \
+				../doscommands.cpp \
+				../x64driver.cpp \
+				../imagecache.cpp \
+				../filenamepattern.cpp \
+				../protocolstats.cpp \
+				../serialhost.cpp \
+				../protocolparser.cpp \
+				../drivecode.cpp \
+				../jobqueue.cpp \
+				../drivebuffers.cpp \
+				../mos6502.cpp \
+				../via6522.cpp \
+				../drive1541.cpp
+
+HEADERS += \
+				../t64driver.hpp \
+				../m2idriver.hpp \
+				../d64driver.hpp \
+				../diskgeometry.hpp \
+				../g64driver.hpp \
+				../gcrcodec.hpp \
+				../archive.hpp \
+				../filedriverbase.hpp \
+				../interface.hpp \
+				../nativefs.hpp \
+				../dircache.hpp \
+				../logger.hpp \
+				../x00fs.hpp \
+				../doscommands.hpp \
+				../uno2iec/cbmdefines.h \
+				../x64driver.hpp \
+				../utils.hpp \
+				../imagecache.hpp \
+				../filenamepattern.hpp \
+				../protocolstats.hpp \
+				../serialhost.hpp \
+				../spscqueue.hpp \
+				../protocolparser.hpp \
+				../drivecode.hpp \
+				../jobqueue.hpp \
+				../drivebuffers.hpp \
+				../mos6502.hpp \
+				../via6522.hpp \
+				../drive1541.hpp
+
+OTHER_FILES += \
+				../other/dos1541
+
+RESOURCES += \
+				../coreresources.qrc
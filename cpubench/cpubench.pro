@@ -0,0 +1,30 @@
+#-------------------------------------------------
+#
+# uno2iec-cpubench: Speed of the emulated 1541 CPU, and the 6502 functional test on it.
+#
+#-------------------------------------------------
+
+QT       = core
+
+TARGET = uno2iec-cpubench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../uno2iec-common.pri)
+include(../uno2iec-core.pri)
+
+SOURCES += main.cpp
+
+# "make functionaltest" runs Klaus Dormann's 6502 functional test on the emulated CPU, from the binary build of the
+# test repository (bin_files/6502_functional_test.bin) placed next to this file. Nothing is downloaded, the target
+# fails with a note when the binary isn't there. Its start and success trap addresses are the defaults of --start and
+# --success.
+unix {
+	FUNCTIONAL_TEST_BIN = $$PWD/6502_functional_test.bin
+	functionaltest.commands = @test -f $${FUNCTIONAL_TEST_BIN} \
+			|| (echo Missing $${FUNCTIONAL_TEST_BIN}, see github.com/Klaus2m5/6502_65C02_functional_tests; false)
+	functionaltest.commands += && ./$(TARGET) --functional $${FUNCTIONAL_TEST_BIN}
+	functionaltest.depends = $(TARGET)
+	QMAKE_EXTRA_TARGETS += functionaltest
+}
@@ -0,0 +1,291 @@
+//
+// Title	: uno2iec-cpubench - drive CPU emulation throughput and correctness
+//
+// Times the 6502 interpreter of the 1541 emulation (Drive1541) on a copy loop in drive RAM, reading the ROM and a VIA,
+// and prints the emulated clock against the 1 MHz of the real drive. Every run first checks ADC and SBC for all operands,
+// carries and both modes against the NMOS behaviour documented by Bruce Clark (decimal mode flags included), and that
+// drive code moving the serial bus lines with nothing but writes of $1800 (as it can after the ROM's setup of VIA1) is
+// recorded for the Arduino to replay.
+// With --functional it instead runs Klaus Dormann's 6502 functional test (6502_functional_test.bin, assembled as a
+// flat 64 KB image) on the bare CPU: The test traps into a jump to itself on a failure, and at the success address
+// when all tests passed.
+//
+// DISCLAIMER:
+// The author is in no way responsible for any problems or damage caused by
+// using this code. Use at your own risk.
+//
+// LICENSE:
+// This code is distributed under the GNU Public License
+// which can be found at http://www.gnu.org/licenses/gpl.txt
+//
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <stdio.h>
+#include <string.h>
+
+#include "drive1541.hpp"
+
+namespace {
+
+// The copy loop, at $0500: copies a ROM page to $0300 and XORs its bytes into $0400, then reads a VIA2 register.
+//	0500 LDX #$00
+//	0502 LDA $C000,X
+//	0505 STA $0300,X
+//	0508 EOR $0400
+//	050B STA $0400
+//	050E INX
+//	050F BNE $0502
+//	0511 INC $0401
+//	0514 LDA $1C0D
+//	0517 JMP $0500
+const ushort LOOP_ADDRESS = 0x0500;
+const uchar s_loop[] = {
+	0xA2, 0x00, 0xBD, 0x00, 0xC0, 0x9D, 0x00, 0x03, 0x4D, 0x00, 0x04, 0x8D, 0x00, 0x04, 0xE8, 0xD0, 0xF1,
+	0xEE, 0x01, 0x04, 0xAD, 0x0D, 0x1C, 0x4C, 0x00, 0x05
+};
+
+const double DRIVE_CLOCK_HZ = 1000000.0;
+
+// Pulls CLOCK, DATA too about 100 cycles later, then releases both.
+//	0500 LDA #$08
+//	0502 STA $1800
+//	0505 LDX #$13
+//	0507 DEX
+//	0508 BNE $0507
+//	050A LDA #$0A
+//	050C STA $1800
+//	050F LDA #$00
+//	0511 STA $1800
+//	0514 RTS
+const uchar s_busCode[] = {
+	0xA9, 0x08, 0x8D, 0x00, 0x18, 0xA2, 0x13, 0xCA, 0xD0, 0xFD, 0xA9, 0x0A, 0x8D, 0x00, 0x18, 0xA9, 0x00, 0x8D, 0x00,
+	0x18, 0x60
+};
+
+
+// What the CPU sees of the pages not mapped: the functional test and the arithmetic check map all of them to memory,
+// so nothing is read or written here.
+class FlatBus : public Mos6502::IBus
+{
+public:
+	uchar read(ushort address)
+	{
+		Q_UNUSED(address);
+		return 0xFF;
+	}
+
+	void write(ushort address, uchar value)
+	{
+		Q_UNUSED(address);
+		Q_UNUSED(value);
+	}
+};
+
+
+// ADC or SBC of the NMOS 6502 as documented in Bruce Clark's decimal mode tutorial (appendix A, 6502.org): the result
+// and the N, V, Z and C flags. In decimal mode the flags of SBC and the Z flag of ADC are those of the binary operation.
+uchar referenceArithmetic(bool isSbc, bool isDecimal, uchar a, uchar b, bool carry, uchar& flags)
+{
+	const int c = carry ? 1 : 0;
+	const uchar operand = isSbc ? uchar(~b) : b;
+	const int sum = a + operand + c;
+	const uchar binary = uchar(sum);
+	flags = (binary bitand Mos6502::FlagN) bitor (binary ? 0 : Mos6502::FlagZ) bitor (sum > 0xFF ? Mos6502::FlagC : 0);
+	if(((a xor binary) bitand (operand xor binary)) bitand 0x80)
+		flags or_eq Mos6502::FlagV;
+	if(not isDecimal)
+		return binary;
+
+	if(isSbc) {
+		int low = (a bitand 0x0F) - (b bitand 0x0F) + c - 1;
+		if(low < 0)
+			low = ((low - 0x06) bitand 0x0F) - 0x10;
+		int result = (a bitand 0xF0) - (b bitand 0xF0) + low;
+		if(result < 0)
+			result -= 0x60;
+		return uchar(result);
+	}
+	int low = (a bitand 0x0F) + (b bitand 0x0F) + c;
+	if(low >= 0x0A)
+		low = ((low + 0x06) bitand 0x0F) + 0x10;
+	int result = (a bitand 0xF0) + (b bitand 0xF0) + low;
+	// N and V of the sum before the high digit is adjusted, V of it as a signed sum.
+	const int signedResult = qint8(a bitand 0xF0) + qint8(b bitand 0xF0) + low;
+	flags and_eq ~(Mos6502::FlagN bitor Mos6502::FlagV bitor Mos6502::FlagC);
+	flags or_eq result bitand Mos6502::FlagN;
+	if(signedResult < -128 or signedResult > 127)
+		flags or_eq Mos6502::FlagV;
+	if(result >= 0xA0)
+		result += 0x60;
+	if(result >= 0x100)
+		flags or_eq Mos6502::FlagC;
+	return uchar(result);
+} // referenceArithmetic
+
+
+// ADC and SBC for all operands and carries, in binary and decimal mode, against referenceArithmetic(). Each one runs
+//	0200 LDA #flags
+//	0202 PHA
+//	0203 PLP
+//	0204 LDA #a
+//	0206 ADC #b (SBC #b)
+bool checkArithmetic()
+{
+	QByteArray memory(0x10000, 0);
+	FlatBus bus;
+	Mos6502 cpu(bus);
+	uchar* pMemory = reinterpret_cast<uchar*>(memory.data());
+	for(uint page = 0; page < 0x100; ++page)
+		cpu.mapPage(page, pMemory + page * 256, pMemory + page * 256);
+	static const uchar code[] = { 0xA9, 0x00, 0x48, 0x28, 0xA9, 0x00, 0x69, 0x00 };
+	memcpy(pMemory + 0x0200, code, sizeof(code));
+	cpu.reset();
+
+	const uchar flagsChecked = Mos6502::FlagN bitor Mos6502::FlagV bitor Mos6502::FlagZ bitor Mos6502::FlagC;
+	uint checked = 0, failed = 0;
+	for(int op = 0; op < 4; ++op) {
+		const bool isSbc = op bitand 1;
+		const bool isDecimal = op bitand 2;
+		pMemory[0x0206] = isSbc ? 0xE9 : 0x69;
+		for(uint operands = 0; operands < 0x20000; ++operands) {
+			const uchar a = operands >> 8;
+			const uchar b = operands;
+			const bool carry = operands >> 16;
+			pMemory[0x0201] = (isDecimal ? Mos6502::FlagD : 0) bitor (carry ? Mos6502::FlagC : 0);
+			pMemory[0x0205] = a;
+			pMemory[0x0207] = b;
+			cpu.setPc(0x0200);
+			for(int i = 0; i < 5; ++i)
+				cpu.step();
+			uchar flags;
+			const uchar result = referenceArithmetic(isSbc, isDecimal, a, b, carry, flags);
+			++checked;
+			if(cpu.a() == result and (cpu.p() bitand flagsChecked) == flags)
+				continue;
+			if(not failed++)
+				printf("%s $%02X %s $%02X, C=%d: $%02X P=%02X, expected $%02X P=%02X\n", isDecimal ? "Decimal" : "Binary", a,
+							 isSbc ? "-" : "+", b, carry, cpu.a(), cpu.p() bitand flagsChecked, result, flags);
+		}
+	}
+	printf("ADC and SBC: %u of %u operations as documented.\n", checked - failed, checked);
+	return not failed;
+} // checkArithmetic
+
+
+int runFunctionalTest(const QString& fileName, ushort startAddress, ushort successAddress)
+{
+	QFile file(fileName);
+	if(not file.open(QIODevice::ReadOnly)) {
+		fprintf(stderr, "Could not read %s\n", qPrintable(fileName));
+		return 1;
+	}
+	QByteArray memory(file.readAll());
+	memory.resize(0x10000);
+
+	FlatBus bus;
+	Mos6502 cpu(bus);
+	uchar* pMemory = reinterpret_cast<uchar*>(memory.data());
+	for(uint page = 0; page < 0x100; ++page)
+		cpu.mapPage(page, pMemory + page * 256, pMemory + page * 256);
+	cpu.setPc(startAddress);
+
+	QElapsedTimer timer;
+	timer.start();
+	// Run until a trap: an instruction that leaves the PC where it was (JMP * or a branch to itself).
+	ushort lastPc;
+	do {
+		lastPc = cpu.pc();
+		cpu.step();
+	} while(cpu.pc() not_eq lastPc and not cpu.isJammed());
+	const qint64 elapsed = qMax(timer.nsecsElapsed(), qint64(1));
+
+	const bool success = successAddress == cpu.pc();
+	printf("Functional test %s at $%04X after %llu instructions, %llu cycles (%.1f emulated MHz).\n",
+				 success ? "passed" : "FAILED", cpu.pc(), cpu.instructions(), cpu.cycles(), cpu.cycles() * 1000.0 / elapsed);
+	if(not success)
+		printf("A=%02X X=%02X Y=%02X S=%02X P=%02X, see the listing of the test for what failed at that address.\n",
+					 cpu.a(), cpu.x(), cpu.y(), cpu.s(), cpu.p());
+	return success ? 0 : 1;
+} // runFunctionalTest
+
+
+// The replay of s_busCode: the three changes of the lines, in order.
+bool checkBusReplay()
+{
+	Drive1541 drive;
+	drive.writeMemory(LOOP_ADDRESS, reinterpret_cast<const char*>(s_busCode), sizeof(s_busCode));
+	const bool returned = drive.execute(LOOP_ADDRESS, 10000);
+	const QByteArray replay(drive.takeBusReplay());
+
+	static const uchar expectedLines[] = { BUS_REPLAY_CLOCK, BUS_REPLAY_CLOCK bitor BUS_REPLAY_DATA, 0 };
+	bool ok = returned and int(sizeof(expectedLines)) * BUS_REPLAY_ENTRY_SIZE == replay.size();
+	printf("Bus replay of code writing $1800:");
+	for(int i = 0; i + BUS_REPLAY_ENTRY_SIZE <= replay.size(); i += BUS_REPLAY_ENTRY_SIZE) {
+		const ushort delay = uchar(replay.at(i)) bitor (uchar(replay.at(i + 1)) << 8);
+		const uchar lines = uchar(replay.at(i + 2));
+		printf(" +%u cycles %s%s%s", delay, lines bitand BUS_REPLAY_CLOCK ? "C" : "", lines bitand BUS_REPLAY_DATA ? "D" : "",
+					 lines ? "" : "-");
+		ok = ok and expectedLines[i / BUS_REPLAY_ENTRY_SIZE] == lines;
+	}
+	printf("%s\n", ok ? "" : " - NOT AS WRITTEN");
+	return ok;
+} // checkBusReplay
+
+
+int runThroughput(quint64 cycles)
+{
+	QFile romFile(":/roms/rom_1541");
+	if(not romFile.open(QIODevice::ReadOnly)) {
+		fprintf(stderr, "Could not open the 1541 ROM %s\n", qPrintable(romFile.fileName()));
+		return 1;
+	}
+	Drive1541 drive;
+	drive.setRom(romFile.readAll());
+	drive.writeMemory(LOOP_ADDRESS, reinterpret_cast<const char*>(s_loop), sizeof(s_loop));
+
+	QElapsedTimer timer;
+	timer.start();
+	drive.execute(LOOP_ADDRESS, cycles);
+	const qint64 elapsed = qMax(timer.nsecsElapsed(), qint64(1));
+
+	const Mos6502& cpu = drive.cpu();
+	const double emulatedHz = cpu.cycles() * 1000000000.0 / elapsed;
+	printf("%llu instructions, %llu cycles in %.3f s: %.1f emulated MHz, %.1f times a real 1541.\n",
+				 cpu.instructions(), cpu.cycles(), elapsed / 1000000000.0, emulatedHz / 1000000.0, emulatedHz / DRIVE_CLOCK_HZ);
+	return 0;
+} // runThroughput
+
+} // unnamed namespace
+
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication a(argc, argv);
+	// The ROM is a resource of the core library.
+	Q_INIT_RESOURCE(coreresources);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Measures the speed of the emulated 1541 CPU, or runs the 6502 functional test.");
+	parser.addHelpOption();
+	QCommandLineOption cyclesOption(QStringList() << "c" << "cycles", "Drive cycles to run the copy loop for.", "cycles",
+																	"100000000");
+	QCommandLineOption functionalOption(QStringList() << "f" << "functional",
+																			"Run the 6502 functional test binary (a 64 KB image) instead.", "file");
+	QCommandLineOption startOption("start", "Start address of the functional test (hex).", "address", "0400");
+	QCommandLineOption successOption("success", "Address the functional test traps at on success (hex).", "address",
+																	 "3469");
+	parser.addOption(cyclesOption);
+	parser.addOption(functionalOption);
+	parser.addOption(startOption);
+	parser.addOption(successOption);
+	parser.process(a);
+
+	if(parser.isSet(functionalOption))
+		return runFunctionalTest(parser.value(functionalOption), parser.value(startOption).toUShort(0, 16),
+														 parser.value(successOption).toUShort(0, 16));
+	const bool checked = checkArithmetic() and checkBusReplay();
+	return runThroughput(parser.value(cyclesOption).toULongLong()) or not checked ? 1 : 0;
+} // main
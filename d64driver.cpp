@@ -1,10 +1,17 @@
 #include "d64driver.hpp"
 #include "logger.hpp"
+#include "imagecache.hpp"
+#include "filenamepattern.hpp"
+#include "archive.hpp"
 
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QtAlgorithms>
 #ifdef CONSOLE_DEBUG
 #include <QDebug>
 #endif
 #include <math.h>
+#include <string.h>
 
 using namespace Logging;
 
@@ -13,41 +20,74 @@ namespace {
 #define D64_BLOCK_SIZE 256  // Actual block size
 #define D64_BLOCK_DATA 254  // Data capacity of block
 
-#define D64_FIRSTDIR_TRACK  18
-#define D64_FIRSTDIR_SECTOR 1
+// Disk name, id and dos type in the header sector, the id is 18 bytes in.
+#define D64_HEADER_SIZE      23
+#define D64_HEADER_ID_OFFSET 0x12
 
-#define D64_BAM_TRACK  18
-#define D64_BAM_SECTOR 0
-
-#define D64_BAM_DISKNAME_OFFSET 0x90
-
-#define D64_IMAGE_SIZE 174848
+#define D64_DIR_SLOT_SIZE  32
+#define D64_FILE_NAME_SIZE 16
 
 typedef struct {
 		uchar disk_name[16]; // disk name padded with A0
 		uchar disk_id[5];    // disk id and dos type
 } D64DiskInfo;
 
-// Sectors p. track table
-// sectors_track[3] is the number of sectors in track 4 (!)
-//
-const uchar sectorsPerTrack[40] = {
-		21,21,21,21,21,21,21,21,21,21,21,21,21,21,21,21,21,
-		19,19,19,19,19,19,19,
-		18,18,18,18,18,18,
-		17,17,17,17,17,17,17,17,17,17
-};
-
 const QString strFileTypes[] = { "DEL", "SEQ", "PRG", "USR", "REL", "???" };
 const QString strBlocksFree("BLOCKS FREE.");
 const QString strD64Error("ERROR: D64");
 
+
+// A file name given to the DOS without any drive number prefix, e.g. "0:NAME" is NAME.
+QByteArray withoutDrive(const QString& fileName)
+{
+		const QByteArray name(fileName.toLatin1());
+		int colon = name.indexOf(':');
+		for(int i = 0; i < colon; ++i)
+				if(name.at(i) < '0' or name.at(i) > '9')
+						colon = -1;
+
+		return name.mid(colon + 1);
+} // withoutDrive
+
+
+// Names in the BAM and the directory are padded with A0.
+QByteArray padded(const QByteArray& name, int length)
+{
+		return FileNamePattern(QString::fromLatin1(name)).paddedName(length);
+} // padded
+
+
+// The sector to continue a chain from. Like the 1541 DOS, passing the end of the track starts over one sector earlier
+// so that successive rounds don't hit the same sectors.
+uchar nextInterleaved(uchar sector, uchar interleave, uchar count)
+{
+		sector += interleave;
+		if(sector >= count) {
+				sector -= count;
+				if(0 not_eq sector)
+						--sector;
+		}
+
+		return sector;
+} // nextInterleaved
+
+
+// The error info byte of a block: 0 and 1 read fine, 2-11 are the errors 20-29 of the 1541, 15 is drive not ready.
+CBM::IOErrorMessage errorFromInfo(uchar info)
+{
+		if(info >= 2 and info <= 11)
+				return static_cast<CBM::IOErrorMessage>(CBM::ErrBlockHeaderNotFound + info - 2);
+
+		return 15 == info ? CBM::ErrDriveNotReady : CBM::ErrOK;
+} // errorFromInfo
+
 } // anonymous
 
 
 D64::D64(const QString& fileName)
-		: FileDriverBase(), m_hostFile(fileName), m_currentTrack(0), m_currentSector(0), m_currentOffset(0),
-				m_currentLinkTrack(0), m_currentLinkSector(0)
+		: FileDriverBase(), m_hostFile(fileName), m_pLayout(&DiskLayout::d64()), m_pImage(0), m_imageSize(0), m_hostPos(0), m_currentTrack(0), m_currentSector(0), m_currentOffset(0),
+				m_currentLinkTrack(0), m_currentLinkSector(0), m_blocksFree(0), m_listingPos(0), m_dirty(false),
+				m_writeSlot(-1), m_replacedSlot(-1), m_writeTrack(0), m_writeSector(0), m_writeOffset(0), m_writeBlocks(0)
 {
 		if(not fileName.isEmpty())
 				mountHostImage(fileName);
@@ -64,12 +104,19 @@ bool D64::mountHostImage(const QString& fileName)
 {
 		unmountHostImage();
 		m_hostFile.setFileName(fileName);
-		if(m_hostFile.open(QIODevice::ReadOnly)) {
-				// Check if file is a valid disk image by the simple criteria that
-				// file size is at least 174.848
-				if(hostSize() >= D64_IMAGE_SIZE) {
+		// All reading is done from memory, the whole image is kept by the image cache between mounts.
+		m_image = loadImage(fileName);
+		if(not m_image.isNull()) {
+				m_pImage = reinterpret_cast<const uchar*>(m_image.constData());
+				m_imageSize = m_image.size();
+				m_hostPos = 0;
+				// Check if file is a valid disk image by the simple criteria that the file has all blocks of the format.
+				const DiskLayout* pLayout = layoutFor(hostSize());
+				if(0 not_eq pLayout) {
+						m_pLayout = pLayout;
 						m_status = IMAGE_OK;
 						m_lastName = QString("Image: ") + fileName;
+						buildDirectoryIndex();
 						return true;
 				}
 		}
@@ -80,10 +127,37 @@ bool D64::mountHostImage(const QString& fileName)
 } // mountHostImage
 
 
+// The size tells the 35 and 40 track images apart, both may have the error info bytes after the blocks.
+const DiskLayout* D64::layoutFor(qint32 imageSize) const
+{
+		if(imageSize >= DiskLayout::d64Extended().imageSize())
+				return &DiskLayout::d64Extended();
+		if(imageSize >= DiskLayout::d64().imageSize())
+				return &DiskLayout::d64();
+
+		return 0;
+} // layoutFor
+
+
+QByteArray D64::loadImage(const QString& fileName) const
+{
+		return imageCache().image(fileName);
+} // loadImage
+
+
 void D64::unmountHostImage()
 {
-		if(not m_hostFile.fileName().isEmpty() and m_hostFile.isOpen())
-				m_hostFile.close();
+		// A file still being saved is left unclosed on the disk, as with a reset 1541.
+		m_writeSlot = m_replacedSlot = -1;
+		flush();
+		m_dirty = false;
+		m_dirIndex.clear();
+		m_nameIndex.clear();
+		m_diskHeader.clear();
+		m_blocksFree = 0;
+		m_image.clear();
+		m_pImage = 0;
+		m_imageSize = m_hostPos = 0;
 		m_status = NOT_READY;
 } // unmountHostImage
 
@@ -95,44 +169,12 @@ void D64::unmountHostImage()
 //
 void D64::seekBlock(uchar track, uchar sector)
 {
-		ushort absSector;
-		ulong absOffset;
-		uchar i;
-
-#ifdef CONSOLE_DEBUG
-		//qDebug() << "seekblock: " << track << " " << sector << " ";
-#endif
-
-		// Change 1 based track notion to 0 based
-		track--;
-
-		//   // Sanity check track value
-		//   if (track > 39) {
-		//     m_status = 0;
-		//     return;
-		//   }
-		//
-		//   // Sanity check sector value
-		//   if (sector > pgm_read_byte_near(&(sectors_track[track]))) {
-		//     m_status = 0;
-		//     return;
-		//   }
-
-		// Calculate absolute sector number
-		absSector = sector;
-		for(i = 0; i < track; i++)
-				absSector += sectorsPerTrack[i];
-
-		// Calculate absolute file offset
-		absOffset = absSector * 256;
-
-#ifdef CONSOLE_DEBUG
-		//qDebug() << absOffset << endl;
-#endif
+		// The offset is looked up in the tables of the image format.
+		const qint32 offset = sectorOffset(track, sector);
 
 		// Seek to that position if possible
-		if(absOffset < static_cast<ulong>(hostSize())) {
-				hostSeek(absOffset);
+		if(offset >= 0) {
+				hostSeek(offset);
 
 				// Read in link to next block
 				m_currentLinkTrack = hostReadByte();
@@ -148,6 +190,13 @@ void D64::seekBlock(uchar track, uchar sector)
 } // seekBlock
 
 
+qint32 D64::sectorOffset(uchar track, uchar sector) const
+{
+		const qint32 offset = m_pLayout->offset(track, sector);
+		return offset + D64_BLOCK_SIZE <= hostSize() ? offset : -1;
+} // sectorOffset
+
+
 bool D64::isEOF(void) const
 {
 		return not(m_status bitand IMAGE_OK) or not(m_status bitand FILE_OPEN)
@@ -159,33 +208,48 @@ bool D64::isEOF(void) const
 //
 char D64::getc(void)
 {
-		uchar ret = 0;
+		char ret = 0;
+		read(&ret, 1);
+
+		return ret;
+} // getc
 
-		// Check status
-		if(not isEOF()) {
-				ret = hostReadByte();
 
-				if(255 == m_currentOffset) {
-						// We need to go to a new block, end of file?
-						if(m_currentLinkTrack not_eq 0) {
-								// Seek the next block:
-								seekBlock(m_currentLinkTrack, m_currentLinkSector);
+// Copies file data sector by sector. In the last sector of the chain the link sector byte is instead the
+// offset of the last used byte, so only that much of it is file data.
+int D64::read(char* dst, int max)
+{
+		int total = 0;
+
+		while(total < max and not isEOF()) {
+				int blockEnd = 0 not_eq m_currentLinkTrack ? D64_BLOCK_SIZE : m_currentLinkSector + 1;
+				int count = qMin(blockEnd - m_currentOffset, max - total);
+				if(count > 0) {
+						if(m_hostPos + count > hostSize()) {
+								m_status = FILE_EOF; // truncated image.
+								break;
 						}
-						else
-								m_status or_eq FILE_EOF;
-
+						memcpy(dst + total, m_pImage + m_hostPos, count);
+						m_hostPos += count;
+						total += count;
 				}
+				if(m_currentOffset + count < blockEnd)
+						m_currentOffset += count;
+				else if(0 not_eq m_currentLinkTrack)
+						seekBlock(m_currentLinkTrack, m_currentLinkSector);
 				else
-						m_currentOffset++;
+						m_status or_eq FILE_EOF;
 		}
 
-		return ret;
-} // getc
+		return total;
+} // read
 
 
 
 bool D64::close(void)
 {
+		if(-1 not_eq m_writeSlot)
+				finishWrite();
 		m_status and_eq IMAGE_OK;  // Clear all flags except disk ok
 
 		return true;
@@ -196,7 +260,7 @@ bool D64::seekFirstDir(void)
 {
 		if(m_status bitand IMAGE_OK) {
 				// Seek to first dir entry
-				seekBlock(D64_FIRSTDIR_TRACK, D64_FIRSTDIR_SECTOR);
+				seekBlock(m_pLayout->geometry().dirTrack, m_pLayout->geometry().dirSector);
 
 				// Set correct status
 				m_status = IMAGE_OK bitor DIR_OPEN;
@@ -252,23 +316,62 @@ bool D64::getDirEntry(DirEntry& dir)
 
 bool D64::getDirEntryByName(D64::DirEntry &dir, const QString &name)
 {
-		// Now for the list entries
-		seekFirstDir();
-		while(getDirEntry(dir)) {
-				if(name == dir.name()) // found it?
+		const FileNamePattern pattern(name);
+		foreach(const DirEntry& entry, m_dirIndex) {
+				if(pattern.matches(entry.m_name, sizeof(entry.m_name))) { // found it?
+						dir = entry;
 						return true;
+				}
 		}
 		// no match.
 		return false;
-} // getDirEntry
+} // getDirEntryByName
+
+
+// Reads all used directory entries, the disk name and the free block count into memory so that listings and file
+// lookups never have to walk the directory track again.
+void D64::buildDirectoryIndex()
+{
+		m_dirIndex.clear();
+		m_nameIndex.clear();
+
+		seekToDiskName();
+		m_diskHeader = QByteArray(reinterpret_cast<const char*>(m_pImage + m_hostPos), D64_HEADER_SIZE);
+
+		// Free blocks are counted from the BAM bitmaps of all tracks except the directory (and other system) track.
+		m_blocksFree = 0;
+		for(uchar track = 1; track <= m_pLayout->geometry().tracks; ++track)
+				if(not m_pLayout->isSystemTrack(track))
+						m_blocksFree += freeOnTrack(track);
+
+		seekFirstDir();
+		DirEntry dir;
+		// Upper limit of directory entries followed, so that a directory chain looping on itself in a broken image ends.
+		const int maxEntries = 8 * m_pLayout->blocks();
+		int numEntries = 0;
+		while(numEntries++ < maxEntries and getDirEntry(dir)) {
+				// Determine if dir entry is valid, a scratched file has type 0:
+				if(0 == dir.m_type or 0 == dir.m_track)
+						continue;
+				uchar fileType = dir.m_type bitand FILE_TYPE_MASK;
+				const QByteArray key(reinterpret_cast<const char*>(dir.m_name), sizeof(dir.m_name));
+				if((SEQ == fileType or PRG == fileType) and not m_nameIndex.contains(key))
+						m_nameIndex.insert(key, m_dirIndex.size());
+				m_dirIndex.append(dir);
+		}
+		m_status = IMAGE_OK;
+} // buildDirectoryIndex
 
 
 uchar D64::hostReadByte(uint length)
 {
-		char theByte;
-		qint64 numRead(m_hostFile.read(&theByte, length));
-		if(numRead < length) // shouldn't happen?
+		uchar theByte = 0;
+		if(m_hostPos + static_cast<qint32>(length) > hostSize()) // shouldn't happen?
 				m_status = FILE_EOF;
+		else {
+				theByte = m_pImage[m_hostPos];
+				m_hostPos += length;
+		}
 
 		return theByte;
 } // hostReadByte
@@ -277,9 +380,12 @@ uchar D64::hostReadByte(uint length)
 bool D64::hostSeek(qint32 pos, bool relative)
 {
 		if(relative)
-				pos += m_hostFile.pos();
+				pos += m_hostPos;
+		if(pos < 0 or pos > hostSize())
+				return false;
+		m_hostPos = pos;
 
-		return m_hostFile.seek(pos);
+		return true;
 } // hostSeek
 
 
@@ -292,11 +398,12 @@ bool D64::hostSeek(qint32 pos, bool relative)
 void D64::seekToDiskName(void)
 {
 		if(m_status bitand IMAGE_OK) {
-				// Seek BAM block
-				seekBlock(D64_BAM_TRACK, D64_BAM_SECTOR);
+				// Seek header block, the BAM block for most formats
+				const DiskGeometry& geometry(m_pLayout->geometry());
+				seekBlock(geometry.headerTrack, geometry.headerSector);
 
 				// Seek to disk name (-2 because seek_block already skips two bytes)
-				hostSeek(D64_BAM_DISKNAME_OFFSET - 2, true);
+				hostSeek(geometry.headerOffset - 2, true);
 
 				// Status now is no file open as such
 				m_status = IMAGE_OK;
@@ -306,62 +413,39 @@ void D64::seekToDiskName(void)
 
 ushort D64::blocksFree(void)
 {
-		// Not implemented yet
-		return 0;
-}
+		return m_blocksFree;
+} // blocksFree
 
 // Opens a file. Filename * will open first file with PRG status
 //
 bool D64::fopen(const QString& fileName)
 {
-		bool found = false;
-		uchar len;
-		uchar i;
-
-		len = fileName.length();
-		if(len > sizeof(m_currDirEntry.m_name))
-				len = sizeof(m_currDirEntry.m_name);
-
-		seekFirstDir();
-
-		while(not found and getDirEntry(m_currDirEntry)) {
-
-				// Acceptable filetype?
-				i = m_currDirEntry.m_type bitand FILE_TYPE_MASK;
-				if(SEQ == i or PRG == i) {
-
-						// Compare filename respecting * and ? wildcards
-						found = true;
-						for(i = 0; i < len and found; i++) {
-								if('?' == fileName[i]) {
-										// This character is ignored
-								}
-								else if('*' == fileName[i]) {
-										// No need to check more chars
-										break;
-								}
-								else
-										found = fileName[i] == m_currDirEntry.m_name[i];
-						}
-
-						// If searched to end of filename, dir.file_name must end here also
-						if(found and (i == len))
-								if(len < 16)
-										found = m_currDirEntry.m_name[i] == 0xA0;
+		const FileNamePattern pattern(fileName.left(sizeof(m_currDirEntry.m_name)));
+		int index = -1;
 
+		if(pattern.hasWildcards()) {
+				// Compare filename respecting * and ? wildcards, first acceptable match wins.
+				for(int i = 0; i < m_dirIndex.size() and -1 == index; ++i) {
+						const DirEntry& dir(m_dirIndex.at(i));
+						uchar fileType = dir.m_type bitand FILE_TYPE_MASK;
+						if((SEQ == fileType or PRG == fileType) and pattern.matches(dir.m_name, sizeof(dir.m_name)))
+								index = i;
 				}
 		}
+		else
+				index = m_nameIndex.value(pattern.paddedName(sizeof(m_currDirEntry.m_name)), -1);
 
-		if(found) {
+		if(-1 not_eq index) {
 				// File found. Jump to block and set correct state
+				m_currDirEntry = m_dirIndex.at(index);
 				seekBlock(m_currDirEntry.track(), m_currDirEntry.sector());
 				m_status = (FSStatus)(IMAGE_OK bitor FILE_OPEN);
 				m_lastName = fileName;
+				return true;
 		}
-		else
-				m_lastName.clear();
+		m_lastName.clear();
 
-		return found;
+		return false;
 } // fopen
 
 
@@ -379,19 +463,58 @@ ushort D64::openedFileSize() const
 
 bool D64::sendListing(ISendLine& cb)
 {
+		openListing();
+		while(listNextLine(cb));
+
+		return true;
+} // sendListing
+
+
+bool D64::openListing()
+{
+		m_listingPos = -1;
+
+		return true;
+} // openListing
+
+
+bool D64::listNextLine(ISendLine& cb)
+{
+		// Entries the listing filter doesn't ask for are skipped.
+		if(m_listingPos >= 0) {
+				while(m_listingPos < m_dirIndex.size() and not isListed(m_dirIndex.at(m_listingPos)))
+						++m_listingPos;
+		}
 		if(not (m_status bitand IMAGE_OK)) {
 				// We are not happy with the d64 file
+				if(-1 not_eq m_listingPos)
+						return false;
 				cb.send(0, strD64Error);
-				return true;
 		}
+		else if(-1 == m_listingPos)
+				sendListingHeader(cb);
+		else if(m_listingPos < m_dirIndex.size())
+				sendListingEntry(cb, m_dirIndex.at(m_listingPos));
+		else if(m_listingPos == m_dirIndex.size()) {
+				// Send line with blocks free
+				QString blkFree(QString(strBlocksFree) + QString(13, ' '));
+				cb.send(blocksFree(), blkFree);
+		}
+		else
+				return false;
+		++m_listingPos;
+
+		return true;
+} // listNextLine
 
-		// Send line with disc name and stuff, 25 chars
-		seekToDiskName();
 
+void D64::sendListingHeader(ISendLine& cb)
+{
+		// Send line with disc name and stuff, 25 chars
 		QString line("\x12\x22"); // Invert face, "
 
 		for(uchar i = 2; i < 25; i++) {
-				uchar c = hostReadByte();
+				uchar c = m_diskHeader.at(i - 2);
 
 				if(0xA0 == c) // Convert padding A0 to spaces
 						c = ' ';
@@ -402,66 +525,63 @@ bool D64::sendListing(ISendLine& cb)
 				line += c;
 		}
 		cb.send(0, line);
+} // sendListingHeader
 
-		// Now for the list entries
-		seekFirstDir();
 
-		DirEntry dir;
-		while(getDirEntry(dir)) {
-				// Determine if dir entry is valid:
-				if(dir.m_track not_eq 0) {
-						// A direntry always takes 32 bytes total = 27 chars
-						// Send filename until A0 or 16 chars
-						QString name(17, QChar(' '));
-						uchar i;
-						for(i = 0; i < sizeof(dir.m_name); ++i) {
-								uchar c = dir.m_name[i];
-								if(0xA0 == c)
-										break;  // Filename is no longer
-								name[i] = c;
-						}
-						// Ending name with dbl quotes
-						name[i] = QChar('"');
+void D64::sendListingEntry(ISendLine& cb, const DirEntry& dir)
+{
+		// A direntry always takes 32 bytes total = 27 chars
+		// Send filename until A0 or 16 chars
+		QString name(17, QChar(' '));
+		uchar i;
+		for(i = 0; i < sizeof(dir.m_name); ++i) {
+				uchar c = dir.m_name[i];
+				if(0xA0 == c)
+						break;  // Filename is no longer
+				name[i] = c;
+		}
+		// Ending name with dbl quotes
+		name[i] = QChar('"');
 
-						// Write filetype
-						uchar fileType = dir.m_type bitand FILE_TYPE_MASK;
-						if(fileType > NumD64FileTypes)
-								fileType = NumD64FileTypes; // Limit to Unknown type (???) when out of range.
+		// Write filetype
+		uchar fileType = dir.m_type bitand FILE_TYPE_MASK;
+		if(fileType > NumD64FileTypes)
+				fileType = NumD64FileTypes; // Limit to Unknown type (???) when out of range.
 
-						// Prepare buffer
-						line = QString("   \"%1 %2%3%4").arg(name) // %s  %s%c%c
-										.arg(strFileTypes[fileType])
-										.arg((dir.m_type bitand FILE_LOCKED) ? '<' : ' ') // Perhaps write locked symbol
-										.arg(not (dir.m_type bitand FILE_CLOSED) ? '*' : ' ');	// Perhaps write splat symbol
+		// Prepare buffer
+		QString line = QString("   \"%1 %2%3%4").arg(name) // %s  %s%c%c
+						.arg(strFileTypes[fileType])
+						.arg((dir.m_type bitand FILE_LOCKED) ? '<' : ' ') // Perhaps write locked symbol
+						.arg(not (dir.m_type bitand FILE_CLOSED) ? '*' : ' ');	// Perhaps write splat symbol
 
-						// Line number is filesize in blocks:
-						ushort fileSize = dir.m_blocksLo + (dir.m_blocksHi << 8);
+		// Line number is filesize in blocks:
+		ushort fileSize = dir.m_blocksLo + (dir.m_blocksHi << 8);
 
-						// Send initial spaces (offset) according to file size
-						cb.send(fileSize, line.mid((int)log10((double)fileSize)));
-				}
-		}
+		// Send initial spaces (offset) according to file size
+		cb.send(fileSize, line.mid((int)log10((double)fileSize)));
+} // sendListingEntry
 
-		// Send line with 0 blocks free
-		QString blkFree(QString(strBlocksFree) + QString(13, ' '));
-		cb.send(0, blkFree);
 
-		return true;
-} // sendListing
+// By the name and the first letter of the file type, as the listing shows it.
+bool D64::isListed(const DirEntry& dir) const
+{
+		if(listingFilter().isEmpty())
+				return true;
+		uchar fileType = dir.m_type bitand FILE_TYPE_MASK;
+		if(fileType > NumD64FileTypes)
+				fileType = NumD64FileTypes;
+
+		return listingFilter().matches(dir.m_name, sizeof(dir.m_name), strFileTypes[fileType].at(0).toLatin1());
+} // isListed
 
 
 bool D64::sendMediaInfo(ISendLine &cb)
 {
 		// TODO: Improve this with information about the file system type AND, usage and free data.
 		Log("D64", info, "sendMediaInfo.");
-		cb.send(0, QString("D64 FS -> %1").arg(m_hostFile.fileName().toUpper()));
-		cb.send(1, QString("FILE SIZE: %1").arg(QString::number(m_hostFile.size())));
-		seekFirstDir();
-		ushort entryCnt = 0;
-		DirEntry dir;
-		while(getDirEntry(dir))
-				entryCnt++;
-		cb.send(2, QString("%1 ENTRIES IN IMAGE.").arg(QString::number(entryCnt)));
+		cb.send(0, QString("%1 FS -> %2").arg(m_pLayout->geometry().name, m_hostFile.fileName().toUpper()));
+		cb.send(1, QString("FILE SIZE: %1").arg(QString::number(hostSize())));
+		cb.send(2, QString("%1 ENTRIES IN IMAGE.").arg(QString::number(m_dirIndex.size())));
 
 		return true;
 } // sendMediaInfo
@@ -477,12 +597,577 @@ D64::DirEntry::~DirEntry()
 } // dtor
 
 
+// Without an id only the BAM and the directory are cleared and the disk keeps its id, with one all blocks are.
 CBM::IOErrorMessage D64::newDisk(const QString& name, const QString& id)
 {
-	return FileDriverBase::newDisk(name, id);
+		if(not (m_status bitand IMAGE_OK))
+				return CBM::ErrDriveNotReady;
+		if(not isWritable())
+				return CBM::ErrWriteProtectOn;
+
+		const DiskGeometry& geometry(m_pLayout->geometry());
+		uchar* pImage = modifyImage();
+		uchar* pHeader = pImage + sectorOffset(geometry.headerTrack, geometry.headerSector);
+		QByteArray diskId(id.toLatin1().left(2));
+		if(diskId.isEmpty())
+				diskId = QByteArray(reinterpret_cast<const char*>(pHeader + geometry.headerOffset + D64_HEADER_ID_OFFSET), 2);
+		else
+				memset(pImage, 0, m_imageSize);
+		diskId = padded(diskId, 2);
+
+		// The BAM sectors, with their own link, DOS version and id where they aren't the header sector.
+		for(uchar i = 0; i < geometry.numBamRegions; ++i) {
+				const BamRegion& region(geometry.bam[i]);
+				memset(pImage + sectorOffset(region.countTrack, region.countSector), 0, D64_BLOCK_SIZE);
+				memset(pImage + sectorOffset(region.bitmapTrack, region.bitmapSector), 0, D64_BLOCK_SIZE);
+				if(geometry.bamSectorHeaders) {
+						uchar* pBam = pImage + sectorOffset(region.countTrack, region.countSector);
+						const bool isLast = i + 1 == geometry.numBamRegions;
+						pBam[0] = isLast ? 0 : geometry.bam[i + 1].countTrack;
+						pBam[1] = isLast ? 0xFF : geometry.bam[i + 1].countSector;
+						pBam[2] = geometry.dosVersion;
+						pBam[3] = ~geometry.dosVersion;
+						memcpy(pBam + 4, diskId.constData(), 2);
+						pBam[6] = 0xC0; // I/O byte: verify on, check header CRC.
+				}
+		}
+		memset(pHeader, 0, D64_BLOCK_SIZE);
+		pHeader[0] = geometry.dirTrack;
+		pHeader[1] = geometry.dirSector;
+		pHeader[2] = geometry.dosVersion;
+		pHeader[3] = geometry.headerFlags;
+		for(uchar track = 1; track <= geometry.tracks; ++track)
+				for(uchar sector = 0; sector < m_pLayout->sectors(track); ++sector)
+						setBlockFree(track, sector, true);
+		allocateSystemBlocks();
+		// Disk name, id and DOS type, all padded with A0.
+		uchar* pName = pHeader + geometry.headerOffset;
+		memset(pName, 0xA0, D64_HEADER_SIZE + 2);
+		memcpy(pName, padded(withoutDrive(name), D64_FILE_NAME_SIZE).constData(), D64_FILE_NAME_SIZE);
+		memcpy(pName + D64_HEADER_ID_OFFSET, diskId.constData(), 2);
+		memcpy(pName + D64_HEADER_ID_OFFSET + 3, geometry.dosType, 2);
+
+		uchar* pDir = pImage + sectorOffset(geometry.dirTrack, geometry.dirSector);
+		memset(pDir, 0, D64_BLOCK_SIZE);
+		pDir[1] = 0xFF;
+		buildDirectoryIndex();
+
+		return CBM::ErrOK;
 } // newDisk
 
 
+// The 1541 way: the BAM is started over with only the directory allocated, then the blocks of every closed file are
+// allocated by following their chains. Files that were never closed are removed from the directory.
+CBM::IOErrorMessage D64::validateDisk()
+{
+		if(not (m_status bitand IMAGE_OK))
+				return CBM::ErrDriveNotReady;
+		if(not isWritable())
+				return CBM::ErrWriteProtectOn;
+
+		const DiskGeometry& geometry(m_pLayout->geometry());
+		for(uchar track = 1; track <= geometry.tracks; ++track)
+				for(uchar sector = 0; sector < m_pLayout->sectors(track); ++sector)
+						setBlockFree(track, sector, true);
+		allocateSystemBlocks();
+		if(not setChainFree(geometry.dirTrack, geometry.dirSector, false))
+				return CBM::ErrDirectoryError;
+
+		uchar lastSector;
+		foreach(qint32 slot, directorySlots(lastSector)) {
+				const uchar type = m_pImage[slot + DIR_OFS_FILE_TYPE];
+				if(0 == type)
+						continue;
+				if(not (type bitand FILE_CLOSED))
+						scratchEntry(slot);
+				else {
+						bool legal = setChainFree(m_pImage[slot + DIR_OFS_TRACK], m_pImage[slot + DIR_OFS_SECTOR], false);
+						// The side sectors of a relative file.
+						const DirEntry* pEntry = reinterpret_cast<const DirEntry*>(m_pImage + slot + DIR_OFS_FILE_TYPE);
+						if(REL == (type bitand FILE_TYPE_MASK))
+								legal = setChainFree(pEntry->m_sideTrack, pEntry->m_sideSector, false) and legal;
+						if(not legal)
+								Log("D64", warning, QString("Validate: file %1 has an illegal block link")
+										.arg(QString(QByteArray(reinterpret_cast<const char*>(pEntry->m_name), D64_FILE_NAME_SIZE))));
+				}
+		}
+		buildDirectoryIndex();
+
+		return CBM::ErrOK;
+} // validateDisk
+
+
+bool D64::flush()
+{
+		if(not m_dirty)
+				return true;
+		// QSaveFile writes to a temporary file that is renamed over the image only when all of it is written, a crash
+		// or a full host disk leaves the previous image intact.
+		QSaveFile file(m_hostFile.fileName());
+		bool written = file.open(QIODevice::WriteOnly) and m_image.size() == file.write(m_image) and file.commit();
+		imageCache().invalidate(m_hostFile.fileName());
+		if(not written) {
+				Log("D64", error, QString("Could not write the image %1: %2").arg(m_hostFile.fileName(), file.errorString()));
+				return false;
+		}
+		m_dirty = false;
+
+		return true;
+} // flush
+
+
+CBM::IOErrorMessage D64::readSector(uchar track, uchar sector, uchar* pDest) const
+{
+		if(0 == m_pImage)
+				return CBM::ErrDriveNotReady;
+		const qint32 offset = sectorOffset(track, sector);
+		if(offset < 0)
+				return CBM::ErrIllegalTrackOrSector;
+		memcpy(pDest, m_pImage + offset, D64_BLOCK_SIZE);
+		// The error info has a byte per block after the last one.
+		if(m_imageSize >= m_pLayout->imageSize() + m_pLayout->blocks())
+				return errorFromInfo(m_pImage[m_pLayout->imageSize() + offset / D64_BLOCK_SIZE]);
+		return CBM::ErrOK;
+} // readSector
+
+
+CBM::IOErrorMessage D64::writeSector(uchar track, uchar sector, const uchar* pSource)
+{
+		if(0 == m_pImage)
+				return CBM::ErrDriveNotReady;
+		const qint32 offset = sectorOffset(track, sector);
+		if(offset < 0)
+				return CBM::ErrIllegalTrackOrSector;
+		if(not isWritable())
+				return CBM::ErrWriteProtectOn;
+
+		memcpy(modifyImage() + offset, pSource, D64_BLOCK_SIZE);
+
+		// The directory index is read again when the directory track changed, unless a file being read depends on the
+		// current position in the image.
+		if(m_pLayout->isSystemTrack(track) and not (m_status bitand FILE_OPEN))
+				buildDirectoryIndex();
+		return CBM::ErrOK;
+} // writeSector
+
+
+CBM::IOErrorMessage D64::allocateBlock(uchar track, uchar sector, bool allocate)
+{
+		if(0 == m_pImage)
+				return CBM::ErrDriveNotReady;
+		// The tracks the BAM covers only, for a D64 that's the 35 standard tracks.
+		if(m_pLayout->bamBitmapOffset(track) < 0 or sector >= m_pLayout->sectors(track))
+				return CBM::ErrIllegalTrackOrSector;
+		if(not isWritable())
+				return CBM::ErrWriteProtectOn;
+
+		const bool isFree = isBlockFree(track, sector);
+		if(allocate not_eq isFree)
+				return allocate ? CBM::ErrNoBlock : CBM::ErrOK;
+		setBlockFree(track, sector, not allocate);
+		if(not (m_status bitand FILE_OPEN))
+				buildDirectoryIndex();
+
+		return CBM::ErrOK;
+} // allocateBlock
+
+
+uchar* D64::modifyImage()
+{
+		// Our copy of the image is detached from the cached one, which is dropped so that the next mount reads the file.
+		if(not m_dirty) {
+				imageCache().invalidate(m_hostFile.fileName());
+				m_dirty = true;
+		}
+		uchar* pImage = reinterpret_cast<uchar*>(m_image.data());
+		m_pImage = pImage;
+
+		return pImage;
+} // modifyImage
+
+
+bool D64::isWritable() const
+{
+		// Compressed images (zip archives, .gz) are read only.
+		QString archivePath;
+		QString name;
+		return not Archive::splitPath(m_hostFile.fileName(), archivePath, name)
+				and QFileInfo(m_hostFile.fileName()).isWritable();
+} // isWritable
+
+
+// Per track the BAM has a free count and a bit per sector, set when it is free. Where they are comes from the tables
+// of the image format.
+bool D64::isBlockFree(uchar track, uchar sector) const
+{
+		const qint32 bitmap = m_pLayout->bamBitmapOffset(track);
+		if(bitmap < 0 or sector >= m_pLayout->sectors(track))
+				return false;
+
+		return 0 not_eq (m_pImage[bitmap + sector / 8] bitand (1 << (sector bitand 7)));
+} // isBlockFree
+
+
+// The free count is set from the bitmap rather than stepped, so that a wrong count in the image heals.
+void D64::setBlockFree(uchar track, uchar sector, bool isFree)
+{
+		const qint32 bitmap = m_pLayout->bamBitmapOffset(track);
+		if(bitmap < 0 or sector >= m_pLayout->sectors(track))
+				return;
+		uchar* pImage = modifyImage();
+		const uchar mask = 1 << (sector bitand 7);
+		if(isFree)
+				pImage[bitmap + sector / 8] or_eq mask;
+		else
+				pImage[bitmap + sector / 8] and_eq ~mask;
+		pImage[m_pLayout->bamCountOffset(track)] = freeOnTrack(track);
+} // setBlockFree
+
+
+uchar D64::freeOnTrack(uchar track) const
+{
+		const qint32 bitmap = m_pLayout->bamBitmapOffset(track);
+		if(bitmap < 0)
+				return 0;
+		quint64 bits = 0;
+		for(int i = m_pLayout->bamBitmapBytes(track) - 1; i >= 0; --i)
+				bits = (bits << 8) bitor m_pImage[bitmap + i];
+		// Bits past the last sector of the track don't count.
+		const quint64 sectorsMask = (Q_UINT64_C(1) << m_pLayout->sectors(track)) - 1;
+		return qPopulationCount(bits bitand sectorsMask);
+} // freeOnTrack
+
+
+bool D64::allocateFromSector(uchar track, uchar& sector)
+{
+		if(0 == freeOnTrack(track))
+				return false;
+		const uchar count = m_pLayout->sectors(track);
+		for(uchar i = 0; i < count; ++i) {
+				const uchar candidate = (sector + i) % count;
+				if(isBlockFree(track, candidate)) {
+						setBlockFree(track, candidate, false);
+						sector = candidate;
+						return true;
+				}
+		}
+
+		return false;
+} // allocateFromSector
+
+
+// The header, the BAM and the first directory sector, and all of the other system track.
+void D64::allocateSystemBlocks()
+{
+		const DiskGeometry& geometry(m_pLayout->geometry());
+		for(uchar sector = 0; sector < m_pLayout->sectors(geometry.systemTrack); ++sector)
+				setBlockFree(geometry.systemTrack, sector, false);
+		setBlockFree(geometry.headerTrack, geometry.headerSector, false);
+		for(uchar i = 0; i < geometry.numBamRegions; ++i) {
+				setBlockFree(geometry.bam[i].countTrack, geometry.bam[i].countSector, false);
+				setBlockFree(geometry.bam[i].bitmapTrack, geometry.bam[i].bitmapSector, false);
+		}
+		setBlockFree(geometry.dirTrack, geometry.dirSector, false);
+} // allocateSystemBlocks
+
+
+// The 1541 starts a file on the track nearest the directory that has room and puts its next block the interleave
+// further on the same track, so that the block has not passed under the head when the previous one is done. When the
+// track is full the file continues outward, and then from the directory on the other side. The 1571 and 1581 do the
+// same with the interleave and directory track of their format.
+bool D64::allocateNextBlock(uchar& track, uchar& sector)
+{
+		const DiskGeometry& geometry(m_pLayout->geometry());
+		const int dirTrack = geometry.dirTrack;
+		if(0 == track) {
+				for(int distance = 1; distance < geometry.tracks; ++distance)
+						if(allocateFirstOnTrack(dirTrack - distance, track, sector)
+								or allocateFirstOnTrack(dirTrack + distance, track, sector))
+								return true;
+				return false;
+		}
+
+		sector = nextInterleaved(sector, geometry.dataInterleave, m_pLayout->sectors(track));
+		if(allocateFromSector(track, sector))
+				return true;
+		const int step = track < dirTrack ? -1 : 1;
+		for(int candidate = track + step; candidate >= 1 and candidate <= geometry.tracks; candidate += step)
+				if(allocateFirstOnTrack(candidate, track, sector))
+						return true;
+		for(int candidate = dirTrack - step; candidate >= 1 and candidate <= geometry.tracks; candidate -= step)
+				if(allocateFirstOnTrack(candidate, track, sector))
+						return true;
+
+		return false;
+} // allocateNextBlock
+
+
+bool D64::allocateFirstOnTrack(int candidate, uchar& track, uchar& sector)
+{
+		if(candidate < 1 or candidate > m_pLayout->geometry().tracks or m_pLayout->isSystemTrack(candidate))
+				return false;
+		uchar first = 0;
+		if(not allocateFromSector(candidate, first))
+				return false;
+		track = candidate;
+		sector = first;
+
+		return true;
+} // allocateFirstOnTrack
+
+
+bool D64::setChainFree(uchar track, uchar sector, bool isFree)
+{
+		// A chain looping on itself in a broken image ends after as many blocks as there are.
+		for(int count = 0; 0 not_eq track and count < m_pLayout->blocks(); ++count) {
+				const qint32 offset = sectorOffset(track, sector);
+				if(offset < 0)
+						return false;
+				setBlockFree(track, sector, isFree);
+				track = m_pImage[offset];
+				sector = m_pImage[offset + 1];
+		}
+
+		return 0 == track;
+} // setChainFree
+
+
+QVector<qint32> D64::directorySlots(uchar& lastSector) const
+{
+		QVector<qint32> slots;
+		uchar track = m_pLayout->geometry().dirTrack;
+		uchar sector = m_pLayout->geometry().dirSector;
+		lastSector = sector;
+		for(int count = 0; 0 not_eq track and count < m_pLayout->blocks(); ++count) {
+				const qint32 offset = sectorOffset(track, sector);
+				if(offset < 0)
+						break;
+				lastSector = sector;
+				for(int slot = 0; slot < D64_BLOCK_SIZE; slot += D64_DIR_SLOT_SIZE)
+						slots.append(offset + slot);
+				track = m_pImage[offset];
+				sector = m_pImage[offset + 1];
+		}
+
+		return slots;
+} // directorySlots
+
+
+// The slots of the files whose name matches, wildcards included.
+QVector<qint32> D64::matchingEntries(const QByteArray& name) const
+{
+		const FileNamePattern pattern(QString::fromLatin1(name.left(D64_FILE_NAME_SIZE)));
+		QVector<qint32> matches;
+		uchar lastSector;
+		foreach(qint32 slot, directorySlots(lastSector))
+				if(0 not_eq m_pImage[slot + DIR_OFS_FILE_TYPE]
+						and pattern.matches(m_pImage + slot + DIR_OFS_FILE_NAME, D64_FILE_NAME_SIZE))
+						matches.append(slot);
+
+		return matches;
+} // matchingEntries
+
+
+qint32 D64::allocateDirectorySlot()
+{
+		uchar lastSector;
+		foreach(qint32 slot, directorySlots(lastSector))
+				if(0 == m_pImage[slot + DIR_OFS_FILE_TYPE])
+						return slot;
+
+		// The directory is full, the new sector is linked from the last one.
+		const uchar dirTrack = m_pLayout->geometry().dirTrack;
+		uchar sector = nextInterleaved(lastSector, m_pLayout->geometry().dirInterleave, m_pLayout->sectors(dirTrack));
+		if(not allocateFromSector(dirTrack, sector))
+				return -1;
+		uchar* pImage = modifyImage();
+		uchar* pLast = pImage + sectorOffset(dirTrack, lastSector);
+		pLast[0] = dirTrack;
+		pLast[1] = sector;
+		const qint32 offset = sectorOffset(dirTrack, sector);
+		memset(pImage + offset, 0, D64_BLOCK_SIZE);
+		pImage[offset + 1] = 0xFF;
+
+		return offset;
+} // allocateDirectorySlot
+
+
+void D64::scratchEntry(qint32 slot)
+{
+		uchar* pSlot = modifyImage() + slot;
+		const DirEntry* pEntry = reinterpret_cast<const DirEntry*>(pSlot + DIR_OFS_FILE_TYPE);
+		if(REL == (pEntry->m_type bitand FILE_TYPE_MASK))
+				setChainFree(pEntry->m_sideTrack, pEntry->m_sideSector, true);
+		setChainFree(pSlot[DIR_OFS_TRACK], pSlot[DIR_OFS_SECTOR], true);
+		pSlot[DIR_OFS_FILE_TYPE] = DEL;
+} // scratchEntry
+
+
+// A name like "NAME,S,W" saves a sequential file, the default is a program file. The first block is allocated right
+// away (as the 1541 does), the directory entry stays unclosed until close().
+CBM::IOErrorMessage D64::fopenWrite(const QString& fileName, bool replaceMode)
+{
+		if(not (m_status bitand IMAGE_OK))
+				return CBM::ErrDriveNotReady;
+		if(not isWritable())
+				return CBM::ErrWriteProtectOn;
+
+		const QList<QByteArray> parts(withoutDrive(fileName).split(','));
+		const QByteArray name(parts.first().left(D64_FILE_NAME_SIZE));
+		uchar type = PRG;
+		if(parts.count() > 1 and not parts.at(1).isEmpty()) {
+				const char letter = parts.at(1).at(0);
+				type = 'S' == letter ? SEQ : 'U' == letter ? USR : 'P' == letter ? PRG : NumD64FileTypes;
+		}
+		if(name.isEmpty())
+				return CBM::ErrNoFileGiven;
+		if(NumD64FileTypes == type)
+				return CBM::ErrFileTypeMismatch;
+		if(FileNamePattern(QString::fromLatin1(name)).hasWildcards())
+				return CBM::ErrSyntaxError;
+
+		const QVector<qint32> existing(matchingEntries(name));
+		if(not existing.isEmpty() and not replaceMode)
+				return CBM::ErrFileExists;
+
+		uchar track = 0;
+		uchar sector = 0;
+		if(not allocateNextBlock(track, sector))
+				return CBM::ErrDiskFullOrDirectoryFull;
+		const qint32 slot = allocateDirectorySlot();
+		if(-1 == slot) {
+				setBlockFree(track, sector, true);
+				return CBM::ErrDiskFullOrDirectoryFull;
+		}
+
+		uchar* pImage = modifyImage();
+		memset(pImage + slot + DIR_OFS_FILE_TYPE, 0, sizeof(DirEntry));
+		pImage[slot + DIR_OFS_FILE_TYPE] = type;
+		pImage[slot + DIR_OFS_TRACK] = track;
+		pImage[slot + DIR_OFS_SECTOR] = sector;
+		memcpy(pImage + slot + DIR_OFS_FILE_NAME, padded(name, D64_FILE_NAME_SIZE).constData(), D64_FILE_NAME_SIZE);
+		memset(pImage + sectorOffset(track, sector), 0, D64_BLOCK_SIZE);
+
+		m_writeSlot = slot;
+		m_replacedSlot = existing.isEmpty() ? -1 : existing.first();
+		m_writeTrack = track;
+		m_writeSector = sector;
+		m_writeOffset = 2;
+		m_writeBlocks = 1;
+		m_status = IMAGE_OK bitor FILE_OPEN;
+		m_lastName = fileName;
+
+		return CBM::ErrOK;
+} // fopenWrite
+
+
+bool D64::putc(char c)
+{
+		return 1 == write(&c, 1);
+} // putc
+
+
+// The bytes go straight into the blocks of the image, the next block is allocated and linked only once a byte doesn't
+// fit in the current one.
+int D64::write(const char* src, int length)
+{
+		if(-1 == m_writeSlot)
+				return 0;
+
+		int total = 0;
+		while(total < length) {
+				if(D64_BLOCK_SIZE == m_writeOffset) {
+						uchar track = m_writeTrack;
+						uchar sector = m_writeSector;
+						if(not allocateNextBlock(track, sector)) {
+								Log("D64", error, QString("Disk full saving %1").arg(m_lastName));
+								break;
+						}
+						uchar* pImage = modifyImage();
+						uchar* pBlock = pImage + sectorOffset(m_writeTrack, m_writeSector);
+						pBlock[0] = track;
+						pBlock[1] = sector;
+						memset(pImage + sectorOffset(track, sector), 0, D64_BLOCK_SIZE);
+						m_writeTrack = track;
+						m_writeSector = sector;
+						m_writeOffset = 2;
+						++m_writeBlocks;
+				}
+				const int count = qMin(D64_BLOCK_SIZE - m_writeOffset, length - total);
+				memcpy(modifyImage() + sectorOffset(m_writeTrack, m_writeSector) + m_writeOffset, src + total, count);
+				m_writeOffset += count;
+				total += count;
+		}
+
+		return total;
+} // write
+
+
+// The last block gets the index of its last byte instead of a link, and the entry its size and the closed flag. A file
+// replaced with "@:" is scratched only now that the new one is complete.
+void D64::finishWrite()
+{
+		uchar* pImage = modifyImage();
+		uchar* pBlock = pImage + sectorOffset(m_writeTrack, m_writeSector);
+		pBlock[0] = 0;
+		pBlock[1] = m_writeOffset - 1;
+		uchar* pSlot = pImage + m_writeSlot;
+		pSlot[DIR_OFS_FILE_TYPE] or_eq FILE_CLOSED;
+		pSlot[DIR_OFS_SIZE_LOW] = m_writeBlocks bitand 0xFF;
+		pSlot[DIR_OFS_SIZE_HI] = m_writeBlocks >> 8;
+		if(-1 not_eq m_replacedSlot)
+				scratchEntry(m_replacedSlot);
+		m_writeSlot = m_replacedSlot = -1;
+		buildDirectoryIndex();
+} // finishWrite
+
+
+bool D64::fileExists(const QString& filePath)
+{
+		return (m_status bitand IMAGE_OK) and not matchingEntries(withoutDrive(filePath)).isEmpty();
+} // fileExists
+
+
+CBM::IOErrorMessage D64::renameFile(const QString& oldName, const QString& newName)
+{
+		if(not (m_status bitand IMAGE_OK))
+				return CBM::ErrDriveNotReady;
+		if(not isWritable())
+				return CBM::ErrWriteProtectOn;
+		const QVector<qint32> matches(matchingEntries(withoutDrive(oldName)));
+		if(matches.isEmpty())
+				return CBM::ErrFileNotFound;
+
+		memcpy(modifyImage() + matches.first() + DIR_OFS_FILE_NAME, padded(withoutDrive(newName), D64_FILE_NAME_SIZE).constData(),
+				D64_FILE_NAME_SIZE);
+		buildDirectoryIndex();
+
+		return CBM::ErrOK;
+} // renameFile
+
+
+bool D64::deleteFile(const QString& fileName)
+{
+		if(not (m_status bitand IMAGE_OK) or not isWritable())
+				return false;
+
+		int scratched = 0;
+		foreach(const QByteArray& name, withoutDrive(fileName).split(',')) {
+				foreach(qint32 slot, matchingEntries(name)) {
+						// Locked files stay.
+						if(not (m_pImage[slot + DIR_OFS_FILE_TYPE] bitand FILE_LOCKED)) {
+								scratchEntry(slot);
+								++scratched;
+						}
+				}
+		}
+		if(scratched > 0)
+				buildDirectoryIndex();
+
+		return scratched > 0;
+} // deleteFile
+
+
 QString D64::DirEntry::name() const
 {
 		return QString::fromLocal8Bit((const char*)(m_name));
@@ -518,36 +1203,30 @@ uchar D64::DirEntry::sector() const
 		return m_sector;
 } // getSector
 
-/**
- * sectorsPerTrack - number of sectors on given track
- * @track: Track number
- *
- * Returns the number of sectors on the given track
- * of a 1541/71/81 disk. Invalid track numbers will return invalid results.
- */
-ushort D64::xxxsectorsPerTrack(uchar track)
-{
-		Q_UNUSED(track);
-		//	switch(m_header.imageType bitand IMAGE_TYPE_MASK)
-		//	{
-		//		case D81:
-		//			return 40;
-
-		//		case DNP:
-		//			return 256;
-
-		//		case D41:
-		//		case D71:
-		//		default:
-		//			if(track > 35)
-		//				track -= 35;
-		//			if(track < 18)
-		//				return 21;
-		//			if(track < 25)
-		//				return 19;
-		//			if(track < 31)
-		//				return 18;
-		//			return 17;
-		//	}
-		return 0;
-} // sectorsPerTrack
+
+D71::D71(const QString& fileName)
+		: D64()
+{
+		if(not fileName.isEmpty())
+				mountHostImage(fileName);
+} // ctor
+
+
+const DiskLayout* D71::layoutFor(qint32 imageSize) const
+{
+		return imageSize >= DiskLayout::d71().imageSize() ? &DiskLayout::d71() : 0;
+} // layoutFor
+
+
+D81::D81(const QString& fileName)
+		: D64()
+{
+		if(not fileName.isEmpty())
+				mountHostImage(fileName);
+} // ctor
+
+
+const DiskLayout* D81::layoutFor(qint32 imageSize) const
+{
+		return imageSize >= DiskLayout::d81().imageSize() ? &DiskLayout::d81() : 0;
+} // layoutFor
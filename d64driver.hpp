@@ -1,9 +1,15 @@
 #ifndef D64DRIVER_H
 #define D64DRIVER_H
 
+#include <QVector>
+#include <QHash>
+
 #include "filedriverbase.hpp"
+#include "diskgeometry.hpp"
 
 
+// The driver of the CBM disk images. The format of the image is a geometry (see diskgeometry.hpp), the D71 and D81
+// drivers below are this same driver with the geometry of their format.
 class D64 : public FileDriverBase
 {
 public:
@@ -61,10 +67,21 @@ public:
 	ushort openedFileSize() const;
 	// Get character from open file:
 	char getc(void);
+	// Copy up to max bytes of the open file, a whole sector at a time.
+	int read(char* dst, int max);
+	// Open a new file in the image for SAVE. The blocks are allocated as the bytes come in.
+	CBM::IOErrorMessage fopenWrite(const QString& fileName, bool replaceMode = false);
+	bool putc(char c);
+	// Copy bytes to the file being saved, returns fewer than length when the disk is full.
+	int write(const char* src, int length);
 	// Returns true if last character was retrieved:
 	bool isEOF(void) const;
-	// Close current file
+	// Close current file, a saved file gets its directory entry completed.
 	bool close(void);
+	bool fileExists(const QString& filePath);
+	CBM::IOErrorMessage renameFile(const QString& oldName, const QString& newName);
+	// Scratch the files matching the name, or any of several comma separated names.
+	bool deleteFile(const QString& fileName);
 	// Blocks free information
 	ushort blocksFree(void);
 
@@ -74,6 +91,8 @@ public:
 	}
 	// Send realistic $ file basic listing, line by line
 	bool sendListing(ISendLine& cb);
+	bool openListing();
+	bool listNextLine(ISendLine& cb);
 	// Whether this file system supports media info or not (true == supports it).
 	bool supportsMediaInfo() const
 	{
@@ -140,6 +159,26 @@ public:
 #endif
 	// special commands.
 	CBM::IOErrorMessage newDisk(const QString& name, const QString& id);
+	CBM::IOErrorMessage validateDisk();
+	// All changes are made to the image in memory, this writes it to the host file if there are any. The file is
+	// only replaced once the whole image has been written. False if that fails.
+	bool flush();
+
+	// Whole sectors by track (1 based) and sector, for direct access to the disk (the 1541 job queue).
+	// ErrIllegalTrackOrSector if the sector isn't on the disk, ErrDriveNotReady without a mounted image. An image with
+	// error info gives the error of the sector (with its data) as the 1541 would read it.
+	CBM::IOErrorMessage readSector(uchar track, uchar sector, uchar* pDest) const;
+	// The sector is written to the image in memory, see flush(). ErrWriteProtectOn for a read only image.
+	CBM::IOErrorMessage writeSector(uchar track, uchar sector, const uchar* pSource);
+	// Marks the block used or free in the BAM (B-A, B-F). ErrNoBlock if it is allocated already.
+	CBM::IOErrorMessage allocateBlock(uchar track, uchar sector, bool allocate);
+
+protected:
+	// The layout of the image format, from the size of the host file. 0 if it is no image of the format.
+	virtual const DiskLayout* layoutFor(qint32 imageSize) const;
+	// The contents of the image as blocks in the order of the format, maybe followed by the error info byte of each.
+	virtual QByteArray loadImage(const QString& fileName) const;
+	virtual bool isWritable() const;
 
 private:
 
@@ -147,18 +186,54 @@ private:
 	bool hostSeek(qint32 pos, bool relative = false);
 	qint32 hostSize() const
 	{
-		return static_cast<qint32>(m_hostFile.size());
+		return m_imageSize;
 	}
 
-	ushort xxxsectorsPerTrack(uchar track);
 	void seekBlock(uchar track, uchar sector);
+	// Offset of the sector in the image, -1 if it isn't in there.
+	qint32 sectorOffset(uchar track, uchar sector) const;
+	// The image for changing, it is detached from the image cache and marked dirty.
+	uchar* modifyImage();
+
+	// The BAM bitmap.
+	bool isBlockFree(uchar track, uchar sector) const;
+	void setBlockFree(uchar track, uchar sector, bool isFree);
+	uchar freeOnTrack(uchar track) const;
+	// Allocates the first free block from the sector on (wrapping around), false if the track is full.
+	bool allocateFromSector(uchar track, uchar& sector);
+	// Allocates the block that follows track/sector in a file, track 0 for the first block of a file.
+	bool allocateNextBlock(uchar& track, uchar& sector);
+	// The first free block of the candidate track, false if it is full or not a track for files.
+	bool allocateFirstOnTrack(int candidate, uchar& track, uchar& sector);
+	void allocateSystemBlocks();
+	// Marks all blocks of a chain free or used, false if it has an illegal link.
+	bool setChainFree(uchar track, uchar sector, bool isFree);
+
+	// Image offsets of all 32 byte directory slots, in directory order. lastSector is set to the last sector of the chain.
+	QVector<qint32> directorySlots(uchar& lastSector) const;
+	QVector<qint32> matchingEntries(const QByteArray& name) const;
+	// A free directory slot, the directory gets one more sector if it is full. -1 when there is no room.
+	qint32 allocateDirectorySlot();
+	void scratchEntry(qint32 slot);
+	void finishWrite();
 	bool seekFirstDir(void);
 	bool getDirEntry(DirEntry& dir);
 	bool getDirEntryByName(DirEntry& dir, const QString& name);
 	void seekToDiskName(void);
+	void buildDirectoryIndex();
+	void sendListingHeader(ISendLine& cb);
+	void sendListingEntry(ISendLine& cb, const DirEntry& dir);
+	bool isListed(const DirEntry& dir) const;
 
 	// The real host file system D64 file:
 	QFile m_hostFile;
+	// The format of the mounted image.
+	const DiskLayout* m_pLayout;
+	// The image contents, shared with the image cache.
+	QByteArray m_image;
+	const uchar* m_pImage;
+	qint32 m_imageSize;
+	qint32 m_hostPos;
 
 	// D64 driver state variables:
 	// The current d64 file position described as track/sector/offset
@@ -171,6 +246,70 @@ private:
 	uchar m_currentLinkSector;
 	DirEntry m_currDirEntry;
 	QString m_lastName;
+
+	// The directory is read once at mount, these are the used entries in directory order.
+	QVector<DirEntry> m_dirIndex;
+	// Index in m_dirIndex of the first SEQ/PRG entry for each (0xA0 padded) name.
+	QHash<QByteArray, int> m_nameIndex;
+	// Disk name, id and dos type as stored in the BAM sector.
+	QByteArray m_diskHeader;
+	ushort m_blocksFree;
+	// Next line to produce for the listing: -1 is the disk name, then the entries and finally blocks free.
+	int m_listingPos;
+
+	// Set when the image in memory has changes not yet written to the host file.
+	bool m_dirty;
+	// The file being saved: the slot of its directory entry (-1 when not saving), and for "@:" the slot of the file it
+	// replaces when closed.
+	qint32 m_writeSlot;
+	qint32 m_replacedSlot;
+	// The block being filled, how much of it is used and the number of blocks so far.
+	uchar m_writeTrack;
+	uchar m_writeSector;
+	ushort m_writeOffset;
+	ushort m_writeBlocks;
+};
+
+
+class D71 : public D64
+{
+public:
+	D71(const QString& fileName = QString());
+
+	const QStringList& extension() const
+	{
+#if !(defined(__APPLE__) || defined(_MSC_VER))
+		static const QStringList ext({ "D71" });
+#else
+		static QStringList ext;
+		ext << "D71";
+#endif
+		return ext;
+	} // extension
+
+protected:
+	const DiskLayout* layoutFor(qint32 imageSize) const;
+};
+
+
+class D81 : public D64
+{
+public:
+	D81(const QString& fileName = QString());
+
+	const QStringList& extension() const
+	{
+#if !(defined(__APPLE__) || defined(_MSC_VER))
+		static const QStringList ext({ "D81" });
+#else
+		static QStringList ext;
+		ext << "D81";
+#endif
+		return ext;
+	} // extension
+
+protected:
+	const DiskLayout* layoutFor(qint32 imageSize) const;
 };
 
 #endif
@@ -0,0 +1,240 @@
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <math.h>
+#include <algorithm>
+
+#include "dircache.hpp"
+#include "archive.hpp"
+#include "logger.hpp"
+
+using namespace Logging;
+
+namespace {
+const QString FAC_DIRCACHE("DIRCACHE");
+const QString strDir("DIR");
+const QString strPrg("PRG");
+// The directories kept, each one is also a watch.
+const int MAX_DIRECTORIES = 32;
+
+
+QString directoryKey(const QString& dirPath)
+{
+	return QDir::cleanPath(QDir(dirPath).absolutePath());
+} // directoryKey
+
+
+// Listing order: by name regardless of case, as the CBM shows the names in upper case. Names differing in case only
+// keep the order QDir::Name gives them.
+bool isNameLess(const DirectoryCache::Entry& left, const DirectoryCache::Entry& right)
+{
+	const int result = left.name.compare(right.name, Qt::CaseInsensitive);
+	return result < 0 or (0 == result and left.name < right.name);
+} // isNameLess
+
+} // anonymous
+
+
+DirectoryCache::DirectoryCache(QObject* parent)
+	: QObject(parent)
+{
+} // ctor
+
+
+DirectoryCache::~DirectoryCache()
+{
+} // dtor
+
+
+DirectoryCache::Entry DirectoryCache::makeEntry(const QString& name, qint64 size, bool isDir, bool showAsDir)
+{
+	Entry entry;
+	entry.name = name;
+	entry.size = size;
+	entry.isDir = isDir;
+
+	QString line("   \"");
+	line.append(name.toUpper());
+	line.append("\" ");
+	int spaceFill = 16 - name.length();
+	if(spaceFill > 0) {
+		QString spaceAdd(spaceFill, ' ');
+		line += spaceAdd;
+	}
+	const QString& type(showAsDir ? strDir : strPrg);
+	line.append(type);
+	entry.type = type.at(0).toLatin1();
+
+	entry.blocks = size / 1024;
+	// Initial spaces (offset) according to file size
+	entry.line = line.mid((int)log10((double)entry.blocks));
+
+	return entry;
+} // makeEntry
+
+
+DirectoryCache::Entries DirectoryCache::entries(const QString& dirPath)
+{
+	const QString key(directoryKey(dirPath));
+	QHash<QString, Directory>::iterator it = m_directories.find(key);
+	if(it not_eq m_directories.end()) {
+		m_lru.move(m_lru.indexOf(key), 0);
+		// Checked even when watched, remote changes on a network share are never reported.
+		const QDateTime lastModified(QFileInfo(key).lastModified());
+		if(it->isChanged or it->lastModified not_eq lastModified) {
+			it->isChanged = false;
+			it->lastModified = lastModified;
+			readDirectory(key, it->entries);
+		}
+		return it->entries;
+	}
+
+	// Made here rather than in the constructor, so that it reports on the thread listing the directories.
+	if(m_watcher.isNull()) {
+		m_watcher.reset(new QFileSystemWatcher);
+		// The watcher is on this thread, but we may have been made on another one.
+		connect(m_watcher.data(), SIGNAL(directoryChanged(const QString&)), this, SLOT(onDirectoryChanged(const QString&)),
+						Qt::DirectConnection);
+	}
+
+	Directory directory;
+	// Watched before it is read, a change while reading it then patches what was read.
+	directory.isWatched = m_watcher->addPath(key);
+	directory.isChanged = false;
+	directory.lastModified = QFileInfo(key).lastModified();
+	readDirectory(key, directory.entries);
+	m_directories.insert(key, directory);
+	m_lru.prepend(key);
+	evict();
+	if(not directory.isWatched)
+		Log(FAC_DIRCACHE, warning, QString("Can't watch %1, its modification time is checked instead.").arg(key));
+
+	return directory.entries;
+} // entries
+
+
+DirectoryCache::Entry DirectoryCache::fileEntry(const QFileInfo& fileInfo)
+{
+	const bool isDir = fileInfo.isDir();
+	// Zip archives are entered like directories.
+	const QString name(fileInfo.fileName());
+	Entry entry(makeEntry(name, fileInfo.size(), isDir, isDir or Archive::isZip(name)));
+	entry.lastModified = fileInfo.lastModified();
+
+	return entry;
+} // fileEntry
+
+
+void DirectoryCache::readDirectory(const QString& dirPath, Entries& entries) const
+{
+	QHash<QString, int> cached;
+	for(int i = 0; i < entries.count(); ++i)
+		cached.insert(entries.at(i).name, i);
+
+	Entries dirs;
+	Entries files;
+	int added = 0, changed = 0;
+	QDirIterator it(dirPath, QDir::AllDirs bitor QDir::Files bitor QDir::NoDot);
+	while(it.hasNext()) {
+		it.next();
+		// The directories kept are reused as they are, nothing of them that is listed can change.
+		const QFileInfo fileInfo(it.fileInfo());
+		const int index = cached.value(fileInfo.fileName(), -1);
+		Entry entry;
+		if(index < 0) {
+			entry = fileEntry(fileInfo);
+			++added;
+		}
+		else {
+			cached.remove(fileInfo.fileName());
+			entry = entries.at(index);
+			if(entry.isDir not_eq fileInfo.isDir() or (not entry.isDir and (entry.size not_eq fileInfo.size()
+				 or entry.lastModified not_eq fileInfo.lastModified()))) {
+				entry = fileEntry(fileInfo);
+				++changed;
+			}
+		}
+		if(entry.isDir)
+			dirs.append(entry);
+		else
+			files.append(entry);
+	}
+	// The iterator gives them in the order of the file system.
+	std::sort(dirs.begin(), dirs.end(), isNameLess);
+	std::sort(files.begin(), files.end(), isNameLess);
+	entries = dirs + files;
+	Log(FAC_DIRCACHE, info, QString("Read %1 directories and %2 files of %3, %4 added, %5 changed and %6 removed.")
+			.arg(dirs.count()).arg(files.count()).arg(dirPath).arg(added).arg(changed).arg(cached.count()));
+} // readDirectory
+
+
+void DirectoryCache::updateFile(const QString& filePath)
+{
+	const QFileInfo fileInfo(filePath);
+	QHash<QString, Directory>::iterator it = m_directories.find(directoryKey(fileInfo.absolutePath()));
+	if(it == m_directories.end())
+		return;
+
+	Entries& entries(it->entries);
+	const QString name(fileInfo.fileName());
+	int index = 0;
+	while(index < entries.count() and entries.at(index).name not_eq name)
+		++index;
+	if(not fileInfo.exists()) {
+		if(index < entries.count())
+			entries.remove(index);
+	}
+	else if(index < entries.count() and entries.at(index).isDir == fileInfo.isDir())
+		entries[index] = fileEntry(fileInfo);
+	else {
+		if(index < entries.count())
+			entries.remove(index);
+		// Directories are listed first, the new entry goes where it sorts among the directories or the files.
+		const Entry entry(fileEntry(fileInfo));
+		int numDirs = 0;
+		while(numDirs < entries.count() and entries.at(numDirs).isDir)
+			++numDirs;
+		const Entries::iterator begin(entry.isDir ? entries.begin() : entries.begin() + numDirs);
+		const Entries::iterator end(entry.isDir ? entries.begin() + numDirs : entries.end());
+		entries.insert(std::lower_bound(begin, end, entry, isNameLess), entry);
+	}
+} // updateFile
+
+
+void DirectoryCache::invalidate(const QString& dirPath)
+{
+	const QString key(directoryKey(dirPath));
+	if(not m_directories.contains(key))
+		return;
+
+	m_directories.remove(key);
+	m_lru.removeOne(key);
+	if(not m_watcher.isNull())
+		m_watcher->removePath(key);
+} // invalidate
+
+
+void DirectoryCache::clear()
+{
+	m_directories.clear();
+	m_lru.clear();
+	if(not m_watcher.isNull() and not m_watcher->directories().isEmpty())
+		m_watcher->removePaths(m_watcher->directories());
+} // clear
+
+
+void DirectoryCache::onDirectoryChanged(const QString& dirPath)
+{
+	// Only the changed directory is patched, and only if and when it is listed again.
+	QHash<QString, Directory>::iterator it = m_directories.find(directoryKey(dirPath));
+	if(it not_eq m_directories.end())
+		it->isChanged = true;
+} // onDirectoryChanged
+
+
+void DirectoryCache::evict()
+{
+	while(m_lru.count() > MAX_DIRECTORIES)
+		invalidate(m_lru.last());
+} // evict
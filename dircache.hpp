@@ -0,0 +1,82 @@
+#ifndef DIRCACHE_HPP
+#define DIRCACHE_HPP
+
+#include <QObject>
+#include <QScopedPointer>
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+#include <QDateTime>
+
+class QFileSystemWatcher;
+class QFileInfo;
+
+// The entries of the host directories listed to the CBM, so that listing a directory again (one with thousands of
+// files on a network share or a slow USB stick) costs a single stat of the directory. A directory is read once, with
+// the listing line of each entry made up front. When the QFileSystemWatcher reports a change in it (a file added,
+// removed or renamed) or its modification time differs, it is patched on its next listing: only the entries that
+// were added or changed are made again and the removed ones dropped. The modification time is checked for watched
+// directories as well, a watch on a network share (NFS, SMB) is accepted but never reports changes made elsewhere.
+// The files we write ourselves are patched in right away.
+// The watcher is made on the thread the cache is first used on and reports there, that thread needs an event loop
+// (the serial worker has one).
+class DirectoryCache : public QObject
+{
+	Q_OBJECT
+public:
+	struct Entry
+	{
+		QString name;
+		qint64 size;
+		bool isDir;
+		// What the listing shows: the line, the number of blocks before it and the first letter of the type (D or P).
+		QString line;
+		ushort blocks;
+		char type;
+		// Of the host file, to tell a changed one when patching the directory.
+		QDateTime lastModified;
+	};
+	typedef QVector<Entry> Entries;
+
+	explicit DirectoryCache(QObject* parent = 0);
+	~DirectoryCache();
+
+	// The entry as a listing line, directories (or what is shown as one) with the DIR type and files as PRG.
+	static Entry makeEntry(const QString& name, qint64 size, bool isDir, bool showAsDir);
+
+	// The entries of the directory, directories (".." included) first, each sorted by name regardless of case. Read
+	// from the host only if not cached or changed. The entries are implicitly shared, they stay valid if the directory
+	// is patched or dropped meanwhile.
+	Entries entries(const QString& dirPath);
+	// For changes made by us, after the file was written, renamed or removed: its entry is made again or dropped. A file
+	// written in place changes neither the directory nor its modification time, so this is the only way to notice.
+	void updateFile(const QString& filePath);
+	void invalidate(const QString& dirPath);
+	void clear();
+
+private slots:
+	void onDirectoryChanged(const QString& dirPath);
+
+private:
+	struct Directory
+	{
+		Entries entries;
+		bool isWatched;
+		// Reported by the watcher, patched on the next listing.
+		bool isChanged;
+		QDateTime lastModified;
+	};
+
+	static Entry fileEntry(const QFileInfo& fileInfo);
+	// Reads the directory into the entries, keeping the ones that are unchanged.
+	void readDirectory(const QString& dirPath, Entries& entries) const;
+	void evict();
+
+	QHash<QString, Directory> m_directories;
+	// Cached directories, most recently listed first.
+	QStringList m_lru;
+	// Not our child, it may be on another thread than we are.
+	QScopedPointer<QFileSystemWatcher> m_watcher;
+};
+
+#endif // DIRCACHE_HPP
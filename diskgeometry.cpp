@@ -0,0 +1,61 @@
+#include "diskgeometry.hpp"
+
+
+DiskLayout::DiskLayout(const DiskGeometry& geometry)
+	: m_geometry(geometry), m_blocks(0)
+{
+	uchar zone = 0;
+	for(int track = 0; track < TABLE_SIZE; ++track) {
+		m_sectors[track] = 0;
+		m_firstBlock[track] = m_blocks;
+		m_bamCount[track] = m_bamBitmap[track] = -1;
+		m_bamBitmapBytes[track] = 0;
+		if(0 == track or track > geometry.tracks)
+			continue;
+
+		while(track > geometry.zones[zone].lastTrack)
+			++zone;
+		m_sectors[track] = geometry.zones[zone].sectors;
+		m_blocks += m_sectors[track];
+	}
+
+	for(uchar i = 0; i < geometry.numBamRegions; ++i) {
+		const BamRegion& region(geometry.bam[i]);
+		for(int track = region.firstTrack; track <= region.lastTrack; ++track) {
+			const int index = track - region.firstTrack;
+			m_bamCount[track] = offset(region.countTrack, region.countSector) + region.countOffset
+					+ index * region.countStride;
+			m_bamBitmap[track] = offset(region.bitmapTrack, region.bitmapSector) + region.bitmapOffset
+					+ index * region.bitmapStride;
+			m_bamBitmapBytes[track] = region.bitmapBytes;
+		}
+	}
+} // ctor
+
+
+const DiskLayout& DiskLayout::d64()
+{
+	static const DiskLayout layout(geometryD64);
+	return layout;
+} // d64
+
+
+const DiskLayout& DiskLayout::d64Extended()
+{
+	static const DiskLayout layout(geometryD64Extended);
+	return layout;
+} // d64Extended
+
+
+const DiskLayout& DiskLayout::d71()
+{
+	static const DiskLayout layout(geometryD71);
+	return layout;
+} // d71
+
+
+const DiskLayout& DiskLayout::d81()
+{
+	static const DiskLayout layout(geometryD81);
+	return layout;
+} // d81
@@ -0,0 +1,181 @@
+#ifndef DISKGEOMETRY_HPP
+#define DISKGEOMETRY_HPP
+
+#include <QtGlobal>
+#ifdef _MSC_VER
+#include <iso646.h>
+#endif
+
+// The formats of the CBM disk images, as compile time descriptors. Everything the D64 driver (and its D71 and D81
+// siblings) needs to know about a format is in its descriptor, a DiskLayout made from one has the tables that turn a
+// track and sector into an image offset with a lookup.
+
+#define DISK_MAX_ZONES       8
+#define DISK_MAX_BAM_REGIONS 2
+
+// Tracks up to and including lastTrack (from the previous zone) have this many sectors.
+struct DiskZone
+{
+	uchar lastTrack;
+	uchar sectors;
+};
+
+// Where the BAM has the free count and the bitmap (a bit per sector, set when it is free) of a range of tracks. The
+// entries are stride bytes apart. Count and bitmap are together for most formats, but the 1571 keeps the bitmaps of the
+// second side on track 53.
+struct BamRegion
+{
+	uchar firstTrack;
+	uchar lastTrack;
+	uchar countTrack;
+	uchar countSector;
+	uchar countOffset;
+	uchar countStride;
+	uchar bitmapTrack;
+	uchar bitmapSector;
+	uchar bitmapOffset;
+	uchar bitmapStride;
+	uchar bitmapBytes;
+};
+
+struct DiskGeometry
+{
+	const char* name;
+	uchar tracks;
+	uchar numZones;
+	DiskZone zones[DISK_MAX_ZONES];
+	// The sector with the disk name, id and DOS type (23 bytes from the offset). The first bytes of it link to the
+	// directory and have the DOS version.
+	uchar headerTrack;
+	uchar headerSector;
+	uchar headerOffset;
+	// The first directory sector. No files are put on the directory track.
+	uchar dirTrack;
+	uchar dirSector;
+	// Another track kept for the DOS (the 1571 BAM of side two), 0 if none.
+	uchar systemTrack;
+	uchar numBamRegions;
+	BamRegion bam[DISK_MAX_BAM_REGIONS];
+	// Sectors skipped from one block of a file, or of the directory, to the next.
+	uchar dataInterleave;
+	uchar dirInterleave;
+	// What NEW writes: the DOS version byte, the DOS type and the flags in header byte 3 (double sided 1571 disks).
+	char dosVersion;
+	char dosType[3];
+	uchar headerFlags;
+	// The BAM sectors have a link, DOS version and disk id of their own (1581).
+	bool bamSectorHeaders;
+};
+
+// 1541: 35 tracks in four speed zones, BAM and directory on track 18.
+constexpr DiskGeometry geometryD64 = {
+	"D64", 35, 4, { { 17, 21 }, { 24, 19 }, { 30, 18 }, { 35, 17 } },
+	18, 0, 0x90, 18, 1, 0,
+	1, { { 1, 35, 18, 0, 0x04, 4, 18, 0, 0x05, 4, 3 } },
+	10, 3, 'A', "2A", 0x00, false
+};
+
+// The 40 track images made by speeders and copiers. The standard BAM doesn't cover the extra tracks, so they are
+// readable but nothing is allocated there.
+constexpr DiskGeometry geometryD64Extended = {
+	"D64", 40, 4, { { 17, 21 }, { 24, 19 }, { 30, 18 }, { 40, 17 } },
+	18, 0, 0x90, 18, 1, 0,
+	1, { { 1, 35, 18, 0, 0x04, 4, 18, 0, 0x05, 4, 3 } },
+	10, 3, 'A', "2A", 0x00, false
+};
+
+// 1571: both sides of a 1541 disk, side two is tracks 36-70. Its free counts are at the end of the BAM sector and its
+// bitmaps on track 53, which is kept free of files.
+constexpr DiskGeometry geometryD71 = {
+	"D71", 70, 8, { { 17, 21 }, { 24, 19 }, { 30, 18 }, { 35, 17 }, { 52, 21 }, { 59, 19 }, { 65, 18 }, { 70, 17 } },
+	18, 0, 0x90, 18, 1, 53,
+	2, { { 1, 35, 18, 0, 0x04, 4, 18, 0, 0x05, 4, 3 }, { 36, 70, 18, 0, 0xDD, 1, 53, 0, 0x00, 3, 3 } },
+	6, 3, 'A', "2A", 0x80, false
+};
+
+// 1581: 80 tracks of 40 sectors. The header is 40/0, the BAM is 40/1 (tracks 1-40) and 40/2 (tracks 41-80), the
+// directory starts at 40/3.
+constexpr DiskGeometry geometryD81 = {
+	"D81", 80, 1, { { 80, 40 } },
+	40, 0, 0x04, 40, 3, 0,
+	2, { { 1, 40, 40, 1, 0x10, 6, 40, 1, 0x11, 6, 5 }, { 41, 80, 40, 2, 0x10, 6, 40, 2, 0x11, 6, 5 } },
+	1, 1, 'D', "3D", 0x00, true
+};
+
+
+// The lookup tables of a geometry. The tables are indexed by the track byte as is, so any track and sector from an
+// image or the CBM can be looked up without checking it first.
+class DiskLayout
+{
+public:
+	explicit DiskLayout(const DiskGeometry& geometry);
+
+	// One layout per format, made on first use.
+	static const DiskLayout& d64();
+	static const DiskLayout& d64Extended();
+	static const DiskLayout& d71();
+	static const DiskLayout& d81();
+
+	const DiskGeometry& geometry() const
+	{
+		return m_geometry;
+	}
+
+	// 0 for a track that isn't on the disk.
+	uchar sectors(uchar track) const
+	{
+		return m_sectors[track];
+	}
+
+	// Offset of the sector in the image, -1 if it isn't on the disk.
+	qint32 offset(uchar track, uchar sector) const
+	{
+		return sector < m_sectors[track] ? (m_firstBlock[track] + sector) * BLOCK_SIZE : -1;
+	}
+
+	int blocks() const
+	{
+		return m_blocks;
+	}
+
+	qint32 imageSize() const
+	{
+		return m_blocks * BLOCK_SIZE;
+	}
+
+	// Image offsets of the BAM free count and bitmap of the track, -1 if the BAM doesn't cover the track.
+	qint32 bamCountOffset(uchar track) const
+	{
+		return m_bamCount[track];
+	}
+
+	qint32 bamBitmapOffset(uchar track) const
+	{
+		return m_bamBitmap[track];
+	}
+
+	uchar bamBitmapBytes(uchar track) const
+	{
+		return m_bamBitmapBytes[track];
+	}
+
+	// The directory track and the other system track aren't used for files, nor counted in the blocks free.
+	bool isSystemTrack(uchar track) const
+	{
+		return m_geometry.dirTrack == track or (0 not_eq m_geometry.systemTrack and m_geometry.systemTrack == track);
+	}
+
+private:
+	static const int BLOCK_SIZE = 256;
+	static const int TABLE_SIZE = 256;
+
+	const DiskGeometry& m_geometry;
+	int m_blocks;
+	uchar m_sectors[TABLE_SIZE];
+	ushort m_firstBlock[TABLE_SIZE];
+	qint32 m_bamCount[TABLE_SIZE];
+	qint32 m_bamBitmap[TABLE_SIZE];
+	uchar m_bamBitmapBytes[TABLE_SIZE];
+};
+
+#endif // DISKGEOMETRY_HPP
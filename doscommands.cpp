@@ -21,7 +21,9 @@ RenameFile renameFileCmd;
 CopyFiles copyFilesCmd;
 SetPosition setPositionCmd;
 BlockRead blockReadCmd;
+User1 user1Cmd;
 BlockWrite blockWriteCmd;
+User2 user2Cmd;
 MemoryRead memoryReadCmd;
 MemoryWrite memoryWriteCmd;
 BufferPointer bufferPointerCmd;
@@ -29,12 +31,44 @@ BlockAllocate blockAllocateCmd;
 BlockFree blockFreeCmd;
 BlockExecute blockExecuteCmd;
 MemoryExecute memoryExecuteCmd;
+User3 user3Cmd;
+User4 user4Cmd;
+User5 user5Cmd;
+User6 user6Cmd;
+User7 user7Cmd;
+User8 user8Cmd;
 VC20ModeOnOff vc20ModeOnOffCmd;
 DeviceAddress deviceAddressCmd;
 ChangeDirectory chDirCmd;
 MakeDirectory makeDirCmd;
 RemoveDirectory rmDirCmd;
-}
+
+
+// The numbers of a block command, e.g. "U1:2 0 18 0" or "B-P 2,1" (PRINT#15,"B-P";2;1 puts spaces around them).
+// False if there are fewer than count of them or one doesn't fit a byte.
+bool blockParameters(const QByteArray& params, int count, QList<uchar>& numbers)
+{
+	const QStringList fields(QString(params).split(QRegExp("[^0-9]+"), QString::SkipEmptyParts));
+	if(fields.count() < count)
+		return false;
+	numbers.clear();
+	for(int i = 0; i < count; ++i) {
+		const uint number = fields.at(i).toUInt();
+		if(number > 255)
+			return false;
+		numbers.append(uchar(number));
+	}
+	return true;
+} // blockParameters
+
+
+// U3 to U8 jump into the table of JMPs at $0500 the user program puts there, three bytes each.
+ushort userJumpAddress(int userNumber)
+{
+	return 0x0500 + 3 * (userNumber - 3);
+} // userJumpAddress
+
+} // unnamed namespace
 
 
 CBM::IOErrorMessage InitDrive::process(const QByteArray& params, Interface& iface)
@@ -48,8 +82,10 @@ CBM::IOErrorMessage InitDrive::process(const QByteArray& params, Interface& ifac
 CBM::IOErrorMessage ValidateDisk::process(const QByteArray& params, Interface& iface)
 {
 	Q_UNUSED(params);
-	Q_UNUSED(iface);
-	return CBM::ErrNotImplemented;
+	if(iface.isDiskWriteProtected())
+		return CBM::ErrWriteProtectOn;
+	Log(FACDOS, info, QString("About to validate disk"));
+	return iface.currentFileDriver()->validateDisk();
 } // ValidateDisk
 
 
@@ -185,25 +221,52 @@ CBM::IOErrorMessage SetPosition::process(const QByteArray& params, Interface& if
 
 CBM::IOErrorMessage BlockRead::process(const QByteArray& params, Interface& iface)
 {
-	Q_UNUSED(params);
-	Q_UNUSED(iface);
-	return CBM::ErrNotImplemented;
+	// Channel, drive, track, sector. The drive is always 0.
+	QList<uchar> numbers;
+	if(not blockParameters(params, 4, numbers))
+		return CBM::ErrSyntaxError;
+	return iface.readBlock(numbers[0], numbers[2], numbers[3], false);
 } // BlockRead
 
 
+CBM::IOErrorMessage User1::process(const QByteArray& params, Interface& iface)
+{
+	QList<uchar> numbers;
+	if(not blockParameters(params, 4, numbers))
+		return CBM::ErrSyntaxError;
+	return iface.readBlock(numbers[0], numbers[2], numbers[3], true);
+} // User1
+
+
 CBM::IOErrorMessage BlockWrite::process(const QByteArray& params, Interface& iface)
 {
-	Q_UNUSED(params);
-	Q_UNUSED(iface);
-	return CBM::ErrNotImplemented;
+	QList<uchar> numbers;
+	if(not blockParameters(params, 4, numbers))
+		return CBM::ErrSyntaxError;
+	return iface.writeBlock(numbers[0], numbers[2], numbers[3], false);
 } // BlockWrite
 
 
+CBM::IOErrorMessage User2::process(const QByteArray& params, Interface& iface)
+{
+	QList<uchar> numbers;
+	if(not blockParameters(params, 4, numbers))
+		return CBM::ErrSyntaxError;
+	return iface.writeBlock(numbers[0], numbers[2], numbers[3], true);
+} // User2
+
+
 CBM::IOErrorMessage MemoryRead::process(const QByteArray& params, Interface& iface)
 {
-	Q_UNUSED(params);
-	Q_UNUSED(iface);
-	return CBM::ErrNotImplemented;
+	if(params.length() < 2)
+		return CBM::ErrSyntaxError;
+	ushort address = ((ushort)(uchar)params.at(1)) << 8 bitor ((uchar)params.at(0));
+	// Without a size one byte is read, a size of 0 reads 256 bytes.
+	ushort length = params.length() >= 3 ? (uchar)params.at(2) : 1;
+	if(0 == length)
+		length = 256;
+	iface.readDriveMemory(address, length);
+	return CBM::ErrOK;
 } // MemoryReadCmd
 
 
@@ -211,20 +274,12 @@ CBM::IOErrorMessage MemoryWrite::process(const QByteArray& params, Interface& if
 {
 	if(params.length() < 3)
 		return CBM::ErrSyntaxError;
-	ushort address = ((ushort)params.at(1)) << 8 bitor ((uchar)params.at(0));
-	ushort length = (uchar)params.at(2);
-	QByteArray bytes(params.mid(3));
-	Log(FACDOS, warning, QString("M-W 0x%1:%2").arg(QString::number(address, 16))
-		.arg(QString::number(length)));
-	// What to do if the designated length doesn't match with the actual received amount of bytes?
-	if(bytes.length() not_eq length) {
-		// resize and don't expect more, temporary solution?
-		bytes.resize(length);
-		// TODO: if we fix this, here we need to know that succeeding bytes are meant to be written with M-W.
-		// and we need to know how many is left and where.
-	}
-	// Do the actual memory write.
-	iface.writeDriveMemory(address, bytes);
+	ushort address = ((ushort)(uchar)params.at(1)) << 8 bitor ((uchar)params.at(0));
+	// Written straight from the command, fast loaders upload their drive code with many of these.
+	// TODO: If fewer bytes than the designated length arrived, only those are written. Handling the rest would need to
+	// know that succeeding bytes are meant to be written with M-W, how many are left and where.
+	int length = qMin((int)(uchar)params.at(2), params.length() - 3);
+	iface.writeDriveMemory(address, params.constData() + 3, length);
 
 	return CBM::ErrOK;
 } // MemoryWrite
@@ -232,44 +287,94 @@ CBM::IOErrorMessage MemoryWrite::process(const QByteArray& params, Interface& if
 
 CBM::IOErrorMessage BufferPointer::process(const QByteArray& params, Interface& iface)
 {
-	Q_UNUSED(params);
-	Q_UNUSED(iface);
-	return CBM::ErrNotImplemented;
+	// Channel, position.
+	QList<uchar> numbers;
+	if(not blockParameters(params, 2, numbers))
+		return CBM::ErrSyntaxError;
+	return iface.setBufferPointer(numbers[0], numbers[1]);
 } // BufferPointer
 
 
 CBM::IOErrorMessage BlockAllocate::process(const QByteArray& params, Interface& iface)
 {
-	Q_UNUSED(params);
-	Q_UNUSED(iface);
-	return CBM::ErrNotImplemented;
+	// Drive, track, sector.
+	QList<uchar> numbers;
+	if(not blockParameters(params, 3, numbers))
+		return CBM::ErrSyntaxError;
+	return iface.allocateBlock(numbers[1], numbers[2], true);
 } // BlockAllocate
 
 
 CBM::IOErrorMessage BlockFree::process(const QByteArray& params, Interface& iface)
 {
-	Q_UNUSED(params);
-	Q_UNUSED(iface);
-	return CBM::ErrNotImplemented;
+	QList<uchar> numbers;
+	if(not blockParameters(params, 3, numbers))
+		return CBM::ErrSyntaxError;
+	return iface.allocateBlock(numbers[1], numbers[2], false);
 } // BlockFree
 
 
 CBM::IOErrorMessage BlockExecute::process(const QByteArray& params, Interface& iface)
 {
-	Q_UNUSED(params);
-	Q_UNUSED(iface);
-	return CBM::ErrNotImplemented;
+	// Channel, drive, track, sector.
+	QList<uchar> numbers;
+	if(not blockParameters(params, 4, numbers))
+		return CBM::ErrSyntaxError;
+	return iface.executeBlock(numbers[0], numbers[2], numbers[3]);
 } // BlockExecute
 
 
 CBM::IOErrorMessage MemoryExecute::process(const QByteArray& params, Interface& iface)
 {
-	Q_UNUSED(params);
-	Q_UNUSED(iface);
-	return CBM::ErrNotImplemented;
+	if(params.length() < 2)
+		return CBM::ErrSyntaxError;
+	ushort address = ((ushort)(uchar)params.at(1)) << 8 bitor ((uchar)params.at(0));
+	return iface.executeDriveCode(address);
 } // MemoryExecute
 
 
+CBM::IOErrorMessage User3::process(const QByteArray& params, Interface& iface)
+{
+	Q_UNUSED(params);
+	return iface.executeDriveCode(userJumpAddress(3));
+} // User3
+
+
+CBM::IOErrorMessage User4::process(const QByteArray& params, Interface& iface)
+{
+	Q_UNUSED(params);
+	return iface.executeDriveCode(userJumpAddress(4));
+} // User4
+
+
+CBM::IOErrorMessage User5::process(const QByteArray& params, Interface& iface)
+{
+	Q_UNUSED(params);
+	return iface.executeDriveCode(userJumpAddress(5));
+} // User5
+
+
+CBM::IOErrorMessage User6::process(const QByteArray& params, Interface& iface)
+{
+	Q_UNUSED(params);
+	return iface.executeDriveCode(userJumpAddress(6));
+} // User6
+
+
+CBM::IOErrorMessage User7::process(const QByteArray& params, Interface& iface)
+{
+	Q_UNUSED(params);
+	return iface.executeDriveCode(userJumpAddress(7));
+} // User7
+
+
+CBM::IOErrorMessage User8::process(const QByteArray& params, Interface& iface)
+{
+	Q_UNUSED(params);
+	return iface.executeDriveCode(userJumpAddress(8));
+} // User8
+
+
 CBM::IOErrorMessage VC20ModeOnOff::process(const QByteArray& params, Interface& iface)
 {
 	Q_UNUSED(params);
@@ -171,12 +171,16 @@ DECLARE_DOSCMD_IMPL(CopyFiles, "COPY|C|C0", ':');
 // Syntax: "P"+CHR$(Channel)+CHR$(RecLow)+CHR$(RecHi)+CHR$(Pos)
 DECLARE_DOSCMD_IMPL(SetPosition, "POSITION|P", QChar());
 
+// The block commands take their numbers separated by spaces, commas or a colon, however they were PRINTed. The
+// channel is one opened with OPEN n,8,n,"#", see DriveBuffers.
+
 // BLOCK-READ - Read a Disk Block into the internal floppy RAM
 // Abbreviation: U1 (superseded by USER1, U1)
 // USER1 works like BLOCK-READ with the exception that U1 considers the link to the next block to be part of the data.
 // Thus a block read with U1 will be 256 (rather than max. 254) bytes long.
 // Syntax: "B-R:"+STR$(Channel)+STR$(Drive)+STR$(Track)+STR$(Sector)
-DECLARE_DOSCMD_IMPL(BlockRead, "B-R|U1", ':');
+DECLARE_DOSCMD_IMPL(BlockRead, "B-R|BLOCK-READ", QChar());
+DECLARE_DOSCMD_IMPL(User1, "U1|UA", QChar());
 
 
 
@@ -185,7 +189,8 @@ DECLARE_DOSCMD_IMPL(BlockRead, "B-R|U1", ':');
 // USER2 works like BLOCK-WRITE with the exception that U2 considers the link to the next block to be part of the data.
 // Thus a block written with U2 has to be 256 (rather than max. 254) bytes long.
 // Syntax: "B-W:"+STR$(Channel)+STR$(Drive)+STR$(Track)+STR$(Sector)
-DECLARE_DOSCMD_IMPL(BlockWrite, "B-W|U2", ':');
+DECLARE_DOSCMD_IMPL(BlockWrite, "B-W|BLOCK-WRITE", QChar());
+DECLARE_DOSCMD_IMPL(User2, "U2|UB", QChar());
 
 
 // MEMORY-READ - Read Data from the floppy RAM
@@ -203,23 +208,22 @@ DECLARE_DOSCMD_IMPL(MemoryWrite, "M-W", QChar());
 // BUFFER-POINTER - Set the pointer for a buffered block
 // Abbreviation: B-P
 // Syntax: "B-P:"+STR$(Channel)+STR$(Pos)
-DECLARE_DOSCMD_IMPL(BufferPointer, "BUFFER-POINTER|B-P", ':');
+DECLARE_DOSCMD_IMPL(BufferPointer, "BUFFER-POINTER|B-P", QChar());
 
 // BLOCK-ALLOCATE - Mark a disk block as used
 // Abbreviation: B-A
 // Syntax: "B-A:"+STR$(Drive)+STR$(Track)+STR$(Sector)
-DECLARE_DOSCMD_IMPL(BlockAllocate, "BLOCK-ALLOCATE|B-A", ':');
+DECLARE_DOSCMD_IMPL(BlockAllocate, "BLOCK-ALLOCATE|B-A", QChar());
 
 // BLOCK-FREE - Mark a disk block as unused
 // Abbreviation: B-F
-// Syntax: "B-F:"+STR$(Channel)+STR$(Pos)
-DECLARE_DOSCMD_IMPL(BlockFree, "BLOCK-FREE|B-F", ':');
+// Syntax: "B-F:"+STR$(Drive)+STR$(Track)+STR$(Sector)
+DECLARE_DOSCMD_IMPL(BlockFree, "BLOCK-FREE|B-F", QChar());
 
 // BLOCK-EXECUTE - Read a Disk Block into the internal floppy and execute it. Abbreviation: B-E
 // Syntax: "B-E:"+STR$(Channel)+STR$(Drive)+STR$(Track)+STR$(Sector)
-// Note: Block Execute obviously requires the complete emulation of the MOS 6502 CPU in the 1541.
-// This is the place to check if a turbo loader should be enabled.
-DECLARE_DOSCMD_IMPL(BlockExecute, "BLOCK-EXECUTE|B-E", ':');
+// The block is read into the buffer of the channel and run like M-E does, on the emulated 1541 CPU.
+DECLARE_DOSCMD_IMPL(BlockExecute, "BLOCK-EXECUTE|B-E", QChar());
 
 
 // MEMORY-EXECUTE - Run a User Program on the Floppy
@@ -227,9 +231,15 @@ DECLARE_DOSCMD_IMPL(BlockExecute, "BLOCK-EXECUTE|B-E", ':');
 // Abbreviation: U3..U8
 // For U3..U8: Program execution starts at $0500 + 3*(x-3) (i.e. $0500 for U3, $0503 for U4...)
 // Syntax: "M-E"+CHR$(LowAddress)+CHR$(HighAddress)
-// Note: Memory Execute obviously requires the complete emulation of the MOS 6502 CPU in the 1541.
-// This is the place to check if a turbo loader should be enabled.
-DECLARE_DOSCMD_IMPL(MemoryExecute, "M-E|USER3|U3|USER4|U4|USER5|U5|USER6|U6|USER7|U7", QChar());
+// The uploaded code runs on the emulated 1541 CPU, see Drive1541, and is logged with its fingerprint, see DriveCode.
+// What it did on the serial bus is replayed by the Arduino right after the command (Interface::processBusReplayRequest).
+DECLARE_DOSCMD_IMPL(MemoryExecute, "M-E", QChar());
+DECLARE_DOSCMD_IMPL(User3, "U3|USER3", QChar());
+DECLARE_DOSCMD_IMPL(User4, "U4|USER4", QChar());
+DECLARE_DOSCMD_IMPL(User5, "U5|USER5", QChar());
+DECLARE_DOSCMD_IMPL(User6, "U6|USER6", QChar());
+DECLARE_DOSCMD_IMPL(User7, "U7|USER7", QChar());
+DECLARE_DOSCMD_IMPL(User8, "U8|USER8", QChar());
 
 
 // USERI - Switch the C1541 between C64 to VC20 mode
@@ -0,0 +1,237 @@
+#include <string.h>
+#include "drive1541.hpp"
+
+namespace {
+
+// How far the CPU runs between looking at the interrupt lines of the VIAs (when no timer runs out before).
+const quint64 SLICE_CYCLES = 1000;
+
+const uchar RAM_PAGES = CBM1541_RAM_SIZE / 256;
+const uchar ROM_PAGES = CBM1541_ROM_SIZE / 256;
+
+// VIA1 port B: the serial bus. The inputs read 1 while a line is pulled low.
+const uchar BUS_DATA_IN = 0x01;
+const uchar BUS_DATA_OUT = 0x02;
+const uchar BUS_CLOCK_IN = 0x04;
+const uchar BUS_CLOCK_OUT = 0x08;
+const uchar BUS_ATN_ACK = 0x10;
+// VIA2 port B, as read without a disk spinning: not write protected (bit 4 high), no SYNC (bit 7 high).
+const uchar DISK_CONTROL_INPUTS = 0x90;
+
+// The VIAs as the ROM's reset routine leaves them ($EAA0, the disk controller's at $F259).
+// VIA1: DATA out, CLOCK out and ATNA are outputs, all released. ATN interrupts on the positive edge at CA1.
+const uchar VIA1_DDRB = 0x1A;
+const uchar VIA1_ORB = 0x00;
+const uchar VIA1_PCR = 0x01;
+// VIA2: The stepper, motor, LED and density bits are outputs (motor and LED off, density of the outer tracks), port A
+// (the GCR byte) is an input for reading. CA2 (byte ready) and CB2 (read mode) high, T1 free running as the 14.8 ms
+// clock of the controller's interrupt.
+const uchar VIA2_DDRB = 0x6F;
+const uchar VIA2_ORB = 0x60;
+const uchar VIA2_DDRA = 0x00;
+const uchar VIA2_PCR = 0xEE;
+const uchar VIA2_ACR = 0x41;
+const ushort VIA2_T1_LATCH = 0x3A00;
+
+
+// The bus lines the drive pulls with VIA1 port B driving the levels, as BUS_REPLAY_* bits. Like updateBusInputs()
+// the ATN acknowledge logic pulls DATA while ATNA is set, ATN being released.
+uchar busLines(uchar portB)
+{
+	uchar lines = 0;
+	if(portB bitand BUS_CLOCK_OUT)
+		lines or_eq BUS_REPLAY_CLOCK;
+	if((portB bitand BUS_DATA_OUT) or (portB bitand BUS_ATN_ACK))
+		lines or_eq BUS_REPLAY_DATA;
+	return lines;
+} // busLines
+
+
+void appendReplayEntry(QByteArray& replay, ushort delay, uchar lines)
+{
+	replay.append(char(delay bitand 0xFF)).append(char(delay >> 8)).append(char(lines));
+} // appendReplayEntry
+
+} // unnamed namespace
+
+
+Drive1541::Drive1541()
+	: m_cpu(*this), m_pJobHandler(0), m_executeCycle(0)
+{
+	for(uint page = 0; page < (CBM1541_VIA1_OFFSET >> 8); ++page)
+		m_cpu.mapPage(page, m_ram + (page % RAM_PAGES) * 256, m_ram + (page % RAM_PAGES) * 256);
+	reset();
+} // ctor
+
+
+void Drive1541::setRom(const QByteArray& rom)
+{
+	// Writes to ROM go to the bus, which ignores them.
+	const bool hasRom = CBM1541_ROM_SIZE == rom.size();
+	if(hasRom)
+		memcpy(m_rom, rom.constData(), CBM1541_ROM_SIZE);
+	for(uint page = 0x80; page <= 0xFF; ++page)
+		m_cpu.mapPage(page, hasRom ? m_rom + (page % ROM_PAGES) * 256 : 0, 0);
+} // setRom
+
+
+void Drive1541::reset()
+{
+	memset(m_ram, 0, sizeof(m_ram));
+	m_via1.reset();
+	m_via2.reset();
+	m_via2.setPortInput(Via6522::PortB, DISK_CONTROL_INPUTS);
+	// The ROM's reset routine isn't run, execute() sets the PC. Drive code relies on the ports it sets up though, e.g. it
+	// only writes $1800 to move the bus lines. The interrupts it enables stay off: the jobs are serviced by the job
+	// handler instead of the ROM's interrupt routine.
+	const quint64 cycle = m_cpu.cycles();
+	m_via1.write(Via6522::RegORB, VIA1_ORB, cycle);
+	m_via1.write(Via6522::RegDDRB, VIA1_DDRB, cycle);
+	m_via1.write(Via6522::RegPCR, VIA1_PCR, cycle);
+	m_via2.write(Via6522::RegORB, VIA2_ORB, cycle);
+	m_via2.write(Via6522::RegDDRB, VIA2_DDRB, cycle);
+	m_via2.write(Via6522::RegDDRA, VIA2_DDRA, cycle);
+	m_via2.write(Via6522::RegPCR, VIA2_PCR, cycle);
+	m_via2.write(Via6522::RegACR, VIA2_ACR, cycle);
+	m_via2.write(Via6522::RegT1LL, VIA2_T1_LATCH bitand 0xFF, cycle);
+	m_via2.write(Via6522::RegT1CH, VIA2_T1_LATCH >> 8, cycle);
+	m_via1.clearPortWrites();
+	m_via2.clearPortWrites();
+	m_cpu.reset();
+} // reset
+
+
+void Drive1541::readMemory(ushort address, char* pDest, int length)
+{
+	while(length > 0) {
+		const int offset = address bitand 0xFF;
+		const int chunk = qMin(length, 0x100 - offset);
+		const uchar* pPage = m_cpu.readPage(address >> 8);
+		if(0 not_eq pPage)
+			memcpy(pDest, pPage + offset, chunk);
+		else {
+			for(int i = 0; i < chunk; ++i)
+				pDest[i] = read(address + i);
+		}
+		address += chunk;
+		pDest += chunk;
+		length -= chunk;
+	}
+} // readMemory
+
+
+void Drive1541::writeMemory(ushort address, const char* pSource, int length)
+{
+	while(length > 0) {
+		const int offset = address bitand 0xFF;
+		const int chunk = qMin(length, 0x100 - offset);
+		uchar* pPage = m_cpu.writePage(address >> 8);
+		if(0 not_eq pPage)
+			memcpy(pPage + offset, pSource, chunk);
+		else {
+			for(int i = 0; i < chunk; ++i)
+				write(address + i, pSource[i]);
+		}
+		address += chunk;
+		pSource += chunk;
+		length -= chunk;
+	}
+} // writeMemory
+
+
+bool Drive1541::execute(ushort address, quint64 maxCycles)
+{
+	m_cpu.jumpSubroutine(address, RETURN_ADDRESS);
+	m_cpu.setStopAddress(RETURN_ADDRESS);
+	m_via1.clearPortWrites();
+	m_via2.clearPortWrites();
+	m_executeCycle = m_cpu.cycles();
+
+	const quint64 endCycle = m_cpu.cycles() + maxCycles;
+	while(m_cpu.cycles() < endCycle) {
+		// Run up to the next timer event so that its interrupt is taken on time.
+		quint64 untilCycle = qMin(endCycle, m_cpu.cycles() + SLICE_CYCLES);
+		untilCycle = qMin(untilCycle, qMin(m_via1.nextEvent(), m_via2.nextEvent()));
+		untilCycle = qMax(untilCycle, m_cpu.cycles() + 1);
+		const Mos6502::StopReason reason = m_cpu.run(untilCycle);
+		m_via1.advanceTo(m_cpu.cycles());
+		m_via2.advanceTo(m_cpu.cycles());
+		m_cpu.setIrq(m_via1.irq() or m_via2.irq());
+		// Jobs the code queued are done before it polls for them again.
+		if(0 not_eq m_pJobHandler)
+			m_pJobHandler->serviceJobs();
+		if(Mos6502::StopAddress == reason)
+			return true;
+		if(Mos6502::Jammed == reason)
+			return false;
+	}
+	return false;
+} // execute
+
+
+QByteArray Drive1541::takeBusReplay()
+{
+	QByteArray replay;
+	quint64 cycle = m_executeCycle;
+	// From the lines released, as the Arduino leaves them after the command.
+	uchar lines = 0;
+	Via6522::PortWrite change;
+	while(m_via1.takePortWrite(change)) {
+		const uchar changedLines = busLines(change.value);
+		if(Via6522::PortB not_eq change.port or changedLines == lines)
+			continue;
+		// Longer waits are split, the lines staying as they are.
+		quint64 delay = change.cycle - cycle;
+		for(; delay > MAX_BUS_REPLAY_DELAY; delay -= MAX_BUS_REPLAY_DELAY)
+			appendReplayEntry(replay, MAX_BUS_REPLAY_DELAY, lines);
+		appendReplayEntry(replay, ushort(delay), changedLines);
+		cycle = change.cycle;
+		lines = changedLines;
+	}
+	m_via2.clearPortWrites();
+	return replay;
+} // takeBusReplay
+
+
+void Drive1541::updateBusInputs()
+{
+	// Nobody else on the bus: a line is low when the drive pulls it. DATA is also pulled by the ATN acknowledge
+	// logic while ATNA differs from ATN (which is released).
+	const uchar outputs = m_via1.portOutput(Via6522::PortB);
+	uchar inputs = 0;
+	if((outputs bitand BUS_DATA_OUT) or (outputs bitand BUS_ATN_ACK))
+		inputs or_eq BUS_DATA_IN;
+	if(outputs bitand BUS_CLOCK_OUT)
+		inputs or_eq BUS_CLOCK_IN;
+	// Device number jumpers (PB5, PB6) at device 8, ATN in (PB7) released.
+	m_via1.setPortInput(Via6522::PortB, inputs);
+} // updateBusInputs
+
+
+uchar Drive1541::read(ushort address)
+{
+	switch(address bitand 0xFC00) {
+		case CBM1541_VIA1_OFFSET:
+			if(Via6522::RegORB == (address bitand 0x0F))
+				updateBusInputs();
+			return m_via1.read(address, m_cpu.cycles());
+		case CBM1541_VIA2_OFFSET:
+			return m_via2.read(address, m_cpu.cycles());
+		default:
+			// Nothing decoded: the data bus keeps the high byte of the address.
+			return address >> 8;
+	}
+} // read
+
+
+void Drive1541::write(ushort address, uchar value)
+{
+	switch(address bitand 0xFC00) {
+		case CBM1541_VIA1_OFFSET:
+			m_via1.write(address, value, m_cpu.cycles());
+			break;
+		case CBM1541_VIA2_OFFSET:
+			m_via2.write(address, value, m_cpu.cycles());
+			break;
+	}
+} // write
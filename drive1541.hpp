@@ -0,0 +1,95 @@
+#ifndef DRIVE1541_HPP
+#define DRIVE1541_HPP
+
+#include <QByteArray>
+
+#include "mos6502.hpp"
+#include "via6522.hpp"
+#include "uno2iec/cbmdefines.h"
+
+// The 1541 board around its 6502: 2 KB RAM (mirrored up to $1800), VIA1 (serial bus) at $1800, VIA2 (disk
+// controller) at $1C00 and the 16 KB ROM at $C000 (mirrored from $8000).
+// The 64 KB address space is one page table, set up once: RAM and ROM pages point into the memory here and are
+// accessed directly, the other pages dispatch to the VIAs or read as unconnected. The CPU and the memory commands of
+// the CBM (M-R, M-W) go through the same table.
+// Used to run the code a CBM uploads and starts (M-E) far faster than the real drive. The IEC bus seen on VIA1 is idle
+// apart from what the drive itself pulls, and the disk controller sees a write enabled disk without any SYNC: the
+// emulation is of the drive code, what it sends on its ports is recorded per VIA. The changes of the serial bus lines
+// are handed to the Arduino to replay on the real bus, see takeBusReplay().
+class Drive1541 : private Mos6502::IBus
+{
+public:
+	// Passed as the return address of the started code: its final RTS arrives here.
+	static const ushort RETURN_ADDRESS = 0xFFFF;
+
+	// Does the work of the disk controller: looks at the job queue in RAM while drive code runs.
+	class IJobHandler
+	{
+	public:
+		virtual void serviceJobs() = 0;
+	};
+
+	Drive1541();
+
+	// Sets the ROM image, mapped if it has the 1541 ROM size (otherwise the ROM area reads as unconnected).
+	void setRom(const QByteArray& rom);
+	// Power on state: RAM cleared, CPU reset and the VIAs set up as the ROM's reset routine leaves them.
+	void reset();
+	// Called between the slices execute() runs the CPU in (none by default).
+	void setJobHandler(IJobHandler* pHandler)
+	{
+		m_pJobHandler = pHandler;
+	}
+
+	// Memory as the CBM sees it with M-R and M-W: RAM and ROM copied page wise, VIA registers read and written like
+	// the CPU does (with their side effects). Writes to ROM and unconnected areas are ignored.
+	void readMemory(ushort address, char* pDest, int length);
+	void writeMemory(ushort address, const char* pSource, int length);
+
+	// Runs the code at the address as a subroutine until it returns, the CPU jams or the number of cycles has passed.
+	// Returns true if it returned.
+	bool execute(ushort address, quint64 maxCycles);
+	// What the last execute() did on the serial bus, as the Arduino replays it (see BUS_REPLAY_ENTRY_SIZE): the lines
+	// pulled at each change with the time since the one before, a cycle of the drive being a microsecond. Takes the
+	// changes recorded on VIA1, those of VIA2 (the disk controller) are dropped.
+	QByteArray takeBusReplay();
+
+	const uchar* ram() const
+	{
+		return m_ram;
+	}
+
+	Mos6502& cpu()
+	{
+		return m_cpu;
+	}
+
+	Via6522& via1()
+	{
+		return m_via1;
+	}
+
+	Via6522& via2()
+	{
+		return m_via2;
+	}
+
+private:
+	// Mos6502::IBus implementation, for the pages not mapped: the VIAs and the unconnected areas.
+	uchar read(ushort address);
+	void write(ushort address, uchar value);
+
+	// Serial bus lines as VIA1 port B reads them.
+	void updateBusInputs();
+
+	Mos6502 m_cpu;
+	Via6522 m_via1;
+	Via6522 m_via2;
+	IJobHandler* m_pJobHandler;
+	// Where the replay of the last execute() starts from.
+	quint64 m_executeCycle;
+	uchar m_ram[CBM1541_RAM_SIZE];
+	uchar m_rom[CBM1541_ROM_SIZE];
+};
+
+#endif // DRIVE1541_HPP
@@ -0,0 +1,181 @@
+#include "drivebuffers.hpp"
+#include "drive1541.hpp"
+#include "d64driver.hpp"
+
+namespace {
+
+const ushort BUFFERS_ADDRESS = 0x0300;
+const int BLOCK_SIZE = 256;
+// After OPEN and B-W the data of a block starts after the count (B-R/B-W) or the link (files) in its first byte.
+const uchar DATA_START = 1;
+
+} // unnamed namespace
+
+
+DriveBuffers::DriveBuffers(Drive1541& drive)
+	: m_drive(drive)
+{
+	reset();
+} // ctor
+
+
+void DriveBuffers::reset()
+{
+	for(uchar channel = 0; channel < NUM_CHANNELS; ++channel)
+		close(channel);
+} // reset
+
+
+CBM::IOErrorMessage DriveBuffers::open(uchar channel, const QByteArray& name)
+{
+	if(channel >= NUM_CHANNELS or not name.startsWith('#'))
+		return CBM::ErrSyntaxError;
+	close(channel);
+
+	bool inUse[NUM_BUFFERS] = { false };
+	for(uchar other = 0; other < NUM_CHANNELS; ++other)
+		if(isBufferChannel(other))
+			inUse[m_channels[other].buffer] = true;
+
+	int buffer = -1;
+	if(name.length() > 1) {
+		// A specific buffer: "#2".
+		bool ok;
+		buffer = name.mid(1).trimmed().toInt(&ok);
+		if(not ok or buffer < 0 or buffer >= NUM_BUFFERS or inUse[buffer])
+			return CBM::ErrNoChannelAvailable;
+	}
+	else {
+		// The first free one.
+		buffer = 0;
+		while(buffer < NUM_BUFFERS and inUse[buffer])
+			++buffer;
+		if(NUM_BUFFERS == buffer)
+			return CBM::ErrNoChannelAvailable;
+	}
+
+	Channel& chan = m_channels[channel];
+	chan.buffer = buffer;
+	chan.pointer = DATA_START;
+	chan.end = BLOCK_SIZE;
+	return CBM::ErrOK;
+} // open
+
+
+void DriveBuffers::close(uchar channel)
+{
+	if(channel < NUM_CHANNELS)
+		m_channels[channel].buffer = -1;
+} // close
+
+
+int DriveBuffers::buffer(uchar channel) const
+{
+	return isBufferChannel(channel) ? m_channels[channel].buffer : -1;
+} // buffer
+
+
+ushort DriveBuffers::bufferAddress(uchar buffer)
+{
+	return BUFFERS_ADDRESS + buffer * BLOCK_SIZE;
+} // bufferAddress
+
+
+void DriveBuffers::read(uchar channel, QByteArray& data)
+{
+	if(not isBufferChannel(channel)) {
+		data.resize(0);
+		return;
+	}
+	const Channel& chan = m_channels[channel];
+	data.resize(chan.end - chan.pointer);
+	m_drive.readMemory(bufferAddress(chan.buffer) + chan.pointer, data.data(), data.size());
+} // read
+
+
+void DriveBuffers::advance(uchar channel, int count)
+{
+	if(not isBufferChannel(channel))
+		return;
+	Channel& chan = m_channels[channel];
+	const int pointer = chan.pointer + count;
+	chan.pointer = pointer >= chan.end ? 0 : pointer;
+} // advance
+
+
+void DriveBuffers::write(uchar channel, const char* pData, int length)
+{
+	if(not isBufferChannel(channel))
+		return;
+	Channel& chan = m_channels[channel];
+	const ushort address = bufferAddress(chan.buffer);
+	// The pointer wraps around within the buffer, like on the drive.
+	while(length > 0) {
+		const int chunk = qMin(length, BLOCK_SIZE - chan.pointer);
+		m_drive.writeMemory(address + chan.pointer, pData, chunk);
+		chan.pointer += chunk;
+		pData += chunk;
+		length -= chunk;
+	}
+	chan.end = BLOCK_SIZE;
+} // write
+
+
+CBM::IOErrorMessage DriveBuffers::setPointer(uchar channel, uchar position)
+{
+	if(not isBufferChannel(channel))
+		return CBM::ErrNoChannelAvailable;
+	m_channels[channel].pointer = position;
+	m_channels[channel].end = BLOCK_SIZE;
+	return CBM::ErrOK;
+} // setPointer
+
+
+CBM::IOErrorMessage DriveBuffers::readBlock(uchar channel, const D64* pDisk, uchar track, uchar sector,
+																						 bool wholeBlock)
+{
+	if(not isBufferChannel(channel))
+		return CBM::ErrNoChannelAvailable;
+	if(0 == pDisk)
+		return CBM::ErrDriveNotReady;
+	uchar block[BLOCK_SIZE];
+	const CBM::IOErrorMessage result = pDisk->readSector(track, sector, block);
+	if(CBM::ErrOK not_eq result)
+		return result;
+
+	Channel& chan = m_channels[channel];
+	m_drive.writeMemory(bufferAddress(chan.buffer), reinterpret_cast<const char*>(block), BLOCK_SIZE);
+	if(wholeBlock) {
+		chan.pointer = 0;
+		chan.end = BLOCK_SIZE;
+	}
+	else {
+		// The first byte is the index of the last data byte, 0 for a full block.
+		chan.pointer = DATA_START;
+		chan.end = 0 == block[0] ? BLOCK_SIZE : block[0] + 1;
+	}
+	return CBM::ErrOK;
+} // readBlock
+
+
+CBM::IOErrorMessage DriveBuffers::writeBlock(uchar channel, D64* pDisk, uchar track, uchar sector,
+																							bool wholeBlock)
+{
+	if(not isBufferChannel(channel))
+		return CBM::ErrNoChannelAvailable;
+	if(0 == pDisk)
+		return CBM::ErrDriveNotReady;
+	Channel& chan = m_channels[channel];
+	const ushort address = bufferAddress(chan.buffer);
+	if(not wholeBlock) {
+		// The data written so far ends before the pointer, its last index goes into the first byte.
+		const char count = chan.pointer - 1;
+		m_drive.writeMemory(address, &count, 1);
+	}
+	uchar block[BLOCK_SIZE];
+	m_drive.readMemory(address, reinterpret_cast<char*>(block), BLOCK_SIZE);
+	const CBM::IOErrorMessage result = pDisk->writeSector(track, sector, block);
+	if(CBM::ErrOK == result)
+		chan.pointer = DATA_START;
+	return result;
+} // writeBlock
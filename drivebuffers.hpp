@@ -0,0 +1,65 @@
+#ifndef DRIVEBUFFERS_HPP
+#define DRIVEBUFFERS_HPP
+
+#include <QByteArray>
+
+#include "uno2iec/cbmdefines.h"
+
+class Drive1541;
+class D64;
+
+// The channels a CBM opens for direct access with OPEN n,8,n,"#" (any free buffer) or "#<buffer>": each one has a
+// buffer of the drive RAM, blocks are read into it and written from it with U1/U2 (B-R/B-W), and reading or writing
+// the channel moves through its bytes from the buffer pointer (B-P). The buffers are the ones of the 1541 at
+// $0300-$07FF, so M-R, M-W, the job queue and drive code started with M-E or B-E see the same bytes.
+class DriveBuffers
+{
+public:
+	static const uchar NUM_BUFFERS = 5;
+
+	DriveBuffers(Drive1541& drive);
+
+	// All channels closed, as at power on.
+	void reset();
+
+	// Opens the channel on the buffer the name asks for ("#" or "#<buffer>").
+	CBM::IOErrorMessage open(uchar channel, const QByteArray& name);
+	void close(uchar channel);
+	// The buffer of the channel, -1 if it isn't open for direct access.
+	int buffer(uchar channel) const;
+	static ushort bufferAddress(uchar buffer);
+
+	// The bytes the channel gives from its pointer up to the end of the data, the last of which is sent with EOI. The
+	// pointer moves on by the bytes the CBM actually took, it wraps to the start after the end.
+	void read(uchar channel, QByteArray& data);
+	void advance(uchar channel, int count);
+	// Bytes sent to the channel go into the buffer at the pointer.
+	void write(uchar channel, const char* pData, int length);
+	CBM::IOErrorMessage setPointer(uchar channel, uchar position);
+
+	// U1/U2 transfer the whole block, B-R/B-W only the data: up to the count in its first byte, or the pointer.
+	CBM::IOErrorMessage readBlock(uchar channel, const D64* pDisk, uchar track, uchar sector, bool wholeBlock);
+	CBM::IOErrorMessage writeBlock(uchar channel, D64* pDisk, uchar track, uchar sector, bool wholeBlock);
+
+private:
+	struct Channel
+	{
+		int buffer;
+		uchar pointer;
+		// End of the data in the buffer, 1-256.
+		ushort end;
+	};
+
+	// Data channels are 0-14, the command channel has no buffer.
+	static const uchar NUM_CHANNELS = CBM::CMD_CHANNEL;
+
+	bool isBufferChannel(uchar channel) const
+	{
+		return channel < NUM_CHANNELS and m_channels[channel].buffer >= 0;
+	}
+
+	Drive1541& m_drive;
+	Channel m_channels[NUM_CHANNELS];
+};
+
+#endif // DRIVEBUFFERS_HPP
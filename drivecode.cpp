@@ -0,0 +1,63 @@
+#include "drivecode.hpp"
+
+namespace {
+
+// FNV-1a, stable across platforms and Qt versions (unlike qHash) so logged fingerprints stay valid.
+quint32 fnv1a(const uchar* pData, int length)
+{
+	quint32 hash = 2166136261U;
+	for(int i = 0; i < length; ++i) {
+		hash ^= pData[i];
+		hash *= 16777619U;
+	}
+	return hash;
+} // fnv1a
+
+} // unnamed namespace
+
+
+DriveCode::DriveCode()
+{
+} // ctor
+
+
+void DriveCode::clear()
+{
+	m_uploaded.reset();
+} // clear
+
+
+void DriveCode::noteWrite(ushort address, ushort length)
+{
+	for(uint i = address; i < uint(address) + length and i < m_uploaded.size(); ++i)
+		m_uploaded.set(i);
+} // noteWrite
+
+
+DriveCode::Fingerprint DriveCode::fingerprint(const uchar* pRam, ushort executeAddress) const
+{
+	Fingerprint print;
+	print.executeAddress = executeAddress;
+	if(executeAddress >= m_uploaded.size() or not m_uploaded.test(executeAddress))
+		return print;
+
+	// The code is the run of uploaded bytes around the execute address. Parameters poked elsewhere (e.g. a track
+	// number in zero page) then don't change the fingerprint.
+	uint start = executeAddress, end = executeAddress + 1;
+	while(start > 0 and m_uploaded.test(start - 1))
+		--start;
+	while(end < m_uploaded.size() and m_uploaded.test(end))
+		++end;
+	print.start = start;
+	print.length = end - start;
+	print.hash = fnv1a(pRam + start, print.length);
+	return print;
+} // fingerprint
+
+
+QString DriveCode::toString(const Fingerprint& fingerprint)
+{
+	return QString("hash 0x%1, %2 bytes at 0x%3, executed at 0x%4").arg(fingerprint.hash, 8, 16, QChar('0'))
+			.arg(fingerprint.length).arg(fingerprint.start, 4, 16, QChar('0'))
+			.arg(fingerprint.executeAddress, 4, 16, QChar('0'));
+} // toString
@@ -0,0 +1,46 @@
+#ifndef DRIVECODE_HPP
+#define DRIVECODE_HPP
+
+#include <QString>
+#include <bitset>
+
+#include "uno2iec/cbmdefines.h"
+
+// Keeps track of the code a CBM uploads into the drive RAM (M-W) and fingerprints it when it is started (M-E).
+// Fast loaders and copiers upload their drive side this way, so a fingerprint identifies them in the log regardless of
+// the name of the program that did it. Nothing is dispatched on it: no loader's own transfer protocol (not even Epyx
+// FastLoad's) is served by the Arduino yet, a fingerprint is only what one would be matched with.
+class DriveCode
+{
+public:
+	// The code block started: the uploaded bytes around the execute address, in one piece.
+	struct Fingerprint
+	{
+		Fingerprint() : hash(0), start(0), length(0), executeAddress(0)
+		{}
+
+		quint32 hash;
+		ushort start;
+		ushort length;
+		ushort executeAddress;
+	};
+
+	DriveCode();
+
+	// Forget all uploads, e.g. at drive reset.
+	void clear();
+	// Bytes have been written to the drive memory at the address.
+	void noteWrite(ushort address, ushort length);
+
+	// Fingerprint of the uploaded code run from the address, pRam is the drive RAM after the uploads.
+	// The length is zero if nothing was uploaded at the address.
+	Fingerprint fingerprint(const uchar* pRam, ushort executeAddress) const;
+
+	static QString toString(const Fingerprint& fingerprint);
+
+private:
+	// One bit per byte of drive RAM, set when it has been uploaded.
+	std::bitset<CBM1541_RAM_SIZE> m_uploaded;
+};
+
+#endif // DRIVECODE_HPP
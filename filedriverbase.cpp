@@ -1,4 +1,26 @@
 #include "filedriverbase.hpp"
+#include "archive.hpp"
+
+namespace {
+
+// Collects the lines of a listing sent by a driver that doesn't support producing them one at a time.
+class ListingBuffer : public ISendLine
+{
+public:
+	ListingBuffer(QList<QPair<short, QString> >& lines)
+		: m_lines(lines)
+	{}
+
+	void send(short lineNo, const QString& text)
+	{
+		m_lines.append(qMakePair(lineNo, text));
+	}
+
+private:
+	QList<QPair<short, QString> >& m_lines;
+};
+
+} // anonymous
 
 FileDriverBase::FileDriverBase()
 	: m_status(NOT_READY)
@@ -13,8 +35,10 @@ FileDriverBase::~FileDriverBase()
 
 bool FileDriverBase::supportsType(const QString& fileName) const
 {
+	// A gzipped image (GAME.D64.GZ) is of the type of the image in it.
+	const QString name(Archive::withoutGzip(fileName));
 	foreach(const QString& ext, extension()) {
-		if(not ext.isEmpty() and fileName.endsWith(ext, Qt::CaseInsensitive))
+		if(not ext.isEmpty() and name.endsWith(ext, Qt::CaseInsensitive))
 			return true;
 	}
 	return false;
@@ -33,6 +57,38 @@ bool FileDriverBase::sendListing(ISendLine& /*cb*/)
 } // sendListing
 
 
+bool FileDriverBase::openListing()
+{
+	m_bufferedListing.clear();
+	ListingBuffer buffer(m_bufferedListing);
+
+	return sendListing(buffer);
+} // openListing
+
+
+bool FileDriverBase::listNextLine(ISendLine& cb)
+{
+	if(m_bufferedListing.isEmpty())
+		return false;
+	const QPair<short, QString> line(m_bufferedListing.takeFirst());
+	cb.send(line.first, line.second);
+
+	return true;
+} // listNextLine
+
+
+void FileDriverBase::closeListing()
+{
+	m_bufferedListing.clear();
+} // closeListing
+
+
+void FileDriverBase::setListingFilter(const ListingFilter& filter)
+{
+	m_listingFilter = filter;
+} // setListingFilter
+
+
 bool FileDriverBase::supportsMediaInfo() const
 {
 	return false;
@@ -90,6 +146,16 @@ CBM::IOErrorMessage FileDriverBase::copyFiles(const QStringList& sourceNames, co
 } // copyFiles
 
 
+int FileDriverBase::read(char* dst, int max)
+{
+	int count = 0;
+	while(count < max and not isEOF())
+		dst[count++] = getc();
+
+	return count;
+} // read
+
+
 // returns a character to the open file. If not overridden, returns always true. If implemented returns false on failure.
 bool FileDriverBase::putc(char c)
 {
@@ -98,6 +164,16 @@ bool FileDriverBase::putc(char c)
 } // putc
 
 
+int FileDriverBase::write(const char* src, int length)
+{
+	int count = 0;
+	while(count < length and putc(src[count]))
+		++count;
+
+	return count;
+} // write
+
+
 FileDriverBase::FSStatus FileDriverBase::status(void) const
 {
 	return static_cast<FSStatus>(m_status);
@@ -120,6 +196,12 @@ CBM::IOErrorMessage FileDriverBase::newDisk(const QString& name, const QString&
 } // newDisk
 
 
+CBM::IOErrorMessage FileDriverBase::validateDisk()
+{
+	return CBM::ErrNotImplemented;
+} // validateDisk
+
+
 bool FileDriverBase::deleteFile(const QString& fileName)
 {
 	Q_UNUSED(fileName);
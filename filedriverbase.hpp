@@ -4,11 +4,13 @@
 #include <QString>
 #include <QStringList>
 #include <QFile>
+#include <QPair>
 #ifdef _MSC_VER
 #include <iso646.h>
 #endif
 
 #include "uno2iec/cbmdefines.h"
+#include "filenamepattern.hpp"
 
 class ISendLine
 {
@@ -35,7 +37,7 @@ public:
 
 	// The three letter extension this file format represents (DOS style) Empty string returned means 'any' and is in default fs mode.
 	virtual const QStringList& extension() const = 0;
-	// Returns true if the file system in question is supporting the given extension type.
+	// Returns true if the file system in question is supporting the given extension type, also when it is gzipped.
 	bool supportsType(const QString& fileName) const;
 
 	// Returns a print-friendly version of the supported extensions as a pipe separated (single) string.
@@ -50,6 +52,19 @@ public:
 	virtual bool supportsListing() const;
 	// Send realistic $ file basic listing, line by line (returning false means there was some error, but that there is a listing anyway).
 	virtual bool sendListing(ISendLine& cb);
+	// The same listing produced on demand: openListing() starts it (return value as for sendListing), every call to
+	// listNextLine() then sends one line to cb and it returns false when there are no more lines.
+	// Drivers that can't produce their listing a line at a time keep the default, which buffers what sendListing() sends.
+	virtual bool openListing();
+	virtual bool listNextLine(ISendLine& cb);
+	virtual void closeListing();
+	// The patterns and file type the listing is restricted to ($:PATTERN=P). The drivers skip the entries not matching
+	// it while listing, so only the matching lines are sent. Set an empty filter to list all again.
+	void setListingFilter(const ListingFilter& filter);
+	const ListingFilter& listingFilter() const
+	{
+		return m_listingFilter;
+	}
 	// Whether this file system supports media info or not (true == supports it).
 	virtual bool supportsMediaInfo() const;
 	// Send information about file system (whether it is OK, sizes etc.).
@@ -75,11 +90,17 @@ public:
 	virtual bool deleteFile(const QString& fileName);
 	// returns a character from the open file. Should always be supported in order to make implementation make any sense.
 	virtual char getc() = 0;
+	// reads up to max bytes from the open file into dst, returns the number of bytes read (less than max only at end of file).
+	// Drivers that can copy whole blocks should override this, the default implementation repeats getc().
+	virtual int read(char* dst, int max);
 	// returns true if end of file reached. Should always be supported in order to make implementation make any sense.
 	virtual bool isEOF() const = 0;
 	// returns a character to the open file. If not overridden, returns always true. If implemented returns false on failure.
 	// write char to open file, returns false if failure
 	virtual bool putc(char c);
+	// writes length bytes to the open file, returns the number written (less than length only on failure).
+	// The default implementation repeats putc().
+	virtual int write(const char* src, int length);
 	// closes the open file. Should always be supported in order to make implementation make any sense.
 	// If returning false here it indicates the filesystem is ready and should move back to native file system.
 	virtual bool close() = 0;
@@ -94,11 +115,18 @@ public:
 	// Initialize (format) a disk with the given name and id (id can be empty). The extension can be used to further
 	// determine the actual image type.
 	virtual CBM::IOErrorMessage newDisk(const QString& name, const QString& id);
+	// Rebuild the block allocation from the files on the disk (the VALIDATE command).
+	virtual CBM::IOErrorMessage validateDisk();
 
 protected:
 	// Status of the driver:
 	uchar m_status;
 
+private:
+	// Lines of the listing buffered by the default openListing().
+	QList<QPair<short, QString> > m_bufferedListing;
+	ListingFilter m_listingFilter;
+
 };
 
 #endif // FILEDRIVERBASE_HPP
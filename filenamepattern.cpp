@@ -0,0 +1,106 @@
+#include "filenamepattern.hpp"
+
+namespace {
+const uchar PADDING = 0xA0;
+} // anonymous
+
+
+FileNamePattern::FileNamePattern(const QString& pattern)
+{
+	setPattern(pattern);
+} // ctor
+
+
+void FileNamePattern::setPattern(const QString& pattern)
+{
+	m_pattern = pattern;
+	m_bytes = pattern.toLatin1();
+	int star = m_bytes.indexOf('*');
+	m_hasStar = -1 not_eq star;
+	m_compareLength = m_hasStar ? star : m_bytes.size();
+	m_hasWildcards = m_hasStar or -1 not_eq m_bytes.indexOf('?');
+} // setPattern
+
+
+QByteArray FileNamePattern::paddedName(int length) const
+{
+	QByteArray padded(m_bytes.left(length));
+	if(padded.size() < length)
+		padded.append(QByteArray(length - padded.size(), char(PADDING)));
+
+	return padded;
+} // paddedName
+
+
+bool FileNamePattern::matches(const uchar* name, int length) const
+{
+	int i;
+	for(i = 0; i < m_compareLength; ++i) {
+		if(i == length) // pattern is longer than the name can be.
+			return false;
+		if('?' not_eq m_bytes.at(i) and uchar(m_bytes.at(i)) not_eq name[i])
+			return false;
+	}
+	// If searched to end of pattern (without any '*'), the name must end here also.
+	return m_hasStar or i == length or PADDING == name[i];
+} // matches
+
+
+bool FileNamePattern::matches(const QString& name) const
+{
+	QByteArray padded(name.toLatin1());
+	padded.append(char(PADDING));
+
+	return matches(reinterpret_cast<const uchar*>(padded.constData()), padded.size());
+} // matches
+
+
+ListingFilter::ListingFilter(const QString& request)
+	: m_type(0)
+{
+	const int colon = request.indexOf(':');
+	if(-1 == colon)
+		return;
+
+	QString patterns(request.mid(colon + 1));
+	const int equals = patterns.lastIndexOf('=');
+	if(-1 not_eq equals) {
+		const QString type(patterns.mid(equals + 1).trimmed());
+		if(not type.isEmpty())
+			m_type = type.at(0).toUpper().toLatin1();
+		patterns.truncate(equals);
+	}
+	foreach(const QString& pattern, patterns.split(',', QString::SkipEmptyParts))
+		m_patterns.append(FileNamePattern(pattern));
+} // ctor
+
+
+bool ListingFilter::matches(const uchar* name, int length, char type) const
+{
+	if(0 not_eq m_type and type not_eq m_type)
+		return false;
+	if(m_patterns.isEmpty())
+		return true;
+	foreach(const FileNamePattern& pattern, m_patterns) {
+		if(pattern.matches(name, length))
+			return true;
+	}
+
+	return false;
+} // matches
+
+
+bool ListingFilter::matches(const QString& name, char type) const
+{
+	if(0 not_eq m_type and type not_eq m_type)
+		return false;
+	if(m_patterns.isEmpty())
+		return true;
+	const QString upperName(name.toUpper());
+	foreach(const FileNamePattern& pattern, m_patterns) {
+		if(pattern.matches(upperName))
+			return true;
+	}
+
+	return false;
+} // matches
@@ -0,0 +1,74 @@
+#ifndef FILENAMEPATTERN_HPP
+#define FILENAMEPATTERN_HPP
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+
+// A CBM DOS style file name pattern, prepared once and then matched against any number of names.
+// '?' matches any single character and '*' matches the rest of the name, without wildcards the name must match exactly.
+// Names are matched the way they are stored in a directory entry, i.e. padded with shifted space (0xA0).
+class FileNamePattern
+{
+public:
+	FileNamePattern(const QString& pattern = QString());
+
+	void setPattern(const QString& pattern);
+	const QString& pattern() const
+	{
+		return m_pattern;
+	}
+
+	bool hasWildcards() const
+	{
+		return m_hasWildcards;
+	}
+
+	// Returns the pattern padded with 0xA0 to the given length, for direct (hash) lookup when there are no wildcards.
+	QByteArray paddedName(int length = 16) const;
+
+	// Match a directory entry name field of the given length.
+	bool matches(const uchar* name, int length = 16) const;
+	// Match a name that isn't padded (i.e. native file system names).
+	bool matches(const QString& name) const;
+
+private:
+	QString m_pattern;
+	QByteArray m_bytes;
+	// Number of characters to compare, i.e. everything up to a '*'.
+	int m_compareLength;
+	bool m_hasStar;
+	bool m_hasWildcards;
+};
+
+
+// What a directory listing is asked for, as in LOAD"$0:A*,B*=P",8: only the entries matching any of the patterns (all
+// if there are none) and of the file type (any if none) are listed. The header and the blocks free line always are.
+class ListingFilter
+{
+public:
+	// The request without the '$', e.g. "0:A*=P". Without a ':' it is just the drive number and everything is listed.
+	ListingFilter(const QString& request = QString());
+
+	bool isEmpty() const
+	{
+		return m_patterns.isEmpty() and 0 == m_type;
+	}
+
+	// The first letter of the file type (P, S, U, R or D for DEL), 0 for any.
+	char type() const
+	{
+		return m_type;
+	}
+
+	// Match a directory entry name field of the given length and the type letter of the entry.
+	bool matches(const uchar* name, int length, char type) const;
+	// Match a name that isn't padded, by its upper case (native file system and M2I names).
+	bool matches(const QString& name, char type) const;
+
+private:
+	QList<FileNamePattern> m_patterns;
+	char m_type;
+};
+
+#endif // FILENAMEPATTERN_HPP
@@ -0,0 +1,132 @@
+#include <QElapsedTimer>
+
+#include "g64driver.hpp"
+#include "gcrcodec.hpp"
+#include "archive.hpp"
+#include "imagecache.hpp"
+#include "logger.hpp"
+
+using namespace Logging;
+
+namespace {
+
+// The header: signature, version, number of half tracks and the largest track size. Then the file offset of each
+// half track (0 for none, 4 bytes), track 1 first. The data of a track is its length (2 bytes) and the GCR bytes.
+const char G64_SIGNATURE[] = "GCR-1541";
+const int G64_HALF_TRACKS_OFFSET = 9;
+const int G64_TRACK_TABLE = 0x0C;
+
+// What the decoded image is cached as.
+const QString DECODED_NAME("D64");
+
+const int BLOCK_SIZE = 256;
+const int MAX_SECTORS = 256;
+
+
+quint32 littleEndian(const uchar* pBytes, int count)
+{
+	quint32 value = 0;
+	for(int i = count - 1; i >= 0; --i)
+		value = (value << 8) bitor pBytes[i];
+
+	return value;
+} // littleEndian
+
+
+// The GCR bytes of a (whole) track, length is 0 if the image has none for it.
+const uchar* trackData(const QByteArray& g64Image, uchar track, int& length)
+{
+	const uchar* pG64 = reinterpret_cast<const uchar*>(g64Image.constData());
+	const qint64 size = g64Image.size();
+	const int halfTrack = (track - 1) * 2;
+	const qint64 entry = G64_TRACK_TABLE + halfTrack * 4;
+	length = 0;
+	if(halfTrack >= pG64[G64_HALF_TRACKS_OFFSET] or entry + 4 > size)
+		return 0;
+	const qint64 offset = littleEndian(pG64 + entry, 4);
+	if(0 == offset or offset + 2 > size)
+		return 0;
+	length = littleEndian(pG64 + offset, 2);
+	if(offset + 2 + length > size)
+		length = 0;
+
+	return pG64 + offset + 2;
+} // trackData
+
+
+// The error info byte of a sector, see the D64 driver.
+uchar errorInfo(CBM::IOErrorMessage result)
+{
+	if(result >= CBM::ErrBlockHeaderNotFound and result <= CBM::ErrDiskIdMismatch)
+		return result - CBM::ErrBlockHeaderNotFound + 2;
+
+	return 1;
+} // errorInfo
+
+} // anonymous
+
+
+G64::G64(const QString& fileName)
+	: D64()
+{
+	if(not fileName.isEmpty())
+		mountHostImage(fileName);
+} // ctor
+
+
+QByteArray G64::decodeImage(const QByteArray& g64Image)
+{
+	if(g64Image.size() < G64_TRACK_TABLE or not g64Image.startsWith(G64_SIGNATURE))
+		return QByteArray();
+
+	// Only the whole tracks are decoded, anything on the tracks after 35 makes it a 40 track image.
+	const DiskLayout* pLayout = &DiskLayout::d64();
+	const uchar extendedTracks = DiskLayout::d64Extended().geometry().tracks;
+	for(uchar track = pLayout->geometry().tracks + 1; track <= extendedTracks; ++track) {
+		int length;
+		trackData(g64Image, track, length);
+		if(length > 0)
+			pLayout = &DiskLayout::d64Extended();
+	}
+
+	QByteArray image(pLayout->imageSize() + pLayout->blocks(), 0);
+	uchar* pImage = reinterpret_cast<uchar*>(image.data());
+	uchar* pErrorInfo = pImage + pLayout->imageSize();
+	CBM::IOErrorMessage results[MAX_SECTORS];
+	for(uchar track = 1; track <= pLayout->geometry().tracks; ++track) {
+		int length;
+		const uchar* pTrack = trackData(g64Image, track, length);
+		const uchar sectors = pLayout->sectors(track);
+		const qint32 offset = pLayout->offset(track, 0);
+		GCR::decodeTrack(pTrack, length, track, sectors, pImage + offset, results);
+		for(uchar sector = 0; sector < sectors; ++sector)
+			pErrorInfo[offset / BLOCK_SIZE + sector] = errorInfo(results[sector]);
+	}
+
+	return image;
+} // decodeImage
+
+
+QByteArray G64::loadImage(const QString& fileName) const
+{
+	QByteArray image(imageCache().derivedImage(fileName, DECODED_NAME));
+	if(not image.isNull())
+		return image;
+
+	// The G64 itself isn't cached, only what it decodes to.
+	QElapsedTimer timer;
+	timer.start();
+	image = decodeImage(Archive::readFile(fileName));
+	if(image.isNull())
+		return image;
+	Log("G64", info, QString("Decoded %1 in %2 ms.").arg(fileName).arg(timer.elapsed()));
+	imageCache().insertDerived(fileName, DECODED_NAME, image);
+
+	return image;
+} // loadImage
+
+
+bool G64::isWritable() const
+{
+	return false;
+} // isWritable
@@ -0,0 +1,34 @@
+#ifndef G64DRIVER_HPP
+#define G64DRIVER_HPP
+
+#include "d64driver.hpp"
+
+// G64 images have the raw GCR tracks of a 1541 disk, as copied from originals with their protections. When the image
+// is mounted its tracks are decoded into the blocks of a D64 with error info, the error each sector reads with. The
+// image cache keeps the decoded image, so mounting it again decodes nothing, and from then on LOAD, the listing and
+// the block commands work on it as on a D64. The image is read only.
+class G64 : public D64
+{
+public:
+	G64(const QString& fileName = QString());
+
+	const QStringList& extension() const
+	{
+#if !(defined(__APPLE__) || defined(_MSC_VER))
+		static const QStringList ext({ "G64" });
+#else
+		static QStringList ext;
+		ext << "G64";
+#endif
+		return ext;
+	} // extension
+
+	// The D64 with error info of the contents of a G64 file, a null QByteArray if it isn't a G64.
+	static QByteArray decodeImage(const QByteArray& g64Image);
+
+protected:
+	QByteArray loadImage(const QString& fileName) const;
+	bool isWritable() const;
+};
+
+#endif // G64DRIVER_HPP
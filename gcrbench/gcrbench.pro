@@ -0,0 +1,17 @@
+#-------------------------------------------------
+#
+# uno2iec-gcrbench: Speed of the GCR decoding of G64 tracks.
+#
+#-------------------------------------------------
+
+QT       = core
+
+TARGET = uno2iec-gcrbench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../uno2iec-common.pri)
+include(../uno2iec-core.pri)
+
+SOURCES += main.cpp
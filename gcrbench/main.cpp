@@ -0,0 +1,158 @@
+//
+// Title	: uno2iec-gcrbench - GCR track decoding throughput
+//
+// Times the decoding of GCR tracks into sectors (GCR::decodeTrack) as done when a G64 image is mounted, and prints the
+// tracks decoded per second. The tracks are a 35 track disk of random blocks encoded as the 1541 writes them, once
+// starting on a byte and once shifted by some bits, as tracks copied from originals often are.
+// With --image it instead times the decoding of all tracks of a G64 file and counts the sectors with errors.
+//
+// DISCLAIMER:
+// The author is in no way responsible for any problems or damage caused by
+// using this code. Use at your own risk.
+//
+// LICENSE:
+// This code is distributed under the GNU Public License
+// which can be found at http://www.gnu.org/licenses/gpl.txt
+//
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QVector>
+#include <stdio.h>
+#include <string.h>
+
+#include "gcrcodec.hpp"
+#include "g64driver.hpp"
+
+namespace {
+
+const int BLOCK_SIZE = 256;
+const int MAX_SECTORS = 256;
+// The disk id the tracks are encoded with.
+const uchar DISK_ID1 = 'U';
+const uchar DISK_ID2 = '2';
+
+
+// The track rotated by some bits, so that its sectors no longer start on a byte.
+QByteArray shifted(const QByteArray& track, int bits)
+{
+	QByteArray result(track.size(), 0);
+	const uchar* pSource = reinterpret_cast<const uchar*>(track.constData());
+	uchar* pDest = reinterpret_cast<uchar*>(result.data());
+	const int length = track.size();
+	for(int i = 0; i < length; ++i)
+		pDest[i] = (pSource[(i + length - 1) % length] << (8 - bits)) bitor (pSource[i] >> bits);
+
+	return result;
+} // shifted
+
+
+// Decodes the tracks the number of rounds, false if any sector doesn't come out as the disk.
+bool timeTracks(const char* what, const DiskLayout& layout, const QVector<QByteArray>& tracks, const QByteArray& disk,
+								int rounds)
+{
+	QByteArray decoded(layout.imageSize(), 0);
+	uchar* pDecoded = reinterpret_cast<uchar*>(decoded.data());
+	CBM::IOErrorMessage results[MAX_SECTORS];
+	QElapsedTimer timer;
+	timer.start();
+	for(int round = 0; round < rounds; ++round) {
+		for(uchar track = 1; track <= tracks.size(); ++track) {
+			const QByteArray& gcr = tracks.at(track - 1);
+			GCR::decodeTrack(reinterpret_cast<const uchar*>(gcr.constData()), gcr.size(), track, layout.sectors(track),
+											 pDecoded + layout.offset(track, 0), results);
+		}
+	}
+	const qint64 elapsed = qMax(timer.nsecsElapsed(), qint64(1));
+
+	const bool ok = decoded == disk;
+	const double decodedTracks = double(rounds) * tracks.size();
+	printf("%-10s %.0f tracks in %.3f s: %.0f tracks/s, %.1f disks/s%s\n", what, decodedTracks, elapsed / 1000000000.0,
+				 decodedTracks * 1000000000.0 / elapsed, rounds * 1000000000.0 / elapsed, ok ? "" : " - DECODED WRONG");
+	return ok;
+} // timeTracks
+
+
+int runTracks(int rounds)
+{
+	// A disk of random blocks.
+	const DiskLayout& layout = DiskLayout::d64();
+	QByteArray disk(layout.imageSize(), 0);
+	quint32 seed = 1541;
+	for(int i = 0; i < disk.size(); ++i) {
+		seed = seed * 1103515245 + 12345;
+		disk[i] = char(seed >> 16);
+	}
+
+	QVector<QByteArray> aligned;
+	QVector<QByteArray> unaligned;
+	for(uchar track = 1; track <= layout.geometry().tracks; ++track) {
+		const QByteArray gcr(GCR::encodeTrack(reinterpret_cast<const uchar*>(disk.constData()) + layout.offset(track, 0),
+																					track, layout.sectors(track), DISK_ID1, DISK_ID2));
+		aligned.append(gcr);
+		unaligned.append(shifted(gcr, 1 + track % 7));
+	}
+
+	const bool alignedOk = timeTracks("aligned", layout, aligned, disk, rounds);
+	const bool unalignedOk = timeTracks("unaligned", layout, unaligned, disk, rounds);
+	return alignedOk and unalignedOk ? 0 : 1;
+} // runTracks
+
+
+int runImage(const QString& fileName, int rounds)
+{
+	QFile file(fileName);
+	if(not file.open(QIODevice::ReadOnly)) {
+		fprintf(stderr, "Could not read %s\n", qPrintable(fileName));
+		return 1;
+	}
+	const QByteArray g64(file.readAll());
+
+	QByteArray image;
+	QElapsedTimer timer;
+	timer.start();
+	for(int round = 0; round < rounds; ++round)
+		image = G64::decodeImage(g64);
+	const qint64 elapsed = qMax(timer.nsecsElapsed(), qint64(1));
+	if(image.isNull()) {
+		fprintf(stderr, "%s is no G64 image\n", qPrintable(fileName));
+		return 1;
+	}
+
+	// The decoded image is the blocks and an error info byte for each.
+	const int blocks = image.size() / (BLOCK_SIZE + 1);
+	const int tracks = blocks > DiskLayout::d64().blocks() ? DiskLayout::d64Extended().geometry().tracks
+																												 : DiskLayout::d64().geometry().tracks;
+	int errors = 0;
+	for(int block = 0; block < blocks; ++block)
+		if(image.at(blocks * BLOCK_SIZE + block) not_eq 1)
+			++errors;
+	printf("%d tracks %d times in %.3f s: %.0f tracks/s, %d of %d sectors with errors.\n", tracks, rounds,
+				 elapsed / 1000000000.0, double(rounds) * tracks * 1000000000.0 / elapsed, errors, blocks);
+	return 0;
+} // runImage
+
+} // unnamed namespace
+
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication a(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Measures the speed of decoding GCR tracks, as when mounting a G64 image.");
+	parser.addHelpOption();
+	QCommandLineOption roundsOption(QStringList() << "r" << "rounds", "Times to decode all tracks.", "rounds", "200");
+	QCommandLineOption imageOption(QStringList() << "i" << "image", "Decode the tracks of this G64 image instead.",
+																 "file");
+	parser.addOption(roundsOption);
+	parser.addOption(imageOption);
+	parser.process(a);
+
+	const int rounds = qMax(parser.value(roundsOption).toInt(), 1);
+	if(parser.isSet(imageOption))
+		return runImage(parser.value(imageOption), rounds);
+	return runTracks(rounds);
+} // main
@@ -0,0 +1,244 @@
+#include <string.h>
+
+#include "gcrcodec.hpp"
+
+namespace {
+
+// The 5 bit codes of the nibbles 0-F.
+const uchar s_nibbleToGcr[16] = {
+	0x0A, 0x0B, 0x12, 0x13, 0x0E, 0x0F, 0x16, 0x17, 0x09, 0x19, 0x1A, 0x1B, 0x0D, 0x1D, 0x1E, 0x15
+};
+
+const int SECTOR_SIZE = 256;
+// A header block is the id, a checksum, sector, track, the two disk id bytes and two padding bytes. A data block is
+// the id, the 256 bytes, a checksum and two 0 bytes.
+const uchar HEADER_BLOCK_ID = 0x08;
+const uchar DATA_BLOCK_ID = 0x07;
+const uchar HEADER_PADDING = 0x0F;
+const int HEADER_BLOCK_SIZE = 8;
+const int DATA_BLOCK_SIZE = 260;
+// A sync mark is at least this many 1 bits.
+const int SYNC_BITS = 10;
+// What the 1541 writes around the blocks: the sync marks, the gap after a header and the gap after a data block.
+const int SYNC_BYTES = 5;
+const int HEADER_GAP_BYTES = 9;
+const int SECTOR_GAP_BYTES = 8;
+const uchar GAP_BYTE = 0x55;
+// The length of a whole sector on the track, a bit more than the 1541 writes.
+const int SECTOR_SPAN = 2 * SYNC_BYTES + GCR::HEADER_GCR_SIZE + GCR::DATA_GCR_SIZE + 2 * HEADER_GAP_BYTES;
+
+// Decoded table entries of bit patterns that aren't two GCR codes.
+const ushort INVALID = 0x100;
+
+
+// 10 GCR bits to the byte they are, and a byte to its 10 GCR bits.
+struct Tables
+{
+	Tables()
+	{
+		for(int gcr = 0; gcr < 1024; ++gcr)
+			decode[gcr] = INVALID;
+		for(int value = 0; value < 256; ++value) {
+			const ushort gcr = (s_nibbleToGcr[value >> 4] << 5) bitor s_nibbleToGcr[value bitand 0x0F];
+			encode[value] = gcr;
+			decode[gcr] = value;
+		}
+	}
+
+	ushort decode[1024];
+	ushort encode[256];
+};
+
+
+const Tables& tables()
+{
+	static const Tables theTables;
+	return theTables;
+} // tables
+
+
+// Copies count bytes that start at any bit.
+void extractBytes(const uchar* pBits, int bitPos, uchar* pDest, int count)
+{
+	const uchar* pSource = pBits + (bitPos >> 3);
+	const int shift = bitPos bitand 7;
+	if(0 == shift) {
+		memcpy(pDest, pSource, count);
+		return;
+	}
+	for(int i = 0; i < count; ++i)
+		pDest[i] = (pSource[i] << shift) bitor (pSource[i + 1] >> (8 - shift));
+} // extractBytes
+
+
+uchar checksum(const uchar* pData, int count)
+{
+	uchar sum = 0;
+	for(int i = 0; i < count; ++i)
+		sum xor_eq pData[i];
+
+	return sum;
+} // checksum
+
+} // anonymous
+
+
+bool GCR::decode(const uchar* pGcr, uchar* pData, int count)
+{
+	const ushort* pTable = tables().decode;
+	ushort invalid = 0;
+	for(int i = 0; i < count; i += 4, pGcr += 5, pData += 4) {
+		const quint32 low = (quint32(pGcr[1]) << 24) bitor (pGcr[2] << 16) bitor (pGcr[3] << 8) bitor pGcr[4];
+		const quint64 bits = (quint64(pGcr[0]) << 32) bitor low;
+		const ushort byte0 = pTable[bits >> 30];
+		const ushort byte1 = pTable[(bits >> 20) bitand 0x3FF];
+		const ushort byte2 = pTable[(bits >> 10) bitand 0x3FF];
+		const ushort byte3 = pTable[bits bitand 0x3FF];
+		invalid or_eq byte0 bitor byte1 bitor byte2 bitor byte3;
+		pData[0] = byte0;
+		pData[1] = byte1;
+		pData[2] = byte2;
+		pData[3] = byte3;
+	}
+
+	return 0 == (invalid bitand INVALID);
+} // decode
+
+
+void GCR::encode(const uchar* pData, uchar* pGcr, int count)
+{
+	const ushort* pTable = tables().encode;
+	for(int i = 0; i < count; i += 4, pData += 4, pGcr += 5) {
+		const quint64 bits = (quint64(pTable[pData[0]]) << 30) bitor (quint64(pTable[pData[1]]) << 20)
+				bitor (quint32(pTable[pData[2]]) << 10) bitor pTable[pData[3]];
+		pGcr[0] = bits >> 32;
+		pGcr[1] = bits >> 24;
+		pGcr[2] = bits >> 16;
+		pGcr[3] = bits >> 8;
+		pGcr[4] = bits;
+	}
+} // encode
+
+
+void GCR::decodeTrack(const uchar* pTrack, int length, uchar track, uchar sectors, uchar* pSectors,
+											CBM::IOErrorMessage* pResults)
+{
+	memset(pSectors, 0, sectors * SECTOR_SIZE);
+	for(uchar sector = 0; sector < sectors; ++sector)
+		pResults[sector] = CBM::ErrBlockHeaderNotFound;
+	if(length <= 0) {
+		for(uchar sector = 0; sector < sectors; ++sector)
+			pResults[sector] = CBM::ErrSyncCharNotFound;
+		return;
+	}
+
+	// The track is scanned for sync marks once around and then another sector on, for a sector that was split by the
+	// end of the track. Blocks that run past the end continue at the start, so the track is repeated in the buffer.
+	const int scanBits = (length + SECTOR_SPAN) * 8;
+	QByteArray buffer;
+	while(buffer.size() < length + SECTOR_SPAN + GCR::DATA_GCR_SIZE + 1)
+		buffer.append(reinterpret_cast<const char*>(pTrack), length);
+	const uchar* pBits = reinterpret_cast<const uchar*>(buffer.constData());
+
+	uchar gcr[GCR::DATA_GCR_SIZE];
+	uchar block[DATA_BLOCK_SIZE];
+	// The sector of the last good header, its data block is the next block.
+	int headerSector = -1;
+	bool anySync = false;
+	int ones = 0;
+	int pos = 0;
+	while(pos < scanBits) {
+		const uchar byte = pBits[pos >> 3];
+		// Most of what is scanned is sync marks, those go a byte at a time.
+		if(0 == (pos bitand 7) and 0xFF == byte) {
+			ones += 8;
+			pos += 8;
+			continue;
+		}
+		if(byte bitand (0x80 >> (pos bitand 7))) {
+			++ones;
+			++pos;
+			continue;
+		}
+		const bool afterSync = ones >= SYNC_BITS;
+		ones = 0;
+		if(not afterSync) {
+			++pos;
+			continue;
+		}
+
+		// A block starts with the first 0 bit after a sync mark.
+		anySync = true;
+		extractBytes(pBits, pos, gcr, GCR::HEADER_GCR_SIZE);
+		const bool validHeader = decode(gcr, block, HEADER_BLOCK_SIZE);
+		if(HEADER_BLOCK_ID == block[0]) {
+			headerSector = -1;
+			const uchar sector = block[2];
+			if(track == block[3] and sector < sectors) {
+				if(validHeader and checksum(block + 2, 4) == block[1]) {
+					headerSector = sector;
+					if(CBM::ErrOK not_eq pResults[sector])
+						pResults[sector] = CBM::ErrDataBlockNotFound;
+				}
+				else if(CBM::ErrBlockHeaderNotFound == pResults[sector])
+					pResults[sector] = CBM::ErrChecksumInHeader;
+			}
+			pos += GCR::HEADER_GCR_SIZE * 8;
+		}
+		else if(DATA_BLOCK_ID == block[0] and headerSector >= 0) {
+			extractBytes(pBits, pos, gcr, GCR::DATA_GCR_SIZE);
+			CBM::IOErrorMessage result = CBM::ErrByteDecoding;
+			if(decode(gcr, block, DATA_BLOCK_SIZE))
+				result = checksum(block + 1, SECTOR_SIZE) == block[SECTOR_SIZE + 1] ? CBM::ErrOK : CBM::ErrChecksumInData;
+			// A sector read fine before (a copy of it further on, or the first round) is kept.
+			if(CBM::ErrOK not_eq pResults[headerSector]) {
+				memcpy(pSectors + headerSector * SECTOR_SIZE, block + 1, SECTOR_SIZE);
+				pResults[headerSector] = result;
+			}
+			headerSector = -1;
+			pos += GCR::DATA_GCR_SIZE * 8;
+		}
+		else
+			++pos;
+	}
+
+	if(not anySync) {
+		for(uchar sector = 0; sector < sectors; ++sector)
+			pResults[sector] = CBM::ErrSyncCharNotFound;
+	}
+} // decodeTrack
+
+
+QByteArray GCR::encodeTrack(const uchar* pSectors, uchar track, uchar sectors, uchar id1, uchar id2)
+{
+	QByteArray gcrTrack;
+	gcrTrack.reserve(sectors * SECTOR_SPAN);
+	const QByteArray sync(SYNC_BYTES, char(0xFF));
+	uchar block[DATA_BLOCK_SIZE];
+	uchar gcr[GCR::DATA_GCR_SIZE];
+	for(uchar sector = 0; sector < sectors; ++sector) {
+		block[0] = HEADER_BLOCK_ID;
+		block[2] = sector;
+		block[3] = track;
+		block[4] = id2;
+		block[5] = id1;
+		block[6] = block[7] = HEADER_PADDING;
+		block[1] = checksum(block + 2, 4);
+		encode(block, gcr, HEADER_BLOCK_SIZE);
+		gcrTrack.append(sync);
+		gcrTrack.append(reinterpret_cast<const char*>(gcr), GCR::HEADER_GCR_SIZE);
+		gcrTrack.append(QByteArray(HEADER_GAP_BYTES, char(GAP_BYTE)));
+
+		const uchar* pData = pSectors + sector * SECTOR_SIZE;
+		block[0] = DATA_BLOCK_ID;
+		memcpy(block + 1, pData, SECTOR_SIZE);
+		block[SECTOR_SIZE + 1] = checksum(pData, SECTOR_SIZE);
+		block[SECTOR_SIZE + 2] = block[SECTOR_SIZE + 3] = 0;
+		encode(block, gcr, DATA_BLOCK_SIZE);
+		gcrTrack.append(sync);
+		gcrTrack.append(reinterpret_cast<const char*>(gcr), GCR::DATA_GCR_SIZE);
+		gcrTrack.append(QByteArray(SECTOR_GAP_BYTES, char(GAP_BYTE)));
+	}
+
+	return gcrTrack;
+} // encodeTrack
@@ -0,0 +1,36 @@
+#ifndef GCRCODEC_HPP
+#define GCRCODEC_HPP
+
+#include <QByteArray>
+
+#include "uno2iec/cbmdefines.h"
+
+// The group coded recording of the 1541: every 4 bits of data are 5 bits on the disk, chosen so that no more than two
+// 0 bits follow each other. A sector is a header block and a data block, each after a sync mark (ten or more 1 bits,
+// which GCR data never has).
+// Decoding looks up a whole data byte (10 GCR bits) at a time in a table of all 1024 bit patterns, 5 GCR bytes give 4
+// independent lookups without any branches.
+namespace GCR {
+
+// The encoded header block (8 bytes) and data block (260 bytes).
+const int HEADER_GCR_SIZE = 10;
+const int DATA_GCR_SIZE = 325;
+
+// Decodes count bytes (a multiple of 4) from the 5 * count / 4 GCR bytes. False if any of them isn't valid GCR, the
+// invalid bytes decode to 0.
+bool decode(const uchar* pGcr, uchar* pData, int count);
+// The 5 * count / 4 GCR bytes of the count (a multiple of 4) bytes.
+void encode(const uchar* pData, uchar* pGcr, int count);
+
+// Decodes all sectors of a track from its raw GCR bytes (as in a G64, the end of the track wraps around to the
+// start). The sectors can start at any bit and come in any order. Each one goes to pSectors at 256 times its number,
+// pResults has what the 1541 would read it with: ErrOK, or the error of a missing sync, header or data block, a bad
+// checksum or bytes that aren't GCR.
+void decodeTrack(const uchar* pTrack, int length, uchar track, uchar sectors, uchar* pSectors,
+								 CBM::IOErrorMessage* pResults);
+// The track as formatted and written by the 1541, the sectors in order from pSectors.
+QByteArray encodeTrack(const uchar* pSectors, uchar track, uchar sectors, uchar id1, uchar id2);
+
+} // namespace GCR
+
+#endif // GCRCODEC_HPP
@@ -0,0 +1,193 @@
+#include <QFile>
+#include <QFileInfo>
+
+#include "imagecache.hpp"
+#include "archive.hpp"
+#include "logger.hpp"
+
+using namespace Logging;
+
+namespace {
+const QString FAC_CACHE("CACHE");
+// Room for a few hundred D64 images by default.
+const qint64 DEFAULT_MAX_BYTES = 64 * 1024 * 1024;
+// Separates the path of the host file, the name of a file in it (when it is an archive) and the name of an image made
+// from that in the cache keys.
+const QChar DERIVED_SEPARATOR('|');
+
+
+QString derivedKey(const QString& key, const QString& name)
+{
+	return key + DERIVED_SEPARATOR + name;
+} // derivedKey
+
+
+// The key of an image made from a file, hostInfo is set to the file on the host it depends on: the file itself, or the
+// archive it is in.
+QString derivedKey(const QString& filePath, const QString& name, QFileInfo& hostInfo)
+{
+	QString hostPath;
+	QString member;
+	if(not Archive::splitPath(filePath, hostPath, member)) {
+		hostPath = filePath;
+		member.clear();
+	}
+	hostInfo.setFile(hostPath);
+
+	return derivedKey(derivedKey(hostInfo.absoluteFilePath(), member), name);
+} // derivedKey
+
+} // anonymous
+
+
+ImageCache::ImageCache()
+	: m_maxBytes(DEFAULT_MAX_BYTES), m_usedBytes(0)
+{
+} // ctor
+
+
+QByteArray ImageCache::image(const QString& filePath)
+{
+	// Files in archives and gzipped images are kept decompressed, under the archive and the name of the file in it.
+	QString archivePath;
+	QString name;
+	if(Archive::splitPath(filePath, archivePath, name)) {
+		QByteArray data(derivedImage(filePath, QString()));
+		if(data.isNull()) {
+			data = Archive::readFile(filePath);
+			if(not data.isNull())
+				insertDerived(filePath, QString(), data);
+		}
+		return data;
+	}
+
+	const QFileInfo info(filePath);
+	const QString key(info.absoluteFilePath());
+	if(not info.isFile()) {
+		invalidate(key);
+		return QByteArray();
+	}
+
+	QHash<QString, Entry>::iterator it = m_entries.find(key);
+	if(it not_eq m_entries.end()) {
+		if(it->lastModified == info.lastModified() and it->size == info.size()) {
+			m_lru.move(m_lru.indexOf(key), 0);
+			return it->data;
+		}
+		// stale, the host file has changed since we cached it.
+		invalidate(key);
+	}
+
+	QFile file(key);
+	if(not file.open(QIODevice::ReadOnly))
+		return QByteArray();
+	Entry entry;
+	entry.data = file.readAll();
+	entry.lastModified = info.lastModified();
+	entry.size = info.size();
+	file.close();
+
+	insert(key, entry);
+
+	return entry.data;
+} // image
+
+
+QByteArray ImageCache::derivedImage(const QString& filePath, const QString& name)
+{
+	QFileInfo info;
+	const QString key(derivedKey(filePath, name, info));
+	QHash<QString, Entry>::iterator it = m_entries.find(key);
+	if(it == m_entries.end())
+		return QByteArray();
+	if(it->lastModified not_eq info.lastModified() or it->size not_eq info.size()) {
+		invalidate(info.absoluteFilePath());
+		return QByteArray();
+	}
+	m_lru.move(m_lru.indexOf(key), 0);
+
+	return it->data;
+} // derivedImage
+
+
+void ImageCache::insertDerived(const QString& filePath, const QString& name, const QByteArray& data)
+{
+	QFileInfo info;
+	const QString key(derivedKey(filePath, name, info));
+	remove(key);
+	// Like the host file, the size and time of the file it was made from tell whether it is still valid.
+	Entry entry;
+	entry.data = data;
+	entry.lastModified = info.lastModified();
+	entry.size = info.size();
+	insert(key, entry);
+} // insertDerived
+
+
+void ImageCache::invalidate(const QString& filePath)
+{
+	const QString key(QFileInfo(filePath).absoluteFilePath());
+	remove(key);
+	const QString derivedPrefix(derivedKey(key, QString()));
+	foreach(const QString& cached, QStringList(m_lru)) {
+		if(cached.startsWith(derivedPrefix))
+			remove(cached);
+	}
+} // invalidate
+
+
+void ImageCache::clear()
+{
+	m_entries.clear();
+	m_lru.clear();
+	m_usedBytes = 0;
+} // clear
+
+
+void ImageCache::setMaxBytes(qint64 maxBytes)
+{
+	m_maxBytes = maxBytes;
+	evict(0);
+} // setMaxBytes
+
+
+// Images larger than the whole cache are handed out but not kept.
+void ImageCache::insert(const QString& key, const Entry& entry)
+{
+	if(entry.data.size() > m_maxBytes)
+		return;
+	evict(entry.data.size());
+	m_entries.insert(key, entry);
+	m_lru.prepend(key);
+	m_usedBytes += entry.data.size();
+} // insert
+
+
+void ImageCache::remove(const QString& key)
+{
+	QHash<QString, Entry>::iterator it = m_entries.find(key);
+	if(it == m_entries.end())
+		return;
+	m_usedBytes -= it->data.size();
+	m_entries.erase(it);
+	m_lru.removeOne(key);
+} // remove
+
+
+// Drop least recently used images until keepFree more bytes fit within the cap.
+void ImageCache::evict(qint64 keepFree)
+{
+	while(not m_lru.isEmpty() and m_usedBytes + keepFree > m_maxBytes) {
+		const QString key(m_lru.takeLast());
+		m_usedBytes -= m_entries.value(key).data.size();
+		m_entries.remove(key);
+		Log(FAC_CACHE, info, QString("Evicted %1 from image cache.").arg(key));
+	}
+} // evict
+
+
+ImageCache& imageCache()
+{
+	static ImageCache theInstance;
+	return theInstance;
+} // imageCache
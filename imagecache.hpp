@@ -0,0 +1,61 @@
+#ifndef IMAGECACHE_HPP
+#define IMAGECACHE_HPP
+
+#include <QHash>
+#include <QStringList>
+#include <QByteArray>
+#include <QDateTime>
+
+// Keeps whole host image files in memory so that mounting an image again, or moving between the images of a
+// directory, doesn't read the host file again. The least recently used images are evicted when the memory cap is
+// reached. An image is reloaded if the host file has changed (modification time or size) since it was cached.
+// The data is handed out as implicitly shared QByteArrays, so an evicted image stays valid for a driver still using it.
+class ImageCache
+{
+public:
+	ImageCache();
+
+	// Returns the contents of the host file, a null QByteArray if it can't be read. Files in zip archives and gzipped
+	// files are decompressed (see archive.hpp), and cached as images made from the archive.
+	QByteArray image(const QString& filePath);
+	// Images made from a host file, e.g. the sectors decoded from a G64. They are cached under the path and a name for
+	// what was made, and are dropped with the host file's own image when the file changes. For a file in an archive
+	// that is when the archive changes. derivedImage() returns a null QByteArray if there is none cached (yet).
+	QByteArray derivedImage(const QString& filePath, const QString& name);
+	void insertDerived(const QString& filePath, const QString& name, const QByteArray& data);
+	// Forget a cached image and the images made from it, e.g. when it has been written to.
+	void invalidate(const QString& filePath);
+	void clear();
+
+	void setMaxBytes(qint64 maxBytes);
+	qint64 maxBytes() const
+	{
+		return m_maxBytes;
+	}
+	qint64 usedBytes() const
+	{
+		return m_usedBytes;
+	}
+
+private:
+	struct Entry
+	{
+		QByteArray data;
+		QDateTime lastModified;
+		qint64 size;
+	};
+
+	void insert(const QString& key, const Entry& entry);
+	void remove(const QString& key);
+	void evict(qint64 keepFree);
+
+	QHash<QString, Entry> m_entries;
+	// Cached paths, most recently used first.
+	QStringList m_lru;
+	qint64 m_maxBytes;
+	qint64 m_usedBytes;
+};
+
+ImageCache& imageCache();
+
+#endif // IMAGECACHE_HPP
@@ -13,6 +13,10 @@ using namespace Logging;
 
 namespace {
 const QString FAC_IFACE("IFACE");
+// Drive code started with M-E is stopped when it hasn't returned after two seconds of drive time.
+const quint64 MAX_DRIVE_CODE_CYCLES = 2000000;
+// M-R reads up to 256 bytes (a length byte of 0).
+const int MAX_M_R_LENGTH = 256;
 
 // The previous cmd is copied to this string:
 //char oldCmdStr[IEC::ATN_CMD_MAX_LENGTH];
@@ -68,24 +72,37 @@ Interface::Interface()
 	, m_queuedError(CBM::ErrOK)
 	,	m_openState(O_NOTHING)
 	, m_currReadLength(MAX_BYTES_PER_REQUEST)
+	, m_readCredits(0)
+	, m_readDone(true)
+	, m_listingOpen(false)
+	, m_basicPtr(C64_BASIC_START)
 	, m_pListener(0)
+	, m_jobQueue(m_drive)
+	, m_buffers(m_drive)
 {
 	// Build the list of implemented / supported file systems.
 	m_fsList.append(&m_native);
 	m_fsList.append(&m_d64);
+	m_fsList.append(&m_d71);
+	m_fsList.append(&m_d81);
+	m_fsList.append(&m_g64);
 	m_fsList.append(&m_t64);
 	m_fsList.append(&m_m2i);
 	m_fsList.append(&m_x00fs);
 
-	// We have included the rom in our Qt resources.
+	// We have included the rom in our Qt resources. They are linked with the core library, so register them here.
+	Q_INIT_RESOURCE(coreresources);
 	QFile romFile(":/roms/rom_1541");
 	bool success = romFile.open(QIODevice::ReadOnly);
 	if(not success)
 		qDebug() << "couldn't open romfile: " << romFile.fileName();
 	else {
-		m_driveROM = romFile.readAll();
+		m_drive.setRom(romFile.readAll());
 		romFile.close();
 	}
+	m_memoryReadData.reserve(MAX_M_R_LENGTH);
+	m_channelReadData.reserve(MAX_BYTES_PER_REQUEST);
+	m_drive.setJobHandler(this);
 	reset();
 } // ctor
 
@@ -103,14 +120,17 @@ void Interface::setImageFilters(const QString& filters, bool showDirs)
 CBM::IOErrorMessage Interface::reset(bool informUnmount)
 {
 	// restore RAM and via areas.
-	m_driveRAM.fill(0, CBM1541_RAM_SIZE);
-	m_via1MEM.fill(0, CBM1541_VIA1_SIZE);
-	m_via2MEM.fill(0, CBM1541_VIA2_SIZE);
+	m_drive.reset();
+	m_driveCode.clear();
+	m_buffers.reset();
+	m_memoryReadData.resize(0);
+	m_busReplay.resize(0);
 	if(informUnmount and 0 not_eq m_pListener)
 		m_pListener->imageUnmounted();
+	// The listing belongs to the driver it was opened on, it must be closed before switching back to the native one.
+	closeListing();
 	m_currFileDriver = &m_native;
 	m_openState = m_currFileDriver->supportsMediaInfo() ? O_INFO : O_NOTHING;
-	m_dirListing.empty();
 	m_lastCmdString.clear();
 	foreach(FileDriverBase* fs, m_fsList)
 		fs->unmountHostImage(); // TODO: Better with a reset or init method on all file systems.
@@ -155,7 +175,7 @@ void Interface::moveToParentOrNativeFS(bool toRoot)
 	if(m_currFileDriver == &m_native) {
 		m_native.setCurrentDirectory(toRoot ? "/" : "..");
 		if(0 not_eq m_pListener) // notify UI listener of change.
-			m_pListener->directoryChanged(QDir::currentPath());
+			m_pListener->directoryChanged(m_native.currentPath());
 		m_openState = O_DIR;
 	}
 	else if(0 not_eq m_currFileDriver) {
@@ -167,74 +187,96 @@ void Interface::moveToParentOrNativeFS(bool toRoot)
 		if(toRoot) {
 			m_native.setCurrentDirectory("/");
 			if(0 not_eq m_pListener) // notify UI listener of change.
-				m_pListener->directoryChanged(QDir::currentPath());
+				m_pListener->directoryChanged(m_native.currentPath());
 		}
 	}
 } // moveToParentOrNativeFS
 
 
-void Interface::readDriveMemory(ushort address, ushort length, QByteArray& bytes) const
+void Interface::readDriveMemory(ushort address, ushort length)
 {
-	bytes.clear();
-	if(/*address >= CBM1541_RAM_OFFSET and */address < CBM1541_RAM_OFFSET + m_driveRAM.size())
-		bytes = m_driveRAM.mid(address, length);
-	else if(address >= CBM1541_VIA1_OFFSET and address < CBM1541_VIA1_OFFSET + m_via1MEM.size())
-		bytes = m_via1MEM.mid(address - CBM1541_VIA1_OFFSET, length);
-	else if(address >= CBM1541_VIA2_OFFSET and address < CBM1541_VIA2_OFFSET + m_via2MEM.size())
-		bytes = m_via2MEM.mid(address - CBM1541_VIA2_OFFSET, length);
-	else if(address >= CBM1541_ROM_OFFSET and address < CBM1541_ROM_OFFSET + m_driveROM.size())
-		bytes = m_driveROM.mid(address - CBM1541_ROM_OFFSET, length);
-
-	// resize to be the expected length in case the read was done at memory borders.
-	// It will be garbage data out of course, but that's to expect.
-	if(bytes.size() < length)
-		bytes.resize(length);
+	// The buffer has its capacity reserved, so this doesn't allocate.
+	m_memoryReadData.resize(length);
+	m_drive.readMemory(address, m_memoryReadData.data(), length);
 } // readDriveMemory
 
 
-// TODO: Place this in a utility file instead.
-static QByteArray& replaceBytes(QByteArray& lhs, int pos, int len, const QByteArray& rhs)
+void Interface::writeDriveMemory(ushort address, const char* pData, int length)
 {
-	for(int i = pos, j = 0; i < pos + len and i < lhs.length() and j < rhs.length(); ++i, ++j)
-		lhs[i] = rhs[j];
-	return lhs;
-} // replaceBytes
+	m_drive.writeMemory(address, pData, length);
+	m_driveCode.noteWrite(address, length);
+	// A job code written to the queue is done before the CBM polls it with M-R.
+	serviceJobs();
+} // writeDriveMemory
 
 
-void Interface::writeDriveMemory(ushort address, const QByteArray& bytes)
+void Interface::serviceJobs()
 {
-	QByteArray source(bytes);
-	// When doing resize (chop) after replace its because if address + array goes outside memory.
-	if(/*address >= CBM1541_RAM_OFFSET and */address < CBM1541_RAM_OFFSET + m_driveRAM.size()) {
-		replaceBytes(m_driveRAM, address, bytes.size(), source);
-		m_driveRAM.resize(CBM1541_RAM_SIZE);
-	}
-	else if((address >= CBM1541_VIA1_OFFSET and address <= CBM1541_VIA1_OFFSET + m_via1MEM.size())
-					or (address < CBM1541_VIA1_OFFSET and address + bytes.length() > CBM1541_VIA1_OFFSET)) {
-		ushort length = bytes.length();
-		if(address < CBM1541_VIA1_OFFSET) {
-			source.remove(0, CBM1541_VIA1_OFFSET - address);
-			length -= CBM1541_VIA1_OFFSET - address;
-			address = CBM1541_VIA1_OFFSET;
-		}
-		replaceBytes(m_via1MEM, address - CBM1541_VIA1_OFFSET, length, source);
-		m_via1MEM.resize(CBM1541_VIA1_SIZE);
-	}
-	else if((address >= CBM1541_VIA2_OFFSET and address <= CBM1541_VIA2_OFFSET + m_via2MEM.size())
-					or (address < CBM1541_VIA2_OFFSET and address + bytes.length() > CBM1541_VIA2_OFFSET)) {
-		ushort length = bytes.length();
-		if(address < CBM1541_VIA2_OFFSET) {
-			source.remove(0, CBM1541_VIA2_OFFSET - address);
-			length -= CBM1541_VIA2_OFFSET - address;
-			address = CBM1541_VIA2_OFFSET;
-		}
-		replaceBytes(m_via2MEM, address - CBM1541_VIA2_OFFSET, bytes.size(), source);
-		m_via2MEM.resize(CBM1541_VIA2_SIZE);
-	}
-	else
-		qDebug() << "trying to write to an invalid address.";
-	// any other memory range is a no-op. Can't write to ROM, can't write to non-existent memory.
-} // writeDriveMemory
+	m_jobQueue.service(mountedDisk(), isDiskWriteProtected());
+} // serviceJobs
+
+
+CBM::IOErrorMessage Interface::readBlock(uchar channel, uchar track, uchar sector, bool wholeBlock)
+{
+	return m_buffers.readBlock(channel, mountedDisk(), track, sector, wholeBlock);
+} // readBlock
+
+
+CBM::IOErrorMessage Interface::writeBlock(uchar channel, uchar track, uchar sector, bool wholeBlock)
+{
+	if(isDiskWriteProtected())
+		return CBM::ErrWriteProtectOn;
+	return m_buffers.writeBlock(channel, mountedDisk(), track, sector, wholeBlock);
+} // writeBlock
+
+
+CBM::IOErrorMessage Interface::setBufferPointer(uchar channel, uchar position)
+{
+	return m_buffers.setPointer(channel, position);
+} // setBufferPointer
+
+
+CBM::IOErrorMessage Interface::allocateBlock(uchar track, uchar sector, bool allocate)
+{
+	D64* pDisk = mountedDisk();
+	if(0 == pDisk)
+		return CBM::ErrDriveNotReady;
+	if(isDiskWriteProtected())
+		return CBM::ErrWriteProtectOn;
+	return pDisk->allocateBlock(track, sector, allocate);
+} // allocateBlock
+
+
+CBM::IOErrorMessage Interface::executeBlock(uchar channel, uchar track, uchar sector)
+{
+	const CBM::IOErrorMessage result = readBlock(channel, track, sector, true);
+	if(CBM::ErrOK not_eq result)
+		return result;
+	// The block counts as uploaded, so that the code is fingerprinted however it got into the buffer.
+	const ushort address = DriveBuffers::bufferAddress(m_buffers.buffer(channel));
+	m_driveCode.noteWrite(address, 256);
+	return executeDriveCode(address);
+} // executeBlock
+
+
+// The code runs on the emulated drive CPU, on the drive RAM and ROM here. It is logged with its fingerprint, see
+// DriveCode. What it drives on the serial bus is kept for the Arduino to replay right after the command ('V'). The
+// code runs ahead without seeing the CBM, so only code that talks to it without waiting for an answer is served.
+CBM::IOErrorMessage Interface::executeDriveCode(ushort address)
+{
+	const DriveCode::Fingerprint fingerprint(m_driveCode.fingerprint(m_drive.ram(), address));
+	const quint64 startCycle = m_drive.cpu().cycles();
+	const bool returned = m_drive.execute(address, MAX_DRIVE_CODE_CYCLES);
+	const quint64 cycles = m_drive.cpu().cycles() - startCycle;
+	const uint dropped = m_drive.via1().droppedPortWrites();
+	m_busReplay = m_drive.takeBusReplay();
+	Log(FAC_IFACE, returned ? info : warning, QString("M-E of drive code %1: %2 after %3 cycles, %4 bus changes to replay.")
+			.arg(DriveCode::toString(fingerprint)).arg(returned ? "returned" : "did not return").arg(cycles)
+			.arg(m_busReplay.size() / BUS_REPLAY_ENTRY_SIZE));
+	if(dropped)
+		Log(FAC_IFACE, warning, QString("M-E: %1 port changes did not fit, the replay stops short.").arg(dropped));
+	return returned ? CBM::ErrOK : CBM::ErrNotImplemented;
+} // executeDriveCode
 
 
 // Parse LOAD command, open either special/file/directory/d64/t64/...
@@ -250,6 +292,7 @@ CBM::IOErrorMessage Interface::openFile(const QString& cmdString)
 
 	// assume fall back result
 	m_openState = O_NOTHING;
+	m_listingFilter = ListingFilter();
 
 	cmd.replace("/:", "/");
 	// remove leading ':' as they have no meaning (but do so in sd2iec for separation).
@@ -281,16 +324,19 @@ CBM::IOErrorMessage Interface::openFile(const QString& cmdString)
 		// whatever file system we have active, check if it supports media info.
 		m_openState = m_currFileDriver->supportsMediaInfo() ? O_INFO : O_NOTHING;
 	}
-	else if(not cmd.isEmpty() and cmd.at(0) == QChar(CBM_DOLLAR_SIGN)) // Send directory listing of the current directory, of whatever file system is the actual one.
+	else if(not cmd.isEmpty() and cmd.at(0) == QChar(CBM_DOLLAR_SIGN)) { // Send directory listing of the current directory, of whatever file system is the actual one.
+		// Only what matches $:PATTERN=P, the driver skips the rest so it never goes over the serial or IEC bus.
+		m_listingFilter = ListingFilter(cmd.mid(1));
 		m_openState = O_DIR;
+	}
 	else {
 		// open file depending on interface state
 		if(m_currFileDriver == &m_native) {
 			// Try if cd works, then try open as file and if none of these ok...then give up
-			if(not cmd.isEmpty() and QDir(cmd).exists() and m_native.setCurrentDirectory(cmd)) {
+			if(not cmd.isEmpty() and m_native.isDirectory(cmd) and m_native.setCurrentDirectory(cmd)) {
 				Log(FAC_IFACE, success, QString("Changed to native FS directory: %1").arg(cmd));
 				if(0 not_eq m_pListener) // notify UI listener of change.
-					m_pListener->directoryChanged(QDir::currentPath());
+					m_pListener->directoryChanged(m_native.currentPath());
 				m_openState = O_DIR;
 //				if(0 not_eq m_pListener)
 //					m_pListener->imageMounted(cmd, m_currFileDriver);
@@ -305,7 +351,8 @@ CBM::IOErrorMessage Interface::openFile(const QString& cmdString)
 					Log(FAC_IFACE, info, QString("Trying image mount using driver: %1").arg(m_currFileDriver->extFriendly()));
 					// file extension matches, change interface state
 					// call new format's reset
-					if(m_currFileDriver->mountHostImage(cmd)) {
+					// A file in a zip archive is mounted from its path in the archive.
+					if(m_currFileDriver->mountHostImage(m_native.hostPath(cmd))) {
 						// see if this format supports listing, if not we're just opening as a file.
 						if(not m_currFileDriver->supportsListing())
 							m_openState = O_FILE;
@@ -356,6 +403,91 @@ CBM::IOErrorMessage Interface::openFile(const QString& cmdString)
 } // openFile
 
 
+// Hands a request from the Arduino to the matching process function, false if it is not one for the Interface.
+bool Interface::processRequest(const ProtocolParser::Request& request)
+{
+	switch(request.command) {
+		case 'S': // request for file size in bytes before sending file to CBM
+			processGetOpenFileSize();
+			break;
+
+		case 'O': // open command
+			// The command string is kept (last command, DOS commands), so this one is copied out of the parser's buffer.
+			processOpenCommand(request.arg1, QByteArray(request.payload.constData(), request.payload.size()));
+			break;
+
+		case 'R':
+			// read byte(s) from current file system driver, note that this command needs no termination char,
+			// because it needs to be short.
+			// The payload given back will be the current size, it is by default MAX_BYTES_PER_REQUEST (or as many left to
+			// read) but may be changed with 'N' command.
+			processReadFileRequest();
+			break;
+
+		case 'N': // same as 'N', but we are also given the expected read size. All succeeding 'R' will be with this size.
+			// The Arduino gives the length in a byte, so the full MAX_BYTES_PER_REQUEST buffer arrives as zero.
+			processReadFileRequest(request.arg1 ? request.arg1 : MAX_BYTES_PER_REQUEST);
+			break;
+
+		case 'F': // windowed read: packet size and how many packets we may send ahead, every 'R' then returns one packet credit.
+			processStreamFileRequest(request.arg1 ? request.arg1 : MAX_BYTES_PER_REQUEST, request.arg2);
+			break;
+
+		case 'X': // the Arduino gave up a windowed read (protocol v7), stop streaming and acknowledge.
+			processStreamAbort();
+			break;
+
+		case 'W': // write characters to file in current file system mode.
+			processWriteFileRequest(request.payload);
+			break;
+
+		case 'L': // directory/media info Line request:
+			processLineRequest();
+			break;
+
+		case 'M': // directory/media info request for a batch of BASIC lines (protocol v4).
+			processBatchedLineRequest();
+			break;
+
+		case 'C': // close FILE command
+			processCloseCommand();
+			break;
+
+		case 'E': // Ask for translation of error string from error code
+			processErrorStringRequest(static_cast<CBM::IOErrorMessage>(request.arg1));
+			break;
+
+		case 'T': // Read of the command channel (protocol v5): the status, or the bytes of the last M-R.
+			processStatusRequest();
+			break;
+
+		case 'G': // Read of a direct access channel (protocol v6).
+			processChannelReadRequest(request.arg1);
+			break;
+
+		case 'A': // The number of bytes the CBM took from the last 'G' response, 0 meaning 256.
+			processChannelAdvance(request.arg1, request.arg2 ? request.arg2 : 256);
+			break;
+
+		case 'P': // Bytes the CBM sent to a direct access channel.
+			processChannelWriteRequest(request.arg1, request.payload);
+			break;
+
+		case 'K': // Close of a direct access channel.
+			processChannelClose(request.arg1);
+			break;
+
+		case 'V': // Bus replay of the drive code just started (protocol v8).
+			processBusReplayRequest();
+			break;
+
+		default:
+			return false;
+	}
+	return true;
+} // processRequest
+
+
 void Interface::sendOpenResponse(char code) const
 {
 	// Response: ><code><CR>
@@ -368,10 +500,17 @@ void Interface::processOpenCommand(uchar channel, const QByteArray& cmd, bool lo
 {
 	// Request: <channel>|<command string>
 	Log(FAC_IFACE, info, QString("processOpenCommand, cmd: %1").arg(QString(cmd)));
+	if(not localImageSelectionMode) {
+		if(CBM::CMD_CHANNEL not_eq channel)
+			m_stats.transferStarted();
+		m_stats.requestReceived('O');
+	}
 
 	// Are we addressing the command channel?
 	switch(channel) {
 		case CBM::CMD_CHANNEL:
+			// A bus replay belongs to the command that started the drive code, no other one may find it.
+			m_busReplay.resize(0);
 			// command channel command, or request for status if empty.
 			if(cmd.isEmpty() or (cmd.length() == 1 and cmd.at(0) == '\r')) {
 				// Response: ><code><CR>
@@ -383,7 +522,8 @@ void Interface::processOpenCommand(uchar channel, const QByteArray& cmd, bool lo
 				m_queuedError = CBM::ErrOK;
 			}
 			else {
-				// it's a DOS command, so execute it.
+				// it's a DOS command, so execute it. The bytes of an earlier M-R are only read until the next command.
+				m_memoryReadData.resize(0);
 				m_queuedError = CBMDos::Command::execute(cmd, *this);
 				Log(FAC_IFACE, m_queuedError == CBM::ErrOK ? success : error, QString("CmdChannel_Response code: %1 = '%2'")
 						.arg(QString::number(m_queuedError)).arg(errorStringFromCode(m_queuedError)));
@@ -450,8 +590,14 @@ void Interface::processOpenCommand(uchar channel, const QByteArray& cmd, bool lo
 			break;
 
 		default:
-			// some other channel.
-			Log(FAC_IFACE, warning, QString("processOpenCommand: got open for channel: %1, not yet implemented.").arg(channel));
+			// some other channel: direct access ("#") is done here, the Arduino doesn't wait for a response.
+			if(cmd.startsWith('#')) {
+				m_queuedError = m_buffers.open(channel, cmd);
+				Log(FAC_IFACE, m_queuedError == CBM::ErrOK ? success : error, QString("Direct access channel %1 on buffer %2")
+						.arg(channel).arg(m_buffers.buffer(channel)));
+			}
+			else
+				Log(FAC_IFACE, warning, QString("processOpenCommand: got open for channel: %1, not yet implemented.").arg(channel));
 			break;
 	}
 } // processOpenCommand
@@ -459,6 +605,7 @@ void Interface::processOpenCommand(uchar channel, const QByteArray& cmd, bool lo
 
 void Interface::processCloseCommand()
 {
+	m_stats.requestReceived('C');
 	QString name = m_currFileDriver->openedFileName();
 	QByteArray data;
 	if(m_openState == O_SAVE or m_openState == O_SAVE_REPLACE or m_openState == O_FILE) {
@@ -477,13 +624,25 @@ void Interface::processCloseCommand()
 		// Means CLOSED and the drive number (that MAY have changed due to a comamnd).
 		data.append('C').append(deviceNumber());
 	}
+	// Changes to a mounted disk image are written to the host file when the CBM closes a file or the command channel.
+	if(0 not_eq mountedDisk())
+		mountedDisk()->flush();
 	write(data);
+	if(O_FILE == m_openState)
+		m_stats.transferEnded("LOAD");
+	else if(O_SAVE == m_openState or O_SAVE_REPLACE == m_openState)
+		m_stats.transferEnded("SAVE");
+	else if(O_DIR == m_openState or O_INFO == m_openState)
+		m_stats.transferEnded("LISTING");
+	else
+		m_stats.transferEnded("OPEN");
 	m_openState = O_NOTHING;
 } // processCloseCommand
 
 
 void Interface::processGetOpenFileSize()
 {
+	m_stats.requestReceived('S');
 	ushort size = m_currFileDriver->openedFileSize();
 
 	QByteArray data;
@@ -495,6 +654,7 @@ void Interface::processGetOpenFileSize()
 
 void Interface::processLineRequest()
 {
+	m_stats.requestReceived('L');
 	if(O_INFO == m_openState or O_DIR == m_openState) {
 		if(m_dirListing.isEmpty()) {
 			// last line was produced. Send back the ending char.
@@ -502,8 +662,11 @@ void Interface::processLineRequest()
 			Log(FAC_IFACE, success, "Last directory line written to arduino.");
 		}
 		else {
-			write(m_dirListing.first());
-			m_dirListing.removeFirst();
+			const QByteArray line(m_dirListing.takeFirst());
+			// Response byte, then the length of the line number and text as one byte.
+			write(QByteArray(1, 'L').append(char(line.size())).append(line));
+			// Have the next line ready before it is asked for.
+			produceListingLine();
 		}
 	}
 	else {
@@ -513,33 +676,108 @@ void Interface::processLineRequest()
 } // processOpenCommand
 
 
-void Interface::processReadFileRequest(ushort length)
+// The response is 'M' or 'm' (last batch), the number of bytes and the bytes: BASIC lines with link pointer, line
+// number, text and terminating zero, just as they are to be sent to the CBM. A line may continue in the next batch.
+void Interface::processBatchedLineRequest()
 {
-	QByteArray data;
-	uchar count;
-	bool atEOF = false;
+	m_stats.requestReceived('M');
+	const int maxBatch = MAX_BYTES_PER_REQUEST - 2;
+	if(O_INFO == m_openState or O_DIR == m_openState) {
+		while(m_listingBatch.size() < maxBatch and not m_dirListing.isEmpty()) {
+			const QByteArray line(m_dirListing.takeFirst());
+			produceListingLine();
+			// Link pointer to where the next line begins: after this one's pointer, line number, text and zero.
+			m_basicPtr += line.size() + 3;
+			m_listingBatch.append(char(m_basicPtr bitand 0xFF)).append(char(m_basicPtr >> 8)).append(line).append(char(0));
+		}
+	}
+	else // TODO: This is a strange error state. Maybe we should return something to CBM here.
+		Log(FAC_IFACE, error, "Strange state.");
 
-	if(length)
+	QByteArray data(m_listingBatch.left(maxBatch));
+	m_listingBatch.remove(0, data.size());
+	bool isLast = m_listingBatch.isEmpty() and m_dirListing.isEmpty();
+	data.prepend(char(data.size()));
+	data.prepend(isLast ? 'm' : 'M');
+	write(data);
+	if(isLast)
+		Log(FAC_IFACE, success, "Last directory batch written to arduino.");
+} // processBatchedLineRequest
+
+
+// 'N' (length given) starts a stop-and-wait transfer, every 'R' thereafter asks for the next buffer. In the windowed
+// mode each 'R' instead hands back one credit for a packet the Arduino has drained.
+void Interface::processReadFileRequest(ushort length)
+{
+	m_stats.requestReceived(length ? 'N' : 'R');
+	if(length) {
 		m_currReadLength = length;
-	// NOTE: -2 here because we need two bytes for the protocol.
-	for(count = 0; count < m_currReadLength - 2 and not atEOF; ++count) {
-		data.append(m_currFileDriver->getc());
-		atEOF = m_currFileDriver->isEOF();
+		m_readCredits = 0;
+		m_readDone = false;
 	}
+	++m_readCredits;
+	pumpReadFile();
+} // processReadFileRequest
+
+
+// The Arduino starts a windowed transfer, we may send window packets of packetSize bytes ahead of its 'R' credits.
+void Interface::processStreamFileRequest(ushort packetSize, uchar window)
+{
+	m_stats.requestReceived('F');
+	m_currReadLength = packetSize;
+	m_readCredits = window;
+	m_readDone = false;
+	pumpReadFile();
+} // processStreamFileRequest
+
+
+// The CBM stopped taking bytes, so the Arduino wants no more packets. The ones already sent are on their way, the
+// acknowledgement is framed like a packet ('X' and a zero count) and follows them, the Arduino drains up to it.
+void Interface::processStreamAbort()
+{
+	m_stats.requestReceived('X');
+	m_readCredits = 0;
+	m_readDone = true;
+	write(QByteArray("X\0", 2));
+} // processStreamAbort
+
+
+// Send as many packets as we have credits for, all in one write so that they leave in as few serial transfers as possible.
+void Interface::pumpReadFile()
+{
+	QByteArray data;
+	int total = 0;
+
+	while(m_readCredits and not m_readDone) {
+		--m_readCredits;
+		int start = data.size();
+		// Reserve the two heading bytes, they are filled in when we know the count.
+		// NOTE: -2 here because we need two bytes for the protocol.
+		data.resize(start + m_currReadLength);
+		uchar count = m_currFileDriver->read(data.data() + start + 2, m_currReadLength - 2);
+		data.resize(start + 2 + count);
+		bool atEOF = m_currFileDriver->isEOF();
+		// If we reached end of file, head byte in answer indicates with 'E' instead of 'B'.
+		data[start] = atEOF ? 'E' : 'B';
+		data[start + 1] = count;
+		total += count;
+		m_readDone = atEOF;
+	}
+	if(data.isEmpty())
+		return;
 	if(0 not_eq m_pListener)
-		m_pListener->bytesRead(data.size());
-	// prepend whatever count we got.
-	data.prepend(count);
-	// If we reached end of file, head byte in answer indicates with 'E' instead of 'B'.
-	data.prepend(atEOF ? 'E' : 'B');
+		m_pListener->bytesRead(total);
+	m_stats.bytesTransferred(total);
 	write(data);
-} // processReadFileRequest
+} // pumpReadFile
 
 
 void Interface::processWriteFileRequest(const QByteArray& theBytes)
 {
-	foreach(uchar theByte, theBytes)
-		m_currFileDriver->putc(theByte);
+	m_stats.requestReceived('W');
+	m_stats.bytesTransferred(theBytes.length());
+	if(m_currFileDriver->write(theBytes.constData(), theBytes.length()) < theBytes.length())
+		m_queuedError = CBM::ErrDiskFullOrDirectoryFull;
 	if(0 not_eq m_pListener)
 		m_pListener->bytesWritten(theBytes.length());
 } // processWriteFileRequest
@@ -569,6 +807,7 @@ QString Interface::errorStringFromCode(CBM::IOErrorMessage code) const
 // For a specific error code, we are supposed to return the corresponding error string.
 void Interface::processErrorStringRequest(CBM::IOErrorMessage code)
 {
+	m_stats.requestReceived('E');
 	// the return message begins with ':' for sync.
 	QByteArray retStr(1, ':');
 
@@ -577,34 +816,109 @@ void Interface::processErrorStringRequest(CBM::IOErrorMessage code)
 } // processErrorStringRequest
 
 
+void Interface::processStatusRequest()
+{
+	m_stats.requestReceived('T');
+	// Response: :<length><bytes>, a length of 0 meaning 256 bytes. No CR, the bytes of a memory read may be anything.
+	QByteArray response(1, ':');
+	if(m_memoryReadData.isEmpty()) {
+		const QByteArray status((errorStringFromCode(m_queuedError) + s_errorEnding).toLatin1());
+		Log(FAC_IFACE, info, QString("CmdChannel Status: %1").arg(QString(status)));
+		response.append(char(status.size())).append(status);
+		// go back to OK state, we have dispatched the error to IEC host now. Error will only show once.
+		m_queuedError = CBM::ErrOK;
+	}
+	else {
+		response.append(char(m_memoryReadData.size() bitand 0xFF)).append(m_memoryReadData);
+		m_memoryReadData.resize(0);
+	}
+	write(response);
+} // processStatusRequest
+
+
+void Interface::processBusReplayRequest()
+{
+	m_stats.requestReceived('V');
+	// Response: 'B' or 'E' for the last one, the length and that many bytes of whole entries.
+	const int length = qMin(m_busReplay.size(), MAX_BUS_REPLAY_BYTES);
+	QByteArray response(1, length < m_busReplay.size() ? 'B' : 'E');
+	response.append(char(length)).append(m_busReplay.left(length));
+	m_busReplay.remove(0, length);
+	write(response);
+} // processBusReplayRequest
+
+
+void Interface::processChannelReadRequest(uchar channel)
+{
+	m_stats.requestReceived('G');
+	// Response: :<length><bytes> as for 'T', the last byte goes with EOI. The pointer moves on with the following 'A'.
+	m_buffers.read(channel, m_channelReadData);
+	if(m_channelReadData.isEmpty()) {
+		// Not a direct access channel, there must be something to send so that the Arduino stays in sync.
+		m_queuedError = CBM::ErrFileNotOpen;
+		m_channelReadData.append('\r');
+	}
+	QByteArray response(1, ':');
+	response.append(char(m_channelReadData.size() bitand 0xFF)).append(m_channelReadData);
+	write(response);
+} // processChannelReadRequest
+
+
+void Interface::processChannelAdvance(uchar channel, ushort count)
+{
+	m_buffers.advance(channel, count);
+} // processChannelAdvance
+
+
+void Interface::processChannelWriteRequest(uchar channel, const QByteArray& theBytes)
+{
+	m_stats.requestReceived('P');
+	if(m_buffers.buffer(channel) < 0)
+		m_queuedError = CBM::ErrFileNotOpen;
+	else
+		m_buffers.write(channel, theBytes.constData(), theBytes.size());
+} // processChannelWriteRequest
+
+
+void Interface::processChannelClose(uchar channel)
+{
+	m_stats.requestReceived('K');
+	m_buffers.close(channel);
+	if(0 not_eq mountedDisk())
+		mountedDisk()->flush();
+} // processChannelClose
+
+
 void Interface::send(short lineNo, const QString& text)
 {
 	QByteArray line(text.toLocal8Bit());
 	// the line number is included with the line itself. It goes in with lobyte,hibyte.
 	line.prepend(uchar((lineNo bitand 0xFF00) >> 8));
 	line.prepend(uchar(lineNo bitand 0xFF));
-	// length of it all is the first byte.
-	line.prepend((uchar)text.size() + 2);
-	// add the response byte.
-	line.prepend('L');
-	// add it to the total dirlisting array.
+	// add it to the lines waiting to be requested.
 	m_dirListing.append(line);
 } // send
 
 
 void Interface::buildDirectoryOrMediaList()
 {
-	m_dirListing.clear();
+	closeListing();
+	m_listingBatch.clear();
+	m_basicPtr = C64_BASIC_START;
 	if(O_DIR == m_openState) {
+		// Only the first line is produced now, the rest follow as the arduino requests them.
 		Log(FAC_IFACE, info, QString("Producing directory listing for FS: \"%1\"...").arg(m_currFileDriver->extFriendly()));
-		if(not m_currFileDriver->sendListing(*this)) {
+		m_listingOpen = true;
+		m_currFileDriver->setListingFilter(m_listingFilter);
+		if(not m_currFileDriver->openListing()) {
 			m_queuedError = CBM::ErrDirectoryError;
-			Log(FAC_IFACE, warning, QString("Directory listing indicated error. Still sending: %1 chars").arg(QString::number(m_dirListing.length())));
+			Log(FAC_IFACE, warning, "Directory listing indicated error. Still sending it.");
 		}
 		else {
-			Log(FAC_IFACE, success, QString("Directory listing ok (%1 lines). Ready waiting for line requests from arduino.").arg(m_dirListing.count()));
+			Log(FAC_IFACE, success, "Directory listing ok. Ready waiting for line requests from arduino.");
 			m_queuedError = CBM::ErrOK;
 		}
+		produceListingLine();
 	}
 	else if(O_INFO == m_openState) {
 		Log(FAC_IFACE, info, QString("Producing media info for FS: \"%1\"...").arg(m_currFileDriver->extFriendly()));
@@ -620,6 +934,28 @@ void Interface::buildDirectoryOrMediaList()
 } // buildDirectoryOrMediaList
 
 
+// Have the current file driver produce the next directory line, if there is one and none is waiting already.
+void Interface::produceListingLine()
+{
+	if(not m_listingOpen or not m_dirListing.isEmpty())
+		return;
+	if(not m_currFileDriver->listNextLine(*this))
+		closeListing();
+} // produceListingLine
+
+
+void Interface::closeListing()
+{
+	if(m_listingOpen) {
+		m_currFileDriver->closeListing();
+		// Listings for anything else (e.g. the UI) are complete again.
+		m_currFileDriver->setListingFilter(ListingFilter());
+	}
+	m_listingOpen = false;
+	m_dirListing.clear();
+} // closeListing
+
+
 bool Interface::changeNativeFSDirectory(const QString& newDir)
 {
 	return m_native.setCurrentDirectory(newDir);
@@ -630,4 +966,5 @@ void Interface::write(const QByteArray& data, bool flush) const
 {
 	if(0 not_eq m_pListener)
 		m_pListener->writePort(data, flush);
+	m_stats.responded();
 } // write
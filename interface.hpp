@@ -5,10 +5,17 @@
 
 #include "filedriverbase.hpp"
 #include "d64driver.hpp"
+#include "g64driver.hpp"
 #include "t64driver.hpp"
 #include "m2idriver.hpp"
 #include "x00fs.hpp"
 #include "nativefs.hpp"
+#include "protocolstats.hpp"
+#include "protocolparser.hpp"
+#include "drivecode.hpp"
+#include "drive1541.hpp"
+#include "jobqueue.hpp"
+#include "drivebuffers.hpp"
 
 typedef QList<FileDriverBase*> FileDriverList;
 
@@ -24,7 +31,7 @@ enum OpenState {
 };
 
 
-class Interface : public ISendLine
+class Interface : public ISendLine, private Drive1541::IJobHandler
 {
 public:
 	// Callback Interface for notification when Arduino triggers various operations (upon CBM requests).
@@ -50,9 +57,12 @@ public:
 	Interface();
 	virtual ~Interface();
 
+	bool processRequest(const ProtocolParser::Request& request);
 	CBM::IOErrorMessage openFile(const QString &cmdString);
 	void processOpenCommand(uchar channel, const QByteArray &cmd, bool localImageSelectionMode = false);
 	void processReadFileRequest(ushort length = 0);
+	void processStreamFileRequest(ushort packetSize, uchar window);
+	void processStreamAbort();
 	void priocessWriteFileRequest(const QByteArray &theBytes);
 	CBM::IOErrorMessage reset(bool informUnmount = false);
 
@@ -75,6 +85,8 @@ public:
 
 	// State specific: CBM requests a single directory line from us.
 	void processLineRequest();
+	// Same, but as many ready linked BASIC lines as fits in one response (protocol version 4 and later).
+	void processBatchedLineRequest();
 	void buildDirectoryOrMediaList();
 
 	// ISendLine implementation.
@@ -83,6 +95,16 @@ public:
 	void processGetOpenFileSize();
 	void processCloseCommand();
 	void processErrorStringRequest(CBM::IOErrorMessage code);
+	// The command channel read in one request (protocol version 5 and later): the status, or the bytes of an M-R.
+	void processStatusRequest();
+	// Data channels opened for direct access with "#" (protocol version 6 and later): reading, what the CBM took of
+	// it, writing and closing.
+	void processChannelReadRequest(uchar channel);
+	void processChannelAdvance(uchar channel, ushort count);
+	void processChannelWriteRequest(uchar channel, const QByteArray& theBytes);
+	void processChannelClose(uchar channel);
+	// The bus lines of the drive code just started, for the Arduino to replay (protocol version 8 and later).
+	void processBusReplayRequest();
 	bool changeNativeFSDirectory(const QString &newDir);
 	void setMountNotifyListener(IFileOpsNotify *pListener);
 	void setImageFilters(const QString &filters, bool showDirs);
@@ -94,18 +116,50 @@ public:
 		return m_currFileDriver;
 	}
 
-	void readDriveMemory(ushort address, ushort length, QByteArray &bytes) const;
-	void writeDriveMemory(ushort address, const QByteArray &bytes);
+	// M-R: The bytes are sent on the next read of the command channel, instead of the status.
+	void readDriveMemory(ushort address, ushort length);
+	void writeDriveMemory(ushort address, const char* pData, int length);
+	// The CBM starts code in the drive memory (M-E).
+	CBM::IOErrorMessage executeDriveCode(ushort address);
+
+	// Direct access to the blocks of the mounted D64 through the buffer of a channel opened with "#".
+	// wholeBlock: U1/U2, otherwise B-R/B-W.
+	CBM::IOErrorMessage readBlock(uchar channel, uchar track, uchar sector, bool wholeBlock);
+	CBM::IOErrorMessage writeBlock(uchar channel, uchar track, uchar sector, bool wholeBlock);
+	CBM::IOErrorMessage setBufferPointer(uchar channel, uchar position);
+	// B-A, B-F.
+	CBM::IOErrorMessage allocateBlock(uchar track, uchar sector, bool allocate);
+	// B-E: reads the block into the buffer and runs it as drive code.
+	CBM::IOErrorMessage executeBlock(uchar channel, uchar track, uchar sector);
 
 private:
+	// Drive1541::IJobHandler implementation: jobs queued by M-W or by drive code, done on the mounted D64.
+	void serviceJobs();
+	// The disk image (D64, D71, D81 or G64) the direct access commands work on, 0 if none is mounted.
+	D64* mountedDisk()
+	{
+		if(m_currFileDriver == &m_d71)
+			return &m_d71;
+		if(m_currFileDriver == &m_d81)
+			return &m_d81;
+		if(m_currFileDriver == &m_g64)
+			return &m_g64;
+		return m_currFileDriver == &m_d64 ? &m_d64 : 0;
+	}
 	void moveToParentOrNativeFS(bool toRoot);
 	bool removeFilePrefix(QString &cmd) const;
 	void sendOpenResponse(char code) const;
 	void write(const QByteArray &data, bool flush = true) const;
+	void pumpReadFile();
+	void produceListingLine();
+	void closeListing();
 	QString errorStringFromCode(CBM::IOErrorMessage code) const;
 
 	// Instantiation of implemented file system handlers. They will be added to the FileDriverList.
 	D64 m_d64;
+	D71 m_d71;
+	D81 m_d81;
+	G64 m_g64;
 	T64 m_t64;
 	M2I m_m2i;
 	x00FS m_x00fs;
@@ -117,18 +171,37 @@ private:
 	CBM::IOErrorMessage m_queuedError;
 	OpenState m_openState;
 	ushort m_currReadLength;
+	// Number of packets we may still send to the Arduino without it asking, and whether the last ('E') one is sent.
+	ushort m_readCredits;
+	bool m_readDone;
 	QByteArray m_lastCmdString;
+	// Listing lines produced but not yet requested. Directory listings are produced a line ahead of the requests,
+	// so this holds at most one of them.
 	QList<QByteArray> m_dirListing;
+	// True while the current file driver still has directory lines to produce.
+	bool m_listingOpen;
+	// What the last open asked to be listed ($:PATTERN=P), given to the file driver when the listing starts.
+	ListingFilter m_listingFilter;
+	// Batched listing: Encoded BASIC lines not yet sent, and the address the next line will be linked at.
+	QByteArray m_listingBatch;
+	ushort m_basicPtr;
+	// Throughput and latency of the transfer in progress, logged when it is closed.
+	mutable ProtocolStats m_stats;
 	IFileOpsNotify* m_pListener;
 
-	// The ROM file for the 1541 drive (16 KB).
-	QByteArray m_driveROM;
-	// The RAM memory for the 1541 drive.
-	QByteArray m_driveRAM;
-	// The VIA1 control area for the 1541 drive.
-	QByteArray m_via1MEM;
-	// The VIA2 control area for the 1541 drive.
-	QByteArray m_via2MEM;
+	// The 1541 memory (RAM, VIAs and the ROM) and the CPU running drive code on it.
+	Drive1541 m_drive;
+	// What the CBM uploaded into the drive RAM, for recognizing the drive code it runs.
+	DriveCode m_driveCode;
+	// The disk controller side of the drive: sector jobs queued in the drive RAM.
+	JobQueue m_jobQueue;
+	// The buffers of the channels opened for direct access.
+	DriveBuffers m_buffers;
+	QByteArray m_channelReadData;
+	// Bytes of the last M-R, read from the command channel in place of the status.
+	QByteArray m_memoryReadData;
+	// Bus replay of the last drive code started, what the Arduino hasn't asked for yet.
+	QByteArray m_busReplay;
 };
 
 #endif // INTERFACE_HPP
@@ -0,0 +1,117 @@
+#include <string.h>
+#include "jobqueue.hpp"
+#include "drive1541.hpp"
+#include "d64driver.hpp"
+#include "logger.hpp"
+
+using namespace Logging;
+
+namespace {
+
+const QString FAC_JOBS("JOBS");
+
+const ushort JOB_CODES_ADDRESS = 0x0000;
+const ushort JOB_TRACK_SECTOR_ADDRESS = 0x0006;
+const ushort JOB_BUFFERS_ADDRESS = 0x0300;
+// Bit 7 set: the job waits for the controller. The low bits select the drive, always 0 on a 1541.
+const uchar JOB_PENDING = 0x80;
+const uchar JOB_CODE_MASK = 0xF0;
+const int SECTOR_SIZE = 256;
+
+
+uchar resultFromError(CBM::IOErrorMessage error)
+{
+	switch(error) {
+		case CBM::ErrOK:
+			return JobQueue::ResultOK;
+		case CBM::ErrDriveNotReady:
+			return JobQueue::ResultDriveNotReady;
+		case CBM::ErrIllegalTrackOrSector:
+			return JobQueue::ResultHeaderNotFound;
+		default:
+			if(error >= CBM::ErrBlockHeaderNotFound and error <= CBM::ErrDiskIdMismatch)
+				return error - CBM::ErrBlockHeaderNotFound + JobQueue::ResultHeaderNotFound;
+			return JobQueue::ResultDriveNotReady;
+	}
+} // resultFromError
+
+} // unnamed namespace
+
+
+JobQueue::JobQueue(Drive1541& drive)
+	: m_drive(drive)
+{
+} // ctor
+
+
+int JobQueue::service(D64* pDisk, bool writeProtected)
+{
+	uchar codes[NUM_JOBS];
+	m_drive.readMemory(JOB_CODES_ADDRESS, reinterpret_cast<char*>(codes), NUM_JOBS);
+	int numDone = 0;
+	for(uchar job = 0; job < NUM_JOBS; ++job) {
+		if(not (codes[job] bitand JOB_PENDING))
+			continue;
+		uchar trackSector[2];
+		m_drive.readMemory(JOB_TRACK_SECTOR_ADDRESS + job * 2, reinterpret_cast<char*>(trackSector), 2);
+		// Buffer 5 is at $0800, which the 1541 decodes as the zero page: just like the real drive.
+		const uchar result = perform(codes[job] bitand JOB_CODE_MASK, trackSector[0], trackSector[1],
+																 JOB_BUFFERS_ADDRESS + job * SECTOR_SIZE, pDisk, writeProtected);
+		m_drive.writeMemory(JOB_CODES_ADDRESS + job, reinterpret_cast<const char*>(&result), 1);
+		++numDone;
+	}
+	return numDone;
+} // service
+
+
+uchar JobQueue::perform(uchar code, uchar track, uchar sector, ushort buffer, D64* pDisk, bool writeProtected)
+{
+	if(0 == pDisk)
+		return ResultDriveNotReady;
+
+	uchar data[SECTOR_SIZE];
+	uchar result;
+	switch(code) {
+		case JobRead:
+			result = resultFromError(pDisk->readSector(track, sector, data));
+			if(ResultOK == result)
+				m_drive.writeMemory(buffer, reinterpret_cast<const char*>(data), SECTOR_SIZE);
+			break;
+
+		case JobWrite:
+			if(writeProtected)
+				result = ResultWriteProtected;
+			else {
+				m_drive.readMemory(buffer, reinterpret_cast<char*>(data), SECTOR_SIZE);
+				result = resultFromError(pDisk->writeSector(track, sector, data));
+			}
+			break;
+
+		case JobVerify:
+			result = resultFromError(pDisk->readSector(track, sector, data));
+			if(ResultOK == result) {
+				char written[SECTOR_SIZE];
+				m_drive.readMemory(buffer, written, SECTOR_SIZE);
+				if(0 not_eq memcmp(data, written, SECTOR_SIZE))
+					result = ResultVerifyError;
+			}
+			break;
+
+		case JobSeek:
+			// Any sector of the track will do for finding it.
+			result = resultFromError(pDisk->readSector(track, 0, data));
+			break;
+
+		case JobBump:
+			result = ResultOK;
+			break;
+
+		default:
+			Log(FAC_JOBS, warning, QString("Job $%1 needs the disk hardware, not emulated.").arg(code, 2, 16, QChar('0')));
+			return ResultDriveNotReady;
+	}
+	if(ResultOK not_eq result)
+		Log(FAC_JOBS, warning, QString("Job $%1 on track %2 sector %3 failed with $%4.").arg(code, 2, 16, QChar('0'))
+				.arg(track).arg(sector).arg(result, 2, 16, QChar('0')));
+	return result;
+} // perform
@@ -0,0 +1,49 @@
+#ifndef JOBQUEUE_HPP
+#define JOBQUEUE_HPP
+
+#include <QtGlobal>
+
+class Drive1541;
+class D64;
+
+// The job queue of the 1541 disk controller: the DOS, and copiers and loaders that bypass it, ask for a sector by
+// writing its track and sector to $06-$11 and a job code to $00-$05, then poll the job code until the controller
+// replaces it with a completion code. Here the job is done right away against the mounted image, with the sector
+// read into or written from the buffer of the job ($0300 + job * $100).
+// Execute jobs ($D0, $E0) run code against the disk hardware, they complete with "drive not ready".
+class JobQueue
+{
+public:
+	static const uchar NUM_JOBS = 6;
+
+	enum JobCode {
+		JobRead = 0x80,
+		JobWrite = 0x90,
+		JobVerify = 0xA0,
+		JobSeek = 0xB0,
+		JobBump = 0xC0,
+		JobJump = 0xD0,
+		JobExecute = 0xE0
+	};
+
+	// Completion codes are the DOS error number less 18, apart from OK and drive not ready.
+	enum JobResult {
+		ResultOK = 0x01,
+		ResultHeaderNotFound = 0x02,
+		ResultVerifyError = 0x07,
+		ResultWriteProtected = 0x08,
+		ResultDriveNotReady = 0x0F
+	};
+
+	JobQueue(Drive1541& drive);
+
+	// Does the queued jobs on the disk, which is 0 when no D64 image is mounted. Returns the number of jobs done.
+	int service(D64* pDisk, bool writeProtected);
+
+private:
+	uchar perform(uchar code, uchar track, uchar sector, ushort buffer, D64* pDisk, bool writeProtected);
+
+	Drive1541& m_drive;
+};
+
+#endif // JOBQUEUE_HPP
@@ -5,7 +5,7 @@
 #include "logfiltersetup.hpp"
 #include "ui_logfiltersetup.h"
 
-LogFilterSetup::LogFilterSetup(LogFilterMap& logFilters, QVector<bool>& logLevels, QWidget* parent) :
+LogFilterSetup::LogFilterSetup(const LogFilterMap& logFilters, const QVector<bool>& logLevels, QWidget* parent) :
 		QDialog(parent),
 		m_logFilters(logFilters),
 		m_logLevels(logLevels),
@@ -3,30 +3,39 @@
 
 #include <QDialog>
 #include <QListWidgetItem>
-#include <QMap>
+#include "logger.hpp"
 
 namespace Ui {
 class LogFilterSetup;
 }
 
-typedef QMap<QString, bool> LogFilterMap;
-
 class LogFilterSetup : public QDialog
 {
 		Q_OBJECT
 
 public:
-		explicit LogFilterSetup(LogFilterMap& logFilters, QVector<bool>& logLevels, QWidget *parent = 0);
+		explicit LogFilterSetup(const LogFilterMap& logFilters, const QVector<bool>& logLevels, QWidget *parent = 0);
 		~LogFilterSetup();
 
+		// The filters as edited, for the logger to take over.
+		const LogFilterMap& logFilters() const
+		{
+				return m_logFilters;
+		}
+
+		const QVector<bool>& logLevels() const
+		{
+				return m_logLevels;
+		}
+
 private slots:
 		void on_m_close_clicked();
 		void on_m_facilityFilterList_itemChanged(QListWidgetItem *item);
 		void on_m_severityFilterList_itemChanged(QListWidgetItem *item);
 
 private:
-		LogFilterMap& m_logFilters;
-		QVector<bool>& m_logLevels;
+		LogFilterMap m_logFilters;
+		QVector<bool> m_logLevels;
 		Ui::LogFilterSetup *ui;
 };
 
@@ -2,6 +2,8 @@
 #include <iso646.h>
 #include <QDate>
 #include <QSettings>
+#include <QThread>
+#include <QMutexLocker>
 
 namespace Logging {
 
@@ -13,19 +15,22 @@ Logger::Logger(QObject *parent) : QObject(parent)
 
 void Logger::log(const QString& facility, const QString& message, LogLevelE level)
 {
-	LogFilterMap::const_iterator it(m_filters.find(facility));
+	{
+		QMutexLocker lock(&m_filterMutex);
+		LogFilterMap::const_iterator it(m_filters.find(facility));
 
-	if(it == m_filters.end())
-		m_filters[facility] = true; // add to existing facilities, enabled by default.
-	else
-		if(!it.value())
-			return; // filtered out!
+		if(it == m_filters.end())
+			m_filters[facility] = true; // add to existing facilities, enabled by default.
+		else
+			if(!it.value())
+				return; // filtered out!
 
-	// manage unlikely out-of-range value.
-	level = level >= NUM_SEVERITY_LEVELS ? info : level;
+		// manage unlikely out-of-range value.
+		level = level >= NUM_SEVERITY_LEVELS ? info : level;
 
-	if(!m_levels[level]) // check if severity level is filtered out.
-		return;
+		if(!m_levels[level]) // check if severity level is filtered out.
+			return;
+	}
 
 	QString dateTime(QDate::currentDate().toString("yyyy-MM-dd") +
 									 QTime::currentTime().toString(" hh:mm:ss:zzz"));
@@ -33,12 +38,23 @@ void Logger::log(const QString& facility, const QString& message, LogLevelE leve
 	// The logging levels are: [E]RROR [W]ARNING [I]NFORMATION [S]UCCESS.
 	QString levelFacility(QString("EWIS")[level] + " " + facility);
 
+	// The transports (e.g. the UI) are only used from our own thread, lines from other threads are queued to it.
+	if(QThread::currentThread() not_eq thread())
+		QMetaObject::invokeMethod(this, "deliver", Qt::QueuedConnection, Q_ARG(QString, dateTime), Q_ARG(int, level)
+															, Q_ARG(QString, levelFacility), Q_ARG(QString, message));
+	else
+		deliver(dateTime, level, levelFacility, message);
+} // Log
+
+
+void Logger::deliver(const QString& dateTime, int level, const QString& levelFacility, const QString& message)
+{
 	foreach(ILogTransport* transport, m_transports) {
 		transport->appendTime(dateTime);
-		transport->appendLevelAndFacility(level, levelFacility);
+		transport->appendLevelAndFacility(static_cast<LogLevelE>(level), levelFacility);
 		transport->appendMessage(message);
 	}
-} // Log
+} // deliver
 
 
 bool Logger::addTransport(ILogTransport* pTransport)
@@ -62,15 +78,42 @@ bool Logger::removeTransport(ILogTransport* pTransport)
 } // removeTransport
 
 
-void Logger::configureFilters(QWidget* parent = 0)
+LogFilterMap Logger::filters() const
+{
+	QMutexLocker lock(&m_filterMutex);
+	return m_filters;
+} // filters
+
+
+QVector<bool> Logger::levels() const
+{
+	QMutexLocker lock(&m_filterMutex);
+	return m_levels;
+} // levels
+
+
+void Logger::setFilters(const LogFilterMap& filters)
+{
+	QMutexLocker lock(&m_filterMutex);
+	LogFilterMap::const_iterator i = filters.constBegin();
+	while(i not_eq filters.constEnd()) {
+		m_filters[i.key()] = i.value();
+		++i;
+	}
+} // setFilters
+
+
+void Logger::setLevels(const QVector<bool>& levels)
 {
-	LogFilterSetup dlgSetup(m_filters, m_levels, parent);
-	dlgSetup.exec();
-} // configureFilters
+	QMutexLocker lock(&m_filterMutex);
+	for(int i = 0; i < levels.size() and i < m_levels.size(); ++i)
+		m_levels[i] = levels[i];
+} // setLevels
 
 
 void Logger::saveFilters(QSettings& sets)
 {
+	QMutexLocker lock(&m_filterMutex);
 	sets.beginGroup("logFilters");
 	LogFilterMap::const_iterator i = m_filters.constBegin();
 	while(i not_eq m_filters.constEnd()) {
@@ -91,6 +134,7 @@ void Logger::saveFilters(QSettings& sets)
 
 void Logger::loadFilters(QSettings& sets)
 {
+	QMutexLocker lock(&m_filterMutex);
 	sets.beginGroup("logFilters");
 	QStringList keys = sets.childKeys();
 	foreach(QString key, keys)
@@ -2,10 +2,14 @@
 #define LOGGER_HPP
 
 #include <QObject>
-#include "logfiltersetup.hpp"
+#include <QMap>
+#include <QVector>
+#include <QMutex>
 
 class QSettings;
 
+typedef QMap<QString, bool> LogFilterMap;
+
 namespace Logging {
 
 typedef enum {
@@ -34,8 +38,13 @@ public:
 	bool addTransport(ILogTransport* pTransport);
 	bool removeTransport(ILogTransport* pTransport);
 
-	// filters
-	void configureFilters(QWidget *parent);
+	// filters, copies since lines are logged (and facilities added) from the serial worker thread meanwhile.
+	LogFilterMap filters() const;
+	QVector<bool> levels() const;
+	// The facilities given are set, the ones added since the copy was taken are kept.
+	void setFilters(const LogFilterMap& filters);
+	void setLevels(const QVector<bool>& levels);
+
 	void saveFilters(QSettings& sets);
 	void loadFilters(QSettings& sets);
 
@@ -44,10 +53,16 @@ signals:
 
 public slots:
 
+private slots:
+	// Hands a line to the transports, on the thread the logger lives in.
+	void deliver(const QString& dateTime, int level, const QString& levelFacility, const QString& message);
+
 private:
 	LogTransportList m_transports;
 	LogFilterMap m_filters;
 	QVector<bool> m_levels;
+	// Guards the filters, lines are logged from the serial worker thread too.
+	mutable QMutex m_filterMutex;
 };
 
 Logger& loggerInstance();
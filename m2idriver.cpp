@@ -23,6 +23,7 @@
 
 #include "m2idriver.hpp"
 #include "logger.hpp"
+#include "imagecache.hpp"
 #include "utils.hpp"
 
 using namespace Logging;
@@ -54,10 +55,11 @@ bool M2I::mountHostImage(const QString& fileName)
 	// Interface has just opened the m2i file, save filename
 	m_hostFile.setFileName(fileName);
 
-	if(not m_hostFile.open(QIODevice::ReadOnly))
+	const QByteArray contents(imageCache().image(fileName));
+	if(contents.isNull())
 		return false;
 
-	QTextStream in(&m_hostFile);
+	QTextStream in(contents, QIODevice::ReadOnly);
 	bool isFirst = true;
 	bool success = true;
 	int lineNbr = 1;
@@ -134,8 +136,7 @@ bool M2I::mountHostImage(const QString& fileName)
 		++lineNbr;
 	} // while
 
-	// We close immediately as we're done, host file (.M2I) is only kept open during parsing (or writing).
-	m_hostFile.close();
+	// The host file (.M2I) is only opened during writing, parsing is done from the cached contents.
 	m_status = success ? IMAGE_OK : NOT_READY;
 
 	return success;
@@ -165,6 +166,8 @@ bool M2I::sendListing(ISendLine &cb)
 	// Write lines
 	foreach(const FileEntry& e, m_entries) {
 		if(FileEntry::TypeDel == e.fileType or FileEntry::TypePrg == e.fileType) {
+			if(not listingFilter().matches(e.cbmName.trimmed(), FileEntry::TypePrg == e.fileType ? 'P' : 'D'))
+				continue;
 			QString name = '"' + e.cbmName + '"';
 			QFile f(e.nativeName.trimmed());
 			ushort fileSize = (ushort)(f.exists() ? f.size() : 0) / 256;
@@ -198,6 +201,7 @@ bool M2I::deleteFile(const QString& fileName)
 					if(result) {
 						m_hostFile.write(QByteArray().append(generateFile()));
 						m_hostFile.close();
+						imageCache().invalidate(m_hostFile.fileName());
 					}
 					else
 						Log("M2I", error, "Failed opening m2i container for writing.");
@@ -232,6 +236,7 @@ CBM::IOErrorMessage M2I::renameFile(const QString& oldName, const QString& newNa
 			if(m_hostFile.open(QFile::WriteOnly)) {
 				m_hostFile.write(QByteArray().append(generateFile()));
 				m_hostFile.close();
+				imageCache().invalidate(m_hostFile.fileName());
 				ret = CBM::ErrOK;
 			}
 			else
@@ -318,6 +323,7 @@ CBM::IOErrorMessage M2I::fopenWrite(const QString& fileName, bool replaceMode)
 			m_entries.append(e);
 			m_hostFile.write(QByteArray().append(generateFile()));
 			m_hostFile.close();
+			imageCache().invalidate(m_hostFile.fileName());
 		}
 		else
 			close();
@@ -357,6 +363,16 @@ char M2I::getc(void)
 } // getc
 
 
+int M2I::read(char* dst, int max)
+{
+	if(not (m_status bitand FILE_OPEN))
+		return 0;
+	qint64 numRead(m_nativeFile.read(dst, max));
+
+	return numRead < 0 ? 0 : numRead;
+} // read
+
+
 // write char to open file, returns false if failure
 bool M2I::putc(char c)
 {
@@ -38,6 +38,7 @@ public:
 	ushort openedFileSize() const;
 
 	char getc(void);
+	int read(char* dst, int max);
 
 	bool isEOF(void) const;
 
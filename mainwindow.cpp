@@ -37,14 +37,12 @@
 #include <QDebug>
 #include <QSettings>
 #include <QTimer>
-#ifdef HAS_WIRINGPI
-#include <wiringPi.h>
-#endif
 
 #include "mainwindow.hpp"
 #include "ui_mainwindow.h"
 #include "aboutdialog.hpp"
 #include "mountspecificfile.h"
+#include "logfiltersetup.hpp"
 #include "version.h"
 
 using namespace Logging;
@@ -57,9 +55,6 @@ namespace {
 EmulatorPaletteMap emulatorPalettes;
 CbmMachineThemeMap machineThemes;
 
-const QString OkString = "OK>%1|%2|%3|%4|%5|%6|%7.%8\r";
-const QString NOkString = "NOK>\r";
-const QString ConnectionString = "connect_arduino:";
 const QColor logLevelColors[] = { QColor(Qt::red), QColor("orange"), QColor(Qt::blue), QColor(Qt::darkGreen) };
 
 QStringList IMAGE_LIST_HEADERS = (QStringList()
@@ -73,16 +68,6 @@ QStringList LOG_LEVELS = (QStringList()
 													<< QObject::tr("success"));
 
 
-// Default Device and Arduino PIN configuration.
-const uint DEFAULT_BAUDRATE = QSerialPort::Baud115200;
-const uint DEFAULT_DEVICE_NUMBER = 8;
-const uint DEFAULT_RESET_PIN = 7;
-const uint DEFAULT_CLOCK_PIN = 4;
-const uint DEFAULT_DATA_PIN = 3;
-const uint DEFAULT_ATN_PIN = 5;
-const uint DEFAULT_SRQIN_PIN = 2;
-
-
 const QString PROGRAM_VERSION_HISTORY = qApp->tr(
 		"<hr>"
 		"<ul>"
@@ -143,9 +128,7 @@ const QString PROGRAM_VERSION_HISTORY = qApp->tr(
 MainWindow::MainWindow(QWidget* parent) :
 	QMainWindow(parent)
 	, ui(new Ui::MainWindow)
-	, m_port(this)
-	, m_isConnected(false)
-	, m_iface()
+	, m_host()
 	, m_isInitialized(false)
 	,	m_fsWatcher(this)
 	, m_simulatedState(simsOff)
@@ -157,35 +140,19 @@ MainWindow::MainWindow(QWidget* parent) :
 	ui->dirList->setModel(m_dirListItemModel);
 	loggerInstance().addTransport(this);
 
-	// Set up the port basic parameters, these won't change...promise.
-	m_port.setDataBits(QSerialPort::Data8);
-	m_port.setParity(QSerialPort::NoParity);
-	m_port.setFlowControl(QSerialPort::NoFlowControl);
-	m_port.setStopBits(QSerialPort::OneStop);
-
 	enumerateComPorts();
 
 	readSettings();
-	m_port.setBaudRate(static_cast<QSerialPort::BaudRate>(m_appSettings.baudRate));
-	usePortByFriendlyName(m_appSettings.portName);
-
-	m_port.open(QIODevice::ReadWrite);
-	Log("MAIN", success, QString("Application Started, using port %1 @ %2").arg(m_port.portName()).arg(QString::number(m_port.baudRate())));
-	// we want events from the port.
-	connect(&m_port, SIGNAL(readyRead()), this, SLOT(onDataAvailable()));
+	applyDeviceConfig();
+	m_host.openPort(m_appSettings.portName, m_appSettings.baudRate);
+	Log("MAIN", success, QString("Application Started, using port %1 @ %2").arg(m_host.portName()).arg(QString::number(m_host.baudRate())));
 	connect(ui->imageDirList, SIGNAL(commandIssued(const QString&)), this, SLOT(onCommandIssued(const QString&)));
 	ui->dockWidget->toggleViewAction()->setShortcut(QKeySequence("CTRL+L"));
 	ui->menuMain->insertAction(ui->menuMain->actions().first(), ui->dockWidget->toggleViewAction());
 
 	// Initialize WiringPI stuff, if we're on the Raspberry Pi platform.
-#ifdef HAS_WIRINGPI
-	system("/usr/local/bin/gpio -g mode 23 out");
-	system("/usr/local/bin/gpio export 23 out");
-	if(-1 == wiringPiSetupSys())
-		Log("MAIN", "Failed initializing WiringPi. Continuing anyway...", error);
-	else
+	if(m_host.setupResetLine())
 		on_resetArduino_clicked();
-#endif
 
     // palettes and themes must be named exactly after action labels
     emulatorPalettes["&vice"] = viceColors;
@@ -212,8 +179,8 @@ MainWindow::MainWindow(QWidget* parent) :
 	directoryChanged(m_appSettings.imageDirectory);
 
 	// register ourselves to listen for all CBM events from the Arduino so that we can reflect this on UI controls.
-	m_iface.setMountNotifyListener(this);
-	m_iface.setImageFilters(m_appSettings.imageFilters, m_appSettings.showDirectories);
+	m_host.setNotifyListener(this);
+	m_host.setImageFilters(m_appSettings.imageFilters, m_appSettings.showDirectories);
 	// This will also reset the device!
 	updateDirListColors();
 	// We want notifications when the local file system changes so that we can update the image directory list.
@@ -296,23 +263,10 @@ void MainWindow::enumerateComPorts()
 } // enumerateComPorts
 
 
-void MainWindow::usePortByFriendlyName(const QString& friendlyName)
-{
-	foreach(QSerialPortInfo port, m_ports) {
-		if(port.portName() == friendlyName) {
-			// found it, set it and be done.
-						m_port.setPort(port);
-			break;
-		}
-	}
-} // usePortByFriendlyName
-
-
 MainWindow::~MainWindow()
 {
-	m_iface.setMountNotifyListener(0);
-	if(m_port.isOpen())
-		m_port.close();
+	m_host.setNotifyListener(0);
+	m_host.closePort();
 	delete ui;
 } // dtor
 
@@ -336,27 +290,24 @@ void MainWindow::on_actionSettings_triggered()
 	AppSettings oldSettings = m_appSettings;
 	SettingsDialog settings(m_ports, m_appSettings, this);
 	if(QDialog::Accepted == settings.exec()) { // user pressed Ok?
+		applyDeviceConfig();
 		if(m_appSettings.cbmBorderWidth not_eq oldSettings.cbmBorderWidth)
 			updateDirListColors();
 		if(m_appSettings.imageFilters not_eq oldSettings.imageFilters
 			 or m_appSettings.showDirectories not_eq oldSettings.showDirectories
 			 or m_appSettings.imageDirectory not_eq oldSettings.imageDirectory) {
-			m_iface.setImageFilters(m_appSettings.imageFilters, m_appSettings.showDirectories);
-			m_iface.changeNativeFSDirectory(m_appSettings.imageDirectory);
+			m_host.setImageFilters(m_appSettings.imageFilters, m_appSettings.showDirectories);
+			m_host.changeNativeFSDirectory(m_appSettings.imageDirectory);
 			watchDirectory(m_appSettings.imageDirectory);
 			updateImageList();
 		}
 		if(m_appSettings.baudRate not_eq oldSettings.baudRate)
-			m_port.setBaudRate(static_cast<QSerialPort::BaudRate>(m_appSettings.baudRate));
+			m_host.setBaudRate(m_appSettings.baudRate);
 
 		// Was port changed?
 		if(m_appSettings.portName not_eq oldSettings.portName) {
-			m_isConnected = false;
-			if(m_port.isOpen())
-				m_port.close();
-			usePortByFriendlyName(m_appSettings.portName);
-			m_port.open(QIODevice::ReadWrite);
-			Log("MAIN", info, QString("Port name changed to %1").arg(m_port.portName()));
+			m_host.openPort(m_appSettings.portName, m_appSettings.baudRate);
+			Log("MAIN", info, QString("Port name changed to %1").arg(m_host.portName()));
 		}
 	}
 } // on_actionSettings_triggered
@@ -367,11 +318,31 @@ void MainWindow::on_actionSingle_file_mount_triggered()
 	MountSpecificFile mountDialog(m_appSettings.lastSpecificMounted, this);
 	if(QDialog::Accepted == mountDialog.exec()) {
 		m_appSettings.lastSpecificMounted = mountDialog.chosenFile();
-		m_iface.processOpenCommand(CBM::READPRG_CHANNEL, m_appSettings.lastSpecificMounted.toLocal8Bit(), true);
+		m_host.openLocal(CBM::READPRG_CHANNEL, m_appSettings.lastSpecificMounted.toLocal8Bit());
 	}
 } // on_actionSingle_file_mount_triggered
 
 
+void MainWindow::on_actionDisk_Write_Protected_toggled(bool checked)
+{
+	m_host.setWriteProtected(checked);
+} // on_actionDisk_Write_Protected_toggled
+
+
+// The Arduino is handed the device number and pins from the settings when it (re)connects.
+void MainWindow::applyDeviceConfig()
+{
+	SerialHost::DeviceConfig config;
+	config.deviceNumber = m_appSettings.deviceNumber;
+	config.atnPin = m_appSettings.atnPin;
+	config.clockPin = m_appSettings.clockPin;
+	config.dataPin = m_appSettings.dataPin;
+	config.resetPin = m_appSettings.resetPin;
+	config.srqInPin = m_appSettings.srqInPin;
+	m_host.setDeviceConfig(config);
+} // applyDeviceConfig
+
+
 void MainWindow::checkVersion()
 {
 	if(m_appSettings.programVersion not_eq VER_PRODUCTVERSION_STR) {
@@ -409,8 +380,10 @@ void MainWindow::readSettings()
 	m_appSettings.resetPin = sets.value("resetPin", QString::number(DEFAULT_RESET_PIN)).toUInt();
 	m_appSettings.srqInPin = sets.value("srqInPin", QString::number(DEFAULT_SRQIN_PIN)).toUInt();
 
-	m_appSettings.imageFilters = sets.value("imageFilters", "*.D64,*.T64,*.M2I,*.PRG,*.P00,*.SID").toString();
+	m_appSettings.imageFilters = sets.value("imageFilters", "*.D64,*.D71,*.D81,*.G64,*.T64,*.M2I,*.PRG,*.P00,*.SID").toString();
 	m_appSettings.showDirectories = sets.value("showDirectories", false).toBool();
+	m_appSettings.imageCacheMegabytes = sets.value("imageCacheMegabytes", 64).toUInt();
+	m_host.setImageCacheBytes(qint64(m_appSettings.imageCacheMegabytes) * 1024 * 1024);
 	m_appSettings.programVersion = sets.value("lastProgramVersion", "unset").toString();
 
 	m_appSettings.emulatorPalette = sets.value("emulatorPalette", "ccs64").toString();
@@ -454,6 +427,7 @@ void MainWindow::writeSettings() const
 	sets.setValue("srqInPin", QString::number(m_appSettings.srqInPin));
 	sets.setValue("imageFilters", m_appSettings.imageFilters);
 	sets.setValue("showDirectories", m_appSettings.showDirectories);
+	sets.setValue("imageCacheMegabytes", m_appSettings.imageCacheMegabytes);
 
 	sets.setValue("emulatorPalette", m_appSettings.emulatorPalette);
 	sets.setValue("cbmMachine", m_appSettings.cbmMachine);
@@ -486,77 +460,10 @@ void LogHexData(const QByteArray& bytes, const QString& header = QString("R#%1:"
 } // LogHexData
 
 
-bool MainWindow::checkConnectRequest(QByteArray& buffer)
-{
-	int connectPos = buffer.indexOf(ConnectionString);
-	if(-1 == connectPos)
-		return false;
-	int crPos = buffer.indexOf('\r', connectPos);
-	if(-1 == crPos)
-		return false;
-
-	// extract version number.
-	const QString verString(buffer.mid(connectPos + ConnectionString.length(), crPos - connectPos));
-	ushort receivedProtoVersion = verString.toInt();
-	if(CURRENT_UNO2IEC_PROTOCOL_VERSION not_eq receivedProtoVersion) {
-		Log("MAIN", error, QString("Received connection string from arduino, but the protocol version (%1) mismatched our "
-				"version (%2). Not accepting connection, please upgrade the Arduino!")
-				.arg(receivedProtoVersion).arg(CURRENT_UNO2IEC_PROTOCOL_VERSION));
-		m_pendingBuffer.clear();
-		m_unexpectedBuffer.clear();
-		// Negative response, make it stop connection attempts.
-		m_port.write(NOkString.toLatin1().data());
-		return false;
-	}
-
-	m_pendingBuffer.clear();
-	m_unexpectedBuffer.clear();
-	// Assume connected, maybe a real ack sequence is needed here from the client?
-	// Are we already connected? If so,
-	if(not m_isConnected) {
-		m_isConnected = true;
-		Log("MAIN", success, "Now connected to Arduino.");
-	}
-	else
-		Log("MAIN", warning, "Got reconnection attempt from Arduino for unknown reason. Accepting new connection.");
-
-	// give the client the version, pin configuration, current date and time in the response string.
-	const QString response = OkString.arg(QString::number(m_appSettings.deviceNumber))
-			.arg(QString::number(m_appSettings.atnPin))
-			.arg(QString::number(m_appSettings.clockPin))
-			.arg(QString::number(m_appSettings.dataPin))
-			.arg(QString::number(m_appSettings.resetPin))
-			.arg(QString::number(m_appSettings.srqInPin))
-			.arg(QDate::currentDate().toString("yyyy-MM-dd"))
-			.arg(QTime::currentTime().toString("hh:mm:ss"));
-
-	m_port.write(response.toLatin1().data());
-	// client is supposed to send it's facilities each start.
-	m_clientFacilities.clear();
-	return true;
-} // checkConnectRequest
-
-
-////////////////////////////////////////////////////////////////////////////
-// Dispatcher for when something has arrived on the serial port / simulated data.
-////////////////////////////////////////////////////////////////////////////
-void MainWindow::onDataAvailable()
-{
-	m_pendingBuffer.append(m_port.readAll());
-//	if(not m_isConnected) {
-		checkConnectRequest(m_pendingBuffer);
-//		return;
-//	}
-	if(m_isConnected)
-		processData();
-} // onDataAvailable
-
-
 #ifdef QT_DEBUG
 void MainWindow::simulateData(const QByteArray& data)
 {
-	m_pendingBuffer.append(data);
-	processData();
+	m_host.processSimulatedData(data);
 } // simulateData
 
 
@@ -583,7 +490,7 @@ void MainWindow::simTimerExpired()
 
 void MainWindow::simTimerExpiredNoResp()
 {
-	writePort(QByteArray(), false);
+	simulatedResponse(QByteArray());
 }
 
 #else
@@ -594,15 +501,10 @@ void MainWindow::delayedSimNoResponse(ProcessingState, const QByteArray&) {}
 void MainWindow::simTimerExpiredNoResp() {}
 #endif
 
-void MainWindow::writePort(const QByteArray &data, bool flush)
+void MainWindow::simulatedResponse(const QByteArray& data)
 {
-	if(simsOff == m_simulatedState) {
-		if(m_port.isOpen()) {
-			m_port.write(data);
-			if(flush)
-				m_port.flush();
-		}
-	}
+	if(simsOff == m_simulatedState)
+		Log("SIM", warning, "Got a response without a simulated request, ignored.");
 	else {
 		LogHexData(data, "W#%1:");
 		switch(m_simulatedState) {
@@ -716,7 +618,7 @@ void MainWindow::writePort(const QByteArray &data, bool flush)
 				break;
 		}
 	}
-} // writePort
+} // simulatedResponse
 
 
 void MainWindow::onCommandIssued(const QString& cmd)
@@ -776,178 +678,9 @@ void MainWindow::onCommandIssued(const QString& cmd)
 } // onCommandIssued
 
 
-void MainWindow::processData(void)
-{
-	bool hasDataToProcess = not m_pendingBuffer.isEmpty();
-	//	if(hasDataToProcess)
-	//		LogHexData(buffer);
-	while(hasDataToProcess) {
-		QString cmdString(m_pendingBuffer);
-		int crIndex =	cmdString.indexOf('\r');
-
-		// Get the first waiting character, which should be the command to perform.
-		char cmdChar(cmdString.at(0).toLatin1());
-		switch(cmdChar) {
-			case '!': // register facility string.
-				if(-1 == crIndex)
-					hasDataToProcess = false; // escape from here, command is incomplete.
-				else {
-					processAddNewFacility(cmdString.left(crIndex));
-					m_pendingBuffer.remove(0, crIndex + 1);
-				}
-				break;
-
-			case 'D': // debug output.
-				if(-1 == crIndex)
-					hasDataToProcess = false; // escape from here, command is incomplete.
-				else {
-					processDebug(cmdString.left(crIndex));
-					m_pendingBuffer.remove(0, crIndex + 1);
-				}
-				break;
-
-			case 'S': // request for file size in bytes before sending file to CBM
-				m_pendingBuffer.remove(0, 1);
-				m_iface.processGetOpenFileSize();
-				break;
-
-			case 'O': // open command
-				if(m_pendingBuffer.size() > 1) {
-					uchar length = (uchar)m_pendingBuffer.at(1);
-					if(length < 3) // sanity: can't be a valid command if total length is less than first control chars.
-						m_pendingBuffer.remove(0, 2); // remove strange garbage and keep processing.
-					else if(m_pendingBuffer.size() >= length) { // only if we got at least as much as length specifies.
-						// Open was issued, string goes from m_pendingBuffer[2] with length - 2
-						m_iface.processOpenCommand((uchar)m_pendingBuffer.at(2), m_pendingBuffer.mid(3, length - 3));
-						m_pendingBuffer.remove(0, length);
-					}
-					else
-						hasDataToProcess = false; // not all chars yet
-				}
-				else
-					hasDataToProcess = false; // not all chars yet
-				break;
-
-			case 'R':
-				// read byte(s) from current file system driver, note that this command needs no termination char,
-				// because it needs to be short.
-				// The payload given back will be the current size, it is by default MAX_BYTES_PER_REQUEST (or as many left to
-				// read) but may be changed with 'N' command.
-				m_pendingBuffer.remove(0, 1);
-				m_iface.processReadFileRequest();
-				break;
-
-			case 'N': // same as 'N', but we are also given the expected read size. All succeeding 'R' will be with this size.
-				if(m_pendingBuffer.size() < 2)
-					hasDataToProcess = false;
-				else {
-					uchar length = (uchar)m_pendingBuffer.at(1);
-					m_pendingBuffer.remove(0, 2);
-					m_iface.processReadFileRequest(length);
-				}
-				break;
-
-			case 'W': // write characters to file in current file system mode.
-				if(m_pendingBuffer.size() > 1) {
-					uchar length = (uchar)m_pendingBuffer.at(1);
-					if(m_pendingBuffer.size() >= length) {
-						m_iface.processWriteFileRequest(m_pendingBuffer.mid(2, length - 2));
-						// discard all processed (written) bytes from buffer.
-						m_pendingBuffer.remove(0, length);
-					}
-					else
-						hasDataToProcess = false; // not all chars yet
-				}
-				else
-					hasDataToProcess = false; // not all chars yet
-				break;
-
-			case 'L': // directory/media info Line request:
-				// Just remove the BYTE from queue and do business.
-				m_pendingBuffer.remove(0, 1);
-				m_iface.processLineRequest();
-				break;
-
-			case 'C': // close FILE command
-				m_pendingBuffer.remove(0, 1);
-				m_iface.processCloseCommand();
-				break;
-
-			case 'E': // Ask for translation of error string from error code
-				if(m_pendingBuffer.size() < 2) // must have both characters, otherwise request is incomplete.
-					hasDataToProcess = false;
-				else {
-					m_iface.processErrorStringRequest(static_cast<CBM::IOErrorMessage>(m_pendingBuffer.at(1)));
-					m_pendingBuffer.remove(0, 2);
-				}
-				break;
-
-			default:
-				// got something, might be in middle of something and with no CR, just get out.
-				//				Log("MAIN", warning, QString("Got unknown char %1").arg(cmdString.at(0).toLatin1()));
-				m_unexpectedBuffer.append(cmdChar);
-				m_pendingBuffer.remove(0, 1);
-				// See if it is a reconnection attempt.
-				if(checkConnectRequest(m_unexpectedBuffer))
-					hasDataToProcess = false;
-				break;
-		}
-		// if we want to continue processing, but have no data in buffer, get out anyway and wait for more data.
-		if(hasDataToProcess)
-			hasDataToProcess = not m_pendingBuffer.isEmpty();
-	} // while(hasDataToProcess);
-
-	//	if(not buffer.isEmpty())
-	//		LogHexData(m_pendingBuffer, "U:#%1");
-} // processData
-
-
-void MainWindow::processAddNewFacility(const QString& str)
-{
-	//	Log("MAIN", QString("Got facility: %1").arg(str.mid(2)), success);
-	m_clientFacilities[str.at(1)] = str.mid(2);
-} // processAddNewFacility
-
-
-void MainWindow::processDebug(const QString& str)
-{
-	LogLevelE level = info;
-	switch(str[1].toUpper().toLatin1()) {
-	case 'S':
-		level = success;
-		break;
-	case 'I':
-						level = info;
-		break;
-	case 'W':
-		level = warning;
-		break;
-	case 'E':
-		level = error;
-		break;
-	}
-
-	Log(QString("R:") + m_clientFacilities.value(str[2], "GENERAL"), level, str.mid(3));
-} // processDebug
-
-
 void MainWindow::on_resetArduino_clicked()
 {
-	m_isConnected = false;
-	m_iface.reset();
-#ifdef HAS_WIRINGPI
-	Log("MAIN", "Moving to disconnected state and resetting arduino...", warning);
-	// pull pin 23 to reset arduino.
-	pinMode(23, OUTPUT);
-	digitalWrite(23, 0);
-	delay(3000);
-	Log("MAIN", "Releasing reset state...", info);
-	// set it high again to release reset state.
-	digitalWrite(23, 1);
-#else
-	m_port.close();
-	m_port.open(QIODevice::ReadWrite);
-#endif
+	m_host.resetArduino();
 } // on_resetArduino_clicked
 
 
@@ -966,7 +699,12 @@ void MainWindow::on_clearLog_clicked()
 
 void MainWindow::on_filterSetup_clicked()
 {
-	Logging::loggerInstance().configureFilters(this);
+	Logging::Logger& logger(Logging::loggerInstance());
+	// The dialog edits copies, the logger is used from the serial worker thread meanwhile.
+	LogFilterSetup dlgSetup(logger.filters(), logger.levels(), this);
+	dlgSetup.exec();
+	logger.setFilters(dlgSetup.logFilters());
+	logger.setLevels(dlgSetup.logLevels());
 } // on_filterSetup_clicked
 
 
@@ -1157,26 +895,17 @@ void MainWindow::on_mountSelected_clicked()
 		return;
 	QString name = selected.first().data(Qt::DisplayRole).toString();
 
-	m_iface.processOpenCommand(CBM::READPRG_CHANNEL, name.toLocal8Bit(), true);
+	m_host.openLocal(CBM::READPRG_CHANNEL, name.toLocal8Bit());
 } // on_mountSelected_clicked
 
 
 void MainWindow::on_unmountCurrent_clicked()
 {
-	m_iface.processOpenCommand(CBM::READPRG_CHANNEL, QByteArray().append(QChar(CBM_BACK_ARROW))
-														 .append(QChar(CBM_BACK_ARROW)), true);
+	m_host.openLocal(CBM::READPRG_CHANNEL, QByteArray().append(QChar(CBM_BACK_ARROW))
+									 .append(QChar(CBM_BACK_ARROW)));
 } // on_unmountCurrent_clicked
 
 
-void MainWindow::send(short lineNo, const QString& text)
-{
-	QString line(text);
-	line.prepend(QString::number(lineNo) + ' ');
-	// add it to the total dirlisting array.
-	m_imageDirListing.append(line);
-} // send
-
-
 //////////////////////////////////////////////////////////////////////////////
 // IMountNotifyListener interface implementation
 //////////////////////////////////////////////////////////////////////////////
@@ -1188,16 +917,15 @@ void MainWindow::directoryChanged(const QString& newPath)
 } // directoryChanged
 
 
-void MainWindow::imageMounted(const QString& imagePath, FileDriverBase* pFileSystem)
+void MainWindow::imageMounted(const QString& imagePath, const QStringList& listing)
 {
 	QColor bgColor, frColor, fgColor;
 	getBgFrAndFgColors(bgColor, frColor, fgColor);
 
 	ui->nowMounted->setText(imagePath);
 	ui->imageDirList->clear();
-	m_imageDirListing.clear();
-	if(pFileSystem->supportsListing() and pFileSystem->sendListing(*this)) {
-		foreach(QString line, m_imageDirListing) {
+	if(not listing.isEmpty()) {
+		foreach(QString line, listing) {
 			QStringList lineInverses = line.split('\x12', QString::SkipEmptyParts);
 			bool rvs = false;
 			foreach(QString linePart, lineInverses) {
@@ -1214,7 +942,6 @@ void MainWindow::imageMounted(const QString& imagePath, FileDriverBase* pFileSys
 			}
 			ui->imageDirList->insertPlainText("\n");
 		}
-		m_imageDirListing.clear();
 	}
 	ui->unmountCurrent->setEnabled(true);
 
@@ -1350,22 +1077,10 @@ void MainWindow::fileClosed(const QString& lastFileName)
 } // fileClosed
 
 
-bool MainWindow::isWriteProtected() const
-{
-	return ui->actionDisk_Write_Protected->isChecked();
-} // isWriteProtected
-
-
-ushort MainWindow::deviceNumber() const
-{
-	return m_appSettings.deviceNumber;
-} // deviceNumber
-
-
-void MainWindow::setDeviceNumber(ushort deviceNumber)
+void MainWindow::deviceNumberChanged(ushort deviceNumber)
 {
 	m_appSettings.deviceNumber = deviceNumber;
-} // setDeviceNumber
+} // deviceNumberChanged
 
 
 void MainWindow::deviceReset()
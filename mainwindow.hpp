@@ -7,7 +7,7 @@
 #include <QFileSystemWatcher>
 #include <QtSerialPort/QtSerialPort>
 #include <QMap>
-#include "interface.hpp"
+#include "serialhost.hpp"
 #include "logger.hpp"
 #include "settingsdialog.hpp"
 
@@ -26,10 +26,8 @@ struct CbmMachineTheme {
 
 typedef QMap<QString, const QRgb*> EmulatorPaletteMap;
 typedef QMap<QString, CbmMachineTheme*> CbmMachineThemeMap;
-typedef QMap<QChar, QString> FacilityMap;
 
-class MainWindow : public QMainWindow, public Logging::ILogTransport, public Interface::IFileOpsNotify,
-		public ISendLine
+class MainWindow : public QMainWindow, public Logging::ILogTransport, public SerialHost::IHostNotify
 {
 	Q_OBJECT
 
@@ -40,27 +38,21 @@ public:
 	~MainWindow();
 
 	void writeTextToDirList(const QString& text, bool atCursor = true);
-	void processAddNewFacility(const QString &str);
 	void checkVersion();
 	void closeEvent(QCloseEvent* event);
 
-	// IMountNotifyListener interface implementation
+	// IHostNotify interface implementation
 	void directoryChanged(const QString& newPath);
-	void imageMounted(const QString& imagePath, FileDriverBase* pFileSystem);
+	void imageMounted(const QString& imagePath, const QStringList& listing);
 	void imageUnmounted();
 	void fileLoading(const QString& fileName, ushort fileSize);
 	void fileSaving(const QString& fileName);
 	void bytesRead(uint numBytes);
 	void bytesWritten(uint numBytes);
 	void fileClosed(const QString &lastFileName);
-	bool isWriteProtected() const;
-	ushort deviceNumber() const;
-	void setDeviceNumber(ushort deviceNumber);
+	void deviceNumberChanged(ushort deviceNumber);
 	void deviceReset();
-	void writePort(const QByteArray& data, bool flush);
-
-	// ISendLine interface implementation.
-	void send(short lineNo, const QString &text);
+	void simulatedResponse(const QByteArray& data);
 
 	// ILogTransport implementation.
 	void appendTime(const QString& dateTime);
@@ -73,7 +65,6 @@ public slots:
 private slots:
 	void onDirListColorSelected(QAction *pAction);
 	void onCbmMachineSelected(QAction *pAction);
-	void onDataAvailable();
 	void on_clearLog_clicked();
 	void on_pauseLog_toggled(bool checked);
 	void on_saveLog_clicked();
@@ -91,12 +82,11 @@ private slots:
 	void simTimerExpired();
 	void simTimerExpiredNoResp();
 	void on_actionSingle_file_mount_triggered();
+	void on_actionDisk_Write_Protected_toggled(bool checked);
 
 private:
-	bool checkConnectRequest(QByteArray& buffer);
 	void enumerateComPorts();
-	void usePortByFriendlyName(const QString &friendlyName);
-	void processDebug(const QString &str);
+	void applyDeviceConfig();
 	void watchDirectory(const QString& dir);
 	void updateImageList(bool reloadDirectory = true);
 	void boldifyItem(QStandardItem *pItem);
@@ -111,18 +101,12 @@ private:
 	void cbmCursorVisible(bool visible = true);
 
 	Ui::MainWindow *ui;
-	QSerialPort m_port;
-	QByteArray m_pendingBuffer;
-	QByteArray m_unexpectedBuffer;
-	bool m_isConnected;
-	FacilityMap m_clientFacilities;
-	Interface m_iface;
+	SerialHost m_host;
 	QList<QSerialPortInfo> m_ports;
 	QStandardItemModel* m_dirListItemModel;
 	QFileInfoList m_filteredInfoList;
 	QFileInfoList m_infoList;
 	bool m_isInitialized;
-	QStringList m_imageDirListing;
 	AppSettings m_appSettings;
 	ushort m_totalReadWritten;
 	QString m_loadSaveName;
@@ -146,7 +130,6 @@ private:
 	} m_simulatedState;
 
 	void simulateData(const QByteArray& data);
-	void processData(void);
 	void delayedSimulate(ProcessingState newState, const QByteArray &data);
 	void delayedSimNoResponse(ProcessingState newState, const QByteArray& data);
 };
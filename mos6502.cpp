@@ -0,0 +1,590 @@
+#include "mos6502.hpp"
+
+namespace {
+
+const ushort RESET_VECTOR = 0xFFFC;
+const ushort IRQ_VECTOR = 0xFFFE;
+
+// Base cycles per opcode (NMOS, undocumented ones included). Page crossings and branches add to these.
+const uchar s_cycles[256] = {
+//0 1 2 3 4 5 6 7 8 9 A B C D E F
+	7,6,2,8,3,3,5,5,3,2,2,2,4,4,6,6, // 0
+	2,5,2,8,4,4,6,6,2,4,2,7,4,4,7,7, // 1
+	6,6,2,8,3,3,5,5,4,2,2,2,4,4,6,6, // 2
+	2,5,2,8,4,4,6,6,2,4,2,7,4,4,7,7, // 3
+	6,6,2,8,3,3,5,5,3,2,2,2,3,4,6,6, // 4
+	2,5,2,8,4,4,6,6,2,4,2,7,4,4,7,7, // 5
+	6,6,2,8,3,3,5,5,4,2,2,2,5,4,6,6, // 6
+	2,5,2,8,4,4,6,6,2,4,2,7,4,4,7,7, // 7
+	2,6,2,6,3,3,3,3,2,2,2,2,4,4,4,4, // 8
+	2,6,2,6,4,4,4,4,2,5,2,5,5,5,5,5, // 9
+	2,6,2,6,3,3,3,3,2,2,2,2,4,4,4,4, // A
+	2,5,2,5,4,4,4,4,2,4,2,4,4,4,4,4, // B
+	2,6,2,8,3,3,5,5,2,2,2,2,4,4,6,6, // C
+	2,5,2,8,4,4,6,6,2,4,2,7,4,4,7,7, // D
+	2,6,2,8,3,3,5,5,2,2,2,2,4,4,6,6, // E
+	2,5,2,8,4,4,6,6,2,4,2,7,4,4,7,7  // F
+};
+
+} // unnamed namespace
+
+
+Mos6502::Mos6502(IBus& bus)
+	: m_bus(bus), m_pc(0), m_a(0), m_x(0), m_y(0), m_s(0xFF), m_p(FlagU bitor FlagI), m_irq(false), m_jammed(false)
+	, m_stopAddress(-1), m_cycles(0), m_instructions(0)
+{
+	for(int page = 0; page < 256; ++page) {
+		m_readPages[page] = 0;
+		m_writePages[page] = 0;
+	}
+} // ctor
+
+
+void Mos6502::mapPage(uchar page, const uchar* pRead, uchar* pWrite)
+{
+	m_readPages[page] = pRead;
+	m_writePages[page] = pWrite;
+} // mapPage
+
+
+void Mos6502::reset()
+{
+	m_a = m_x = m_y = 0;
+	m_s = 0xFD;
+	m_p = FlagU bitor FlagI;
+	m_jammed = false;
+	m_irq = false;
+	m_pc = read16(RESET_VECTOR);
+} // reset
+
+
+void Mos6502::jumpSubroutine(ushort address, ushort returnAddress)
+{
+	// Like JSR: the address of the last byte of the call is pushed, RTS adds one.
+	returnAddress--;
+	push(returnAddress >> 8);
+	push(returnAddress bitand 0xFF);
+	m_pc = address;
+	m_jammed = false;
+} // jumpSubroutine
+
+
+Mos6502::StopReason Mos6502::run(quint64 untilCycle)
+{
+	while(m_cycles < untilCycle) {
+		if(int(m_pc) == m_stopAddress)
+			return StopAddress;
+		if(m_irq and not (m_p bitand FlagI)) {
+			interrupt(IRQ_VECTOR, false);
+			m_cycles += 7;
+			continue;
+		}
+		execute();
+		if(m_jammed)
+			return Jammed;
+	}
+	return CyclesDone;
+} // run
+
+
+uint Mos6502::step()
+{
+	const quint64 start = m_cycles;
+	if(m_irq and not (m_p bitand FlagI)) {
+		interrupt(IRQ_VECTOR, false);
+		m_cycles += 7;
+	}
+	else if(not m_jammed)
+		execute();
+	return uint(m_cycles - start);
+} // step
+
+
+uchar Mos6502::read(ushort address)
+{
+	const uchar* pPage = m_readPages[address >> 8];
+	return 0 not_eq pPage ? pPage[address bitand 0xFF] : m_bus.read(address);
+} // read
+
+
+void Mos6502::write(ushort address, uchar value)
+{
+	uchar* pPage = m_writePages[address >> 8];
+	if(0 not_eq pPage)
+		pPage[address bitand 0xFF] = value;
+	else
+		m_bus.write(address, value);
+} // write
+
+
+ushort Mos6502::read16(ushort address)
+{
+	return read(address) bitor (ushort(read(address + 1)) << 8);
+} // read16
+
+
+void Mos6502::push(uchar value)
+{
+	write(0x0100 bitor m_s--, value);
+} // push
+
+
+uchar Mos6502::pull()
+{
+	return read(0x0100 bitor ++m_s);
+} // pull
+
+
+void Mos6502::setNZ(uchar value)
+{
+	m_p = (m_p bitand ~(FlagN bitor FlagZ)) bitor (value bitand FlagN) bitor (value ? 0 : FlagZ);
+} // setNZ
+
+
+ushort Mos6502::fetch16()
+{
+	const ushort address = read16(m_pc);
+	m_pc += 2;
+	return address;
+} // fetch16
+
+
+ushort Mos6502::zeroPageX()
+{
+	return uchar(read(m_pc++) + m_x);
+} // zeroPageX
+
+
+ushort Mos6502::zeroPageY()
+{
+	return uchar(read(m_pc++) + m_y);
+} // zeroPageY
+
+
+ushort Mos6502::absoluteX(bool pageCycle)
+{
+	const ushort base = fetch16();
+	const ushort address = base + m_x;
+	if(pageCycle and (base xor address) > 0xFF)
+		++m_cycles;
+	return address;
+} // absoluteX
+
+
+ushort Mos6502::absoluteY(bool pageCycle)
+{
+	const ushort base = fetch16();
+	const ushort address = base + m_y;
+	if(pageCycle and (base xor address) > 0xFF)
+		++m_cycles;
+	return address;
+} // absoluteY
+
+
+ushort Mos6502::indirectX()
+{
+	const uchar zp = read(m_pc++) + m_x;
+	return read(zp) bitor (ushort(read(uchar(zp + 1))) << 8);
+} // indirectX
+
+
+ushort Mos6502::indirectY(bool pageCycle)
+{
+	const uchar zp = read(m_pc++);
+	const ushort base = read(zp) bitor (ushort(read(uchar(zp + 1))) << 8);
+	const ushort address = base + m_y;
+	if(pageCycle and (base xor address) > 0xFF)
+		++m_cycles;
+	return address;
+} // indirectY
+
+
+void Mos6502::adc(uchar value)
+{
+	const uint carry = m_p bitand FlagC;
+	uint result;
+	m_p and_eq ~(FlagC bitor FlagV bitor FlagN bitor FlagZ);
+	if(m_p bitand FlagD) {
+	// NMOS decimal mode: Z from the binary sum, N and V from the intermediate result.
+		result = (m_a bitand 0x0F) + (value bitand 0x0F) + carry;
+		if(result > 0x09)
+			result += 0x06;
+		result = (result bitand 0x0F) + (m_a bitand 0xF0) + (value bitand 0xF0) + (result > 0x0F ? 0x10 : 0);
+		if(not uchar(m_a + value + carry))
+			m_p or_eq FlagZ;
+		m_p or_eq result bitand FlagN;
+		if(((m_a xor result) bitand 0x80) and not ((m_a xor value) bitand 0x80))
+			m_p or_eq FlagV;
+		if((result bitand 0x1F0) > 0x90)
+			result += 0x60;
+		if((result bitand 0xFF0) > 0xF0)
+			m_p or_eq FlagC;
+	}
+	else {
+		result = m_a + value + carry;
+		if(not uchar(result))
+			m_p or_eq FlagZ;
+		m_p or_eq result bitand FlagN;
+		if(((m_a xor result) bitand (value xor result)) bitand 0x80)
+			m_p or_eq FlagV;
+		if(result > 0xFF)
+			m_p or_eq FlagC;
+	}
+	m_a = uchar(result);
+} // adc
+
+
+void Mos6502::sbc(uchar value)
+{
+	const uint borrow = (m_p bitand FlagC) ? 0 : 1;
+	const uint result = uint(m_a) - value - borrow;
+	m_p and_eq ~(FlagC bitor FlagV bitor FlagN bitor FlagZ);
+	// The flags are those of the binary subtraction, also in decimal mode.
+	setNZ(uchar(result));
+	if(result < 0x100)
+		m_p or_eq FlagC;
+	if(((m_a xor result) bitand (m_a xor value)) bitand 0x80)
+		m_p or_eq FlagV;
+	if(m_p bitand FlagD) {
+		uint decimal = (m_a bitand 0x0F) - (value bitand 0x0F) - borrow;
+		if(decimal bitand 0x10)
+			decimal = ((decimal - 0x06) bitand 0x0F) bitor ((m_a bitand 0xF0) - (value bitand 0xF0) - 0x10);
+		else
+			decimal = (decimal bitand 0x0F) bitor ((m_a bitand 0xF0) - (value bitand 0xF0));
+		if(decimal bitand 0x100)
+			decimal -= 0x60;
+		m_a = uchar(decimal);
+	}
+	else
+		m_a = uchar(result);
+} // sbc
+
+
+void Mos6502::compare(uchar reg, uchar value)
+{
+	setNZ(uchar(reg - value));
+	if(reg >= value)
+		m_p or_eq FlagC;
+	else
+		m_p and_eq ~FlagC;
+} // compare
+
+
+uchar Mos6502::asl(uchar value)
+{
+	m_p = (m_p bitand ~FlagC) bitor (value >> 7);
+	value <<= 1;
+	setNZ(value);
+	return value;
+} // asl
+
+
+uchar Mos6502::lsr(uchar value)
+{
+	m_p = (m_p bitand ~FlagC) bitor (value bitand FlagC);
+	value >>= 1;
+	setNZ(value);
+	return value;
+} // lsr
+
+
+uchar Mos6502::rol(uchar value)
+{
+	const uchar carry = m_p bitand FlagC;
+	m_p = (m_p bitand ~FlagC) bitor (value >> 7);
+	value = (value << 1) bitor carry;
+	setNZ(value);
+	return value;
+} // rol
+
+
+uchar Mos6502::ror(uchar value)
+{
+	const uchar carry = (m_p bitand FlagC) << 7;
+	m_p = (m_p bitand ~FlagC) bitor (value bitand FlagC);
+	value = (value >> 1) bitor carry;
+	setNZ(value);
+	return value;
+} // ror
+
+
+void Mos6502::branch(bool condition)
+{
+	const signed char offset = static_cast<signed char>(read(m_pc++));
+	if(not condition)
+		return;
+	const ushort target = m_pc + offset;
+	m_cycles += (target xor m_pc) > 0xFF ? 2 : 1;
+	m_pc = target;
+} // branch
+
+
+void Mos6502::interrupt(ushort vector, bool isBreak)
+{
+	push(m_pc >> 8);
+	push(m_pc bitand 0xFF);
+	// The B flag only exists on the stack: set by BRK, clear for an interrupt.
+	push((m_p bitand ~FlagB) bitor FlagU bitor (isBreak ? FlagB : 0));
+	m_p or_eq FlagI;
+	m_pc = read16(vector);
+} // interrupt
+
+
+// Operations shared by the opcodes of all addressing modes. Read operations take the effective address, the
+// read-modify-write ones (and their undocumented combinations) write the modified value back.
+#define OP_READ(OPCODE, ADDRESS, ACTION) \
+	case OPCODE: { const uchar value = read(ADDRESS); ACTION; } break
+#define OP_STORE(OPCODE, ADDRESS, VALUE) \
+	case OPCODE: write(ADDRESS, VALUE); break
+#define OP_MODIFY(OPCODE, ADDRESS, MODIFY, ACTION) \
+	case OPCODE: { const ushort address = ADDRESS; uchar value = read(address); value = MODIFY; write(address, value); ACTION; } break
+
+// The eight addressing modes of the ALU (and undocumented) opcode group.
+#define OPS_READ(BASE, ACTION) \
+	OP_READ(BASE + 0x09, m_pc++, ACTION); \
+	OP_READ(BASE + 0x05, read(m_pc++), ACTION); \
+	OP_READ(BASE + 0x15, zeroPageX(), ACTION); \
+	OP_READ(BASE + 0x0D, fetch16(), ACTION); \
+	OP_READ(BASE + 0x1D, absoluteX(true), ACTION); \
+	OP_READ(BASE + 0x19, absoluteY(true), ACTION); \
+	OP_READ(BASE + 0x01, indirectX(), ACTION); \
+	OP_READ(BASE + 0x11, indirectY(true), ACTION)
+#define OPS_MODIFY_UNDOC(BASE, MODIFY, ACTION) \
+	OP_MODIFY(BASE + 0x07, read(m_pc++), MODIFY, ACTION); \
+	OP_MODIFY(BASE + 0x17, zeroPageX(), MODIFY, ACTION); \
+	OP_MODIFY(BASE + 0x0F, fetch16(), MODIFY, ACTION); \
+	OP_MODIFY(BASE + 0x1F, absoluteX(false), MODIFY, ACTION); \
+	OP_MODIFY(BASE + 0x1B, absoluteY(false), MODIFY, ACTION); \
+	OP_MODIFY(BASE + 0x03, indirectX(), MODIFY, ACTION); \
+	OP_MODIFY(BASE + 0x13, indirectY(false), MODIFY, ACTION)
+#define OPS_MODIFY(BASE, MODIFY) \
+	OP_MODIFY(BASE + 0x06, read(m_pc++), MODIFY, ;); \
+	OP_MODIFY(BASE + 0x16, zeroPageX(), MODIFY, ;); \
+	OP_MODIFY(BASE + 0x0E, fetch16(), MODIFY, ;); \
+	OP_MODIFY(BASE + 0x1E, absoluteX(false), MODIFY, ;)
+
+
+void Mos6502::execute()
+{
+	const uchar opcode = read(m_pc++);
+	m_cycles += s_cycles[opcode];
+	++m_instructions;
+
+	switch(opcode) {
+		// Loads, stores and the ALU.
+		OPS_READ(0x00, m_a or_eq value; setNZ(m_a));	// ORA
+		OPS_READ(0x20, m_a and_eq value; setNZ(m_a));	// AND
+		OPS_READ(0x40, m_a xor_eq value; setNZ(m_a));	// EOR
+		OPS_READ(0x60, adc(value));	// ADC
+		OPS_READ(0xA0, m_a = value; setNZ(m_a));	// LDA
+		OPS_READ(0xC0, compare(m_a, value));	// CMP
+		OPS_READ(0xE0, sbc(value));	// SBC
+		OP_READ(0xEB, m_pc++, sbc(value));	// SBC (undocumented)
+
+		OP_STORE(0x85, read(m_pc++), m_a);	// STA
+		OP_STORE(0x95, zeroPageX(), m_a);
+		OP_STORE(0x8D, fetch16(), m_a);
+		OP_STORE(0x9D, absoluteX(false), m_a);
+		OP_STORE(0x99, absoluteY(false), m_a);
+		OP_STORE(0x81, indirectX(), m_a);
+		OP_STORE(0x91, indirectY(false), m_a);
+		OP_STORE(0x86, read(m_pc++), m_x);	// STX
+		OP_STORE(0x96, zeroPageY(), m_x);
+		OP_STORE(0x8E, fetch16(), m_x);
+		OP_STORE(0x84, read(m_pc++), m_y);	// STY
+		OP_STORE(0x94, zeroPageX(), m_y);
+		OP_STORE(0x8C, fetch16(), m_y);
+
+		OP_READ(0xA2, m_pc++, m_x = value; setNZ(m_x));	// LDX
+		OP_READ(0xA6, read(m_pc++), m_x = value; setNZ(m_x));
+		OP_READ(0xB6, zeroPageY(), m_x = value; setNZ(m_x));
+		OP_READ(0xAE, fetch16(), m_x = value; setNZ(m_x));
+		OP_READ(0xBE, absoluteY(true), m_x = value; setNZ(m_x));
+		OP_READ(0xA0, m_pc++, m_y = value; setNZ(m_y));	// LDY
+		OP_READ(0xA4, read(m_pc++), m_y = value; setNZ(m_y));
+		OP_READ(0xB4, zeroPageX(), m_y = value; setNZ(m_y));
+		OP_READ(0xAC, fetch16(), m_y = value; setNZ(m_y));
+		OP_READ(0xBC, absoluteX(true), m_y = value; setNZ(m_y));
+
+		OP_READ(0xE0, m_pc++, compare(m_x, value));	// CPX
+		OP_READ(0xE4, read(m_pc++), compare(m_x, value));
+		OP_READ(0xEC, fetch16(), compare(m_x, value));
+		OP_READ(0xC0, m_pc++, compare(m_y, value));	// CPY
+		OP_READ(0xC4, read(m_pc++), compare(m_y, value));
+		OP_READ(0xCC, fetch16(), compare(m_y, value));
+
+		OP_READ(0x24, read(m_pc++), m_p = (m_p bitand ~(FlagN bitor FlagV bitor FlagZ))	// BIT
+						bitor (value bitand (FlagN bitor FlagV)) bitor ((m_a bitand value) ? 0 : FlagZ));
+		OP_READ(0x2C, fetch16(), m_p = (m_p bitand ~(FlagN bitor FlagV bitor FlagZ))
+						bitor (value bitand (FlagN bitor FlagV)) bitor ((m_a bitand value) ? 0 : FlagZ));
+
+		// Shifts, increments and decrements.
+		OPS_MODIFY(0x00, asl(value));	// ASL
+		OPS_MODIFY(0x20, rol(value));	// ROL
+		OPS_MODIFY(0x40, lsr(value));	// LSR
+		OPS_MODIFY(0x60, ror(value));	// ROR
+		OPS_MODIFY(0xC0, uchar(value - 1); setNZ(value));	// DEC
+		OPS_MODIFY(0xE0, uchar(value + 1); setNZ(value));	// INC
+		case 0x0A: m_a = asl(m_a); break;
+		case 0x2A: m_a = rol(m_a); break;
+		case 0x4A: m_a = lsr(m_a); break;
+		case 0x6A: m_a = ror(m_a); break;
+
+		// Register transfers, increments and decrements.
+		case 0xAA: m_x = m_a; setNZ(m_x); break;	// TAX
+		case 0x8A: m_a = m_x; setNZ(m_a); break;	// TXA
+		case 0xA8: m_y = m_a; setNZ(m_y); break;	// TAY
+		case 0x98: m_a = m_y; setNZ(m_a); break;	// TYA
+		case 0xBA: m_x = m_s; setNZ(m_x); break;	// TSX
+		case 0x9A: m_s = m_x; break;	// TXS
+		case 0xE8: setNZ(++m_x); break;	// INX
+		case 0xCA: setNZ(--m_x); break;	// DEX
+		case 0xC8: setNZ(++m_y); break;	// INY
+		case 0x88: setNZ(--m_y); break;	// DEY
+
+		// Flags.
+		case 0x18: m_p and_eq ~FlagC; break;	// CLC
+		case 0x38: m_p or_eq FlagC; break;	// SEC
+		case 0x58: m_p and_eq ~FlagI; break;	// CLI
+		case 0x78: m_p or_eq FlagI; break;	// SEI
+		case 0xB8: m_p and_eq ~FlagV; break;	// CLV
+		case 0xD8: m_p and_eq ~FlagD; break;	// CLD
+		case 0xF8: m_p or_eq FlagD; break;	// SED
+
+		// Stack.
+		case 0x48: push(m_a); break;	// PHA
+		case 0x68: m_a = pull(); setNZ(m_a); break;	// PLA
+		case 0x08: push(m_p bitor FlagB bitor FlagU); break;	// PHP
+		case 0x28: m_p = (pull() bitand ~FlagB) bitor FlagU; break;	// PLP
+
+		// Jumps, calls and branches.
+		case 0x4C: m_pc = fetch16(); break;	// JMP abs
+		case 0x6C: {	// JMP (ind), with the page wrap of the NMOS
+			const ushort pointer = fetch16();
+			m_pc = read(pointer) bitor (ushort(read((pointer bitand 0xFF00) bitor uchar(pointer + 1))) << 8);
+		}
+			break;
+		case 0x20: {	// JSR
+			const ushort target = read16(m_pc);
+			++m_pc;
+			push(m_pc >> 8);
+			push(m_pc bitand 0xFF);
+			m_pc = target;
+		}
+			break;
+		case 0x60:	// RTS
+			m_pc = pull();
+			m_pc or_eq ushort(pull()) << 8;
+			++m_pc;
+			break;
+		case 0x40:	// RTI
+			m_p = (pull() bitand ~FlagB) bitor FlagU;
+			m_pc = pull();
+			m_pc or_eq ushort(pull()) << 8;
+			break;
+		case 0x00:	// BRK
+			++m_pc;
+			interrupt(IRQ_VECTOR, true);
+			break;
+		case 0x10: branch(not (m_p bitand FlagN)); break;	// BPL
+		case 0x30: branch(m_p bitand FlagN); break;	// BMI
+		case 0x50: branch(not (m_p bitand FlagV)); break;	// BVC
+		case 0x70: branch(m_p bitand FlagV); break;	// BVS
+		case 0x90: branch(not (m_p bitand FlagC)); break;	// BCC
+		case 0xB0: branch(m_p bitand FlagC); break;	// BCS
+		case 0xD0: branch(not (m_p bitand FlagZ)); break;	// BNE
+		case 0xF0: branch(m_p bitand FlagZ); break;	// BEQ
+
+		case 0xEA: break;	// NOP
+
+		// Undocumented: combined read-modify-write and ALU operations.
+		OPS_MODIFY_UNDOC(0x00, asl(value), m_a or_eq value; setNZ(m_a));	// SLO
+		OPS_MODIFY_UNDOC(0x20, rol(value), m_a and_eq value; setNZ(m_a));	// RLA
+		OPS_MODIFY_UNDOC(0x40, lsr(value), m_a xor_eq value; setNZ(m_a));	// SRE
+		OPS_MODIFY_UNDOC(0x60, ror(value), adc(value));	// RRA
+		OPS_MODIFY_UNDOC(0xC0, uchar(value - 1), compare(m_a, value));	// DCP
+		OPS_MODIFY_UNDOC(0xE0, uchar(value + 1), sbc(value));	// ISC
+
+		OP_READ(0xA7, read(m_pc++), m_a = m_x = value; setNZ(value));	// LAX
+		OP_READ(0xB7, zeroPageY(), m_a = m_x = value; setNZ(value));
+		OP_READ(0xAF, fetch16(), m_a = m_x = value; setNZ(value));
+		OP_READ(0xBF, absoluteY(true), m_a = m_x = value; setNZ(value));
+		OP_READ(0xA3, indirectX(), m_a = m_x = value; setNZ(value));
+		OP_READ(0xB3, indirectY(true), m_a = m_x = value; setNZ(value));
+		OP_READ(0xAB, m_pc++, m_a = m_x = value; setNZ(value));	// LAX imm (unstable)
+		OP_STORE(0x87, read(m_pc++), m_a bitand m_x);	// SAX
+		OP_STORE(0x97, zeroPageY(), m_a bitand m_x);
+		OP_STORE(0x8F, fetch16(), m_a bitand m_x);
+		OP_STORE(0x83, indirectX(), m_a bitand m_x);
+
+		OP_READ(0x0B, m_pc++, m_a and_eq value; setNZ(m_a);	// ANC
+						m_p = (m_p bitand ~FlagC) bitor (m_a >> 7));
+		OP_READ(0x2B, m_pc++, m_a and_eq value; setNZ(m_a); m_p = (m_p bitand ~FlagC) bitor (m_a >> 7));
+		OP_READ(0x4B, m_pc++, m_a = lsr(m_a bitand value));	// ALR
+		OP_READ(0x6B, m_pc++, m_a = ((m_a bitand value) >> 1) bitor ((m_p bitand FlagC) << 7);	// ARR
+						setNZ(m_a);
+						m_p = (m_p bitand ~(FlagC bitor FlagV)) bitor ((m_a >> 6) bitand FlagC)
+						bitor (((m_a >> 6) xor (m_a >> 5)) bitand 1 ? FlagV : 0));
+		OP_READ(0xCB, m_pc++, const uchar ax = m_a bitand m_x; m_x = ax - value;	// SBX
+						setNZ(m_x); m_p = (m_p bitand ~FlagC) bitor (ax >= value ? FlagC : 0));
+		OP_READ(0x8B, m_pc++, m_a = (m_a bitor 0xEE) bitand m_x bitand value; setNZ(m_a));	// ANE (unstable)
+		OP_READ(0xBB, absoluteY(true), m_a = m_x = m_s = value bitand m_s; setNZ(m_a));	// LAS
+
+		// The stores ANDing with the high byte of the address plus one (unstable on page crossings).
+		case 0x9C: {	// SHY
+			const ushort address = absoluteX(false);
+			write(address, m_y bitand ((address >> 8) + 1));
+		}
+			break;
+		case 0x9E: {	// SHX
+			const ushort address = absoluteY(false);
+			write(address, m_x bitand ((address >> 8) + 1));
+		}
+			break;
+		case 0x9F: {	// SHA abs,Y
+			const ushort address = absoluteY(false);
+			write(address, m_a bitand m_x bitand ((address >> 8) + 1));
+		}
+			break;
+		case 0x93: {	// SHA (ind),Y
+			const ushort address = indirectY(false);
+			write(address, m_a bitand m_x bitand ((address >> 8) + 1));
+		}
+			break;
+		case 0x9B: {	// TAS
+			const ushort address = absoluteY(false);
+			m_s = m_a bitand m_x;
+			write(address, m_s bitand ((address >> 8) + 1));
+		}
+			break;
+
+		// Undocumented NOPs, reading their operands.
+		case 0x1A: case 0x3A: case 0x5A: case 0x7A: case 0xDA: case 0xFA:
+			break;
+		case 0x80: case 0x82: case 0x89: case 0xC2: case 0xE2:
+			++m_pc;
+			break;
+		OP_READ(0x04, read(m_pc++), (void)value);
+		OP_READ(0x44, read(m_pc++), (void)value);
+		OP_READ(0x64, read(m_pc++), (void)value);
+		OP_READ(0x14, zeroPageX(), (void)value);
+		OP_READ(0x34, zeroPageX(), (void)value);
+		OP_READ(0x54, zeroPageX(), (void)value);
+		OP_READ(0x74, zeroPageX(), (void)value);
+		OP_READ(0xD4, zeroPageX(), (void)value);
+		OP_READ(0xF4, zeroPageX(), (void)value);
+		OP_READ(0x0C, fetch16(), (void)value);
+		OP_READ(0x1C, absoluteX(true), (void)value);
+		OP_READ(0x3C, absoluteX(true), (void)value);
+		OP_READ(0x5C, absoluteX(true), (void)value);
+		OP_READ(0x7C, absoluteX(true), (void)value);
+		OP_READ(0xDC, absoluteX(true), (void)value);
+		OP_READ(0xFC, absoluteX(true), (void)value);
+
+		// JAM: the CPU stops until reset.
+		default:
+			--m_pc;
+			m_jammed = true;
+			break;
+	}
+} // execute
@@ -0,0 +1,169 @@
+#ifndef MOS6502_HPP
+#define MOS6502_HPP
+
+#include <QtGlobal>
+
+// Interpreter for the NMOS 6502 as in the 1541 (a 6502 at 1 MHz), including decimal mode and the undocumented
+// opcodes that drive code is known to use. One switch over the opcode, compiled to a jump table.
+// Memory is mapped per 256 byte page: a page with a pointer is read or written directly, the others go through the
+// bus (I/O like the VIAs, unmapped areas, writes to ROM).
+// Cycles are counted per instruction, with the extra cycles for page crossings and taken branches.
+class Mos6502
+{
+public:
+	struct IBus
+	{
+		virtual uchar read(ushort address) = 0;
+		virtual void write(ushort address, uchar value) = 0;
+	};
+
+	enum Flags {
+		FlagC = 0x01,
+		FlagZ = 0x02,
+		FlagI = 0x04,
+		FlagD = 0x08,
+		FlagB = 0x10,
+		FlagU = 0x20,
+		FlagV = 0x40,
+		FlagN = 0x80
+	};
+
+	enum StopReason {
+		CyclesDone,			// the given number of cycles has passed.
+		StopAddress,		// the stop address was reached.
+		Jammed					// one of the JAM opcodes halted the CPU.
+	};
+
+	explicit Mos6502(IBus& bus);
+
+	// Maps a page for direct access, 0 makes the accesses go through the bus.
+	void mapPage(uchar page, const uchar* pRead, uchar* pWrite);
+
+	const uchar* readPage(uchar page) const
+	{
+		return m_readPages[page];
+	}
+
+	uchar* writePage(uchar page) const
+	{
+		return m_writePages[page];
+	}
+
+	// Reset: registers to power up state, PC from the reset vector.
+	void reset();
+	// Calls the subroutine at the address, its RTS returns to the return address.
+	void jumpSubroutine(ushort address, ushort returnAddress);
+	// IRQ line level, taken before the next instruction when not masked.
+	void setIrq(bool active)
+	{
+		m_irq = active;
+	}
+
+	// Runs until the cycle count gets to the given one, the PC gets to the stop address or the CPU jams.
+	StopReason run(quint64 untilCycle);
+	// Executes one instruction (or takes a pending interrupt), returns the cycles it took.
+	uint step();
+
+	// Stops run() when the PC gets here, -1 for none.
+	void setStopAddress(int address)
+	{
+		m_stopAddress = address;
+	}
+
+	quint64 cycles() const
+	{
+		return m_cycles;
+	}
+
+	quint64 instructions() const
+	{
+		return m_instructions;
+	}
+
+	ushort pc() const
+	{
+		return m_pc;
+	}
+
+	void setPc(ushort pc)
+	{
+		m_pc = pc;
+	}
+
+	uchar a() const
+	{
+		return m_a;
+	}
+
+	uchar x() const
+	{
+		return m_x;
+	}
+
+	uchar y() const
+	{
+		return m_y;
+	}
+
+	uchar s() const
+	{
+		return m_s;
+	}
+
+	uchar p() const
+	{
+		return m_p;
+	}
+
+	bool isJammed() const
+	{
+		return m_jammed;
+	}
+
+private:
+	inline uchar read(ushort address);
+	inline void write(ushort address, uchar value);
+	inline ushort read16(ushort address);
+	inline void push(uchar value);
+	inline uchar pull();
+	inline void setNZ(uchar value);
+	inline ushort fetch16();
+
+	// Addressing modes, returning the effective address. The indexed ones count the page crossing cycle when asked.
+	inline ushort zeroPageX();
+	inline ushort zeroPageY();
+	inline ushort absoluteX(bool pageCycle);
+	inline ushort absoluteY(bool pageCycle);
+	inline ushort indirectX();
+	inline ushort indirectY(bool pageCycle);
+
+	// Operations.
+	inline void adc(uchar value);
+	inline void sbc(uchar value);
+	inline void compare(uchar reg, uchar value);
+	inline uchar asl(uchar value);
+	inline uchar lsr(uchar value);
+	inline uchar rol(uchar value);
+	inline uchar ror(uchar value);
+	inline void branch(bool condition);
+	void interrupt(ushort vector, bool isBreak);
+	inline void execute();
+
+	IBus& m_bus;
+	const uchar* m_readPages[256];
+	uchar* m_writePages[256];
+
+	ushort m_pc;
+	uchar m_a;
+	uchar m_x;
+	uchar m_y;
+	uchar m_s;
+	uchar m_p;
+	bool m_irq;
+	bool m_jammed;
+	int m_stopAddress;
+	quint64 m_cycles;
+	quint64 m_instructions;
+};
+
+#endif // MOS6502_HPP
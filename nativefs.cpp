@@ -1,17 +1,12 @@
 #include "nativefs.hpp"
 #include "logger.hpp"
+#include "imagecache.hpp"
 #include <QDir>
-#include <math.h>
 
 using namespace Logging;
 
-namespace {
-const QString strDir("DIR");
-const QString strPrg("PRG");
-}
-
 NativeFS::NativeFS()
-	: m_listDirectories(false)
+	: m_listDirectories(false), m_listingPhase(ListDone), m_listingPos(0)
 {
 } // ctor
 
@@ -31,8 +26,15 @@ bool NativeFS::mountHostImage(const QString& fileName)
 
 void NativeFS::unmountHostImage()
 {
-	if(not m_hostFile.fileName().isEmpty() and m_hostFile.isOpen())
+	if(not m_hostFile.fileName().isEmpty() and m_hostFile.isOpen()) {
+		const bool written = m_hostFile.openMode() bitand QIODevice::WriteOnly;
 		m_hostFile.close();
+		// A file written changes the listing of its directory.
+		if(written)
+			m_dirCache.updateFile(m_hostFile.fileName());
+	}
+	if(m_archiveFile.isOpen())
+		m_archiveFile.close();
 	m_status = NOT_READY;
 } // unmountHostImage
 
@@ -40,8 +42,19 @@ void NativeFS::unmountHostImage()
 bool NativeFS::fopen(const QString& fileName)
 {
 	unmountHostImage();
-	m_hostFile.setFileName(fileName);
-	bool success = m_hostFile.open(QIODevice::ReadOnly);
+	m_hostFile.setFileName(hostPath(fileName));
+	bool success = false;
+	QString archivePath, name;
+	if(Archive::splitPath(m_hostFile.fileName(), archivePath, name)) {
+		// Decompressed in memory (and cached, it is probably read again).
+		const QByteArray contents(imageCache().image(m_hostFile.fileName()));
+		if(not contents.isNull()) {
+			m_archiveFile.setData(contents);
+			success = m_archiveFile.open(QIODevice::ReadOnly);
+		}
+	}
+	else
+		success = m_hostFile.open(QIODevice::ReadOnly);
 	m_status = success ? FILE_OPEN : NOT_READY;
 
 	return success;
@@ -51,6 +64,8 @@ bool NativeFS::fopen(const QString& fileName)
 CBM::IOErrorMessage NativeFS::fopenWrite(const QString &fileName, bool replaceMode)
 {
 	unmountHostImage();
+	if(inArchive())
+		return CBM::ErrWriteProtectOn;
 	m_hostFile.setFileName(fileName);
 	if(m_hostFile.exists() and not replaceMode)
 		return CBM::ErrFileExists;
@@ -75,7 +90,7 @@ CBM::IOErrorMessage NativeFS::fopenWrite(const QString &fileName, bool replaceMo
 char NativeFS::getc()
 {
 	char theByte;
-	qint64 numRead(m_hostFile.read(&theByte, 1));
+	qint64 numRead(openedFile().read(&theByte, 1));
 	if(numRead < 1) // shouldn't happen?
 		m_status = FILE_EOF;
 
@@ -83,6 +98,18 @@ char NativeFS::getc()
 } // getc
 
 
+int NativeFS::read(char* dst, int max)
+{
+	qint64 numRead(openedFile().read(dst, max));
+	if(numRead < 0) { // shouldn't happen?
+		m_status = FILE_EOF;
+		return 0;
+	}
+
+	return numRead;
+} // read
+
+
 const QString NativeFS::openedFileName() const
 {
 	return m_hostFile.fileName();
@@ -91,31 +118,58 @@ const QString NativeFS::openedFileName() const
 
 ushort NativeFS::openedFileSize() const
 {
-	return m_hostFile.size();
+	return openedFile().size();
 } // openedFileSize
 
 
+QIODevice& NativeFS::openedFile()
+{
+	if(m_archiveFile.isOpen())
+		return m_archiveFile;
+	return m_hostFile;
+} // openedFile
+
+
+const QIODevice& NativeFS::openedFile() const
+{
+	if(m_archiveFile.isOpen())
+		return m_archiveFile;
+	return m_hostFile;
+} // openedFile
+
+
 bool NativeFS::fileExists(const QString &filePath)
 {
+	if(inArchive())
+		return m_archive.find(m_archiveDir + filePath) >= 0;
 	return QFile::exists(filePath);
 } // fileExists
 
 
 CBM::IOErrorMessage NativeFS::renameFile(const QString &oldName, const QString &newName)
 {
-	return QFile::rename(oldName, newName) ? CBM::ErrOK : CBM::ErrFileNotFound;
+	if(inArchive())
+		return CBM::ErrWriteProtectOn;
+	const bool renamed = QFile::rename(oldName, newName);
+	m_dirCache.updateFile(oldName);
+	m_dirCache.updateFile(newName);
+	return renamed ? CBM::ErrOK : CBM::ErrFileNotFound;
 } // renameFile
 
 
 bool NativeFS::deleteFile(const QString &fileName)
 {
-	return QFile::remove(fileName);
+	if(inArchive())
+		return false;
+	const bool removed = QFile::remove(fileName);
+	m_dirCache.updateFile(fileName);
+	return removed;
 } // deleteFile
 
 
 bool NativeFS::isEOF() const
 {
-	return m_hostFile.atEnd();
+	return openedFile().atEnd();
 } // isEOF
 
 
@@ -135,37 +189,174 @@ bool NativeFS::close()
 
 CBM::IOErrorMessage NativeFS::copyFiles(const QStringList &sourceNames, const QString &destName)
 {
+	if(inArchive())
+		return CBM::ErrWriteProtectOn;
 	QFile destFile(destName);
 	if(not destFile.open(QFile::WriteOnly))
 		return CBM::ErrWriteProtectOn; // TODO: Maybe find out better reason for error.
 
 	// copy (append) each file from the list.
+	CBM::IOErrorMessage result = CBM::ErrOK;
 	foreach(const QString& source, sourceNames) {
 		QFile sourceFile(source);
 		if(not sourceFile.open(QFile::ReadOnly)) {
 			destFile.close();
 			destFile.remove();
-			return CBM::ErrFileNotFound;
+			result = CBM::ErrFileNotFound;
+			break;
 		}
 		destFile.write(sourceFile.readAll());
 		sourceFile.close();
 	}
 	destFile.close();
-	return CBM::ErrOK;
+	m_dirCache.updateFile(destName);
+	return result;
 } // copyFiles
 
 
 bool NativeFS::sendListing(ISendLine& cb)
 {
-	QDir dir(QDir::current());
-	QString dirName(dir.dirName().toUpper());
+	bool success = openListing();
+	while(listNextLine(cb));
+
+	return success;
+} // sendListing
+
+
+bool NativeFS::openListing()
+{
+	m_listingPhase = ListHeader;
+	m_listing.clear();
+	m_listingPos = 0;
+
+	return true;
+} // openListing
+
+
+bool NativeFS::listNextLine(ISendLine& cb)
+{
+	forever {
+		switch(m_listingPhase) {
+			case ListHeader:
+				sendListingHeader(cb);
+				m_listing = inArchive() ? readArchiveListing() : m_dirCache.entries(QDir::currentPath());
+				m_listingPos = 0;
+				m_listingPatterns.clear();
+				foreach(const QString& filter, listingFilters())
+					m_listingPatterns.append(QRegExp(filter, Qt::CaseInsensitive, QRegExp::Wildcard));
+				m_listingPhase = ListEntries;
+				return true;
+
+			case ListEntries:
+				while(m_listingPos < m_listing.count()) {
+					const DirectoryCache::Entry& entry(m_listing.at(m_listingPos++));
+					if(isListed(entry)) {
+						cb.send(entry.blocks, entry.line);
+						return true;
+					}
+				}
+				closeListing();
+				break;
+
+			case ListDone:
+				return false;
+		}
+	}
+} // listNextLine
+
+
+void NativeFS::closeListing()
+{
+	m_listingPhase = ListDone;
+	m_listing.clear();
+} // closeListing
+
+
+// The listing filters, with the gzipped files of the same kinds and the zip archives too.
+QStringList NativeFS::listingFilters() const
+{
+	QStringList filters(m_filters.split(',', QString::SkipEmptyParts));
+	if(filters.isEmpty())
+		return filters;
+	const int count = filters.count();
+	for(int i = 0; i < count; ++i)
+		filters.append(filters.at(i) + ".GZ");
+	filters.append("*.ZIP");
+
+	return filters;
+} // listingFilters
+
+
+// Directories if they are listed at all, files if they match any of the filters (or there are none). Then either must
+// match the listing filter of the CBM, by the name and the type shown.
+bool NativeFS::isListed(const DirectoryCache::Entry& entry) const
+{
+	if(entry.isDir) {
+		if(not m_listDirectories)
+			return false;
+	}
+	else if(not m_listingPatterns.isEmpty()) {
+		bool matches = false;
+		foreach(const QRegExp& pattern, m_listingPatterns) {
+			if(pattern.exactMatch(entry.name)) {
+				matches = true;
+				break;
+			}
+		}
+		if(not matches)
+			return false;
+	}
+
+	return listingFilter().matches(entry.name, entry.type);
+} // isListed
+
+
+// The entries of the current directory in the archive, directories first. A directory need not have its own entry in
+// the archive, it is there if any file is in it.
+DirectoryCache::Entries NativeFS::readArchiveListing()
+{
+	// The archive may have changed since it was entered.
+	const QString archivePath(m_archive.path());
+	if(not m_archive.open(archivePath)) {
+		Log("NATIVEFS", warning, QString("Archive %1 can no longer be read.").arg(archivePath));
+		m_archiveDir.clear();
+		return DirectoryCache::Entries();
+	}
+
+	QStringList dirs;
+	DirectoryCache::Entries files;
+	foreach(const Archive::ZipArchive::Entry& entry, m_archive.entries()) {
+		if(not entry.name.startsWith(m_archiveDir))
+			continue;
+		const QString name(entry.name.mid(m_archiveDir.length()));
+		const int slash = name.indexOf('/');
+		if(slash >= 0) {
+			const QString dir(name.left(slash));
+			if(not dir.isEmpty() and not dirs.contains(dir))
+				dirs.append(dir);
+		}
+		else if(not name.isEmpty())
+			files.append(DirectoryCache::makeEntry(name, entry.size, false, false));
+	}
+
+	// Up, out of the archive from its top.
+	DirectoryCache::Entries listing;
+	listing.append(DirectoryCache::makeEntry("..", 0, true, true));
+	foreach(const QString& dir, dirs)
+		listing.append(DirectoryCache::makeEntry(dir, 0, true, true));
+
+	return listing + files;
+} // readArchiveListing
+
+
+void NativeFS::sendListingHeader(ISendLine& cb)
+{
+	QString dirName(inArchive() ? QFileInfo(currentPath()).fileName() : QDir::current().dirName());
+	dirName = dirName.toUpper();
 	dirName.truncate(23);
 	dirName = dirName.leftJustified(23);
 
-	QStringList filters = m_filters.split(',', QString::SkipEmptyParts);
-
 	QString line("\x12\""); // Invert face, "
-	QString diskLabel("NATIVE FS");
 	uchar i;
 	for(i = 2; i < 25; i++) {
 		uchar c = dirName.at(0).toLatin1();
@@ -183,34 +374,8 @@ bool NativeFS::sendListing(ISendLine& cb)
 	line[i] = QChar('"').toLatin1();
 
 	cb.send(0, line);
-
-	QFileInfoList list(dir.entryInfoList(filters, QDir::NoDot bitor QDir::Files
-																			 bitor (m_listDirectories ? QDir::AllDirs : QDir::Files), QDir::Name bitor QDir::DirsFirst));
-
-	Log("NATIVEFS", info, QString("Listing %1 entrie(s) to CBM.").arg(QString::number(list.count())));
-	while(not list.isEmpty()) {
-		QFileInfo entry = list.first();
-		list.removeFirst();
-		line = "   \"";
-		line.append(entry.fileName().toUpper());
-		line.append("\" ");
-		int spaceFill = 16 - entry.fileName().length();
-		if(spaceFill > 0) {
-			QString spaceAdd(spaceFill, ' ');
-			line += spaceAdd;
-		}
-		if(entry.isDir())
-			line.append(strDir);
-		else
-			line.append(strPrg);
-
-		ushort fileSize = entry.size() / 1024;
-		// Send initial spaces (offset) according to file size
-		cb.send(fileSize, line.mid((int)log10((double)fileSize)));
-	}
-
-	return true;
-} // sendListing
+	Log("NATIVEFS", info, QString("Listing %1 to CBM.").arg(currentPath()));
+} // sendListingHeader
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -222,7 +387,7 @@ bool NativeFS::sendMediaInfo(ISendLine &cb)
 	// TODO: Improve this with information about the file system type AND, usage and free data.
 	Log("NATIVEFS", info, "sendMediaInfo.");
 	cb.send(0, QString("NATIVE FS ACTIVE."));
-	cb.send(1, QString("CURRENT DIR: %1").arg(QDir::currentPath().toUpper()));
+	cb.send(1, QString("CURRENT DIR: %1").arg(currentPath().toUpper()));
 	cb.send(2, "HELLO FROM ARDUINO!");
 
 	return true;
@@ -237,6 +402,28 @@ FileDriverBase::FSStatus NativeFS::status() const
 
 bool NativeFS::setCurrentDirectory(const QString& dir)
 {
+	if(inArchive()) {
+		if(not QDir::isAbsolutePath(dir))
+			return changeArchiveDirectory(dir);
+		leaveArchive();
+	}
+
+	// A zip archive, or a directory in one.
+	QString archivePath(dir), archiveDir;
+	if((Archive::isZip(dir) and QFileInfo(dir).isFile()) or Archive::splitPath(dir, archivePath, archiveDir)) {
+		if(not Archive::isZip(archivePath) or not m_archive.open(QFileInfo(archivePath).absoluteFilePath())) {
+			Log("NATIVEFS", warning, QString("Failed entering archive: %1").arg(archivePath));
+			return false;
+		}
+		m_archiveDir.clear();
+		if(not archiveDir.isEmpty() and not changeArchiveDirectory(archiveDir)) {
+			leaveArchive();
+			return false;
+		}
+		Log("NATIVEFS", success, QString("Changing current directory to: %1").arg(currentPath()));
+		return true;
+	}
+
 	bool wasSuccess = QDir::setCurrent(dir);
 	if(wasSuccess)
 		Log("NATIVEFS", success, QString("Changing current directory to: %1").arg(QDir::currentPath()));
@@ -247,6 +434,81 @@ bool NativeFS::setCurrentDirectory(const QString& dir)
 } // setCurrentDirectory
 
 
+// A directory relative to the current one in the archive.
+bool NativeFS::changeArchiveDirectory(const QString& dir)
+{
+	QString archiveDir(m_archiveDir);
+	const QStringList parts(dir.split('/', QString::SkipEmptyParts));
+	for(int i = 0; i < parts.count(); ++i) {
+		const QString& part(parts.at(i));
+		if(".." == part) {
+			if(archiveDir.isEmpty()) {
+				// Up from the top of the archive is the directory it is in, where the rest of the path goes on.
+				leaveArchive();
+				const QStringList rest(parts.mid(i + 1));
+				return rest.isEmpty() or setCurrentDirectory(rest.join('/'));
+			}
+			archiveDir = archiveDir.left(archiveDir.lastIndexOf('/', -2) + 1);
+		}
+		else if("." not_eq part) {
+			QString subDir(archiveDir + part + '/');
+			if(not m_archive.findDirectory(subDir)) {
+				Log("NATIVEFS", warning, QString("Failed changing current directory to: %1 (this may be just OK)").arg(dir));
+				return false;
+			}
+			archiveDir = subDir;
+		}
+	}
+	m_archiveDir = archiveDir;
+	Log("NATIVEFS", success, QString("Changing current directory to: %1").arg(currentPath()));
+
+	return true;
+} // changeArchiveDirectory
+
+
+void NativeFS::leaveArchive()
+{
+	Log("NATIVEFS", info, QString("Leaving archive: %1").arg(m_archive.path()));
+	m_archive.close();
+	m_archiveDir.clear();
+} // leaveArchive
+
+
+bool NativeFS::isDirectory(const QString& name) const
+{
+	if(name.isEmpty())
+		return false;
+	if(inArchive() and not QDir::isAbsolutePath(name)) {
+		QString dir(m_archiveDir + name + '/');
+		return ".." == name or m_archive.findDirectory(dir);
+	}
+	const QFileInfo info(name);
+	return info.isDir() or (info.isFile() and Archive::isZip(name));
+} // isDirectory
+
+
+QString NativeFS::currentPath() const
+{
+	if(not inArchive())
+		return QDir::currentPath();
+	QString path(m_archive.path());
+	if(not m_archiveDir.isEmpty())
+		path += '/' + m_archiveDir.left(m_archiveDir.length() - 1);
+
+	return path;
+} // currentPath
+
+
+QString NativeFS::hostPath(const QString& name) const
+{
+	if(not inArchive() or QDir::isAbsolutePath(name))
+		return name;
+	const int index = m_archive.find(m_archiveDir + name);
+
+	return m_archive.path() + '/' + (index < 0 ? m_archiveDir + name : m_archive.entries().at(index).name);
+} // hostPath
+
+
 // Command to the command channel.
 CBM::IOErrorMessage NativeFS::cmdChannel(const QString& cmd)
 {
@@ -1,8 +1,15 @@
 #ifndef NATIVEFS_HPP
 #define NATIVEFS_HPP
 
+#include <QBuffer>
+#include <QRegExp>
+
 #include "filedriverbase.hpp"
+#include "archive.hpp"
+#include "dircache.hpp"
 
+// The file system of the host. Zip archives are browsed as directories (read only), their files and gzipped files are
+// read decompressed through the image cache.
 class NativeFS : public FileDriverBase
 {
 public:
@@ -25,6 +32,10 @@ public:
 
 	// Send realistic $ file basic listing, line by line (returning false means not supported).
 	bool sendListing(ISendLine& cb);
+	// Host directories are read once and then listed from the directory cache until they change.
+	bool openListing();
+	bool listNextLine(ISendLine& cb);
+	void closeListing();
 	bool supportsListing() const
 	{
 		return true;
@@ -47,6 +58,7 @@ public:
 	CBM::IOErrorMessage renameFile(const QString& oldName, const QString& newName);
 	bool deleteFile(const QString& fileName);
 	char getc();
+	int read(char* dst, int max);
 	bool isEOF() const;
 	bool putc(char c);
 	bool close();
@@ -56,7 +68,15 @@ public:
 	CBM::IOErrorMessage cmdChannel(const QString& cmd);
 
 	FSStatus status() const;
+	// The directory may also be a zip archive, or a directory in one. Inside an archive, relative directories are in
+	// the archive and ".." from its top leaves it.
 	bool setCurrentDirectory(const QString& dir);
+	bool isDirectory(const QString& name) const;
+	// The current directory, in an archive that is the path of the archive and the directory in it.
+	QString currentPath() const;
+	// The path of a file in the current directory, for mounting it by another driver.
+	QString hostPath(const QString& name) const;
+
 protected:
 	// File to open, either as for checking its existance before trying another FS, or for reading .PRG native files.
 	QFile m_hostFile;
@@ -64,6 +84,41 @@ protected:
 	QString m_filters;
 	bool m_listDirectories;
 
+private:
+	bool inArchive() const
+	{
+		return not m_archive.path().isEmpty();
+	}
+
+	bool changeArchiveDirectory(const QString& dir);
+	void leaveArchive();
+	// The file being read, a file on the host or one from an archive.
+	QIODevice& openedFile();
+	const QIODevice& openedFile() const;
+	QStringList listingFilters() const;
+	bool isListed(const DirectoryCache::Entry& entry) const;
+	DirectoryCache::Entries readArchiveListing();
+	void sendListingHeader(ISendLine& cb);
+
+	// Listing state: The header line first, then the entries, directories (if listed) before the files.
+	enum ListingPhase {
+		ListHeader,
+		ListEntries,
+		ListDone
+	};
+	ListingPhase m_listingPhase;
+	DirectoryCache::Entries m_listing;
+	int m_listingPos;
+	// The listing filters as wildcard patterns, made when the listing starts.
+	QVector<QRegExp> m_listingPatterns;
+	DirectoryCache m_dirCache;
+
+	// The zip archive browsed, and the directory in it ("" or ending with '/'). Not open when not in an archive.
+	Archive::ZipArchive m_archive;
+	QString m_archiveDir;
+	// A file read from an archive, or a gzipped one.
+	QBuffer m_archiveFile;
+
 };
 
 #endif // NATIVEFS_HPP
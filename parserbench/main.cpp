@@ -0,0 +1,188 @@
+//
+// Title	: uno2iec-parserbench - protocol parser throughput
+//
+// Times the splitting of the bytes received from the Arduino into requests (ProtocolParser) and prints the bytes and
+// requests parsed per second. The stream is what a session of loading and saving files sends: open requests, read
+// credits, closes, debug lines and the 'W' packets of the files saved, whose random bytes now and then contain the
+// connection string. It is fed in chunks of several sizes, as the serial port hands them out.
+// Every run checks the requests come out as they were sent: A connection string in the data of a 'W' packet must not
+// be taken for a reconnecting Arduino, one at the start of a request must.
+//
+// DISCLAIMER:
+// The author is in no way responsible for any problems or damage caused by
+// using this code. Use at your own risk.
+//
+// LICENSE:
+// This code is distributed under the GNU Public License
+// which can be found at http://www.gnu.org/licenses/gpl.txt
+//
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <stdio.h>
+#include <string.h>
+
+#include "protocolparser.hpp"
+
+namespace {
+
+const char connectionString[] = "connect_arduino:";
+// As the Arduino sends them, the total length includes the 'W' and the length byte.
+const int WRITE_PACKET_SIZE = 0xf0;
+const int READ_CREDITS = 300;
+const int SAVE_PACKETS = 100;
+
+struct Stream
+{
+	QByteArray bytes;
+	int requests;
+	int writeBytes;
+};
+
+
+void appendOpen(Stream& stream, uchar channel, const char* name)
+{
+	const int length = strlen(name);
+	stream.bytes.append('O');
+	stream.bytes.append(char(3 + length));
+	stream.bytes.append(char(channel));
+	stream.bytes.append(name, length);
+	++stream.requests;
+} // appendOpen
+
+
+void appendLine(Stream& stream, const char* line)
+{
+	stream.bytes.append(line);
+	stream.bytes.append('\r');
+	++stream.requests;
+} // appendLine
+
+
+// A session loading and saving a file the number of rounds.
+Stream makeSession(int rounds)
+{
+	Stream stream;
+	stream.requests = 0;
+	stream.writeBytes = 0;
+	quint32 seed = 1541;
+	for(int round = 0; round < rounds; ++round) {
+		appendOpen(stream, 0, "GAME");
+		stream.bytes.append('S');
+		stream.bytes.append('F');
+		stream.bytes.append(char(66));
+		stream.bytes.append(char(3));
+		stream.requests += 2;
+		for(int i = 0; i < READ_CREDITS; ++i)
+			stream.bytes.append('R');
+		stream.requests += READ_CREDITS;
+		stream.bytes.append('C');
+		++stream.requests;
+		appendLine(stream, "DIILOADED");
+
+		appendOpen(stream, 1, "@:SAVED");
+		for(int packet = 0; packet < SAVE_PACKETS; ++packet) {
+			stream.bytes.append('W');
+			stream.bytes.append(char(WRITE_PACKET_SIZE));
+			const int start = stream.bytes.size();
+			for(int i = 2; i < WRITE_PACKET_SIZE; ++i) {
+				seed = seed * 1103515245 + 12345;
+				stream.bytes.append(char(seed >> 16));
+			}
+			// Some saved files contain the connection string, e.g. a program talking to the Arduino.
+			if(0 == packet % 10)
+				memcpy(stream.bytes.data() + start + packet % 64, connectionString, sizeof(connectionString) - 1);
+			stream.writeBytes += WRITE_PACKET_SIZE - 2;
+			++stream.requests;
+		}
+		stream.bytes.append('C');
+		++stream.requests;
+	}
+	return stream;
+} // makeSession
+
+
+// Parses the stream in chunks the number of times, false if the requests don't come out as they were sent.
+bool timeChunks(const Stream& stream, int chunkSize, int rounds)
+{
+	ProtocolParser parser;
+	ProtocolParser::Request request;
+	int requests = 0, writeBytes = 0, connects = 0;
+	QElapsedTimer timer;
+	timer.start();
+	for(int round = 0; round < rounds; ++round) {
+		const char* pData = stream.bytes.constData();
+		int remaining = stream.bytes.size();
+		while(remaining) {
+			int chunk = qMin(chunkSize, remaining);
+			while(chunk) {
+				const int written = parser.write(pData, chunk);
+				pData += written;
+				remaining -= written;
+				chunk -= written;
+				while(parser.next(request)) {
+					++requests;
+					if('W' == request.command)
+						writeBytes += request.payload.size();
+					else if('c' == request.command)
+						++connects;
+				}
+			}
+		}
+	}
+	const qint64 elapsed = qMax(timer.nsecsElapsed(), qint64(1));
+
+	const bool ok = requests == stream.requests * rounds and writeBytes == stream.writeBytes * rounds and 0 == connects;
+	const double bytes = double(stream.bytes.size()) * rounds;
+	printf("%5d byte chunks: %.0f bytes in %.3f s: %.1f MB/s, %.2f M requests/s%s\n", chunkSize, bytes,
+				 elapsed / 1000000000.0, bytes * 1000.0 / elapsed, requests * 1000.0 / elapsed, ok ? "" : " - PARSED WRONG");
+	return ok;
+} // timeChunks
+
+
+// A connection string where a request starts is a reconnecting Arduino, also when it cuts off a request.
+bool checkReconnect()
+{
+	ProtocolParser parser;
+	ProtocolParser::Request request;
+	const char stream[] = "Rconnect_arduino:6\rCcconnect_arduino:7\r";
+	QByteArray versions;
+	int others = 0;
+	for(const char* p = stream; *p; ++p) {
+		parser.write(p, 1);
+		while(parser.next(request))
+			if('c' == request.command)
+				versions.append(request.payload);
+			else
+				++others;
+	}
+	// The second 'c' is a stray byte and dropped.
+	const bool ok = "67" == versions and 2 == others;
+	printf("reconnect at a request boundary: %s\n", ok ? "ok" : "NOT DETECTED");
+	return ok;
+} // checkReconnect
+
+} // unnamed namespace
+
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication a(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Measures the speed of splitting the bytes from the Arduino into requests.");
+	parser.addHelpOption();
+	QCommandLineOption roundsOption(QStringList() << "r" << "rounds", "Times to parse the session.", "rounds", "200");
+	parser.addOption(roundsOption);
+	parser.process(a);
+
+	const int rounds = qMax(parser.value(roundsOption).toInt(), 1);
+	const Stream stream(makeSession(10));
+	printf("session of %d bytes, %d requests\n", stream.bytes.size(), stream.requests);
+	bool ok = checkReconnect();
+	static const int chunkSizes[] = { 1, 16, 64, 512, 4096 };
+	for(uint i = 0; i < sizeof(chunkSizes) / sizeof(chunkSizes[0]); ++i)
+		ok = timeChunks(stream, chunkSizes[i], rounds) and ok;
+	return ok ? 0 : 1;
+} // main
@@ -0,0 +1,17 @@
+#-------------------------------------------------
+#
+# uno2iec-parserbench: Speed of splitting the bytes from the Arduino into requests.
+#
+#-------------------------------------------------
+
+QT       = core
+
+TARGET = uno2iec-parserbench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../uno2iec-common.pri)
+include(../uno2iec-core.pri)
+
+SOURCES += main.cpp
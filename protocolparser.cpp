@@ -0,0 +1,174 @@
+#include <string.h>
+
+#include "protocolparser.hpp"
+
+namespace {
+const char connectionString[] = "connect_arduino:";
+const int CONNECTION_STRING_LENGTH = sizeof(connectionString) - 1;
+} // anonymous
+
+ProtocolParser::ProtocolParser()
+{
+	reset();
+} // ctor
+
+
+void ProtocolParser::reset()
+{
+	m_head = 0;
+	m_size = 0;
+	m_lineScanned = 0;
+	m_skippingLine = false;
+} // reset
+
+
+int ProtocolParser::write(const char* data, int length)
+{
+	int written = 0;
+	// A line too long for the buffer is dropped, the bytes up to and including its CR are skipped as they arrive.
+	while(m_skippingLine and written < length)
+		if('\r' == data[written++])
+			m_skippingLine = false;
+
+	int count = qMin(length - written, int(Capacity) - m_size);
+	int tail = (m_head + m_size) bitand (Capacity - 1);
+	int firstPart = qMin(count, int(Capacity) - tail);
+	memcpy(m_ring + tail, data + written, firstPart);
+	memcpy(m_ring, data + written + firstPart, count - firstPart);
+	m_size += count;
+	return written + count;
+} // write
+
+
+bool ProtocolParser::next(Request& request)
+{
+	if(0 == m_size)
+		return false;
+
+	request.command = char(at(0));
+	request.arg1 = 0;
+	request.arg2 = 0;
+	request.payload.setRawData(m_ring, 0);
+
+	switch(request.command) {
+		case 'S':
+		case 'R':
+		case 'L':
+		case 'M':
+		case 'C':
+		case 'T':
+		case 'X':
+		case 'V':
+			consume(1);
+			return true;
+
+		case 'N':
+		case 'E':
+		case 'G':
+		case 'K':
+			if(m_size < 2)
+				return false;
+			request.arg1 = at(1);
+			consume(2);
+			return true;
+
+		case 'F':
+		case 'A':
+			if(m_size < 3)
+				return false;
+			request.arg1 = at(1);
+			request.arg2 = at(2);
+			consume(3);
+			return true;
+
+		case 'O':
+		case 'W':
+		case 'P':
+		{
+			if(m_size < 2)
+				return false;
+			const int length = at(1);
+			// sanity: can't be a valid request if the total length is less than the control chars, drop it.
+			const bool hasChannel = 'W' not_eq request.command;
+			const int minLength = hasChannel ? 3 : 2;
+			if(length < minLength) {
+				consume(2);
+				return next(request);
+			}
+			if(m_size < length)
+				return false; // not all chars yet
+			if(hasChannel) {
+				request.arg1 = at(2);
+				setPayload(request, 3, length - 3);
+			}
+			else
+				setPayload(request, 2, length - 2);
+			consume(length);
+			return true;
+		}
+
+		case '!':
+		case 'D':
+			return takeLine(request, 1, 0);
+
+		case 'c':
+			for(int i = 1; i < CONNECTION_STRING_LENGTH; ++i) {
+				if(i == m_size)
+					return false; // may still become one.
+				if(connectionString[i] not_eq char(at(i))) {
+					// A stray byte, dropped.
+					consume(1);
+					return next(request);
+				}
+			}
+			return takeLine(request, CONNECTION_STRING_LENGTH, CONNECTION_STRING_LENGTH);
+
+		default:
+			consume(1);
+			return true;
+	}
+} // next
+
+
+bool ProtocolParser::takeLine(Request& request, int offset, int payloadOffset)
+{
+	// only search the bytes that arrived since last time.
+	for(int i = qMax(m_lineScanned, offset); i < m_size; ++i) {
+		if('\r' == at(i)) {
+			setPayload(request, payloadOffset, i - payloadOffset);
+			consume(i + 1);
+			return true;
+		}
+	}
+	m_lineScanned = m_size;
+	if(int(Capacity) == m_size) {
+		// The line doesn't fit, drop what we have and the rest of it.
+		consume(m_size);
+		m_skippingLine = true;
+	}
+	return false;
+} // takeLine
+
+
+void ProtocolParser::consume(int length)
+{
+	m_head = (m_head + length) bitand (Capacity - 1);
+	m_size -= length;
+	m_lineScanned = 0;
+} // consume
+
+
+void ProtocolParser::setPayload(Request& request, int offset, int length)
+{
+	const int start = (m_head + offset) bitand (Capacity - 1);
+	const char* pData = m_ring + start;
+	if(start + length > int(Capacity)) {
+		const int firstPart = int(Capacity) - start;
+		memcpy(m_payload, m_ring + start, firstPart);
+		memcpy(m_payload + firstPart, m_ring, length - firstPart);
+		pData = m_payload;
+	}
+	// Unlike fromRawData(), which allocates a new header every time, this points the request's own header at the data
+	// as long as no copy of the previous payload is kept.
+	request.payload.setRawData(pData, length);
+} // setPayload
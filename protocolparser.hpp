@@ -0,0 +1,76 @@
+#ifndef PROTOCOLPARSER_HPP
+#define PROTOCOLPARSER_HPP
+
+#include <QByteArray>
+
+// Splits the bytes received from the Arduino into requests. The bytes are kept in a fixed size ring buffer and each
+// request is only looked at again when more bytes for it have arrived, so bulk data (e.g. 'W' packets while saving)
+// costs linear time and no allocations.
+// The request framing depends on the command byte:
+//   S R L M C T X  the command byte alone.
+//   N E G K        one argument byte.
+//   F A            two argument bytes.
+//   O W P          a total length byte (including the command and length bytes) followed by the payload (after a
+//                  channel byte for O and P).
+//   ! D            a text line up to a CR.
+//   c              "connect_arduino:<version>" up to a CR, the connection request of a restarted Arduino. Only looked for
+//                  where a request starts, the same bytes in the payload of a request (e.g. a file being saved) are
+//                  just data.
+// Any other byte is handed out as a request of its own.
+class ProtocolParser
+{
+public:
+	struct Request
+	{
+		char command;
+		// N, E, F: first argument. O, P, G, A, K: channel.
+		uchar arg1;
+		// F: second argument (window). A: the byte count.
+		uchar arg2;
+		// O: the command string, W and P: the bytes to write, ! and D: the line (command included) without the CR,
+		// c: the protocol version as text.
+		// Refers to the parser's buffer, so it is only valid until the next call to write() or next().
+		QByteArray payload;
+	};
+
+	ProtocolParser();
+
+	// Forget everything buffered, e.g. when the Arduino reconnects.
+	void reset();
+	// Copies as many of the bytes as there is room for, returns the number copied. Room is made by next().
+	int write(const char* data, int length);
+	// Takes the next complete request from the buffer, false if there is none (yet).
+	bool next(Request& request);
+
+	bool isEmpty() const
+	{
+		return 0 == m_size;
+	}
+
+private:
+	// Larger than the biggest length prefixed request (255 bytes), so one always fits.
+	enum { Capacity = 512 };
+
+	uchar at(int offset) const
+	{
+		return m_ring[(m_head + offset) bitand (Capacity - 1)];
+	}
+
+	// A line from the offset up to a CR, the payload is the line from payloadOffset without the CR.
+	bool takeLine(Request& request, int offset, int payloadOffset);
+	void consume(int length);
+	// Points request.payload at length bytes from the offset, copying them in one piece first if they wrap around.
+	void setPayload(Request& request, int offset, int length);
+
+	char m_ring[Capacity];
+	// Offset of the first unparsed byte and how many bytes there are.
+	int m_head;
+	int m_size;
+	// Line requests: how many bytes have been searched for the CR already.
+	int m_lineScanned;
+	// Set when a line didn't fit in the buffer, the rest of it is skipped up to the CR.
+	bool m_skippingLine;
+	char m_payload[Capacity];
+};
+
+#endif // PROTOCOLPARSER_HPP
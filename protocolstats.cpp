@@ -0,0 +1,91 @@
+#include <algorithm>
+
+#include "protocolstats.hpp"
+#include "logger.hpp"
+
+using namespace Logging;
+
+namespace {
+const QString FAC_STATS("STATS");
+// Keep the per command samples bounded, plenty for the largest CBM files.
+const int MAX_SAMPLES = 4096;
+} // anonymous
+
+
+ProtocolStats::ProtocolStats()
+	: m_active(false), m_lastResponse(-1), m_currentCommand(0), m_numRequests(0), m_numBytes(0)
+{
+} // ctor
+
+
+void ProtocolStats::transferStarted()
+{
+	m_samples.clear();
+	m_numRequests = m_numBytes = 0;
+	m_currentCommand = 0;
+	m_lastResponse = -1;
+	m_transferTimer.start();
+	m_active = true;
+} // transferStarted
+
+
+void ProtocolStats::transferEnded(const QString& name)
+{
+	if(not m_active)
+		return;
+	m_active = false;
+	qint64 elapsed = m_transferTimer.nsecsElapsed() / 1000;
+	Log(FAC_STATS, info, QString("%1: %2 bytes in %3 ms (%4 bytes/s), %5 round trips.").arg(name)
+			.arg(m_numBytes).arg(elapsed / 1000).arg(elapsed ? qint64(m_numBytes) * 1000000 / elapsed : 0).arg(m_numRequests));
+
+	QHash<char, Samples>::iterator it;
+	for(it = m_samples.begin(); it not_eq m_samples.end(); ++it)
+		Log(FAC_STATS, info, QString("%1 '%2' x%3 turnaround %4, service %5.").arg(name).arg(QChar(it.key()))
+				.arg(it->service.size()).arg(percentiles(it->turnaround)).arg(percentiles(it->service)));
+} // transferEnded
+
+
+void ProtocolStats::requestReceived(char command)
+{
+	if(not m_active)
+		return;
+	++m_numRequests;
+	m_currentCommand = command;
+	m_requestTimer.start();
+	Samples& samples(m_samples[command]);
+	if(-1 not_eq m_lastResponse and samples.turnaround.size() < MAX_SAMPLES)
+		samples.turnaround.append(m_transferTimer.nsecsElapsed() / 1000 - m_lastResponse);
+} // requestReceived
+
+
+void ProtocolStats::responded()
+{
+	if(not m_active)
+		return;
+	m_lastResponse = m_transferTimer.nsecsElapsed() / 1000;
+	if(not m_currentCommand)
+		return;
+	Samples& samples(m_samples[m_currentCommand]);
+	if(samples.service.size() < MAX_SAMPLES)
+		samples.service.append(m_requestTimer.nsecsElapsed() / 1000);
+	m_currentCommand = 0;
+} // responded
+
+
+void ProtocolStats::bytesTransferred(uint numBytes)
+{
+	m_numBytes += numBytes;
+} // bytesTransferred
+
+
+// Returns the 50th, 90th and 99th percentile of the samples (in microseconds), formatted for the log.
+QString ProtocolStats::percentiles(QVector<qint64>& samples)
+{
+	if(samples.isEmpty())
+		return "-";
+	std::sort(samples.begin(), samples.end());
+	int last = samples.size() - 1;
+
+	return QString("p50 %1us p90 %2us p99 %3us").arg(samples.at(last * 50 / 100))
+			.arg(samples.at(last * 90 / 100)).arg(samples.at(last * 99 / 100));
+} // percentiles
@@ -0,0 +1,53 @@
+#ifndef PROTOCOLSTATS_HPP
+#define PROTOCOLSTATS_HPP
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QVector>
+#include <QString>
+
+// Measures the serial protocol while a file or listing is transferred, from the open request until the close.
+// For every request from the Arduino two times are recorded: the turnaround (from our previous response until the
+// request arrived, i.e. serial line and Arduino/IEC time) and the service time (until we had the response written).
+// When the transfer is closed a summary with throughput, round trips and latency percentiles per command is logged.
+class ProtocolStats
+{
+public:
+	ProtocolStats();
+
+	// A new transfer begins, any unfinished one is discarded.
+	void transferStarted();
+	// Log the summary of the transfer, under the given name ("LOAD", "SAVE"...).
+	void transferEnded(const QString& name);
+
+	// Request with the given command character has arrived.
+	void requestReceived(char command);
+	// Our response to the current request has been written.
+	void responded();
+	void bytesTransferred(uint numBytes);
+
+	bool isActive() const
+	{
+		return m_active;
+	}
+
+private:
+	struct Samples
+	{
+		QVector<qint64> turnaround;
+		QVector<qint64> service;
+	};
+
+	static QString percentiles(QVector<qint64>& samples);
+
+	bool m_active;
+	QElapsedTimer m_transferTimer;
+	QElapsedTimer m_requestTimer;
+	qint64 m_lastResponse;
+	char m_currentCommand;
+	uint m_numRequests;
+	uint m_numBytes;
+	QHash<char, Samples> m_samples;
+};
+
+#endif // PROTOCOLSTATS_HPP
@@ -11,85 +11,31 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 TARGET = rpi2iec
 TEMPLATE = app
 
-DEFINES += CONSOLE_DEBUG
-
-win32-msvc* {
-	# Multiple build processes with jom
-	# only works in .pro file for MSVC compilers, for gnu add -j8 in projects / make
-	QMAKE_CXXFLAGS += /MP
-}
-else {
-	# explicit enabling of c++11 under all gnu compilers.
-	QMAKE_CXXFLAGS += -std=gnu++0x
-}
+include(uno2iec-common.pri)
+# The Interface, drivers and serial handling come from the core library, build it first (or build uno2iec.pro).
+include(uno2iec-core.pri)
 
 win32 {
 	# version resource and appicon.
 	RC_FILE = rpi2iec.rc
-	OBJPRE = win
-	# Add this for static linking of mingw libs. Note: Needs static Qt version.
-	# QMAKE_LFLAGS += -static-libgcc -static-libstdc++ -static
-}
-
-
-unix {
-	OBJPRE = nix
-}
-
-# To compile for Raspberry PI, run qmake with the flags: CONFIG+=raspberry
-raspberry {
-	# So wiringPi include files can be found during compile
-	INCLUDEPATH += /usr/local/include
-	# To link the wiringPi library when making the executable
-	LIBS += -L/usr/local/lib -lwiringPi
-	# To conditionally compile wiringPi so that it still builds on other platforms.
-	DEFINES += "HAS_WIRINGPI="
-
-	OBJPRE = pi
-} #raspberry
-
-mac {
-	OBJPRE = mac
 }
 
 SOURCES += main.cpp\
 				mainwindow.cpp \
-				t64driver.cpp \
-				m2idriver.cpp \
-				d64driver.cpp \
-				filedriverbase.cpp \
-				interface.cpp \
-				nativefs.cpp \
-				logger.cpp \
-				x00fs.cpp \
 				aboutdialog.cpp \
 				settingsdialog.cpp \
-				doscommands.cpp \
-				x64driver.cpp \
 				logfiltersetup.cpp \
 				qcmdtextedit.cpp \
 				mountspecificfile.cpp
 
 HEADERS += mainwindow.hpp \
-				t64driver.hpp \
-				m2idriver.hpp \
-				d64driver.hpp \
-				filedriverbase.hpp \
-				interface.hpp \
-				nativefs.hpp \
-				logger.hpp \
-				x00fs.hpp \
 				version.h \
 				aboutdialog.hpp \
 				settingsdialog.hpp \
 				dirlistthemingconsts.hpp \
-				doscommands.hpp \
-				uno2iec/cbmdefines.h \
-				x64driver.hpp \
 				logfiltersetup.hpp \
 				qcmdtextedit.h \
-				mountspecificfile.h \
-				utils.hpp
+				mountspecificfile.h
 
 FORMS += mainwindow.ui \
 				aboutdialog.ui \
@@ -118,7 +64,6 @@ OTHER_FILES += \
 				icons/settings.png \
 				icons/theme.png \
 				icons/1541.ico \
-				other/dos1541 \
 				fonts/PetMe2X.ttf \
 				fonts/PetMe64.ttf \
 				fonts/PetMe1282Y.ttf
@@ -126,19 +71,3 @@ OTHER_FILES += \
 RESOURCES += \
 				resources.qrc
 
-
-
-# we want intermediate build files stored in configuration and platform specific folders.
-# Reason is not getting compile errors when switching from building under one platform to another.
-# Object file formats are different. We don't want to mix release and debug either.
-CONFIG(debug, debug|release) {
-		REL = debug
-} else {
-		REL = release
-}
-
-OBJECTS_DIR = $$quote($${REL}/.obj$${OBJPRE})
-DESTDIR = $$quote($${REL})
-MOC_DIR = $$quote($${REL}/.moc)
-RCC_DIR = $$quote($${REL}/.rcc)
-UI_DIR = $$quote($${REL}/.ui)
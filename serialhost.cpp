@@ -0,0 +1,625 @@
+#include <QDate>
+#include <QTime>
+#include <QMetaObject>
+#include <stdlib.h>
+#ifdef HAS_WIRINGPI
+#include <wiringPi.h>
+#endif
+
+#include "serialhost.hpp"
+#include "imagecache.hpp"
+#include "logger.hpp"
+
+using namespace Logging;
+
+namespace {
+
+const QString OkString = "OK>%1|%2|%3|%4|%5|%6|%7.%8\r";
+const QString NOkString = "NOK>\r";
+const QString ConnectionString = "connect_arduino:";
+
+// The Raspberry Pi GPIO pin wired to the Arduino reset.
+const int ARDUINO_RESET_GPIO_PIN = 23;
+
+} // unnamed namespace
+
+
+SerialHost::DeviceConfig::DeviceConfig()
+	: deviceNumber(DEFAULT_DEVICE_NUMBER)
+	, atnPin(DEFAULT_ATN_PIN)
+	, clockPin(DEFAULT_CLOCK_PIN)
+	, dataPin(DEFAULT_DATA_PIN)
+	, resetPin(DEFAULT_RESET_PIN)
+	, srqInPin(DEFAULT_SRQIN_PIN)
+{
+} // ctor
+
+
+SerialHost::SerialHost(QObject* parent) :
+	QObject(parent)
+	, m_pWorker(0)
+	, m_pListener(0)
+	, m_hasListener(0)
+	, m_writeProtected(0)
+	, m_deliveryPending(0)
+	, m_numDropped(0)
+	, m_baudRate(DEFAULT_BAUDRATE)
+{
+	qRegisterMetaType<SerialHost::DeviceConfig>("SerialHost::DeviceConfig");
+	// The logger delivers lines on the thread it was created on, make sure it isn't the worker.
+	loggerInstance();
+
+	m_pWorker = new SerialPortWorker(*this);
+	m_pWorker->moveToThread(&m_thread);
+	connect(&m_thread, SIGNAL(finished()), m_pWorker, SLOT(deleteLater()));
+	m_thread.setObjectName("SerialPortWorker");
+	// The Arduino waits for every response, so the worker should get the CPU before the UI does.
+	m_thread.start(QThread::HighPriority);
+} // ctor
+
+
+SerialHost::~SerialHost()
+{
+	closePort();
+	m_thread.quit();
+	m_thread.wait();
+} // dtor
+
+
+bool SerialHost::openPort(const QString& portName, uint baudRate)
+{
+	bool success = false;
+	m_portName = portName;
+	m_baudRate = baudRate;
+	QMetaObject::invokeMethod(m_pWorker, "openPort", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, success)
+														, Q_ARG(QString, portName), Q_ARG(uint, baudRate));
+	return success;
+} // openPort
+
+
+void SerialHost::closePort()
+{
+	QMetaObject::invokeMethod(m_pWorker, "closePort", Qt::BlockingQueuedConnection);
+} // closePort
+
+
+void SerialHost::setBaudRate(uint baudRate)
+{
+	m_baudRate = baudRate;
+	QMetaObject::invokeMethod(m_pWorker, "setBaudRate", Qt::QueuedConnection, Q_ARG(uint, baudRate));
+} // setBaudRate
+
+
+bool SerialHost::setupResetLine()
+{
+	// Initialize WiringPI stuff, if we're on the Raspberry Pi platform.
+#ifdef HAS_WIRINGPI
+	system("/usr/local/bin/gpio -g mode 23 out");
+	system("/usr/local/bin/gpio export 23 out");
+	if(-1 == wiringPiSetupSys()) {
+		Log("MAIN", error, "Failed initializing WiringPi. Continuing anyway...");
+		return false;
+	}
+	return true;
+#else
+	return false;
+#endif
+} // setupResetLine
+
+
+void SerialHost::resetArduino()
+{
+	QMetaObject::invokeMethod(m_pWorker, "resetArduino", Qt::QueuedConnection);
+} // resetArduino
+
+
+void SerialHost::setDeviceConfig(const DeviceConfig& config)
+{
+	QMetaObject::invokeMethod(m_pWorker, "setDeviceConfig", Qt::QueuedConnection, Q_ARG(SerialHost::DeviceConfig, config));
+} // setDeviceConfig
+
+
+void SerialHost::setWriteProtected(bool writeProtected)
+{
+	m_writeProtected.storeRelease(writeProtected ? 1 : 0);
+} // setWriteProtected
+
+
+bool SerialHost::isWriteProtected() const
+{
+	return 0 not_eq m_writeProtected.loadAcquire();
+} // isWriteProtected
+
+
+void SerialHost::setImageFilters(const QString& filters, bool showDirs)
+{
+	QMetaObject::invokeMethod(m_pWorker, "setImageFilters", Qt::QueuedConnection, Q_ARG(QString, filters), Q_ARG(bool, showDirs));
+} // setImageFilters
+
+
+void SerialHost::changeNativeFSDirectory(const QString& newDir)
+{
+	QMetaObject::invokeMethod(m_pWorker, "changeNativeFSDirectory", Qt::QueuedConnection, Q_ARG(QString, newDir));
+} // changeNativeFSDirectory
+
+
+void SerialHost::setImageCacheBytes(qint64 maxBytes)
+{
+	QMetaObject::invokeMethod(m_pWorker, "setImageCacheBytes", Qt::QueuedConnection, Q_ARG(qint64, maxBytes));
+} // setImageCacheBytes
+
+
+void SerialHost::openLocal(uchar channel, const QByteArray& cmd)
+{
+	QMetaObject::invokeMethod(m_pWorker, "openLocal", Qt::QueuedConnection, Q_ARG(uchar, channel), Q_ARG(QByteArray, cmd));
+} // openLocal
+
+
+void SerialHost::processSimulatedData(const QByteArray& data)
+{
+	QMetaObject::invokeMethod(m_pWorker, "processSimulatedData", Qt::QueuedConnection, Q_ARG(QByteArray, data));
+} // processSimulatedData
+
+
+void SerialHost::setNotifyListener(IHostNotify* pListener)
+{
+	m_pListener = pListener;
+	m_hasListener.storeRelease(0 == pListener ? 0 : 1);
+} // setNotifyListener
+
+
+// Called on the worker thread, never waits. If the queue is full the notification is dropped (and counted).
+bool SerialHost::post(const Notification& notification)
+{
+	if(not m_notifications.push(notification)) {
+		m_numDropped.ref();
+		return false;
+	}
+	// Only the first notification after a delivery has started needs to schedule another one.
+	if(m_deliveryPending.testAndSetOrdered(0, 1))
+		QMetaObject::invokeMethod(this, "deliverNotifications", Qt::QueuedConnection);
+	return true;
+} // post
+
+
+void SerialHost::deliverNotifications()
+{
+	// Cleared before the queue is read: anything posted from now on schedules a new delivery.
+	m_deliveryPending.storeRelease(0);
+
+	Notification notification;
+	while(m_notifications.pop(notification)) {
+		if(0 == m_pListener)
+			continue;
+		switch(notification.type) {
+			case Notification::DirectoryChanged:
+				m_pListener->directoryChanged(notification.name);
+				break;
+			case Notification::ImageMounted:
+				m_pListener->imageMounted(notification.name, notification.listing);
+				break;
+			case Notification::ImageUnmounted:
+				m_pListener->imageUnmounted();
+				break;
+			case Notification::FileLoading:
+				m_pListener->fileLoading(notification.name, ushort(notification.value));
+				break;
+			case Notification::FileSaving:
+				m_pListener->fileSaving(notification.name);
+				break;
+			case Notification::BytesRead:
+				m_pListener->bytesRead(notification.value);
+				break;
+			case Notification::BytesWritten:
+				m_pListener->bytesWritten(notification.value);
+				break;
+			case Notification::FileClosed:
+				m_pListener->fileClosed(notification.name);
+				break;
+			case Notification::DeviceNumberChanged:
+				m_pListener->deviceNumberChanged(ushort(notification.value));
+				break;
+			case Notification::DeviceReset:
+				m_pListener->deviceReset();
+				break;
+			case Notification::SimulatedResponse:
+				m_pListener->simulatedResponse(notification.data);
+				break;
+		}
+	}
+
+	int numDropped = m_numDropped.fetchAndStoreOrdered(0);
+	if(numDropped)
+		Log("MAIN", warning, QString("UI was too far behind, %1 notification(s) dropped.").arg(numDropped));
+} // deliverNotifications
+
+
+//////////////////////////////////////////////////////////////////////////////
+// SerialPortWorker, everything below runs on the worker thread.
+//////////////////////////////////////////////////////////////////////////////
+SerialPortWorker::SerialPortWorker(SerialHost& host) :
+	QObject(0)
+	, m_host(host)
+	, m_port(this)
+	, m_isConnected(false)
+	, m_simulating(false)
+	, m_unpostedBytesRead(0)
+	, m_unpostedBytesWritten(0)
+	, m_iface()
+{
+	// Set up the port basic parameters, these won't change...promise.
+	m_port.setDataBits(QSerialPort::Data8);
+	m_port.setParity(QSerialPort::NoParity);
+	m_port.setFlowControl(QSerialPort::NoFlowControl);
+	m_port.setStopBits(QSerialPort::OneStop);
+	m_port.setBaudRate(static_cast<QSerialPort::BaudRate>(DEFAULT_BAUDRATE));
+
+	// we want events from the port.
+	connect(&m_port, SIGNAL(readyRead()), this, SLOT(onDataAvailable()));
+	m_iface.setMountNotifyListener(this);
+} // ctor
+
+
+SerialPortWorker::~SerialPortWorker()
+{
+	m_iface.setMountNotifyListener(0);
+	closePort();
+} // dtor
+
+
+bool SerialPortWorker::openPort(const QString& portName, uint baudRate)
+{
+	closePort();
+	m_port.setPortName(portName);
+	m_port.setBaudRate(static_cast<QSerialPort::BaudRate>(baudRate));
+	bool success = m_port.open(QIODevice::ReadWrite);
+	if(not success)
+		Log("MAIN", error, QString("Failed opening port %1: %2").arg(portName, m_port.errorString()));
+	return success;
+} // openPort
+
+
+void SerialPortWorker::closePort()
+{
+	m_isConnected = false;
+	if(m_port.isOpen())
+		m_port.close();
+} // closePort
+
+
+void SerialPortWorker::setBaudRate(uint baudRate)
+{
+	m_port.setBaudRate(static_cast<QSerialPort::BaudRate>(baudRate));
+} // setBaudRate
+
+
+void SerialPortWorker::resetArduino()
+{
+	m_isConnected = false;
+	m_iface.reset();
+#ifdef HAS_WIRINGPI
+	Log("MAIN", warning, "Moving to disconnected state and resetting arduino...");
+	// pull pin 23 to reset arduino.
+	pinMode(ARDUINO_RESET_GPIO_PIN, OUTPUT);
+	digitalWrite(ARDUINO_RESET_GPIO_PIN, 0);
+	delay(3000);
+	Log("MAIN", info, "Releasing reset state...");
+	// set it high again to release reset state.
+	digitalWrite(ARDUINO_RESET_GPIO_PIN, 1);
+#else
+	m_port.close();
+	m_port.open(QIODevice::ReadWrite);
+#endif
+} // resetArduino
+
+
+void SerialPortWorker::setDeviceConfig(const SerialHost::DeviceConfig& config)
+{
+	m_config = config;
+} // setDeviceConfig
+
+
+void SerialPortWorker::setImageFilters(const QString& filters, bool showDirs)
+{
+	m_iface.setImageFilters(filters, showDirs);
+} // setImageFilters
+
+
+void SerialPortWorker::changeNativeFSDirectory(const QString& newDir)
+{
+	m_iface.changeNativeFSDirectory(newDir);
+} // changeNativeFSDirectory
+
+
+void SerialPortWorker::setImageCacheBytes(qint64 maxBytes)
+{
+	imageCache().setMaxBytes(maxBytes);
+} // setImageCacheBytes
+
+
+void SerialPortWorker::openLocal(uchar channel, const QByteArray& cmd)
+{
+	m_iface.processOpenCommand(channel, cmd, true);
+} // openLocal
+
+
+void SerialPortWorker::processSimulatedData(const QByteArray& data)
+{
+	m_simulating = true;
+	processData(data);
+} // processSimulatedData
+
+
+bool SerialPortWorker::checkConnectRequest(QByteArray& buffer)
+{
+	int connectPos = buffer.indexOf(ConnectionString);
+	if(-1 == connectPos)
+		return false;
+	int crPos = buffer.indexOf('\r', connectPos);
+	if(-1 == crPos)
+		return false;
+
+	// extract version number.
+	return acceptConnection(buffer.mid(connectPos + ConnectionString.length(), crPos - connectPos));
+} // checkConnectRequest
+
+
+bool SerialPortWorker::acceptConnection(const QString& versionString)
+{
+	ushort receivedProtoVersion = versionString.toInt();
+	if(receivedProtoVersion < MIN_UNO2IEC_PROTOCOL_VERSION or receivedProtoVersion > CURRENT_UNO2IEC_PROTOCOL_VERSION) {
+		Log("MAIN", error, QString("Received connection string from arduino, but the protocol version (%1) is not within our "
+				"supported versions (%2 to %3). Not accepting connection, please upgrade the Arduino!")
+				.arg(receivedProtoVersion).arg(MIN_UNO2IEC_PROTOCOL_VERSION).arg(CURRENT_UNO2IEC_PROTOCOL_VERSION));
+		m_pendingBuffer.clear();
+		m_parser.reset();
+		// Negative response, make it stop connection attempts.
+		m_port.write(NOkString.toLatin1().data());
+		return false;
+	}
+
+	m_pendingBuffer.clear();
+	m_parser.reset();
+	// Assume connected, maybe a real ack sequence is needed here from the client?
+	// Are we already connected? If so,
+	if(not m_isConnected) {
+		m_isConnected = true;
+		Log("MAIN", success, QString("Now connected to Arduino (protocol version %1).").arg(receivedProtoVersion));
+	}
+	else
+		Log("MAIN", warning, "Got reconnection attempt from Arduino for unknown reason. Accepting new connection.");
+
+	// give the client the version, pin configuration, current date and time in the response string.
+	const QString response = OkString.arg(QString::number(m_config.deviceNumber))
+			.arg(QString::number(m_config.atnPin))
+			.arg(QString::number(m_config.clockPin))
+			.arg(QString::number(m_config.dataPin))
+			.arg(QString::number(m_config.resetPin))
+			.arg(QString::number(m_config.srqInPin))
+			.arg(QDate::currentDate().toString("yyyy-MM-dd"))
+			.arg(QTime::currentTime().toString("hh:mm:ss"));
+
+	m_port.write(response.toLatin1().data());
+	// client is supposed to send it's facilities each start.
+	m_clientFacilities.clear();
+	return true;
+} // acceptConnection
+
+
+////////////////////////////////////////////////////////////////////////////
+// Dispatcher for when something has arrived on the serial port / simulated data.
+////////////////////////////////////////////////////////////////////////////
+void SerialPortWorker::onDataAvailable()
+{
+	m_simulating = false;
+	const QByteArray data(m_port.readAll());
+	if(not m_isConnected) {
+		// Nothing but the connection request is of interest until connected.
+		m_pendingBuffer.append(data);
+		if(not checkConnectRequest(m_pendingBuffer) and -1 == m_pendingBuffer.indexOf(ConnectionString))
+			m_pendingBuffer = m_pendingBuffer.right(ConnectionString.length());
+		return;
+	}
+
+	processData(data);
+} // onDataAvailable
+
+
+void SerialPortWorker::processData(const QByteArray& data)
+{
+	const char* pData = data.constData();
+	int remaining = data.size();
+	while(remaining) {
+		const int written = m_parser.write(pData, remaining);
+		pData += written;
+		remaining -= written;
+		while(m_parser.next(m_request))
+			if(not processRequest(m_request))
+				return; // The Arduino reconnected, the rest belongs to the old connection.
+	}
+} // processData
+
+
+bool SerialPortWorker::processRequest(const ProtocolParser::Request& request)
+{
+	switch(request.command) {
+		case '!': // register facility string.
+			processAddNewFacility(QString::fromLatin1(request.payload.constData(), request.payload.size()));
+			break;
+
+		case 'D': // debug output.
+			processDebug(QString::fromLatin1(request.payload.constData(), request.payload.size()));
+			break;
+
+		case 'c': // connection request of a restarted Arduino, what follows belongs to the new connection.
+			acceptConnection(QString::fromLatin1(request.payload.constData(), request.payload.size()));
+			return false;
+
+		default:
+			m_iface.processRequest(request);
+			break;
+	}
+	return true;
+} // processRequest
+
+
+void SerialPortWorker::processAddNewFacility(const QString& str)
+{
+	m_clientFacilities[str.at(1)] = str.mid(2);
+} // processAddNewFacility
+
+
+void SerialPortWorker::processDebug(const QString& str)
+{
+	LogLevelE level = info;
+	switch(str[1].toUpper().toLatin1()) {
+	case 'S':
+		level = success;
+		break;
+	case 'I':
+		level = info;
+		break;
+	case 'W':
+		level = warning;
+		break;
+	case 'E':
+		level = error;
+		break;
+	}
+
+	Log(QString("R:") + m_clientFacilities.value(str[2], "GENERAL"), level, str.mid(3));
+} // processDebug
+
+
+//////////////////////////////////////////////////////////////////////////////
+// IFileOpsNotify interface implementation, the UI notifications are posted to the SerialHost's thread.
+//////////////////////////////////////////////////////////////////////////////
+void SerialPortWorker::post(const SerialHost::Notification& notification)
+{
+	if(not m_host.hasListener())
+		return;
+	// Progress first, so that it reaches the UI before e.g. the file is closed.
+	postProgress();
+	m_host.post(notification);
+} // post
+
+
+void SerialPortWorker::postProgress()
+{
+	if(m_unpostedBytesRead and m_host.post(SerialHost::Notification(SerialHost::Notification::BytesRead, QString(), m_unpostedBytesRead)))
+		m_unpostedBytesRead = 0;
+	if(m_unpostedBytesWritten and m_host.post(SerialHost::Notification(SerialHost::Notification::BytesWritten, QString(), m_unpostedBytesWritten)))
+		m_unpostedBytesWritten = 0;
+} // postProgress
+
+
+void SerialPortWorker::directoryChanged(const QString& newPath)
+{
+	post(SerialHost::Notification(SerialHost::Notification::DirectoryChanged, newPath));
+} // directoryChanged
+
+
+void SerialPortWorker::imageMounted(const QString& imagePath, FileDriverBase* pFileSystem)
+{
+	if(not m_host.hasListener())
+		return;
+	// The UI can't use the driver from its thread, so it is given the listing lines instead.
+	SerialHost::Notification notification(SerialHost::Notification::ImageMounted, imagePath);
+	m_listing.clear();
+	if(pFileSystem->supportsListing() and pFileSystem->sendListing(*this))
+		notification.listing = m_listing;
+	m_listing.clear();
+	post(notification);
+} // imageMounted
+
+
+void SerialPortWorker::send(short lineNo, const QString& text)
+{
+	m_listing.append(QString::number(lineNo) + ' ' + text);
+} // send
+
+
+void SerialPortWorker::imageUnmounted()
+{
+	post(SerialHost::Notification(SerialHost::Notification::ImageUnmounted));
+} // imageUnmounted
+
+
+void SerialPortWorker::fileLoading(const QString& fileName, ushort fileSize)
+{
+	post(SerialHost::Notification(SerialHost::Notification::FileLoading, fileName, fileSize));
+} // fileLoading
+
+
+void SerialPortWorker::fileSaving(const QString& fileName)
+{
+	post(SerialHost::Notification(SerialHost::Notification::FileSaving, fileName));
+} // fileSaving
+
+
+void SerialPortWorker::bytesRead(uint numBytes)
+{
+	if(not m_host.hasListener())
+		return;
+	// Summed up as long as the UI hasn't taken the previous notifications.
+	m_unpostedBytesRead += numBytes;
+	if(not m_host.isDelivering())
+		postProgress();
+} // bytesRead
+
+
+void SerialPortWorker::bytesWritten(uint numBytes)
+{
+	if(not m_host.hasListener())
+		return;
+	m_unpostedBytesWritten += numBytes;
+	if(not m_host.isDelivering())
+		postProgress();
+} // bytesWritten
+
+
+void SerialPortWorker::fileClosed(const QString& lastFileName)
+{
+	post(SerialHost::Notification(SerialHost::Notification::FileClosed, lastFileName));
+} // fileClosed
+
+
+bool SerialPortWorker::isWriteProtected() const
+{
+	return m_host.isWriteProtected();
+} // isWriteProtected
+
+
+ushort SerialPortWorker::deviceNumber() const
+{
+	return m_config.deviceNumber;
+} // deviceNumber
+
+
+void SerialPortWorker::setDeviceNumber(ushort deviceNumber)
+{
+	m_config.deviceNumber = deviceNumber;
+	// let the UI remember it in its settings.
+	post(SerialHost::Notification(SerialHost::Notification::DeviceNumberChanged, QString(), deviceNumber));
+} // setDeviceNumber
+
+
+void SerialPortWorker::deviceReset()
+{
+	post(SerialHost::Notification(SerialHost::Notification::DeviceReset));
+} // deviceReset
+
+
+void SerialPortWorker::writePort(const QByteArray& data, bool flush)
+{
+	if(m_simulating) {
+		SerialHost::Notification notification(SerialHost::Notification::SimulatedResponse);
+		notification.data = data;
+		post(notification);
+	}
+	else if(m_port.isOpen()) {
+		m_port.write(data);
+		if(flush)
+			m_port.flush();
+	}
+} // writePort
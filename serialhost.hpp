@@ -0,0 +1,237 @@
+#ifndef SERIALHOST_HPP
+#define SERIALHOST_HPP
+
+#include <QObject>
+#include <QMap>
+#include <QThread>
+#include <QAtomicInt>
+#include <QStringList>
+#include <QtSerialPort/QSerialPort>
+
+#include "interface.hpp"
+#include "spscqueue.hpp"
+#include "protocolparser.hpp"
+
+typedef QMap<QChar, QString> FacilityMap;
+
+// Default Device and Arduino PIN configuration.
+const uint DEFAULT_BAUDRATE = QSerialPort::Baud115200;
+const uint DEFAULT_DEVICE_NUMBER = 8;
+const uint DEFAULT_RESET_PIN = 7;
+const uint DEFAULT_CLOCK_PIN = 4;
+const uint DEFAULT_DATA_PIN = 3;
+const uint DEFAULT_ATN_PIN = 5;
+const uint DEFAULT_SRQIN_PIN = 2;
+
+class SerialPortWorker;
+
+// The host side of the Arduino connection. The serial port, the connection handshake, the request parsing and the
+// Interface with its drivers all run on a worker thread of their own, so nothing done on the thread owning the
+// SerialHost (the UI) adds latency to the Arduino's requests. The calls below are handed over to the worker.
+// Notifications for the UI come back through a lock-free queue and are delivered on the owning thread.
+// It has no UI of its own, the GUI and the console daemon both drive one of these.
+class SerialHost : public QObject
+{
+	Q_OBJECT
+public:
+	// Device number and pin configuration the Arduino is given when it connects.
+	struct DeviceConfig
+	{
+		DeviceConfig();
+
+		ushort deviceNumber;
+		ushort atnPin;
+		ushort clockPin;
+		ushort dataPin;
+		ushort resetPin;
+		ushort srqInPin;
+	};
+
+	// Callback Interface for the UI, called on the thread owning the SerialHost. Progress (bytesRead/bytesWritten)
+	// is summed up while the UI is behind, so a busy UI gets fewer but larger steps.
+	struct IHostNotify
+	{
+		virtual void directoryChanged(const QString& newPath) = 0;
+		// The listing holds the lines of the image directory, empty if the file system has none.
+		virtual void imageMounted(const QString& imagePath, const QStringList& listing) = 0;
+		virtual void imageUnmounted() = 0;
+		virtual void fileLoading(const QString& fileName, ushort fileSize) = 0;
+		virtual void fileSaving(const QString& fileName) = 0;
+		virtual void bytesRead(uint numBytes) = 0;
+		virtual void bytesWritten(uint numBytes) = 0;
+		virtual void fileClosed(const QString& lastFileName) = 0;
+		virtual void deviceNumberChanged(ushort deviceNumber) = 0;
+		virtual void deviceReset() = 0;
+		// Response to data given to processSimulatedData(), it is not written to the port.
+		virtual void simulatedResponse(const QByteArray& data) = 0;
+	};
+
+	explicit SerialHost(QObject* parent = 0);
+	~SerialHost();
+
+	// Opening and closing wait for the worker, the rest of the calls don't.
+	bool openPort(const QString& portName, uint baudRate);
+	void closePort();
+	void setBaudRate(uint baudRate);
+	QString portName() const
+	{
+		return m_portName;
+	}
+
+	uint baudRate() const
+	{
+		return m_baudRate;
+	}
+
+	// Initializes the Raspberry Pi GPIO line wired to the Arduino reset, false where there is none.
+	bool setupResetLine();
+	// Drops the connection and restarts the Arduino, it will then do a new connection request.
+	void resetArduino();
+
+	// Takes effect the next time the Arduino connects.
+	void setDeviceConfig(const DeviceConfig& config);
+	void setWriteProtected(bool writeProtected);
+	bool isWriteProtected() const;
+	void setImageFilters(const QString& filters, bool showDirs);
+	void changeNativeFSDirectory(const QString& newDir);
+	void setImageCacheBytes(qint64 maxBytes);
+	// Open (mount) from the host side instead of on a CBM request.
+	void openLocal(uchar channel, const QByteArray& cmd);
+	// Process bytes as if they were received from the Arduino, the responses go to IHostNotify::simulatedResponse().
+	void processSimulatedData(const QByteArray& data);
+
+	void setNotifyListener(IHostNotify* pListener);
+
+private slots:
+	void deliverNotifications();
+
+private:
+	friend class SerialPortWorker;
+
+	struct Notification
+	{
+		enum Type {
+			DirectoryChanged,
+			ImageMounted,
+			ImageUnmounted,
+			FileLoading,
+			FileSaving,
+			BytesRead,
+			BytesWritten,
+			FileClosed,
+			DeviceNumberChanged,
+			DeviceReset,
+			SimulatedResponse
+		};
+
+		Notification(Type notificationType = DeviceReset, const QString& fileName = QString(), uint number = 0)
+			: type(notificationType), name(fileName), value(number)
+		{}
+
+		Type type;
+		QString name;
+		uint value;
+		QStringList listing;
+		QByteArray data;
+	};
+
+	// Called by the worker thread only.
+	bool hasListener() const
+	{
+		return 0 not_eq m_hasListener.loadAcquire();
+	}
+
+	bool isDelivering() const
+	{
+		return 0 not_eq m_deliveryPending.loadAcquire();
+	}
+
+	bool post(const Notification& notification);
+
+	QThread m_thread;
+	SerialPortWorker* m_pWorker;
+	IHostNotify* m_pListener;
+	QAtomicInt m_hasListener;
+	QAtomicInt m_writeProtected;
+	// Set while a delivery is scheduled on our thread, so that a burst of notifications costs one wakeup.
+	QAtomicInt m_deliveryPending;
+	QAtomicInt m_numDropped;
+	SpscQueue<Notification, 256> m_notifications;
+	QString m_portName;
+	uint m_baudRate;
+};
+
+Q_DECLARE_METATYPE(SerialHost::DeviceConfig)
+
+
+// Lives on the SerialHost's worker thread: owns the serial port, splits the received bytes into requests and hands
+// them to the Interface.
+class SerialPortWorker : public QObject, public Interface::IFileOpsNotify, public ISendLine
+{
+	Q_OBJECT
+public:
+	explicit SerialPortWorker(SerialHost& host);
+	~SerialPortWorker();
+
+	// IFileOpsNotify implementation.
+	void directoryChanged(const QString& newPath);
+	void imageMounted(const QString& imagePath, FileDriverBase* pFileSystem);
+	void imageUnmounted();
+	void fileLoading(const QString& fileName, ushort fileSize);
+	void fileSaving(const QString& fileName);
+	void bytesRead(uint numBytes);
+	void bytesWritten(uint numBytes);
+	void fileClosed(const QString& lastFileName);
+	bool isWriteProtected() const;
+	ushort deviceNumber() const;
+	void setDeviceNumber(ushort deviceNumber);
+	void deviceReset();
+	void writePort(const QByteArray& data, bool flush);
+
+	// ISendLine implementation, collects the image listing for the UI.
+	void send(short lineNo, const QString& text);
+
+public slots:
+	bool openPort(const QString& portName, uint baudRate);
+	void closePort();
+	void setBaudRate(uint baudRate);
+	void resetArduino();
+	void setDeviceConfig(const SerialHost::DeviceConfig& config);
+	void setImageFilters(const QString& filters, bool showDirs);
+	void changeNativeFSDirectory(const QString& newDir);
+	void setImageCacheBytes(qint64 maxBytes);
+	void openLocal(uchar channel, const QByteArray& cmd);
+	void processSimulatedData(const QByteArray& data);
+
+private slots:
+	void onDataAvailable();
+
+private:
+	bool checkConnectRequest(QByteArray& buffer);
+	bool acceptConnection(const QString& versionString);
+	void processData(const QByteArray& data);
+	bool processRequest(const ProtocolParser::Request& request);
+	void processAddNewFacility(const QString& str);
+	void processDebug(const QString& str);
+	void post(const SerialHost::Notification& notification);
+	void postProgress();
+
+	SerialHost& m_host;
+	QSerialPort m_port;
+	// Received bytes while waiting for the connection request.
+	QByteArray m_pendingBuffer;
+	ProtocolParser m_parser;
+	ProtocolParser::Request m_request;
+	bool m_isConnected;
+	// True while the bytes being processed came from processSimulatedData().
+	bool m_simulating;
+	FacilityMap m_clientFacilities;
+	SerialHost::DeviceConfig m_config;
+	// Progress not yet posted to the UI.
+	uint m_unpostedBytesRead;
+	uint m_unpostedBytesWritten;
+	QStringList m_listing;
+	Interface m_iface;
+};
+
+#endif // SERIALHOST_HPP
@@ -31,6 +31,8 @@ struct AppSettings {
 	QString cbmMachine;
 	QString emulatorPalette;
 	ushort cbmBorderWidth;
+	// Memory cap for the cache of mounted images, in megabytes.
+	uint imageCacheMegabytes;
 };
 
 
@@ -0,0 +1,52 @@
+#ifndef SPSCQUEUE_HPP
+#define SPSCQUEUE_HPP
+
+#include <QAtomicInt>
+
+// Fixed size queue for handing items from one thread (the producer) to another (the consumer) without locks.
+// Only the producer may call push() and only the consumer pop(). The producer never waits: push() fails when the
+// queue is full. Each index is written by one side only and published with release / read with acquire ordering.
+template <typename T, int Capacity>
+class SpscQueue
+{
+	// The indexes wrap with a mask, and one slot is kept free to tell a full queue from an empty one.
+	Q_STATIC_ASSERT(Capacity > 1 and 0 == (Capacity bitand (Capacity - 1)));
+
+public:
+	SpscQueue()
+		: m_head(0)
+		, m_tail(0)
+	{}
+
+	bool push(const T& item)
+	{
+		const int tail = m_tail.load();
+		const int next = (tail + 1) bitand (Capacity - 1);
+		if(next == m_head.loadAcquire())
+			return false; // full.
+		m_items[tail] = item;
+		m_tail.storeRelease(next);
+		return true;
+	}
+
+	bool pop(T& item)
+	{
+		const int head = m_head.load();
+		if(head == m_tail.loadAcquire())
+			return false; // empty.
+		item = m_items[head];
+		// Release the slot's contents (e.g. implicitly shared data) before handing the slot back.
+		m_items[head] = T();
+		m_head.storeRelease((head + 1) bitand (Capacity - 1));
+		return true;
+	}
+
+private:
+	T m_items[Capacity];
+	// Next slot to pop, only written by the consumer.
+	QAtomicInt m_head;
+	// Next slot to push, only written by the producer.
+	QAtomicInt m_tail;
+};
+
+#endif // SPSCQUEUE_HPP
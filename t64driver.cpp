@@ -2,6 +2,7 @@
 #include <math.h>
 #include "t64driver.hpp"
 #include "logger.hpp"
+#include "imagecache.hpp"
 
 using namespace Logging;
 
@@ -29,7 +30,7 @@ const QString strPrg("PRG");
 
 
 T64::T64(const QString& fileName)
-	:  FileDriverBase(), m_hostFile(fileName), m_dirEntries(0), m_dirEntry(0),
+	:  FileDriverBase(), m_hostFileName(fileName), m_dirEntries(0), m_dirEntry(0),
 		m_fileOffset(0), m_fileLength(0)
 {
 	if(not fileName.isEmpty())
@@ -46,7 +47,8 @@ T64::~T64()
 bool T64::mountHostImage(const QString& fileName)
 {
 	unmountHostImage();
-	m_hostFile.setFileName(fileName);
+	m_hostFileName = fileName;
+	m_hostFile.setData(imageCache().image(fileName));
 	// Analyse the file open in host file system and if it is a valid t64, set up
 	// variables
 	if(m_hostFile.open(QIODevice::ReadOnly)) {
@@ -78,8 +80,9 @@ bool T64::mountHostImage(const QString& fileName)
 
 void T64::unmountHostImage()
 {
-	if(not m_hostFile.fileName().isEmpty() and m_hostFile.isOpen())
+	if(m_hostFile.isOpen())
 		m_hostFile.close();
+	m_hostFile.setData(QByteArray());
 	// Reset status
 	m_status = NOT_READY;
 } // unmountHostImage
@@ -154,6 +157,29 @@ char T64::getc(void)
 } // fgetc
 
 
+int T64::read(char* dst, int max)
+{
+	int total = 0;
+	// The start address comes from the header, so these are given one at a time.
+	while(total < max and not isEOF() and (OFFSET_PRE1 == m_fileOffset or OFFSET_PRE2 == m_fileOffset))
+		dst[total++] = getc();
+
+	if(total < max and not isEOF()) {
+		qint64 numRead = m_hostFile.read(dst + total, qMin(max - total, m_fileLength - m_fileOffset));
+		if(numRead <= 0) // shouldn't happen?
+			m_status = FILE_EOF;
+		else {
+			total += numRead;
+			m_fileOffset += numRead;
+			if(m_fileOffset == m_fileLength)
+				m_status or_eq FILE_EOF;
+		}
+	}
+
+	return total;
+} // read
+
+
 bool T64::seekFirstDir(void)
 {
 	if(m_status bitand IMAGE_OK) {
@@ -306,9 +332,13 @@ bool T64::sendListing(ISendLine& cb)
 	while(getDirEntry(dir)) {
 		// Determine if dir entry is valid:
 		if(0 not_eq dir.c64sFileType and 0 not_eq dir.d64FileType) {
+			const QString fileName(QString::fromLocal8Bit(reinterpret_cast<char*>(dir.fileName), sizeof(dir.fileName)));
+			// All files are listed as PRG, the name is matched without its padding.
+			if(not listingFilter().matches(fileName.trimmed(), 'P'))
+				continue;
 			ushort fileBlocks = (calcFileLength(dir) + T64_BLOCK_DATA - 1) / T64_BLOCK_DATA;
 			// Send filename, which is padded with spaces, line number is just zero.
-			QString line = QString("  \"%1\" %2").arg(QString::fromLocal8Bit(reinterpret_cast<char*>(dir.fileName), sizeof(dir.fileName)), strPrg);
+			QString line = QString("  \"%1\" %2").arg(fileName, strPrg);
 
 			cb.send(fileBlocks, line.mid((int)log10((double)fileBlocks)));
 		}
@@ -324,7 +354,7 @@ bool T64::sendMediaInfo(ISendLine &cb)
 {
 	// TODO: Improve this with information about the file system type AND, usage and free data.
 	Log("T64", info, "sendMediaInfo.");
-	cb.send(0, QString("T64 FS -> %1").arg(m_hostFile.fileName()));
+	cb.send(0, QString("T64 FS -> %1").arg(m_hostFileName));
 	cb.send(1, QString("FILE SIZE: %1").arg(QString::number(m_hostFile.size())));
 	cb.send(2, QString("%1 FILE(S) IN IMAGE.").arg(QString::number(m_dirEntries)));
 
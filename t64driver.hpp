@@ -1,6 +1,8 @@
 #ifndef T64DRIVER_H
 #define T64DRIVER_H
 
+#include <QBuffer>
+
 #include "filedriverbase.hpp"
 
 
@@ -52,6 +54,8 @@ public:
 	//
 	// Get character from open file:
 	char getc(void);
+	// Copy up to max bytes from open file:
+	int read(char* dst, int max);
 
 	//
 	// Returns true if last character was retrieved:
@@ -101,8 +105,9 @@ private:
 #ifdef _MSC_VER
 #pragma pack(pop, before_1)
 #endif
-	// The real host file system D64 image file:
-	QFile m_hostFile;
+	// The real host file system T64 image file name, and its contents as shared with the image cache.
+	QString m_hostFileName;
+	QBuffer m_hostFile;
 
 	// T64 driver state variables:
 
@@ -0,0 +1,61 @@
+# Build settings shared by the core library, the console daemon and the GUI.
+
+DEFINES += CONSOLE_DEBUG
+
+win32-msvc* {
+	# Multiple build processes with jom
+	# only works in .pro file for MSVC compilers, for gnu add -j8 in projects / make
+	QMAKE_CXXFLAGS += /MP
+}
+else {
+	# explicit enabling of c++11 under all gnu compilers.
+	QMAKE_CXXFLAGS += -std=gnu++0x
+}
+
+win32 {
+	OBJPRE = win
+	# Add this for static linking of mingw libs. Note: Needs static Qt version.
+	# QMAKE_LFLAGS += -static-libgcc -static-libstdc++ -static
+}
+
+unix {
+	OBJPRE = nix
+}
+
+# To compile for Raspberry PI, run qmake with the flags: CONFIG+=raspberry
+raspberry {
+	# So wiringPi include files can be found during compile
+	INCLUDEPATH += /usr/local/include
+	# To link the wiringPi library when making the executable
+	LIBS += -L/usr/local/lib -lwiringPi
+	# To conditionally compile wiringPi so that it still builds on other platforms.
+	DEFINES += "HAS_WIRINGPI="
+
+	OBJPRE = pi
+} #raspberry
+
+mac {
+	OBJPRE = mac
+}
+
+# The core sources and headers live in the top directory.
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+# we want intermediate build files stored in configuration and platform specific folders.
+# Reason is not getting compile errors when switching from building under one platform to another.
+# Object file formats are different. We don't want to mix release and debug either.
+CONFIG(debug, debug|release) {
+		REL = debug
+} else {
+		REL = release
+}
+
+OBJECTS_DIR = $$quote($${REL}/.obj$${OBJPRE})
+DESTDIR = $$quote($${REL})
+MOC_DIR = $$quote($${REL}/.moc)
+RCC_DIR = $$quote($${REL}/.rcc)
+UI_DIR = $$quote($${REL}/.ui)
+
+# Where the core library ends up, for the applications linking it.
+CORE_LIB_DIR = $$shadowed($$PWD)/core/$${REL}
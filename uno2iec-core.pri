@@ -0,0 +1,12 @@
+# Link the headless core library (Interface, file drivers, DOS commands and the serial host) into an application.
+
+QT += serialport
+
+LIBS += -L$$CORE_LIB_DIR -luno2iec-core
+
+win32-msvc* {
+	PRE_TARGETDEPS += $$CORE_LIB_DIR/uno2iec-core.lib
+}
+else {
+	PRE_TARGETDEPS += $$CORE_LIB_DIR/libuno2iec-core.a
+}
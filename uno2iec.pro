@@ -0,0 +1,40 @@
+#-------------------------------------------------
+#
+# Builds the headless core library first, then the console daemon and the GUI that both link it, and the benchmarks
+# of the drive CPU emulation (uno2iec-cpubench), of the GCR decoding of G64 images (uno2iec-gcrbench) and of the
+# protocol parser (uno2iec-parserbench).
+# On unix also the Arduino sketch as a host program against a mock Arduino core (uno2iec-sim), and the same with a
+# simulated C64 and the core library for timing transfers (uno2iec-bench), the serial protocol against the core library
+# through a pseudo terminal (uno2iec-protobench), and the checks of the IEC driver's bus timing against the simulated
+# C64 (uno2iec-test).
+#
+#-------------------------------------------------
+
+TEMPLATE = subdirs
+
+SUBDIRS = core daemon gui cpubench gcrbench parserbench
+
+core.file = core/uno2iec-core.pro
+daemon.file = uno2iecd/uno2iecd.pro
+daemon.depends = core
+gui.file = rpi2iec.pro
+gui.depends = core
+cpubench.file = cpubench/cpubench.pro
+cpubench.depends = core
+gcrbench.file = gcrbench/gcrbench.pro
+gcrbench.depends = core
+parserbench.file = parserbench/parserbench.pro
+parserbench.depends = core
+
+unix {
+	SUBDIRS += sim
+	sim.file = uno2iec/host/uno2iec-sim.pro
+	SUBDIRS += bench
+	bench.file = uno2iec/host/uno2iec-bench.pro
+	bench.depends = core
+	SUBDIRS += protobench
+	protobench.file = uno2iec/host/uno2iec-protobench.pro
+	protobench.depends = core
+	SUBDIRS += test
+	test.file = uno2iec/host/uno2iec-test.pro
+}
@@ -8,7 +8,7 @@ namespace CBM {
 #define CBM1541_RAM_SIZE  (1024 * 2)
 #define CBM1541_VIA1_OFFSET 0x1800
 #define CBM1541_VIA1_SIZE 0x10
-#define CBM1541_VIA2_OFFSET 0x1800
+#define CBM1541_VIA2_OFFSET 0x1C00
 #define CBM1541_VIA2_SIZE 0x10
 #define CBM1541_ROM_OFFSET 0xC000
 #define CBM1541_ROM_SIZE (1024 * 16)
@@ -16,9 +16,29 @@ namespace CBM {
 // Largest Serial byte buffer request from / to arduino.
 #define MAX_BYTES_PER_REQUEST 256
 
+// The base pointer of basic, listings are linked as a BASIC program loaded here.
+#define C64_BASIC_START 0x0801
+
 // For every change of the serial protocol that makes a difference enough for incompitability, this number
 // should be increased. That way the host side can detect whether the peers are compatible or not.
-#define CURRENT_UNO2IEC_PROTOCOL_VERSION 2
+#define CURRENT_UNO2IEC_PROTOCOL_VERSION 8
+// The oldest protocol version the host side still accepts a connection from. Version 2 only knows the stop-and-wait
+// 'N' / 'R' file transfer, version 3 and later stream files with the windowed 'F' request. Version 4 and later
+// request directory listings in batches of ready made BASIC lines ('M') instead of line by line ('L'). Version 5 and
+// later read the command channel with a single 'T' request instead of an 'O' and an 'E', which also carries the
+// bytes of a memory read (M-R). Version 6 and later read, write and close the direct access channels 2-14 ("#")
+// with 'G', 'P' and 'K'. Version 7 and later abort a windowed read with 'X' and drain up to its acknowledgement.
+// Version 8 and later replay the bus lines of drive code started with M-E, B-E or U3-U8 ('V').
+#define MIN_UNO2IEC_PROTOCOL_VERSION 2
+
+// Bus replay ('V'): Entries of the microseconds to wait (little endian) and the lines the drive pulls after that.
+// A wait is at most MAX_BUS_REPLAY_DELAY, which the Arduino can wait exactly. A response holds as many entries as fit
+// in the half of the Arduino's request buffer that is in front of its ATN command.
+#define BUS_REPLAY_CLOCK 0x01
+#define BUS_REPLAY_DATA 0x02
+#define BUS_REPLAY_ENTRY_SIZE 3
+#define MAX_BUS_REPLAY_DELAY 16000
+#define MAX_BUS_REPLAY_BYTES (42 * BUS_REPLAY_ENTRY_SIZE)
 
 // Device OPEN channels.
 // Special channels.
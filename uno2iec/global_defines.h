@@ -2,7 +2,7 @@
 #define GLOBAL_DEFINES_HPP
 
 #ifdef UNDER_QT
-// Reason for defining this is only that Qt Creator should understand the define when browsing the source files
+// Defined when browsing the source files in Qt Creator and when building the sketch for the host (uno2iec/host).
 // It won't be defined like this when compiling under arduino tools.
 #define PROGMEM
 #define __flash
@@ -22,6 +22,11 @@ typedef unsigned long ulong;
 // arduino to go into a reset state and wait for the CBM to become ready for communiction.
 #define HAS_RESET_LINE
 
+// Define this to let CBMs with a JiffyDOS kernal use the JiffyDOS fast serial protocol for LOAD, SAVE and channel
+// reads. The support is detected on every bus command, other CBMs keep using the standard protocol.
+// NOTE: Timer1 is used as the time base for the JiffyDOS bit timing, so PWM on pins 9 and 10 is not available.
+#define USE_JIFFYDOS
+
 // Define this if you want to include the support for the MAX7219 display library in this project.
 // What it does is showing loading progress on the display and some nice scrolling of the filename and other
 // stuff on the display. The display hardware can be bought cheap here at dx.com:
@@ -32,10 +37,10 @@ typedef unsigned long ulong;
 // with the commodore machine completely wireless. Defining this will configure the BT module in the main sketch.
 //#define CONFIG_HC06_BLUETOOTH
 
-// Define this for speed increase when reading (filling serial buffer while transferring
-// to CBM without interrupts off). It is experimental, stability needs to be checked
-// further even though it seems to work just fine.
-//#define EXPERIMENTAL_SPEED_FIX
+// Define this for speed increase when reading (filling serial buffer while transferring to CBM without interrupts
+// off). The host then streams a window of packets ahead while the bytes are sent to the CBM. Without it interrupts
+// are off while talking to the CBM and the file is transferred a packet at a time, stop-and-wait.
+#define EXPERIMENTAL_SPEED_FIX
 
 // For serial communication. 115200 Works fine, but probably use 57600 for bluetooth dongle for stability.
 #define DEFAULT_BAUD_RATE 115200
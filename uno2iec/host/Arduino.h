@@ -0,0 +1,131 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// Mock Arduino core for building the sketch on the host (Linux), see mockarduino.h for the simulation side of it.
+// Only what the sketch uses is here. Program memory is ordinary memory, so the _P functions are the plain ones.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef uint8_t byte;
+typedef uint16_t word;
+typedef bool boolean;
+
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#define PGM_P const char*
+#define F(string) (string)
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#define pgm_read_word(address) (*(const uint16_t*)(address))
+#define sprintf_P sprintf
+#define sscanf_P sscanf
+#define strcpy_P strcpy
+#define strcat_P strcat
+#define strlen_P strlen
+#define memcpy_P memcpy
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+
+#define lowByte(w) ((uint8_t)((w) & 0xff))
+#define highByte(w) ((uint8_t)((w) >> 8))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+
+// No interrupts to hold off, the simulation runs the sketch on a single thread.
+inline void noInterrupts()
+{
+}
+
+inline void interrupts()
+{
+}
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+// The virtual clock, see mockarduino.h.
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+
+// Size of the receive ring of the serial port, as on the ATmega328.
+#define SERIAL_RX_BUFFER_SIZE 64
+
+// The serial port of the sketch, backed by a pseudo terminal or by in-memory buffers.
+class HardwareSerial
+{
+public:
+	HardwareSerial();
+
+	void begin(unsigned long baud);
+	void end();
+	void setTimeout(unsigned long timeout);
+
+	int available(void);
+	int peek(void);
+	int read(void);
+	void flush(void);
+
+	size_t write(uint8_t data);
+	size_t write(const uint8_t* buffer, size_t size);
+	size_t write(const char* str)
+	{
+		return write((const uint8_t*)str, strlen(str));
+	}
+
+	size_t print(const char* str)
+	{
+		return write(str);
+	}
+
+	size_t print(char c)
+	{
+		return write((uint8_t)c);
+	}
+
+	size_t print(int value);
+	size_t print(unsigned value);
+
+	// Stream functions, waiting for at most the timeout.
+	size_t readBytes(char* buffer, size_t length);
+	size_t readBytes(uint8_t* buffer, size_t length)
+	{
+		return readBytes((char*)buffer, length);
+	}
+
+	size_t readBytesUntil(char terminator, char* buffer, size_t length);
+	bool find(const char* target);
+
+	operator bool()
+	{
+		return true;
+	}
+
+private:
+	int timedRead();
+
+	unsigned long m_baud;
+	unsigned long m_timeout;
+};
+
+extern HardwareSerial Serial;
+
+#endif // ARDUINO_H
@@ -0,0 +1,166 @@
+//
+// Title	: uno2iec-bench - end to end transfer timing in simulated time
+//
+// Runs the Arduino sketch against the mock Arduino core with a simulated C64 on its IEC lines and the media host's
+// Interface (from the core library) on the other end of its serial line, all in one process on the virtual clock.
+// The C64 runs LOADs, SAVEs and directory listings through the KERNAL serial routines, and the simulated time of
+// each is printed. Nothing depends on the speed or load of the machine running it, so two runs give the same numbers
+// and changes to the sketch, the protocol or the host can be compared by them.
+//
+// The media host answers in no (virtual) time, what is measured is the IEC bus, the sketch and the serial line.
+//
+// DISCLAIMER:
+// The author is in no way responsible for any problems or damage caused by
+// using this code. Use at your own risk.
+//
+// LICENSE:
+// This code is distributed under the GNU Public License
+// which can be found at http://www.gnu.org/licenses/gpl.txt
+//
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <stdio.h>
+
+#include "hostlink.h"
+#include "serialhost.hpp"
+// Last, the mock Arduino.h has macros of the Arduino core.
+#include "mockarduino.h"
+#include "c64bus.h"
+
+namespace firmware {
+void setup();
+void loop();
+} // namespace firmware
+
+namespace {
+
+// Give up when the jobs haven't finished in this much virtual time.
+const uint64_t MAX_NANOS = 3600ULL * 1000000000ULL;
+
+// The host link on the in-memory serial line of the mock core, the Interface answers in no virtual time.
+class MockHostLink : public HostLink, public MockPeripheral
+{
+public:
+	MockHostLink(Interface& iface, ushort deviceNumber, bool verbose)
+		: HostLink(iface, deviceNumber, verbose)
+	{}
+
+	// MockPeripheral implementation.
+	void advanceTo(uint64_t nanos)
+	{
+		Q_UNUSED(nanos);
+		uint8_t buffer[64];
+		size_t length;
+		while(0 not_eq (length = mockSerialTake(buffer, sizeof(buffer))))
+			processInput(reinterpret_cast<const char*>(buffer), int(length));
+	}
+
+	void writePort(const QByteArray& data, bool flush = true)
+	{
+		Q_UNUSED(flush);
+		mockSerialFeed(reinterpret_cast<const uint8_t*>(data.constData()), data.size());
+	}
+};
+
+
+const char* jobName(C64Bus::JobType type)
+{
+	switch(type) {
+		case C64Bus::Load:
+			return "LOAD";
+		case C64Bus::Save:
+			return "SAVE";
+		default:
+			return "DIRECTORY";
+	}
+} // jobName
+
+} // unnamed namespace
+
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication a(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Times LOADs, SAVEs and directory listings of a simulated C64 through the sketch "
+																	 "and the media host, in simulated time.");
+	parser.addHelpOption();
+	QCommandLineOption dirOption(QStringList() << "d" << "directory", "Directory with the images and programs to serve.",
+															 "path", QDir::currentPath());
+	QCommandLineOption filtersOption("filters", "Comma separated file filters for the directory listing.", "filters",
+																	 "*.D64,*.D71,*.D81,*.G64,*.T64,*.M2I,*.PRG,*.P00,*.SID");
+	QCommandLineOption loadOption(QStringList() << "l" << "load", "LOAD the file (repeatable).", "name");
+	QCommandLineOption saveOption(QStringList() << "s" << "save",
+																"SAVE the local file, under its name without the extension (repeatable).", "file");
+	QCommandLineOption listOption("list", "LOAD the directory (\"$\").");
+	QCommandLineOption deviceOption(QStringList() << "n" << "device", "CBM device number.", "number",
+																	QString::number(DEFAULT_DEVICE_NUMBER));
+	QCommandLineOption verboseOption(QStringList() << "v" << "verbose", "Print the log lines of the sketch.");
+	parser.addOption(dirOption);
+	parser.addOption(filtersOption);
+	parser.addOption(loadOption);
+	parser.addOption(saveOption);
+	parser.addOption(listOption);
+	parser.addOption(deviceOption);
+	parser.addOption(verboseOption);
+	parser.process(a);
+
+	const ushort deviceNumber = parser.value(deviceOption).toUShort();
+	C64Bus c64(DEFAULT_ATN_PIN, DEFAULT_CLOCK_PIN, DEFAULT_DATA_PIN, deviceNumber);
+	if(parser.isSet(listOption))
+		c64.addJob(C64Bus::Directory, "$");
+	foreach(const QString& name, parser.values(loadOption))
+		c64.addJob(C64Bus::Load, name.toUpper().toStdString());
+	foreach(const QString& fileName, parser.values(saveOption)) {
+		QFile file(fileName);
+		if(not file.open(QIODevice::ReadOnly)) {
+			fprintf(stderr, "Could not read %s\n", qPrintable(fileName));
+			return 1;
+		}
+		const QByteArray bytes(file.readAll());
+		c64.addJob(C64Bus::Save, QFileInfo(fileName).completeBaseName().toUpper().toStdString(),
+							 std::vector<uint8_t>(bytes.constData(), bytes.constData() + bytes.size()));
+	}
+	if(c64.jobs().empty())
+		parser.showHelp(1);
+
+	const QString imageDirectory(parser.value(dirOption));
+	QDir::setCurrent(imageDirectory);
+	Interface iface;
+	MockHostLink host(iface, deviceNumber, parser.isSet(verboseOption));
+	iface.setMountNotifyListener(&host);
+	iface.setImageFilters(parser.value(filtersOption), false);
+	iface.changeNativeFSDirectory(imageDirectory);
+
+	// Deterministic: No pacing, the in-memory serial line and the C64 only joining once the sketch is connected.
+	mockSetPacing(false);
+	mockAddPeripheral(&host);
+	firmware::setup();
+	mockAddPeripheral(&c64);
+	while(not c64.isDone() and mockNanos() < MAX_NANOS)
+		firmware::loop();
+	mockRemovePeripheral(&c64);
+	mockRemovePeripheral(&host);
+	iface.setMountNotifyListener(0);
+
+	bool allDone = c64.isDone();
+	for(size_t i = 0; i < c64.jobs().size(); ++i) {
+		const C64Bus::Job& job = c64.jobs()[i];
+		const double micros = double(job.endNanos - job.startNanos) / 1000.0;
+		const size_t numBytes = job.data.size();
+		printf("%-9s \"%s\": %s, %u bytes in %.0f us", jobName(job.type), job.name.c_str(),
+					 job.success ? "ok" : "FAILED", unsigned(numBytes), micros);
+		if(numBytes)
+			printf(" (%.1f us/byte, %.0f bytes/s)", micros / numBytes, numBytes * 1000000.0 / micros);
+		printf("\n");
+		allDone = allDone and job.success;
+	}
+	if(not c64.isDone())
+		printf("Timed out after %.0f us of simulated time.\n", double(mockNanos()) / 1000.0);
+	return allDone ? 0 : 1;
+} // main
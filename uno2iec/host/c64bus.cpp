@@ -0,0 +1,433 @@
+#include "c64bus.h"
+
+namespace {
+
+// KERNAL serial bus timing (us).
+const uint64_t KERNAL_CALL = 100;     // from calling LISTEN/TALK until ATN is pulled (RS-232 check, line setup).
+const uint64_t ATN_DELAY = 1000;      // ATN held before the first byte, devices answer by pulling DATA.
+const uint64_t ATN_RELEASE = 50;      // ATN released before the clock and data at the end of a sequence.
+const uint64_t NON_EOI_DELAY = 40;    // listener ready for data until the talker pulls the clock (Tne).
+const uint64_t EOI_TIMEOUT = 200;     // listener's EOI detection (Tye).
+const uint64_t EOI_ACK = 60;          // listener's DATA pulse acknowledging the EOI (Tei).
+const uint64_t BIT_SETUP = 20;        // data bit set up before the clock is released (Ts).
+const uint64_t BIT_VALID = 20;        // clock released with the data bit valid (Tv).
+const uint64_t FRAME_ACK = 1000;      // the listener has this long to accept a byte (Tf).
+const uint64_t BIT_TIMEOUT = 1000;    // the talker has this long for each bit.
+const uint64_t TURNAROUND = 10000;    // the device has this long to become talker.
+const uint64_t HOST_WAIT = 2000000;   // waits that include a round trip to the media host.
+const uint64_t BYTE_LOOP = 60;        // LOAD/SAVE loop around each byte (store it, check STOP, advance the pointer).
+
+// JiffyDOS timing (us), as the drive side in iec_driver.cpp (after sd2iec) expects it. The bit times count from the
+// edge starting the byte.
+const uint64_t JIFFY_DETECT_WINDOW = 400; // clock held before the last bit under ATN, a JiffyDOS device pulses DATA.
+const uint64_t JIFFY_READY = 10;          // from the other side being ready until the C64 starts a byte (poll, SEI).
+const uint64_t JIFFY_LOAD_PULSE = 4;      // LOAD: DATA pulled to ask for the next byte.
+// Sending, the bit pairs (4, 5), (6, 7), (3, 1), (2, 0) go on (clock, data) halfway between the times the listener
+// samples them, pulled = 1. Then the clock tells EOI (released) or not.
+const uint64_t JIFFY_SEND_TIMES[4] = { 8, 29, 46, 59 };
+const uint8_t JIFFY_SEND_CLOCK_BITS[4] = { 1 << 4, 1 << 6, 1 << 3, 1 << 2 };
+const uint8_t JIFFY_SEND_DATA_BITS[4] = { 1 << 5, 1 << 7, 1 << 1, 1 << 0 };
+const uint64_t JIFFY_SEND_EOI = 69;
+// Receiving, the bit pairs (0, 1), (2, 3), (4, 5), (6, 7) are sampled on (clock, data) between the talker's changes,
+// released = 1. Then EOI is clock released and data pulled, not EOI the other way around.
+const uint64_t JIFFY_RECEIVE_TIMES[4] = { 15, 25, 36, 46 };
+const uint64_t JIFFY_RECEIVE_EOI = 57;
+
+const uint8_t LISTEN = 0x20;
+const uint8_t UNLISTEN = 0x3F;
+const uint8_t TALK = 0x40;
+const uint8_t UNTALK = 0x5F;
+const uint8_t DATA = 0x60;
+const uint8_t CLOSE = 0xE0;
+const uint8_t OPEN = 0xF0;
+
+const size_t STACK_SIZE = 256 * 1024;
+
+// The C64 being started, makecontext() can't pass it a pointer portably.
+C64Bus* s_pStarting = 0;
+
+} // unnamed namespace
+
+
+C64Bus::C64Bus(uint8_t atnPin, uint8_t clockPin, uint8_t dataPin, uint8_t deviceNumber)
+	: m_atnPin(atnPin), m_clockPin(clockPin), m_dataPin(dataPin), m_deviceNumber(deviceNumber), m_now(0)
+	, m_jiffyDos(false), m_jiffyActive(false), m_jiffyDevice(false), m_jiffyLoad(false), m_stack(STACK_SIZE), m_wakeAt(0)
+	, m_waitPin(-1), m_waitLevel(false), m_started(false), m_done(false)
+{
+	getcontext(&m_c64Context);
+	m_c64Context.uc_stack.ss_sp = &m_stack[0];
+	m_c64Context.uc_stack.ss_size = m_stack.size();
+	// When run() is done, the sketch continues.
+	m_c64Context.uc_link = &m_sketchContext;
+	makecontext(&m_c64Context, &C64Bus::entry, 0);
+} // ctor
+
+
+C64Bus::~C64Bus()
+{
+	pull(m_atnPin, false);
+	pull(m_clockPin, false);
+	pull(m_dataPin, false);
+} // dtor
+
+
+void C64Bus::addJob(JobType type, const std::string& name, const std::vector<uint8_t>& data)
+{
+	Job job = { type, name, data, false, 0, 0 };
+	m_jobs.push_back(job);
+} // addJob
+
+
+void C64Bus::advanceTo(uint64_t nanos)
+{
+	m_now = nanos;
+	if(m_done)
+		return;
+	if(m_started) {
+		const bool lineReached = m_waitPin >= 0 and level(m_waitPin) == m_waitLevel;
+		if(nanos < m_wakeAt and not lineReached)
+			return;
+	}
+	else {
+		m_started = true;
+		s_pStarting = this;
+	}
+	swapcontext(&m_sketchContext, &m_c64Context);
+} // advanceTo
+
+
+void C64Bus::entry()
+{
+	C64Bus* pThis = s_pStarting;
+	pThis->run();
+	pThis->m_done = true;
+} // entry
+
+
+void C64Bus::run()
+{
+	for(size_t i = 0; i < m_jobs.size(); ++i) {
+		Job& job = m_jobs[i];
+		job.startNanos = m_now;
+		job.success = runJob(job);
+		job.endNanos = m_now;
+		// Leave the bus released whatever happened, and give the drive a moment before the next job.
+		pull(m_atnPin, false);
+		pull(m_clockPin, false);
+		pull(m_dataPin, false);
+		wait(10000);
+	}
+} // run
+
+
+bool C64Bus::runJob(Job& job)
+{
+	if(Save == job.type) {
+		// SAVE: open for writing on secondary 1, LISTEN and send all bytes, the last one with EOI.
+		if(not open(1, job.name) or not listen(DATA bitor 1))
+			return false;
+		for(size_t i = 0; i < job.data.size(); ++i) {
+			if(not sendByte(job.data[i], i + 1 == job.data.size()))
+				return false;
+			wait(BYTE_LOOP);
+		}
+		return unlisten() and close(1);
+	}
+
+	// LOAD (and the directory, which is LOAD"$"): open on secondary 0, TALK and receive until EOI. A JiffyDOS device is
+	// asked to use the LOAD protocol by talking on secondary 1.
+	job.data.clear();
+	if(not open(0, Directory == job.type ? std::string("$") : job.name) or not talk(DATA bitor (m_jiffyDevice ? 1 : 0)))
+		return false;
+	bool eoi = false;
+	while(not eoi) {
+		uint8_t data;
+		if(not receiveByte(data, eoi))
+			return false;
+		job.data.push_back(data);
+		wait(BYTE_LOOP);
+	}
+	return untalk() and close(0);
+} // runJob
+
+
+// Starts an ATN sequence: the devices stop whatever they do and listen for a command.
+bool C64Bus::atnStart()
+{
+	wait(KERNAL_CALL);
+	m_jiffyActive = false;
+	m_jiffyLoad = false;
+	pull(m_atnPin, true);
+	pull(m_clockPin, true);
+	pull(m_dataPin, false);
+	wait(ATN_DELAY);
+	// Device not present if nobody holds DATA by now.
+	return not level(m_dataPin);
+} // atnStart
+
+
+// Ends an ATN sequence, the C64 keeps the clock (it is still the talker).
+void C64Bus::atnRelease()
+{
+	pull(m_atnPin, false);
+	wait(ATN_RELEASE);
+} // atnRelease
+
+
+bool C64Bus::listen(uint8_t secondary)
+{
+	if(not atnStart() or not sendByte(LISTEN bitor m_deviceNumber, false) or not sendByte(secondary, false))
+		return false;
+	atnRelease();
+	return true;
+} // listen
+
+
+bool C64Bus::talk(uint8_t secondary)
+{
+	if(not atnStart() or not sendByte(TALK bitor m_deviceNumber, false) or not sendByte(secondary, false))
+		return false;
+	m_jiffyLoad = m_jiffyActive and (DATA bitor 1) == secondary;
+	// Turnaround: the C64 becomes listener, holding DATA, and waits for the device to take the clock.
+	pull(m_dataPin, true);
+	atnRelease();
+	pull(m_clockPin, false);
+	return waitFor(m_clockPin, false, TURNAROUND);
+} // talk
+
+
+bool C64Bus::unlisten()
+{
+	if(not atnStart() or not sendByte(UNLISTEN, false))
+		return false;
+	atnRelease();
+	pull(m_clockPin, false);
+	pull(m_dataPin, false);
+	return true;
+} // unlisten
+
+
+bool C64Bus::untalk()
+{
+	if(not atnStart() or not sendByte(UNTALK, false))
+		return false;
+	atnRelease();
+	pull(m_clockPin, false);
+	pull(m_dataPin, false);
+	return true;
+} // untalk
+
+
+bool C64Bus::open(uint8_t secondary, const std::string& name)
+{
+	if(not listen(OPEN bitor secondary))
+		return false;
+	for(size_t i = 0; i < name.size(); ++i) {
+		if(not sendByte(uint8_t(name[i]), i + 1 == name.size()))
+			return false;
+	}
+	return unlisten();
+} // open
+
+
+bool C64Bus::close(uint8_t secondary)
+{
+	return listen(CLOSE bitor secondary) and unlisten();
+} // close
+
+
+// KERNAL CIOUT: send a byte as talker, the C64 holds the clock when called.
+bool C64Bus::sendByte(uint8_t data, bool eoi)
+{
+	const bool underAtn = not level(m_atnPin);
+	if(m_jiffyActive and not underAtn)
+		return sendJiffyByte(data, eoi);
+	const uint8_t byte = data;
+
+	// Ready to send: release the clock, then wait for the listener to release DATA (ready for data).
+	pull(m_clockPin, false);
+	if(not waitFor(m_dataPin, true, HOST_WAIT))
+		return false;
+
+	if(eoi) {
+		// Not pulling the clock within the EOI timeout signals the last byte, the listener acknowledges it.
+		if(not waitFor(m_dataPin, false, EOI_TIMEOUT + FRAME_ACK) or not waitFor(m_dataPin, true, FRAME_ACK))
+			return false;
+	}
+	wait(NON_EOI_DELAY);
+	pull(m_clockPin, true);
+
+	// The bits, least significant first. Released DATA is a 1, valid while the clock is released.
+	for(uint8_t n = 0; n < 8; n++) {
+		if(7 == n and m_jiffyDos and underAtn)
+			detectJiffyDos(byte);
+		pull(m_dataPin, not (data bitand 1));
+		data >>= 1;
+		wait(BIT_SETUP);
+		pull(m_clockPin, false);
+		wait(BIT_VALID);
+		pull(m_clockPin, true);
+		pull(m_dataPin, false);
+	}
+
+	// The listener accepts the byte by pulling DATA.
+	return waitFor(m_dataPin, false, FRAME_ACK);
+} // sendByte
+
+
+// KERNAL ACPTR: receive a byte as listener, the C64 holds DATA when called.
+bool C64Bus::receiveByte(uint8_t& data, bool& eoi)
+{
+	if(m_jiffyActive)
+		return receiveJiffyByte(data, eoi);
+	eoi = false;
+	// Talker ready to send, then say we're ready for data.
+	if(not waitFor(m_clockPin, true, HOST_WAIT))
+		return false;
+	pull(m_dataPin, false);
+
+	// The talker pulls the clock in time, unless this is the last byte.
+	if(not waitFor(m_clockPin, false, EOI_TIMEOUT)) {
+		eoi = true;
+		pull(m_dataPin, true);
+		wait(EOI_ACK);
+		pull(m_dataPin, false);
+		if(not waitFor(m_clockPin, false, FRAME_ACK))
+			return false;
+	}
+
+	data = 0;
+	for(uint8_t n = 0; n < 8; n++) {
+		if(not waitFor(m_clockPin, true, BIT_TIMEOUT))
+			return false;
+		data >>= 1;
+		data or_eq (level(m_dataPin) ? (1 << 7) : 0);
+		if(not waitFor(m_clockPin, false, BIT_TIMEOUT))
+			return false;
+	}
+
+	// Accept the byte.
+	pull(m_dataPin, true);
+	return true;
+} // receiveByte
+
+
+// Before the last bit of a byte under ATN, with the clock held: a JiffyDOS device pulls DATA for a moment meanwhile if
+// the byte is a LISTEN or TALK to it.
+void C64Bus::detectJiffyDos(uint8_t data)
+{
+	JiffyDetection detection = { data, m_now, 0, 0 };
+	const uint64_t endNanos = m_now + JIFFY_DETECT_WINDOW * 1000;
+	if(waitFor(m_dataPin, false, JIFFY_DETECT_WINDOW)) {
+		detection.pulseNanos = m_now;
+		if(waitFor(m_dataPin, true, (endNanos - m_now) / 1000))
+			detection.pulseEndNanos = m_now;
+	}
+	waitUntil(endNanos);
+	m_jiffyDetections.push_back(detection);
+
+	const bool answered = 0 not_eq detection.pulseEndNanos;
+	m_jiffyActive = m_jiffyActive or answered;
+	if((LISTEN bitor m_deviceNumber) == data or (TALK bitor m_deviceNumber) == data)
+		m_jiffyDevice = answered;
+} // detectJiffyDos
+
+
+// JiffyDOS byte to a listener, the C64 holds the clock when called. Once the listener has released DATA, releasing the
+// clock starts the byte. The listener accepts it by pulling DATA, then the clock is held again.
+bool C64Bus::sendJiffyByte(uint8_t data, bool eoi)
+{
+	if(not waitFor(m_dataPin, true, HOST_WAIT))
+		return false;
+	wait(JIFFY_READY);
+	pull(m_clockPin, false);
+	const uint64_t start = m_now;
+	m_jiffyByteStarts.push_back(start);
+	for(uint8_t n = 0; n < 4; n++) {
+		waitUntil(start + JIFFY_SEND_TIMES[n] * 1000);
+		pull(m_clockPin, data bitand JIFFY_SEND_CLOCK_BITS[n]);
+		pull(m_dataPin, data bitand JIFFY_SEND_DATA_BITS[n]);
+	}
+	waitUntil(start + JIFFY_SEND_EOI * 1000);
+	pull(m_clockPin, not eoi);
+	pull(m_dataPin, false);
+
+	const bool accepted = waitFor(m_dataPin, false, FRAME_ACK);
+	pull(m_clockPin, true);
+	return accepted;
+} // sendJiffyByte
+
+
+// JiffyDOS byte from a talker, the C64 holds DATA when called (but in the LOAD protocol). The talker releasing the
+// clock says it is ready, then the C64 starts the byte: by releasing DATA, in the LOAD protocol by a short pulse of it.
+// A byte is accepted by pulling DATA, the LOAD protocol does without. There the talker holds the clock after each byte
+// (not EOI) until it is ready for the next.
+bool C64Bus::receiveJiffyByte(uint8_t& data, bool& eoi)
+{
+	if(m_jiffyLoad)
+		pull(m_dataPin, false);
+	if(not waitFor(m_clockPin, true, HOST_WAIT))
+		return false;
+	wait(JIFFY_READY);
+	const uint64_t start = m_now;
+	m_jiffyByteStarts.push_back(start);
+	if(m_jiffyLoad) {
+		pull(m_dataPin, true);
+		wait(JIFFY_LOAD_PULSE);
+	}
+	pull(m_dataPin, false);
+
+	data = 0;
+	for(uint8_t n = 0; n < 4; n++) {
+		waitUntil(start + JIFFY_RECEIVE_TIMES[n] * 1000);
+		data or_eq (level(m_clockPin) ? 1 : 0) << (2 * n);
+		data or_eq (level(m_dataPin) ? 2 : 0) << (2 * n);
+	}
+	waitUntil(start + JIFFY_RECEIVE_EOI * 1000);
+	const bool clockReleased = level(m_clockPin);
+	const bool dataReleased = level(m_dataPin);
+	if(clockReleased == dataReleased)
+		return false; // not sent at all, e.g. file not found.
+	eoi = clockReleased;
+	if(not m_jiffyLoad)
+		pull(m_dataPin, true);
+	return true;
+} // receiveJiffyByte
+
+
+void C64Bus::wait(uint64_t micros)
+{
+	m_wakeAt = m_now + micros * 1000;
+	m_waitPin = -1;
+	yield();
+} // wait
+
+
+void C64Bus::waitUntil(uint64_t nanos)
+{
+	if(nanos <= m_now)
+		return;
+	m_wakeAt = nanos;
+	m_waitPin = -1;
+	yield();
+} // waitUntil
+
+
+bool C64Bus::waitFor(uint8_t pin, bool lineLevel, uint64_t timeoutMicros)
+{
+	if(level(pin) == lineLevel)
+		return true;
+	m_wakeAt = m_now + timeoutMicros * 1000;
+	m_waitPin = pin;
+	m_waitLevel = lineLevel;
+	yield();
+	m_waitPin = -1;
+	return level(pin) == lineLevel;
+} // waitFor
+
+
+// Hands back to the sketch until the wait is over.
+void C64Bus::yield()
+{
+	swapcontext(&m_c64Context, &m_sketchContext);
+} // yield
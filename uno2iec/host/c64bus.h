@@ -0,0 +1,159 @@
+#ifndef C64BUS_H
+#define C64BUS_H
+
+#include <ucontext.h>
+#include <string>
+#include <vector>
+
+#include "mockarduino.h"
+
+// A simulated C64 on the IEC bus: the controller side of the KERNAL serial routines (ATN sequences, LISTEN/TALK,
+// OPEN/CLOSE and the byte handshake with EOI) driving the sketch's IEC lines in virtual time. It runs a list of jobs
+// (LOAD, SAVE, directory listing) the way the KERNAL does them and takes the simulated time of each.
+//
+// The C64 side is written as plain sequential code running in a context of its own. Whenever it waits (for some
+// time or for a line to change) it hands back to the sketch, and the virtual clock resumes it once the wait is over.
+// Only one of them runs at any time, so all of it is deterministic.
+// The tests script the bus their own way by overriding run() with calls of the KERNAL routines.
+//
+// With a JiffyDOS kernal the C64 holds the clock before the last bit of each byte under ATN, and if the device pulses
+// DATA meanwhile the bytes of that LISTEN or TALK go the JiffyDOS way, two bits at a time: LOADs with the JiffyDOS LOAD
+// protocol (TALK on secondary 1 after opening 0), SAVEs and the other bytes with its byte protocol. The times of the
+// detection and of the start of every JiffyDOS byte are kept for checking the drive's timing against them.
+class C64Bus : public MockPeripheral
+{
+public:
+	enum JobType {
+		Load,
+		Save,
+		Directory
+	};
+
+	// A byte sent under ATN by a JiffyDOS C64, and the device's answer if any.
+	struct JiffyDetection
+	{
+		uint8_t data;
+		// When the clock hold before the last bit began, and when DATA was pulled and released during it (0 if it wasn't).
+		uint64_t holdNanos;
+		uint64_t pulseNanos;
+		uint64_t pulseEndNanos;
+	};
+
+	struct Job
+	{
+		JobType type;
+		std::string name;
+		// Save: the bytes to save (with the load address). Load and Directory: the bytes received.
+		std::vector<uint8_t> data;
+		bool success;
+		// Virtual time from the OPEN to the end of the CLOSE.
+		uint64_t startNanos;
+		uint64_t endNanos;
+	};
+
+	C64Bus(uint8_t atnPin, uint8_t clockPin, uint8_t dataPin, uint8_t deviceNumber);
+	virtual ~C64Bus();
+
+	void addJob(JobType type, const std::string& name, const std::vector<uint8_t>& data = std::vector<uint8_t>());
+	// Whether the C64 has a JiffyDOS kernal, off by default.
+	void setJiffyDos(bool jiffyDos)
+	{
+		m_jiffyDos = jiffyDos;
+	}
+	const std::vector<Job>& jobs() const
+	{
+		return m_jobs;
+	}
+
+	// True when all jobs have run.
+	bool isDone() const
+	{
+		return m_done;
+	}
+
+	const std::vector<JiffyDetection>& jiffyDetections() const
+	{
+		return m_jiffyDetections;
+	}
+
+	// The edge each JiffyDOS byte started with (the bit times count from it), received and sent.
+	const std::vector<uint64_t>& jiffyByteStarts() const
+	{
+		return m_jiffyByteStarts;
+	}
+
+	// MockPeripheral implementation.
+	void advanceTo(uint64_t nanos);
+
+protected:
+	// The C64 side, runs the jobs.
+	virtual void run();
+
+	// KERNAL serial routines.
+	bool atnStart();
+	void atnRelease();
+	bool listen(uint8_t secondary);
+	bool talk(uint8_t secondary);
+	bool unlisten();
+	bool untalk();
+	bool open(uint8_t secondary, const std::string& name);
+	bool close(uint8_t secondary);
+	bool sendByte(uint8_t data, bool eoi);
+	bool receiveByte(uint8_t& data, bool& eoi);
+
+	// JiffyDOS, see the .cpp. sendByte() and receiveByte() use them once the device has answered the detection.
+	void detectJiffyDos(uint8_t data);
+	bool sendJiffyByte(uint8_t data, bool eoi);
+	bool receiveJiffyByte(uint8_t& data, bool& eoi);
+
+	// true == PULL == LOW, false == RELEASE == HIGH
+	void pull(uint8_t pin, bool pull)
+	{
+		mockPullLine(pin, pull);
+	}
+
+	// false = LOW, true == HIGH
+	bool level(uint8_t pin) const
+	{
+		return mockLineLevel(pin);
+	}
+
+	void wait(uint64_t micros);
+	void waitUntil(uint64_t nanos);
+	// Waits for the line to be at the level, false on timeout.
+	bool waitFor(uint8_t pin, bool level, uint64_t timeoutMicros);
+
+	uint8_t m_atnPin;
+	uint8_t m_clockPin;
+	uint8_t m_dataPin;
+	uint8_t m_deviceNumber;
+	// Virtual time the C64 side runs at.
+	uint64_t m_now;
+	bool m_jiffyDos;
+	// The device answered the detection in the current ATN sequence, and in the last LISTEN or TALK to it.
+	bool m_jiffyActive;
+	bool m_jiffyDevice;
+	// Talking with the JiffyDOS LOAD protocol.
+	bool m_jiffyLoad;
+
+private:
+	static void entry();
+	bool runJob(Job& job);
+	void yield();
+
+	std::vector<Job> m_jobs;
+	std::vector<JiffyDetection> m_jiffyDetections;
+	std::vector<uint64_t> m_jiffyByteStarts;
+
+	ucontext_t m_sketchContext;
+	ucontext_t m_c64Context;
+	std::vector<char> m_stack;
+	// The C64 side is resumed at this time, or before if m_waitPin gets to m_waitLevel.
+	uint64_t m_wakeAt;
+	int m_waitPin;
+	bool m_waitLevel;
+	bool m_started;
+	bool m_done;
+};
+
+#endif // C64BUS_H
@@ -0,0 +1,12 @@
+// The sketch for uno2iec-bench. The bench links the media host's core library too, which has classes of the same
+// names (Interface), so here all of the sketch is built as one translation unit inside a namespace of its own.
+#include <Arduino.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace firmware {
+#include "../iec_driver.cpp"
+#include "../interface.cpp"
+#include "../log.cpp"
+#include "../uno2iec.ino"
+} // namespace firmware
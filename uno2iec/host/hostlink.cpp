@@ -0,0 +1,147 @@
+#include <stdio.h>
+
+#include "hostlink.h"
+#include "serialhost.hpp"
+
+namespace {
+
+const QString OkString = "OK>%1|%2|%3|%4|%5|%6|2026-01-01.12:00:00\r";
+const QString ConnectionString = "connect_arduino:";
+
+} // unnamed namespace
+
+
+HostLink::HostLink(Interface& iface, ushort deviceNumber, bool verbose)
+	: m_iface(iface), m_deviceNumber(deviceNumber), m_verbose(verbose), m_isConnected(false)
+{
+} // ctor
+
+
+HostLink::~HostLink()
+{
+} // dtor
+
+
+void HostLink::processInput(const char* pData, int length)
+{
+	if(m_isConnected) {
+		processData(pData, length);
+		return;
+	}
+	m_pendingBuffer.append(pData, length);
+	checkConnectRequest();
+} // processInput
+
+
+void HostLink::directoryChanged(const QString& newPath)
+{
+	Q_UNUSED(newPath);
+} // directoryChanged
+
+
+void HostLink::imageMounted(const QString& imagePath, FileDriverBase* pFileSystem)
+{
+	Q_UNUSED(imagePath);
+	Q_UNUSED(pFileSystem);
+} // imageMounted
+
+
+void HostLink::imageUnmounted()
+{
+} // imageUnmounted
+
+
+void HostLink::fileLoading(const QString& fileName, ushort fileSize)
+{
+	Q_UNUSED(fileName);
+	Q_UNUSED(fileSize);
+} // fileLoading
+
+
+void HostLink::fileSaving(const QString& fileName)
+{
+	Q_UNUSED(fileName);
+} // fileSaving
+
+
+void HostLink::bytesRead(uint numBytes)
+{
+	Q_UNUSED(numBytes);
+} // bytesRead
+
+
+void HostLink::bytesWritten(uint numBytes)
+{
+	Q_UNUSED(numBytes);
+} // bytesWritten
+
+
+void HostLink::fileClosed(const QString& lastFileName)
+{
+	Q_UNUSED(lastFileName);
+} // fileClosed
+
+
+bool HostLink::isWriteProtected() const
+{
+	return false;
+} // isWriteProtected
+
+
+ushort HostLink::deviceNumber() const
+{
+	return m_deviceNumber;
+} // deviceNumber
+
+
+void HostLink::setDeviceNumber(ushort deviceNumber)
+{
+	m_deviceNumber = deviceNumber;
+} // setDeviceNumber
+
+
+void HostLink::deviceReset()
+{
+} // deviceReset
+
+
+void HostLink::checkConnectRequest()
+{
+	const int connectPos = m_pendingBuffer.indexOf(ConnectionString);
+	if(-1 == connectPos) {
+		m_pendingBuffer = m_pendingBuffer.right(ConnectionString.length());
+		return;
+	}
+	const int endPos = m_pendingBuffer.indexOf('\r', connectPos);
+	if(-1 == endPos)
+		return;
+
+	const QString response = OkString.arg(QString::number(m_deviceNumber)).arg(QString::number(DEFAULT_ATN_PIN))
+			.arg(QString::number(DEFAULT_CLOCK_PIN)).arg(QString::number(DEFAULT_DATA_PIN))
+			.arg(QString::number(DEFAULT_RESET_PIN)).arg(QString::number(DEFAULT_SRQIN_PIN));
+	writePort(response.toLatin1());
+	m_isConnected = true;
+	m_parser.reset();
+	const QByteArray rest(m_pendingBuffer.mid(endPos + 1));
+	m_pendingBuffer.clear();
+	processData(rest.constData(), rest.size());
+} // checkConnectRequest
+
+
+void HostLink::processData(const char* pData, int remaining)
+{
+	while(remaining) {
+		const int written = m_parser.write(pData, remaining);
+		pData += written;
+		remaining -= written;
+		while(m_parser.next(m_request)) {
+			if('!' == m_request.command or 'D' == m_request.command) {
+				// Facilities and log lines of the sketch.
+				if(m_verbose)
+					printf("%.*s\n", m_request.payload.size(), m_request.payload.constData());
+			}
+			else if(not m_iface.processRequest(m_request) and m_verbose)
+				printf("Unexpected byte from the Arduino: 0x%02x\n", uchar(m_request.command));
+		}
+	}
+} // processData
@@ -0,0 +1,52 @@
+#ifndef HOSTLINK_H
+#define HOSTLINK_H
+
+#include <QByteArray>
+#include <QString>
+
+#include "interface.hpp"
+#include "protocolparser.hpp"
+
+// The media host end of the Arduino's serial line for the benches: answers the connection request with the device
+// config, then hands the requests to the Interface the way the serial worker of the real host does. What the bytes
+// travel on is up to the subclass, it feeds what the Arduino sent to processInput() and puts writePort() on the line.
+class HostLink : public Interface::IFileOpsNotify
+{
+public:
+	HostLink(Interface& iface, ushort deviceNumber, bool verbose);
+	virtual ~HostLink();
+
+	void processInput(const char* pData, int length);
+	bool isConnected() const
+	{
+		return m_isConnected;
+	}
+
+	// IFileOpsNotify implementation, nothing to reflect without a UI. writePort() is left to the subclass.
+	void directoryChanged(const QString& newPath);
+	void imageMounted(const QString& imagePath, FileDriverBase* pFileSystem);
+	void imageUnmounted();
+	void fileLoading(const QString& fileName, ushort fileSize);
+	void fileSaving(const QString& fileName);
+	void bytesRead(uint numBytes);
+	void bytesWritten(uint numBytes);
+	void fileClosed(const QString& lastFileName);
+	bool isWriteProtected() const;
+	ushort deviceNumber() const;
+	void setDeviceNumber(ushort deviceNumber);
+	void deviceReset();
+
+private:
+	void checkConnectRequest();
+	void processData(const char* pData, int remaining);
+
+	Interface& m_iface;
+	ushort m_deviceNumber;
+	bool m_verbose;
+	bool m_isConnected;
+	QByteArray m_pendingBuffer;
+	ProtocolParser m_parser;
+	ProtocolParser::Request m_request;
+};
+
+#endif // HOSTLINK_H
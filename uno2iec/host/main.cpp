@@ -0,0 +1,34 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "mockarduino.h"
+
+// uno2iec-sim: Runs the Arduino sketch on the host. The serial port of the sketch is a pseudo terminal, give its
+// path as the port to the media host (e.g. uno2iecd --port /dev/pts/3). Nothing is connected to the IEC bus.
+
+int main(int argc, char* argv[])
+{
+	bool pacing = true;
+	for(int i = 1; i < argc; ++i) {
+		if(0 == strcmp(argv[i], "--no-pacing"))
+			pacing = false;
+		else {
+			fprintf(stderr, "Usage: %s [--no-pacing]\n"
+							"  --no-pacing  Run as fast as possible instead of in step with the wall clock.\n", argv[0]);
+			return 0 == strcmp(argv[i], "--help") ? 0 : 1;
+		}
+	}
+
+	const char* portName = mockSerialOpenPty();
+	if(0 == portName) {
+		perror("Could not open a pseudo terminal");
+		return 1;
+	}
+	printf("Arduino serial port: %s\n", portName);
+	fflush(stdout);
+
+	mockSetPacing(pacing);
+	setup();
+	for(;;)
+		loop();
+} // main
@@ -0,0 +1,496 @@
+#define _XOPEN_SOURCE 600
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+#include "mockarduino.h"
+
+HardwareSerial Serial;
+
+namespace {
+
+// Cost of the core calls in virtual time, as on a 16 MHz ATmega328.
+const uint64_t PIN_ACCESS_NANOS = 63;     // one cycle, sbi/cbi/sbic on a fast pin.
+const uint64_t CLOCK_READ_NANOS = 250;    // micros()/millis() with interrupts held off.
+const uint64_t SERIAL_POLL_NANOS = 500;   // looking at the serial receive buffer.
+const uint64_t SERIAL_WAIT_NANOS = 10000; // smallest step of a wait for serial input.
+// Peripherals are stepped at least this often, so they can react while the sketch is in a delay.
+const uint64_t PERIPHERAL_STEP_NANOS = 1000;
+// How far the virtual clock may get ahead of the wall clock before the simulation sleeps.
+const uint64_t PACING_SLICE_NANOS = 1000000;
+const size_t TX_BUFFER_SIZE = 64;
+// The receive ring of the Arduino core holds one byte less than its size.
+const size_t RX_RING_SIZE = SERIAL_RX_BUFFER_SIZE - 1;
+
+uint64_t s_nanos = 0;
+bool s_pacing = true;
+uint64_t s_pacedUpTo = 0;
+timespec s_wallStart;
+std::vector<MockPeripheral*> s_peripherals;
+
+uint8_t s_pinMode[MOCK_NUM_PINS];
+uint8_t s_pinValue[MOCK_NUM_PINS];
+bool s_externalPull[MOCK_NUM_PINS];
+
+int s_ptyFd = -1;
+int s_ptySlaveFd = -1;
+// A byte on the serial line and when it has been completely transferred.
+struct LineByte
+{
+	uint64_t doneAt;
+	uint8_t data;
+};
+
+// Bytes on their way to the sketch, the ones received and not yet read (at most RX_RING_SIZE), and the bytes it has
+// written: in memory mode until they are taken, with a pseudo terminal until they are through the line.
+std::deque<LineByte> s_rx;
+std::deque<uint8_t> s_rxRing;
+std::deque<LineByte> s_tx;
+// Received bytes lost because the receive ring was full.
+size_t s_rxDropped = 0;
+// Time per byte on the line, and when the last byte in each direction is through.
+uint64_t s_byteNanos = 10 * 1000000000ULL / 115200;
+uint64_t s_rxDoneAt = 0;
+uint64_t s_txDoneAt = 0;
+
+
+uint64_t wallNanos()
+{
+	if(0 == s_wallStart.tv_sec and 0 == s_wallStart.tv_nsec)
+		clock_gettime(CLOCK_MONOTONIC, &s_wallStart);
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return uint64_t(now.tv_sec - s_wallStart.tv_sec) * 1000000000ULL + now.tv_nsec - s_wallStart.tv_nsec;
+} // wallNanos
+
+
+// Puts bytes on the line to the sketch, one after the other at the baud rate.
+void receive(const uint8_t* data, size_t length)
+{
+	if(s_rxDoneAt < s_nanos)
+		s_rxDoneAt = s_nanos;
+	for(size_t i = 0; i < length; ++i) {
+		s_rxDoneAt += s_byteNanos;
+		LineByte lineByte = { s_rxDoneAt, data[i] };
+		s_rx.push_back(lineByte);
+	}
+} // receive
+
+
+// Moves the bytes that are through the line into the receive ring. Like the UART's interrupt handler, a byte that
+// arrives when the ring is full is lost. The sketch only reads from the ring, so doing this before it looks gives the
+// same result as doing it as each byte arrives.
+size_t numReceived()
+{
+	while(not s_rx.empty() and s_rx.front().doneAt <= s_nanos) {
+		if(s_rxRing.size() < RX_RING_SIZE)
+			s_rxRing.push_back(s_rx.front().data);
+		else
+			++s_rxDropped;
+		s_rx.pop_front();
+	}
+	return s_rxRing.size();
+} // numReceived
+
+
+void pollSerialInput()
+{
+	if(s_ptyFd < 0)
+		return;
+	uint8_t buffer[256];
+	ssize_t numRead = ::read(s_ptyFd, buffer, sizeof(buffer));
+	if(numRead > 0)
+		receive(buffer, numRead);
+} // pollSerialInput
+
+
+// Lets time pass until serial input might have arrived. With a pseudo terminal the wall clock time spent waiting
+// for the media host is what passes.
+void waitForSerialInput()
+{
+	// Something on the way, that is when it is through.
+	if(not s_rx.empty()) {
+		mockAdvance(s_rx.front().doneAt - s_nanos);
+		return;
+	}
+	if(s_ptyFd < 0) {
+		mockAdvance(SERIAL_WAIT_NANOS);
+		return;
+	}
+	const uint64_t start = wallNanos();
+	pollfd pfd = { s_ptyFd, POLLIN, 0 };
+	poll(&pfd, 1, 1);
+	mockAdvance(std::max(wallNanos() - start, SERIAL_WAIT_NANOS));
+} // waitForSerialInput
+
+
+void transmit(uint8_t data)
+{
+	LineByte lineByte = { s_txDoneAt, data };
+	s_tx.push_back(lineByte);
+} // transmit
+
+
+bool isTransmitted()
+{
+	return s_ptyFd >= 0 and not s_tx.empty() and s_tx.front().doneAt <= s_nanos;
+} // isTransmitted
+
+
+// The media host gets the bytes on the pseudo terminal when they are through the line, not when they were written.
+void deliverTransmitted()
+{
+	while(isTransmitted()) {
+		// Like a serial line with nobody listening, bytes the media host doesn't take are lost.
+		const uint8_t data = s_tx.front().data;
+		s_tx.pop_front();
+		if(1 not_eq ::write(s_ptyFd, &data, 1))
+			continue;
+	}
+} // deliverTransmitted
+
+} // unnamed namespace
+
+
+uint64_t mockNanos()
+{
+	return s_nanos;
+} // mockNanos
+
+
+void mockAdvance(uint64_t nanos)
+{
+	const uint64_t end = s_nanos + nanos;
+	do {
+		s_nanos = s_peripherals.empty() ? end : std::min(end, s_nanos + PERIPHERAL_STEP_NANOS);
+		for(size_t i = 0; i < s_peripherals.size(); ++i)
+			s_peripherals[i]->advanceTo(s_nanos);
+	} while(s_nanos < end);
+
+	// Bytes for the media host are paced each, they must not get to it before their time.
+	if(s_pacing and (s_nanos - s_pacedUpTo >= PACING_SLICE_NANOS or isTransmitted())) {
+		s_pacedUpTo = s_nanos;
+		const uint64_t wall = wallNanos();
+		if(s_nanos > wall) {
+			const uint64_t ahead = s_nanos - wall;
+			timespec sleepTime = { time_t(ahead / 1000000000ULL), long(ahead % 1000000000ULL) };
+			nanosleep(&sleepTime, 0);
+		}
+	}
+	deliverTransmitted();
+} // mockAdvance
+
+
+void mockSetPacing(bool pacing)
+{
+	s_pacing = pacing;
+} // mockSetPacing
+
+
+void mockCatchUp()
+{
+	const uint64_t wall = wallNanos();
+	if(s_pacing and wall > s_nanos)
+		mockAdvance(wall - s_nanos);
+} // mockCatchUp
+
+
+void mockAddPeripheral(MockPeripheral* pPeripheral)
+{
+	s_peripherals.push_back(pPeripheral);
+} // mockAddPeripheral
+
+
+void mockRemovePeripheral(MockPeripheral* pPeripheral)
+{
+	s_peripherals.erase(std::remove(s_peripherals.begin(), s_peripherals.end(), pPeripheral), s_peripherals.end());
+} // mockRemovePeripheral
+
+
+bool mockSketchPulls(uint8_t pin)
+{
+	return pin < MOCK_NUM_PINS and OUTPUT == s_pinMode[pin] and LOW == s_pinValue[pin];
+} // mockSketchPulls
+
+
+bool mockLineLevel(uint8_t pin)
+{
+	if(pin >= MOCK_NUM_PINS)
+		return true;
+	return not (mockSketchPulls(pin) or s_externalPull[pin]);
+} // mockLineLevel
+
+
+void mockPullLine(uint8_t pin, bool pull)
+{
+	if(pin < MOCK_NUM_PINS)
+		s_externalPull[pin] = pull;
+} // mockPullLine
+
+
+const char* mockSerialOpenPty()
+{
+	int fd = posix_openpt(O_RDWR bitor O_NOCTTY);
+	if(fd < 0)
+		return 0;
+	const char* slaveName = 0;
+	if(0 == grantpt(fd) and 0 == unlockpt(fd))
+		slaveName = ptsname(fd);
+	// The slave side is kept open here too, so that the pseudo terminal survives the media host closing its port.
+	// It is raw until the media host configures it.
+	int slaveFd = slaveName ? open(slaveName, O_RDWR bitor O_NOCTTY) : -1;
+	if(slaveFd < 0) {
+		close(fd);
+		return 0;
+	}
+	termios tio;
+	if(0 == tcgetattr(slaveFd, &tio)) {
+		cfmakeraw(&tio);
+		tcsetattr(slaveFd, TCSANOW, &tio);
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) bitor O_NONBLOCK);
+
+	s_ptyFd = fd;
+	s_ptySlaveFd = slaveFd;
+	return slaveName;
+} // mockSerialOpenPty
+
+
+void mockSerialFeed(const uint8_t* data, size_t length)
+{
+	receive(data, length);
+} // mockSerialFeed
+
+
+size_t mockSerialDropped()
+{
+	return s_rxDropped;
+} // mockSerialDropped
+
+
+size_t mockSerialTake(uint8_t* buffer, size_t maxLength)
+{
+	size_t length = 0;
+	while(length < maxLength and not s_tx.empty() and s_tx.front().doneAt <= s_nanos) {
+		buffer[length++] = s_tx.front().data;
+		s_tx.pop_front();
+	}
+	return length;
+} // mockSerialTake
+
+
+/******************************************************************************
+ *                                                                             *
+ *                              Arduino core API                               *
+ *                                                                             *
+ ******************************************************************************/
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+	mockAdvance(PIN_ACCESS_NANOS);
+	if(pin >= MOCK_NUM_PINS)
+		return;
+	// As on the Arduino, making the pin an input also sets its pull-up (the output bit) off or on.
+	s_pinMode[pin] = OUTPUT == mode ? OUTPUT : INPUT;
+	if(OUTPUT not_eq mode)
+		s_pinValue[pin] = INPUT_PULLUP == mode ? HIGH : LOW;
+} // pinMode
+
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+	mockAdvance(PIN_ACCESS_NANOS);
+	if(pin < MOCK_NUM_PINS)
+		s_pinValue[pin] = value ? HIGH : LOW;
+} // digitalWrite
+
+
+int digitalRead(uint8_t pin)
+{
+	mockAdvance(PIN_ACCESS_NANOS);
+	if(pin < MOCK_NUM_PINS and OUTPUT == s_pinMode[pin])
+		return s_pinValue[pin];
+	return mockLineLevel(pin) ? HIGH : LOW;
+} // digitalRead
+
+
+unsigned long millis(void)
+{
+	mockAdvance(CLOCK_READ_NANOS);
+	return (unsigned long)(s_nanos / 1000000);
+} // millis
+
+
+unsigned long micros(void)
+{
+	mockAdvance(CLOCK_READ_NANOS);
+	return (unsigned long)(s_nanos / 1000);
+} // micros
+
+
+void delay(unsigned long ms)
+{
+	mockAdvance(uint64_t(ms) * 1000000);
+} // delay
+
+
+void delayMicroseconds(unsigned int us)
+{
+	mockAdvance(uint64_t(us) * 1000);
+} // delayMicroseconds
+
+
+HardwareSerial::HardwareSerial()
+	: m_baud(115200), m_timeout(1000)
+{
+} // ctor
+
+
+void HardwareSerial::begin(unsigned long baud)
+{
+	m_baud = baud;
+	// start, eight data and a stop bit.
+	s_byteNanos = 10 * 1000000000ULL / baud;
+} // begin
+
+
+void HardwareSerial::end()
+{
+} // end
+
+
+void HardwareSerial::setTimeout(unsigned long timeout)
+{
+	m_timeout = timeout;
+} // setTimeout
+
+
+int HardwareSerial::available(void)
+{
+	mockAdvance(SERIAL_POLL_NANOS);
+	pollSerialInput();
+	return int(numReceived());
+} // available
+
+
+int HardwareSerial::peek(void)
+{
+	return available() ? s_rxRing.front() : -1;
+} // peek
+
+
+int HardwareSerial::read(void)
+{
+	if(not available())
+		return -1;
+	int data = s_rxRing.front();
+	s_rxRing.pop_front();
+	return data;
+} // read
+
+
+void HardwareSerial::flush(void)
+{
+	// Waits for the transmission to complete.
+	if(s_txDoneAt > s_nanos)
+		mockAdvance(s_txDoneAt - s_nanos);
+} // flush
+
+
+size_t HardwareSerial::write(uint8_t data)
+{
+	if(s_txDoneAt < s_nanos)
+		s_txDoneAt = s_nanos;
+	// The sketch only waits when the transmit buffer is full.
+	const uint64_t buffered = TX_BUFFER_SIZE * s_byteNanos;
+	if(s_txDoneAt - s_nanos > buffered)
+		mockAdvance(s_txDoneAt - s_nanos - buffered);
+	s_txDoneAt += s_byteNanos;
+	transmit(data);
+	return 1;
+} // write
+
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+	for(size_t i = 0; i < size; ++i)
+		write(buffer[i]);
+	return size;
+} // write
+
+
+size_t HardwareSerial::print(int value)
+{
+	char buffer[12];
+	snprintf(buffer, sizeof(buffer), "%d", value);
+	return write(buffer);
+} // print
+
+
+size_t HardwareSerial::print(unsigned value)
+{
+	char buffer[12];
+	snprintf(buffer, sizeof(buffer), "%u", value);
+	return write(buffer);
+} // print
+
+
+int HardwareSerial::timedRead()
+{
+	const uint64_t start = s_nanos;
+	do {
+		int data = read();
+		if(data >= 0)
+			return data;
+		waitForSerialInput();
+	} while(s_nanos - start < uint64_t(m_timeout) * 1000000);
+	return -1;
+} // timedRead
+
+
+size_t HardwareSerial::readBytes(char* buffer, size_t length)
+{
+	size_t count = 0;
+	while(count < length) {
+		int data = timedRead();
+		if(data < 0)
+			break;
+		buffer[count++] = char(data);
+	}
+	return count;
+} // readBytes
+
+
+size_t HardwareSerial::readBytesUntil(char terminator, char* buffer, size_t length)
+{
+	size_t count = 0;
+	while(count < length) {
+		int data = timedRead();
+		if(data < 0 or terminator == data)
+			break;
+		buffer[count++] = char(data);
+	}
+	return count;
+} // readBytesUntil
+
+
+bool HardwareSerial::find(const char* target)
+{
+	const size_t length = strlen(target);
+	size_t matched = 0;
+	while(matched < length) {
+		int data = timedRead();
+		if(data < 0)
+			return false;
+		if(target[matched] == data)
+			++matched;
+		else
+			matched = target[0] == data ? 1 : 0;
+	}
+	return true;
+} // find
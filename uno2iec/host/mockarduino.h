@@ -0,0 +1,69 @@
+#ifndef MOCKARDUINO_H
+#define MOCKARDUINO_H
+
+#include <stdint.h>
+#include "Arduino.h"
+
+// Simulation side of the mock Arduino core.
+//
+// Virtual clock: Time only moves on when the sketch spends it. Every call into the core costs about what the
+// corresponding access costs on a 16 MHz ATmega328 with the fast pin HAL (a pin access is a cycle or two), and
+// delay()/delayMicroseconds() move the clock by exactly the given time. That way the bit timing of the IEC driver can
+// be looked at on the host with a resolution of nanoseconds, independent of how fast the host runs the code.
+// With pacing (the default) the simulation sleeps whenever the virtual clock gets ahead of the wall clock, so a real
+// media host on the other end of the serial port sees about the timing of an Arduino.
+//
+// Pins: The IEC lines are open collector with pull-ups. A pin pulls its line when it is an output driven LOW,
+// peripherals (e.g. a simulated CBM) pull lines with mockPullLine() and are stepped along with the virtual clock, at
+// least every microsecond (also through a delay of the sketch).
+//
+// Serial: Either a pseudo terminal (the media host opens its slave side as the Arduino's serial port) or in-memory
+// buffers for driving the sketch from the same process. Bytes take their time on the line at the configured baud rate
+// in both directions. The sketch only waits for its own when the 64 byte transmit buffer is full, like on the Arduino.
+// What it doesn't read in time is kept in a ring of SERIAL_RX_BUFFER_SIZE - 1 bytes, bytes arriving when that is full
+// are dropped as by the Arduino's UART interrupt.
+
+enum {
+	MOCK_NUM_PINS = 20
+};
+
+// Something living on the simulated bus or serial line, called whenever the virtual clock moves on.
+class MockPeripheral
+{
+public:
+	virtual ~MockPeripheral()
+	{}
+
+	virtual void advanceTo(uint64_t nanos) = 0;
+};
+
+// Virtual clock.
+uint64_t mockNanos();
+void mockAdvance(uint64_t nanos);
+void mockSetPacing(bool pacing);
+// With pacing, moves the virtual clock on to the wall clock if it fell behind, e.g. while the program using the core
+// did something else than running the sketch.
+void mockCatchUp();
+void mockAddPeripheral(MockPeripheral* pPeripheral);
+void mockRemovePeripheral(MockPeripheral* pPeripheral);
+
+// Pins, as seen from the bus: false == LOW (pulled by anyone), true == HIGH (released).
+bool mockLineLevel(uint8_t pin);
+void mockPullLine(uint8_t pin, bool pull);
+// Whether the sketch itself pulls the line.
+bool mockSketchPulls(uint8_t pin);
+
+// Serial. Opens a pseudo terminal for the serial port, returns the path of its slave side or 0 on failure.
+const char* mockSerialOpenPty();
+// In-memory serial (used when no pseudo terminal is open): bytes for the sketch to read, and what it has written (the
+// bytes that are through the line by now).
+void mockSerialFeed(const uint8_t* data, size_t length);
+// Received bytes lost so far because the sketch didn't read them in time.
+size_t mockSerialDropped();
+size_t mockSerialTake(uint8_t* buffer, size_t maxLength);
+
+// The sketch, runs setup() and then loop() forever.
+void setup();
+void loop();
+
+#endif // MOCKARDUINO_H
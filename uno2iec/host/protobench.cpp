@@ -0,0 +1,777 @@
+//
+// Title	: uno2iec-protobench - serial protocol throughput and latency through a pseudo terminal
+//
+// A software Arduino stand-in speaks the serial protocol of the sketch ('O', 'S', 'F'/'N' and 'R', 'M'/'L', 'W', 'C'
+// and 'E') to the media host's Interface (from the core library) over a pseudo terminal pair. The stand-in runs on
+// the mock Arduino core, so its serial port has the Arduino's baud rate and transmit buffer, the Interface is served
+// by a thread of its own on the other side of the pseudo terminal like the serial worker of the real host.
+// It runs LOADs, SAVEs and directory listings over a corpus of PRG files and D64/T64 images it makes up front, and
+// prints the bytes per second, the round trips per file and the latency percentiles of each job type and request.
+//
+// Unlike uno2iec-bench the clock is the wall clock (the mock core is paced), so what the media host takes to answer
+// is part of the numbers, and so is the machine running it. The CBM side is reduced to a time per byte.
+//
+// DISCLAIMER:
+// The author is in no way responsible for any problems or damage caused by
+// using this code. Use at your own risk.
+//
+// LICENSE:
+// This code is distributed under the GNU Public License
+// which can be found at http://www.gnu.org/licenses/gpl.txt
+//
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QAtomicInt>
+#include <QFile>
+#include <QDir>
+#include <QList>
+#include <QPair>
+#include <QElapsedTimer>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <map>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+#include "hostlink.h"
+#include "serialhost.hpp"
+// Last, the mock Arduino.h has macros of the Arduino core.
+#include "mockarduino.h"
+
+namespace {
+
+// The sketch's windowed transfer, see STREAM_PACKET_SIZE and STREAM_WINDOW in uno2iec/interface.cpp.
+const uint DEFAULT_PACKET_SIZE = 31;
+const uint DEFAULT_WINDOW = 2;
+// The sketch sends at most this many bytes, the 'W' and length included, in one write request.
+const int MAX_WRITE_REQUEST = 0xf0;
+const unsigned long SERIAL_TIMEOUT_MSECS = 2000;
+// How long the media host end waits on input before it looks whether it is to stop.
+const qint64 MAX_POLL_NANOS = 10000000;
+const ushort LOAD_ADDRESS = 0x0801;
+
+// D64 layout: sectors of each track (1 to 35), the directory track and its first sector.
+const int D64_TRACKS = 35;
+const int D64_DIR_TRACK = 18;
+const int D64_SECTOR_SIZE = 256;
+const int D64_SECTOR_DATA = 254;
+
+enum JobType {
+	Load,
+	Save,
+	Directory,
+	NumJobTypes
+};
+
+const char* const jobNames[NumJobTypes] = { "LOAD", "SAVE", "$" };
+
+struct Job
+{
+	JobType type;
+	QByteArray name;
+	// What a LOAD must give, or what a SAVE sends. Not checked when empty.
+	QByteArray data;
+	// A LOAD that is to fail, answered with the error string.
+	bool isMissing;
+
+	bool success;
+	uint numBytes;
+	uint64_t nanos;
+	uint roundTrips;
+	// Windowed reads: the packets the line went idle for, they weren't even on their way when the stand-in was ready.
+	uint stalls;
+};
+
+
+// The media host on the slave side of the pseudo terminal, in a thread of its own. Its responses go out the latency
+// after they were made, that is what a USB serial adapter and the host scheduling add to each round trip.
+class PtyHostLink : public QThread, public HostLink
+{
+public:
+	PtyHostLink(Interface& iface, ushort deviceNumber, const QString& portName, ulong latencyMicros, bool verbose)
+		: HostLink(iface, deviceNumber, verbose), m_portName(portName), m_latencyNanos(qint64(latencyMicros) * 1000)
+		, m_fd(-1), m_stop(0)
+	{}
+
+	~PtyHostLink()
+	{
+		stop();
+	}
+
+	void stop()
+	{
+		m_stop.store(1);
+		wait();
+	}
+
+	void writePort(const QByteArray& data, bool flush = true)
+	{
+		Q_UNUSED(flush);
+		m_responses.push_back(Response(m_clock.nsecsElapsed() + m_latencyNanos, data));
+	}
+
+protected:
+	void run()
+	{
+		m_fd = ::open(m_portName.toLocal8Bit().constData(), O_RDWR bitor O_NOCTTY);
+		if(m_fd < 0) {
+			fprintf(stderr, "Could not open %s\n", qPrintable(m_portName));
+			return;
+		}
+		termios tio;
+		if(0 == tcgetattr(m_fd, &tio)) {
+			cfmakeraw(&tio);
+			tcsetattr(m_fd, TCSANOW, &tio);
+		}
+		m_clock.start();
+		char buffer[256];
+		while(not m_stop.load()) {
+			sendDueResponses();
+			// Woken for the next response that is due, or else every now and then to see if we are to stop. To the
+			// nanosecond, a spinning wait for less than a millisecond would starve the stand-in on a single core.
+			qint64 timeout = MAX_POLL_NANOS;
+			if(not m_responses.empty())
+				timeout = qBound(qint64(0), m_responses.front().first - m_clock.nsecsElapsed(), timeout);
+			const timespec timeoutSpec = { time_t(timeout / 1000000000), long(timeout % 1000000000) };
+			pollfd pfd = { m_fd, POLLIN, 0 };
+			if(ppoll(&pfd, 1, &timeoutSpec, 0) <= 0)
+				continue;
+			const ssize_t numRead = ::read(m_fd, buffer, sizeof(buffer));
+			if(numRead > 0)
+				processInput(buffer, int(numRead));
+		}
+		::close(m_fd);
+	}
+
+private:
+	typedef QPair<qint64, QByteArray> Response;
+
+	void sendDueResponses()
+	{
+		while(not m_responses.empty() and m_responses.front().first <= m_clock.nsecsElapsed()) {
+			const QByteArray& data(m_responses.front().second);
+			const char* pData = data.constData();
+			int remaining = data.size();
+			while(remaining > 0) {
+				const ssize_t written = ::write(m_fd, pData, remaining);
+				if(written <= 0)
+					break;
+				pData += written;
+				remaining -= written;
+			}
+			m_responses.pop_front();
+		}
+	}
+
+	const QString m_portName;
+	const qint64 m_latencyNanos;
+	int m_fd;
+	QAtomicInt m_stop;
+	QElapsedTimer m_clock;
+	// Made, but not due yet.
+	std::deque<Response> m_responses;
+};
+
+
+// The serial side of the sketch's Interface on the mock core, the CBM side of it is only a time per byte.
+class SoftArduino
+{
+public:
+	SoftArduino(ulong baud, bool legacy, uint packetSize, uint window, uint64_t iecNanos)
+		: m_byteNanos(10 * 1000000000ULL / baud), m_legacy(legacy), m_packetSize(packetSize), m_window(window)
+		, m_iecNanos(iecNanos), m_pJob(0)
+	{}
+
+	bool connect()
+	{
+		Serial.setTimeout(SERIAL_TIMEOUT_MSECS);
+		Serial.print("connect_arduino:");
+		Serial.print(CURRENT_UNO2IEC_PROTOCOL_VERSION);
+		Serial.print('\r');
+		char buffer[MAX_BYTES_PER_REQUEST];
+		const size_t length = Serial.readBytesUntil('\r', buffer, sizeof(buffer));
+		return length >= 3 and 0 == memcmp(buffer, "OK>", 3);
+	}
+
+	void run(Job& job)
+	{
+		m_pJob = &job;
+		job.numBytes = 0;
+		job.roundTrips = 0;
+		job.stalls = 0;
+		mockCatchUp();
+		const uint64_t start = mockNanos();
+		job.success = Save == job.type ? save() : load();
+		job.nanos = mockNanos() - start;
+		m_pJob = 0;
+	}
+
+	// Round trip time of each request, from its last byte on the line to the first byte of the response.
+	const std::map<char, std::vector<uint64_t> >& requestNanos() const
+	{
+		return m_requestNanos;
+	}
+
+private:
+	bool load()
+	{
+		int code = open(CBM::READPRG_CHANNEL, m_pJob->name);
+		if(O_NOTHING == code or O_FILE_ERR == code) {
+			// The status the CBM reads next, the stand-in asks for its text right away.
+			if(exchange(QByteArray(1, 'E').append(char(CBM::ErrFileNotFound))) not_eq ':')
+				return false;
+			char buffer[MAX_BYTES_PER_REQUEST];
+			Serial.readBytesUntil('\r', buffer, sizeof(buffer));
+			return m_pJob->isMissing;
+		}
+
+		QByteArray data;
+		bool success;
+		if(O_DIR == code or O_INFO == code)
+			success = m_legacy ? readLines(data) : readBatches(data);
+		else if(O_FILE == code) {
+			if(exchange("S") not_eq 'S')
+				return false;
+			uint8_t size[2];
+			Serial.readBytes(size, sizeof(size));
+			success = m_legacy ? readBuffers(data) : readStream(data);
+		}
+		else
+			return false;
+		m_pJob->numBytes = data.size();
+		if(not m_pJob->data.isEmpty() and data not_eq m_pJob->data)
+			success = false;
+		return close() and success and not m_pJob->isMissing;
+	}
+
+	bool save()
+	{
+		if(CBM::ErrOK not_eq open(CBM::WRITEPRG_CHANNEL, m_pJob->name))
+			return false;
+		const QByteArray& data(m_pJob->data);
+		int pos = 0;
+		while(pos < data.size()) {
+			const int count = qMin(data.size() - pos, MAX_WRITE_REQUEST - 2);
+			// The bytes are taken from the CBM first, then sent in one request.
+			mockAdvance(m_iecNanos * count);
+			Serial.write('W');
+			Serial.write(uint8_t(count + 2));
+			Serial.write(reinterpret_cast<const uint8_t*>(data.constData() + pos), count);
+			Serial.flush();
+			pos += count;
+		}
+		m_pJob->numBytes = data.size();
+		return close();
+	}
+
+	// Open request, the response code is the open state for reading and the error code for writing.
+	int open(uchar channel, const QByteArray& name)
+	{
+		QByteArray request(1, 'O');
+		request.append(char(name.size() + 3)).append(char(channel)).append(name);
+		if(exchange(request) not_eq '>')
+			return -1;
+		uint8_t response[2];
+		if(sizeof(response) not_eq Serial.readBytes(response, sizeof(response)) or '\r' not_eq response[1])
+			return -1;
+		return response[0];
+	}
+
+	bool close()
+	{
+		const int response = exchange("C");
+		uint8_t length = 0;
+		if('N' == response or 'n' == response)
+			Serial.readBytes(&length, 1);
+		else if('C' not_eq response)
+			return false;
+		else
+			length = 1;
+		char buffer[MAX_BYTES_PER_REQUEST];
+		return length == Serial.readBytes(buffer, length);
+	}
+
+	// Windowed read: the host sends packets ahead, a credit ('R') goes back for each one drained.
+	bool readStream(QByteArray& data)
+	{
+		QByteArray request(1, 'F');
+		request.append(char(m_packetSize)).append(char(m_window));
+		int response = exchange(request);
+		forever {
+			uint8_t count;
+			if(('B' not_eq response and 'E' not_eq response) or 1 not_eq Serial.readBytes(&count, 1))
+				return false;
+			if(not readPacket(count, data))
+				return false;
+			if('E' == response)
+				return true;
+			Serial.write('R');
+			// A header that was already on the line is through within a byte's time.
+			const uint64_t waitFrom = mockNanos();
+			uint8_t head;
+			response = 1 == Serial.readBytes(&head, 1) ? head : -1;
+			if(mockNanos() - waitFrom > m_byteNanos)
+				++m_pJob->stalls;
+		}
+	}
+
+	// Stop-and-wait read of protocol v2: every buffer is asked for and drained before the next one.
+	bool readBuffers(QByteArray& data)
+	{
+		QByteArray request(1, 'N');
+		// The full buffer of MAX_BYTES_PER_REQUEST goes as zero.
+		request.append(char(MAX_BYTES_PER_REQUEST bitand 0xff));
+		forever {
+			const int response = exchange(request);
+			uint8_t count;
+			if(('B' not_eq response and 'E' not_eq response) or 1 not_eq Serial.readBytes(&count, 1))
+				return false;
+			if(not readWhole(count, data))
+				return false;
+			if('E' == response)
+				return true;
+			request = "R";
+		}
+	}
+
+	bool readPacket(uint count, QByteArray& data)
+	{
+		// Each byte goes on to the CBM as soon as it is in, while the rest of the packet is still on the line.
+		for(uint i = 0; i < count; ++i) {
+			uint8_t byte;
+			if(1 not_eq Serial.readBytes(&byte, 1))
+				return false;
+			data.append(char(byte));
+			mockAdvance(m_iecNanos);
+		}
+		return true;
+	}
+
+	// A response the sketch takes in whole before it goes on to the CBM (the bytes of stop-and-wait reads and listings).
+	bool readWhole(uint count, QByteArray& data)
+	{
+		char buffer[MAX_BYTES_PER_REQUEST];
+		if(count not_eq Serial.readBytes(buffer, count))
+			return false;
+		data.append(buffer, count);
+		mockAdvance(m_iecNanos * count);
+		return true;
+	}
+
+	// Listing in batches of BASIC lines (protocol v4), 'm' heads the last one.
+	bool readBatches(QByteArray& data)
+	{
+		int response;
+		do {
+			response = exchange("M");
+			uint8_t length;
+			if(('M' not_eq response and 'm' not_eq response) or 1 not_eq Serial.readBytes(&length, 1))
+				return false;
+			if(not readWhole(length, data))
+				return false;
+		} while('M' == response);
+		return true;
+	}
+
+	// Listing a line at a time, 'l' instead of a line ends it.
+	bool readLines(QByteArray& data)
+	{
+		forever {
+			const int response = exchange("L");
+			if('l' == response)
+				return true;
+			uint8_t length;
+			if('L' not_eq response or 1 not_eq Serial.readBytes(&length, 1))
+				return false;
+			if(not readWhole(length, data))
+				return false;
+		}
+	}
+
+	// Sends the request, then waits for the first byte of the response and takes the time in between.
+	int exchange(const char* request)
+	{
+		return exchange(QByteArray(request));
+	}
+
+	int exchange(const QByteArray& request)
+	{
+		mockCatchUp();
+		Serial.write(reinterpret_cast<const uint8_t*>(request.constData()), request.size());
+		// Timed from when the request is through the line.
+		Serial.flush();
+		const uint64_t sent = mockNanos();
+		uint8_t response;
+		if(1 not_eq Serial.readBytes(&response, 1))
+			return -1;
+		m_requestNanos[request.at(0)].push_back(mockNanos() - sent);
+		++m_pJob->roundTrips;
+		return response;
+	}
+
+	const uint64_t m_byteNanos;
+	const bool m_legacy;
+	const uint m_packetSize;
+	const uint m_window;
+	const uint64_t m_iecNanos;
+	Job* m_pJob;
+	std::map<char, std::vector<uint64_t> > m_requestNanos;
+};
+
+
+typedef QPair<QByteArray, QByteArray> Program;
+typedef QList<Program> Programs;
+
+// A program of the given size with its load address, the rest made up so that no two are alike.
+QByteArray makeProgram(int size, uint seed)
+{
+	QByteArray program;
+	program.append(char(LOAD_ADDRESS bitand 0xff)).append(char(LOAD_ADDRESS >> 8));
+	uint value = seed;
+	while(program.size() < size) {
+		value = value * 1103515245 + 12345;
+		program.append(char(value >> 16));
+	}
+	return program.left(size);
+} // makeProgram
+
+
+int sectorsOfTrack(int track)
+{
+	return track < 18 ? 21 : track < 25 ? 19 : track < 31 ? 18 : 17;
+} // sectorsOfTrack
+
+
+int sectorOffset(int track, int sector)
+{
+	int offset = sector;
+	for(int i = 1; i < track; ++i)
+		offset += sectorsOfTrack(i);
+	return offset * D64_SECTOR_SIZE;
+} // sectorOffset
+
+
+// A 1541 image with the programs as PRG files, their sectors one after the other from track 1 on. At most eight,
+// they all go in the first directory sector.
+QByteArray makeD64(const QByteArray& diskName, const Programs& programs)
+{
+	QByteArray image(sectorOffset(D64_TRACKS + 1, 0), 0);
+	uchar* pImage = reinterpret_cast<uchar*>(image.data());
+	std::vector<std::vector<bool> > used(D64_TRACKS + 1);
+	for(int track = 1; track <= D64_TRACKS; ++track)
+		used[track].resize(sectorsOfTrack(track), false);
+	used[D64_DIR_TRACK][0] = used[D64_DIR_TRACK][1] = true;
+
+	uchar* pDir = pImage + sectorOffset(D64_DIR_TRACK, 1);
+	pDir[1] = 0xff;
+	int track = 1, sector = 0;
+	for(int i = 0; i < programs.count(); ++i) {
+		const QByteArray& data(programs.at(i).second);
+		uchar* pEntry = pDir + i * 32;
+		pEntry[2] = 0x82; // closed PRG
+		pEntry[3] = track;
+		pEntry[4] = sector;
+		memcpy(pEntry + 5, programs.at(i).first.leftJustified(16, char(0xa0), true).constData(), 16);
+		const int numBlocks = (data.size() + D64_SECTOR_DATA - 1) / D64_SECTOR_DATA;
+		pEntry[30] = numBlocks bitand 0xff;
+		pEntry[31] = numBlocks >> 8;
+		for(int block = 0; block < numBlocks; ++block) {
+			uchar* pSector = pImage + sectorOffset(track, sector);
+			used[track][sector] = true;
+			const int count = qMin(data.size() - block * D64_SECTOR_DATA, D64_SECTOR_DATA);
+			memcpy(pSector + 2, data.constData() + block * D64_SECTOR_DATA, count);
+			if(++sector == sectorsOfTrack(track)) {
+				sector = 0;
+				if(++track == D64_DIR_TRACK)
+					++track;
+			}
+			// The last block links to nowhere, its sector byte is the offset of its last byte instead.
+			pSector[0] = block + 1 < numBlocks ? track : 0;
+			pSector[1] = block + 1 < numBlocks ? sector : count + 1;
+		}
+	}
+
+	uchar* pBam = pImage + sectorOffset(D64_DIR_TRACK, 0);
+	pBam[0] = D64_DIR_TRACK;
+	pBam[1] = 1;
+	pBam[2] = 0x41;
+	for(int i = 1; i <= D64_TRACKS; ++i) {
+		uchar* pTrack = pBam + 4 * i;
+		for(int j = 0; j < sectorsOfTrack(i); ++j) {
+			if(not used[i][j]) {
+				++pTrack[0];
+				pTrack[1 + j / 8] or_eq 1 << (j % 8);
+			}
+		}
+	}
+	memset(pBam + 0x90, 0xa0, 0x1b);
+	memcpy(pBam + 0x90, diskName.left(16).constData(), qMin(diskName.size(), 16));
+	memcpy(pBam + 0xa2, "PB", 2);
+	memcpy(pBam + 0xa5, "2A", 2);
+	return image;
+} // makeD64
+
+
+// A tape image with the programs, the load address of each is in its entry and not in the data.
+QByteArray makeT64(const QByteArray& tapeName, const Programs& programs)
+{
+	QByteArray image(0x40 + 32 * programs.count(), 0);
+	uchar* pImage = reinterpret_cast<uchar*>(image.data());
+	memcpy(pImage, "C64 tape image file", 19);
+	pImage[0x20] = 0x01;
+	pImage[0x21] = 0x01;
+	pImage[0x22] = pImage[0x24] = programs.count();
+	memcpy(pImage + 0x28, tapeName.leftJustified(24, ' ', true).constData(), 24);
+	for(int i = 0; i < programs.count(); ++i) {
+		const QByteArray& program(programs.at(i).second);
+		const ushort start = uchar(program.at(0)) bitor (uchar(program.at(1)) << 8);
+		const ushort end = start + program.size() - 2;
+		const uint offset = image.size();
+		pImage = reinterpret_cast<uchar*>(image.data());
+		uchar* pEntry = pImage + 0x40 + 32 * i;
+		pEntry[0] = 1;
+		pEntry[1] = 0x82;
+		pEntry[2] = start bitand 0xff;
+		pEntry[3] = start >> 8;
+		pEntry[4] = end bitand 0xff;
+		pEntry[5] = end >> 8;
+		for(int j = 0; j < 4; ++j)
+			pEntry[8 + j] = (offset >> (8 * j)) bitand 0xff;
+		memcpy(pEntry + 16, programs.at(i).first.leftJustified(16, ' ', true).constData(), 16);
+		image.append(program.mid(2));
+	}
+	return image;
+} // makeT64
+
+
+bool writeFile(const QString& fileName, const QByteArray& data)
+{
+	QFile file(fileName);
+	return file.open(QIODevice::WriteOnly) and data.size() == file.write(data);
+} // writeFile
+
+
+Job makeJob(JobType type, const QByteArray& name, const QByteArray& data = QByteArray(), bool isMissing = false)
+{
+	Job job;
+	job.type = type;
+	job.name = name;
+	job.data = data;
+	job.isMissing = isMissing;
+	job.success = false;
+	job.numBytes = 0;
+	job.nanos = 0;
+	job.roundTrips = 0;
+	job.stalls = 0;
+	return job;
+} // makeJob
+
+
+// Writes the corpus to the directory: PRG files of all sizes, a D64 and a T64 with a few programs each. The jobs
+// LOAD each file (the ones in the images after mounting them, "_" unmounts again), a file that isn't there, list the
+// directory and SAVE a few programs.
+bool makeCorpus(const QString& path, std::vector<Job>& jobs)
+{
+	static const int prgSizes[] = { 2, 254, 1000, 4096, 16384, 60000 };
+	jobs.push_back(makeJob(Directory, "$"));
+	uint seed = 1;
+	for(uint i = 0; i < sizeof(prgSizes) / sizeof(prgSizes[0]); ++i) {
+		const QByteArray name(QString("P%1.PRG").arg(prgSizes[i], 5, 10, QChar('0')).toLatin1());
+		const QByteArray program(makeProgram(prgSizes[i], seed++));
+		if(not writeFile(QDir(path).filePath(name), program))
+			return false;
+		jobs.push_back(makeJob(Load, name, program));
+	}
+	jobs.push_back(makeJob(Load, "MISSING.PRG", QByteArray(), true));
+
+	static const int imageSizes[] = { 1000, 5000, 20000 };
+	const QByteArray upArrow(1, char(CBM_BACK_ARROW));
+	for(int image = 0; image < 2; ++image) {
+		const QByteArray imageName(0 == image ? "DISK.D64" : "TAPE.T64");
+		Programs programs;
+		for(uint i = 0; i < sizeof(imageSizes) / sizeof(imageSizes[0]); ++i)
+			programs.append(Program(QString("%1%2").arg(0 == image ? 'D' : 'T').arg(i + 1).toLatin1(),
+															makeProgram(imageSizes[i], seed++)));
+		const QByteArray data(0 == image ? makeD64("PROTOBENCH", programs) : makeT64("PROTOBENCH", programs));
+		if(not writeFile(QDir(path).filePath(imageName), data))
+			return false;
+		jobs.push_back(makeJob(Directory, imageName));
+		foreach(const Program& program, programs)
+			jobs.push_back(makeJob(Load, program.first, program.second));
+		jobs.push_back(makeJob(Directory, upArrow));
+	}
+
+	jobs.push_back(makeJob(Save, "S01000.PRG", makeProgram(1000, seed++)));
+	jobs.push_back(makeJob(Save, "S16384.PRG", makeProgram(16384, seed++)));
+	return true;
+} // makeCorpus
+
+
+// Nearest rank, of sorted values.
+double percentile(const std::vector<uint64_t>& sorted, uint percent)
+{
+	const size_t rank = (sorted.size() * percent + 99) / 100;
+	return double(sorted.at(rank ? rank - 1 : 0)) / 1000.0;
+} // percentile
+
+
+void printLatencies(const std::vector<uint64_t>& nanos)
+{
+	std::vector<uint64_t> sorted(nanos);
+	std::sort(sorted.begin(), sorted.end());
+	printf("p50 %.0f us, p90 %.0f us, p99 %.0f us, max %.0f us\n", percentile(sorted, 50), percentile(sorted, 90),
+				 percentile(sorted, 99), percentile(sorted, 100));
+} // printLatencies
+
+} // unnamed namespace
+
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication a(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Times LOADs, SAVEs and directory listings of a software Arduino through a pseudo "
+																	 "terminal and the media host, over a corpus of PRG, D64 and T64 files.");
+	parser.addHelpOption();
+	QCommandLineOption baudOption(QStringList() << "b" << "baud", "Baud rate of the serial line.", "rate",
+																QString::number(DEFAULT_BAUDRATE));
+	QCommandLineOption latencyOption(QStringList() << "l" << "latency",
+																	 "Microseconds the media host waits before it handles what arrived.", "us", "0");
+	QCommandLineOption iecOption("iec-us", "Microseconds the CBM side takes for each byte.", "us", "0");
+	QCommandLineOption legacyOption("legacy", "Stop-and-wait reads ('N', 'R') and line by line listings ('L') of "
+																						"protocol v2 instead of windowed reads ('F') and listing batches ('M').");
+	QCommandLineOption packetOption("packet", "Packet size of windowed reads, with its two heading bytes.", "bytes",
+																	QString::number(DEFAULT_PACKET_SIZE));
+	QCommandLineOption windowOption("window", "Packets the media host may send ahead in windowed reads.", "packets",
+																	QString::number(DEFAULT_WINDOW));
+	QCommandLineOption roundsOption(QStringList() << "r" << "rounds", "How many times the jobs are run.", "count", "1");
+	QCommandLineOption dirOption(QStringList() << "d" << "directory",
+															 "Directory to write the corpus to and serve, instead of a temporary one.", "path");
+	QCommandLineOption deviceOption(QStringList() << "n" << "device", "CBM device number.", "number",
+																	QString::number(DEFAULT_DEVICE_NUMBER));
+	QCommandLineOption verboseOption(QStringList() << "v" << "verbose", "Print each job.");
+	parser.addOption(baudOption);
+	parser.addOption(latencyOption);
+	parser.addOption(iecOption);
+	parser.addOption(legacyOption);
+	parser.addOption(packetOption);
+	parser.addOption(windowOption);
+	parser.addOption(roundsOption);
+	parser.addOption(dirOption);
+	parser.addOption(deviceOption);
+	parser.addOption(verboseOption);
+	parser.process(a);
+
+	const uint packetSize = parser.value(packetOption).toUInt();
+	const uint window = parser.value(windowOption).toUInt();
+	if(packetSize < 3 or not window or packetSize * window > SERIAL_RX_BUFFER_SIZE - 1) {
+		fprintf(stderr, "The packets in flight must fit the %d bytes of the UART's receive ring.\n",
+						SERIAL_RX_BUFFER_SIZE - 1);
+		return 1;
+	}
+	const ulong baud = parser.value(baudOption).toULong();
+	if(not baud) {
+		fprintf(stderr, "Invalid baud rate: %s\n", qPrintable(parser.value(baudOption)));
+		return 1;
+	}
+
+	QTemporaryDir tempDir;
+	const QString corpusPath(parser.isSet(dirOption) ? parser.value(dirOption) : tempDir.path());
+	std::vector<Job> corpusJobs;
+	if(not QDir().mkpath(corpusPath) or not makeCorpus(corpusPath, corpusJobs)) {
+		fprintf(stderr, "Could not write the corpus to %s\n", qPrintable(corpusPath));
+		return 1;
+	}
+	// The native file system saves relative to the working directory.
+	QDir::setCurrent(corpusPath);
+
+	const char* portName = mockSerialOpenPty();
+	if(0 == portName) {
+		fprintf(stderr, "Could not open a pseudo terminal.\n");
+		return 1;
+	}
+	Serial.begin(baud);
+
+	Interface iface;
+	PtyHostLink host(iface, parser.value(deviceOption).toUShort(), portName, parser.value(latencyOption).toULong(),
+									 false);
+	iface.setMountNotifyListener(&host);
+	iface.setImageFilters("*.D64,*.T64,*.PRG", false);
+	iface.changeNativeFSDirectory(corpusPath);
+	host.start();
+
+	// The mock core is paced (its default), the media host answers in wall clock time.
+	SoftArduino arduino(baud, parser.isSet(legacyOption), packetSize, window, parser.value(iecOption).toULongLong() * 1000);
+	if(not arduino.connect()) {
+		fprintf(stderr, "No connection to the media host.\n");
+		return 1;
+	}
+
+	const bool verbose = parser.isSet(verboseOption);
+	const uint numRounds = qMax(parser.value(roundsOption).toUInt(), 1U);
+	std::vector<Job> jobs;
+	bool allDone = true;
+	for(uint round = 0; round < numRounds; ++round) {
+		for(size_t i = 0; i < corpusJobs.size(); ++i) {
+			Job job(corpusJobs[i]);
+			// Each round saves files of its own, replacing isn't what is timed.
+			if(Save == job.type)
+				job.name.prepend(QByteArray::number(round + 1)).prepend('R');
+			arduino.run(job);
+			if(job.success and Save == job.type) {
+				QFile saved(QString::fromLatin1(job.name));
+				job.success = saved.open(QIODevice::ReadOnly) and saved.readAll() == job.data;
+			}
+			if(verbose or not job.success)
+				printf("%-4s \"%s\": %s, %u bytes in %.0f us, %u round trips, %u stalls\n", jobNames[job.type],
+							 job.name.constData(), job.success ? "ok" : "FAILED", job.numBytes, double(job.nanos) / 1000.0,
+							 job.roundTrips, job.stalls);
+			allDone = allDone and job.success;
+			jobs.push_back(job);
+		}
+	}
+	host.stop();
+	iface.setMountNotifyListener(0);
+
+	printf("%s at %lu baud, %s us host latency, %s us per CBM byte:\n",
+				 parser.isSet(legacyOption) ? "Protocol v2 (stop-and-wait)"
+																		: qPrintable(QString("Windowed reads (%1 x %2 bytes)").arg(window).arg(packetSize)),
+				 baud, qPrintable(parser.value(latencyOption)),
+				 qPrintable(parser.value(iecOption)));
+	for(int type = 0; type < NumJobTypes; ++type) {
+		uint numJobs = 0, numBytes = 0, roundTrips = 0, stalls = 0;
+		uint64_t nanos = 0;
+		std::vector<uint64_t> jobNanos;
+		for(size_t i = 0; i < jobs.size(); ++i) {
+			const Job& job = jobs[i];
+			if(type not_eq job.type)
+				continue;
+			++numJobs;
+			numBytes += job.numBytes;
+			roundTrips += job.roundTrips;
+			stalls += job.stalls;
+			nanos += job.nanos;
+			jobNanos.push_back(job.nanos);
+		}
+		if(not numJobs)
+			continue;
+		printf("%-4s %3u files, %7u bytes, %7.0f bytes/s, %5.1f round trips and %5.1f stalls per file, ", jobNames[type],
+					 numJobs, numBytes, nanos ? numBytes * 1e9 / double(nanos) : 0.0, double(roundTrips) / numJobs,
+					 double(stalls) / numJobs);
+		printLatencies(jobNanos);
+	}
+	const std::map<char, std::vector<uint64_t> >& requestNanos(arduino.requestNanos());
+	for(std::map<char, std::vector<uint64_t> >::const_iterator it = requestNanos.begin(); it not_eq requestNanos.end(); ++it) {
+		printf("'%c'  %5u requests, ", it->first, unsigned(it->second.size()));
+		printLatencies(it->second);
+	}
+	return allDone ? 0 : 1;
+} // main
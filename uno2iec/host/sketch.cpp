@@ -0,0 +1,3 @@
+// The sketch as a translation unit of its own, the way the Arduino tools build it.
+#include <Arduino.h>
+#include "../uno2iec.ino"
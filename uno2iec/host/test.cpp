@@ -0,0 +1,1035 @@
+//
+// Title	: uno2iec-test - checks of the sketch's IEC bus timing in simulated time
+//
+// Runs the IEC driver against the mock Arduino core with a simulated C64 on its lines and checks what the KERNAL
+// relies on: how soon the drive answers ATN, the bit timing and EOI handshake of the bytes it sends and receives,
+// and how long it waits for a stuck bus before giving up. The same for a C64 with a JiffyDOS kernal: the detection,
+// and the bit pair and acceptance times of the JiffyDOS bytes. Then the whole sketch serves LOADs (also JiffyDOS
+// ones) and a JiffyDOS SAVE to the C64 from a media host stand-in on its serial line, and replays the bus lines of
+// drive code started with M-E. Nothing depends on the speed of the machine running it.
+// Prints each failed check and exits with 1 if there was any.
+//
+// DISCLAIMER:
+// The author is in no way responsible for any problems or damage caused by
+// using this code. Use at your own risk.
+//
+// LICENSE:
+// This code is distributed under the GNU Public License
+// which can be found at http://www.gnu.org/licenses/gpl.txt
+//
+
+#include <stdio.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mockarduino.h"
+#include "c64bus.h"
+#include "iec_driver.h"
+#include "interface.h"
+
+namespace {
+
+// Of the driver (iec_driver.cpp), in us.
+const uint64_t TIMING_BIT = 70;
+// timeoutWait() polls the line 65000 times with a 3 us delay, plus the pin read and the loop.
+const uint64_t MIN_TIMEOUT_NANOS = 65000ULL * 3000;
+const uint64_t MAX_TIMEOUT_NANOS = 65000ULL * 3300;
+// JiffyDOS: how long the clock is held under ATN before the drive answers the detection (seen up to a poll of
+// timeoutWait() late), and for how long. The bit
+// pairs and then EOI or not go on the lines at these times after the start of a byte the drive sends, and it accepts a
+// byte it receives at JIFFY_ACCEPT.
+const uint64_t JIFFY_DETECT_DELAY = 218;
+const uint64_t JIFFY_DETECT_ACK = 101;
+const uint64_t JIFFY_SEND_TIMES[] = { 10, 20, 31, 41, 52 };
+const uint64_t JIFFY_ACCEPT = 73;
+// The drive starts its bit timing when it sees the start of a byte and counts in microseconds.
+const uint64_t JIFFY_TOLERANCE_NANOS = 1500;
+
+// Of the KERNAL: a device that doesn't hold DATA 1 ms after ATN is not present.
+const uint64_t ATN_RESPONSE_NANOS = 1000000;
+
+const uint8_t DEVICE_NUMBER = 8;
+
+int s_numFailed = 0;
+
+
+void check(bool condition, const char* what)
+{
+	if(condition)
+		return;
+	printf("FAIL: %s\n", what);
+	++s_numFailed;
+} // check
+
+
+// The changes of the IEC lines, as pulled by the sketch and by anyone on the bus, at the resolution the peripherals
+// are stepped with (1 us).
+class LineRecorder : public MockPeripheral
+{
+public:
+	struct Edge
+	{
+		uint64_t nanos;
+		uint8_t pin;
+		bool bySketch;
+		bool pulled;
+	};
+
+	LineRecorder()
+	{
+		for(uint8_t i = 0; i < NUM_LINES; ++i) {
+			m_busPulled[i] = not mockLineLevel(s_pins[i]);
+			m_sketchPulled[i] = mockSketchPulls(s_pins[i]);
+			m_busPulledAtStart[i] = m_busPulled[i];
+			m_sketchPulledAtStart[i] = m_sketchPulled[i];
+		}
+	}
+
+	// MockPeripheral implementation.
+	void advanceTo(uint64_t nanos)
+	{
+		for(uint8_t i = 0; i < NUM_LINES; ++i) {
+			const bool busPulled = not mockLineLevel(s_pins[i]);
+			const bool sketchPulled = mockSketchPulls(s_pins[i]);
+			if(busPulled not_eq m_busPulled[i]) {
+				m_busPulled[i] = busPulled;
+				Edge edge = { nanos, s_pins[i], false, busPulled };
+				m_edges.push_back(edge);
+			}
+			if(sketchPulled not_eq m_sketchPulled[i]) {
+				m_sketchPulled[i] = sketchPulled;
+				Edge edge = { nanos, s_pins[i], true, sketchPulled };
+				m_edges.push_back(edge);
+			}
+		}
+	}
+
+	// Whether the line was pulled at the time.
+	bool isPulled(uint8_t pin, bool bySketch, uint64_t nanos) const
+	{
+		bool pulled = false;
+		for(uint8_t i = 0; i < NUM_LINES; ++i) {
+			if(s_pins[i] == pin)
+				pulled = bySketch ? m_sketchPulledAtStart[i] : m_busPulledAtStart[i];
+		}
+		for(size_t i = 0; i < m_edges.size() and m_edges[i].nanos <= nanos; ++i) {
+			if(m_edges[i].pin == pin and m_edges[i].bySketch == bySketch)
+				pulled = m_edges[i].pulled;
+		}
+		return pulled;
+	}
+
+	const std::vector<Edge>& edges() const
+	{
+		return m_edges;
+	}
+
+	// When the line was next pulled (or released) at or after the time, 0 if it wasn't.
+	uint64_t find(uint8_t pin, bool bySketch, bool pulled, uint64_t from) const
+	{
+		for(size_t i = 0; i < m_edges.size(); ++i) {
+			const Edge& edge = m_edges[i];
+			if(edge.nanos >= from and edge.pin == pin and edge.bySketch == bySketch and edge.pulled == pulled)
+				return edge.nanos;
+		}
+		return 0;
+	}
+
+private:
+	enum {
+		NUM_LINES = 3
+	};
+	static const uint8_t s_pins[NUM_LINES];
+
+	bool m_busPulled[NUM_LINES];
+	bool m_sketchPulled[NUM_LINES];
+	bool m_busPulledAtStart[NUM_LINES];
+	bool m_sketchPulledAtStart[NUM_LINES];
+	std::vector<Edge> m_edges;
+};
+
+const uint8_t LineRecorder::s_pins[LineRecorder::NUM_LINES] = { DEFAULT_ATN_PIN, DEFAULT_CLOCK_PIN, DEFAULT_DATA_PIN };
+
+
+// A C64 running a script of its own instead of the jobs.
+class ScriptedC64 : public C64Bus
+{
+public:
+	ScriptedC64()
+		: C64Bus(DEFAULT_ATN_PIN, DEFAULT_CLOCK_PIN, DEFAULT_DATA_PIN, DEVICE_NUMBER)
+	{}
+};
+
+
+// Holds a line forever: a listener that never gets ready (DATA) or a talker that never does (CLOCK).
+class StuckC64 : public ScriptedC64
+{
+public:
+	explicit StuckC64(bool holdData)
+		: m_holdData(holdData)
+	{}
+
+protected:
+	void run()
+	{
+		pull(m_holdData ? m_dataPin : m_clockPin, true);
+		wait(10000000);
+	}
+
+private:
+	bool m_holdData;
+};
+
+
+// TALK, the bytes up to the one with EOI and UNTALK.
+class ListeningC64 : public ScriptedC64
+{
+public:
+	std::string received;
+	std::vector<bool> eois;
+	bool success;
+
+	ListeningC64()
+		: success(false)
+	{}
+
+protected:
+	void run()
+	{
+		success = talk(0x60);
+		bool eoi = false;
+		while(success and not eoi) {
+			uint8_t data;
+			success = receiveByte(data, eoi);
+			received.push_back(char(data));
+			eois.push_back(eoi);
+			wait(60);
+		}
+		success = success and untalk();
+	}
+};
+
+
+// OPEN, a few bytes to the opened channel (the last with EOI) and CLOSE.
+class TalkingC64 : public ScriptedC64
+{
+public:
+	std::string data;
+	bool success;
+
+	TalkingC64()
+		: success(false)
+	{}
+
+protected:
+	void run()
+	{
+		success = open(2, "TEST") and listen(0x60 bitor 2);
+		for(size_t i = 0; success and i < data.size(); ++i)
+			success = sendByte(uint8_t(data[i]), i + 1 == data.size());
+		success = success and unlisten() and close(2);
+	}
+};
+
+
+// Only a LISTEN or TALK to the drive is answered as JiffyDOS, in time for the C64 and for as long as the driver does.
+void checkJiffyDetection(const C64Bus& c64)
+{
+	const std::vector<C64Bus::JiffyDetection>& detections(c64.jiffyDetections());
+	bool answeredRight = not detections.empty();
+	uint64_t minDelay = ~0ULL, maxDelay = 0, minPulse = ~0ULL, maxPulse = 0;
+	for(size_t i = 0; i < detections.size(); ++i) {
+		const C64Bus::JiffyDetection& detection = detections[i];
+		const bool addressed = (0x20 bitor DEVICE_NUMBER) == detection.data or (0x40 bitor DEVICE_NUMBER) == detection.data;
+		answeredRight = answeredRight and addressed == (0 not_eq detection.pulseEndNanos);
+		if(not detection.pulseEndNanos)
+			continue;
+		const uint64_t delay = detection.pulseNanos - detection.holdNanos;
+		const uint64_t pulse = detection.pulseEndNanos - detection.pulseNanos;
+		minDelay = std::min(minDelay, delay);
+		maxDelay = std::max(maxDelay, delay);
+		minPulse = std::min(minPulse, pulse);
+		maxPulse = std::max(maxPulse, pulse);
+	}
+	printf("jiffy detection: %u ATN bytes, DATA pulled %.1f to %.1f us into the hold for %.1f to %.1f us\n",
+				 unsigned(detections.size()), minDelay / 1e3, maxDelay / 1e3, minPulse / 1e3, maxPulse / 1e3);
+	check(answeredRight, "only a LISTEN or TALK to the drive is answered as JiffyDOS");
+	check(minDelay >= JIFFY_DETECT_DELAY * 1000 and maxDelay < (JIFFY_DETECT_DELAY + 3) * 1000 + JIFFY_TOLERANCE_NANOS
+				and minPulse >= JIFFY_DETECT_ACK * 1000 and maxPulse < JIFFY_DETECT_ACK * 1000 + JIFFY_TOLERANCE_NANOS,
+				"the JiffyDOS detection is answered in time");
+} // checkJiffyDetection
+
+
+// How far the sketch's changes of CLOCK and DATA within the window after the start of each JiffyDOS byte are off the
+// nearest of the times (us), and how many there were.
+uint64_t jiffyTimingError(const LineRecorder& recorder, const std::vector<uint64_t>& starts, uint64_t windowMicros,
+													const uint64_t* times, size_t numTimes, size_t& numChanges)
+{
+	const std::vector<LineRecorder::Edge>& edges(recorder.edges());
+	uint64_t maxError = 0;
+	numChanges = 0;
+	size_t first = 0;
+	for(size_t byte = 0; byte < starts.size(); ++byte) {
+		while(first < edges.size() and edges[first].nanos <= starts[byte])
+			++first;
+		for(size_t i = first; i < edges.size() and edges[i].nanos <= starts[byte] + windowMicros * 1000; ++i) {
+			const LineRecorder::Edge& edge = edges[i];
+			if(not edge.bySketch or DEFAULT_ATN_PIN == edge.pin)
+				continue;
+			const uint64_t offset = edge.nanos - starts[byte];
+			uint64_t error = ~0ULL;
+			for(size_t n = 0; n < numTimes; ++n) {
+				const uint64_t nanos = times[n] * 1000;
+				error = std::min(error, offset > nanos ? offset - nanos : nanos - offset);
+			}
+			maxError = std::max(maxError, error);
+			++numChanges;
+		}
+	}
+	return maxError;
+} // jiffyTimingError
+
+
+void settle(uint64_t micros)
+{
+	mockAdvance(micros * 1000);
+} // settle
+
+
+// The media host end of the sketch's serial line, serving files from memory: it speaks just as much of the protocol
+// as a LOAD takes (open, size, the windowed read and close), a SAVE (open for writing and the written bytes) and the
+// bus replay of drive code, and keeps count of the requests.
+class FileHost : public MockPeripheral
+{
+public:
+	std::map<std::string, std::string> files;
+	std::map<char, unsigned> numRequests;
+	// What the sketch logged as errors.
+	std::vector<std::string> errors;
+	// How long the host takes to answer (a busy host, a Bluetooth link).
+	uint64_t latencyNanos;
+	// What the drive code started next did on the bus, entries of BUS_REPLAY_ENTRY_SIZE.
+	std::string busReplay;
+
+	FileHost()
+		: latencyNanos(0), m_now(0), m_isConnected(false), m_packetSize(0), m_credits(0), m_readPos(0), m_isReading(false)
+	{}
+
+	// MockPeripheral implementation.
+	void advanceTo(uint64_t nanos)
+	{
+		m_now = nanos;
+		uint8_t buffer[64];
+		size_t length;
+		while(0 not_eq (length = mockSerialTake(buffer, sizeof(buffer))))
+			m_pending.append(reinterpret_cast<const char*>(buffer), length);
+		while(processRequest());
+		while(not m_responses.empty() and m_responses.front().first <= nanos) {
+			const std::string& data(m_responses.front().second);
+			mockSerialFeed(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+			m_responses.pop_front();
+		}
+	}
+
+private:
+	void write(const std::string& data)
+	{
+		m_responses.push_back(std::make_pair(m_now + latencyNanos, data));
+	}
+
+	// Handles the first complete request pending, false if there is none.
+	bool processRequest()
+	{
+		if(not m_isConnected) {
+			const size_t endPos = m_pending.find('\r', m_pending.find("connect_arduino:"));
+			if(std::string::npos == endPos)
+				return false;
+			m_pending.erase(0, endPos + 1);
+			char response[80];
+			sprintf(response, "OK>%u|%u|%u|%u|%u|%u|2026-01-01.12:00:00\r", DEVICE_NUMBER, DEFAULT_ATN_PIN,
+							DEFAULT_CLOCK_PIN, DEFAULT_DATA_PIN, DEFAULT_RESET_PIN, DEFAULT_SRQIN_PIN);
+			write(response);
+			m_isConnected = true;
+			return true;
+		}
+		if(m_pending.empty())
+			return false;
+
+		const char command = m_pending[0];
+		size_t length = 1;
+		switch(command) {
+			case '!': // facilities and log lines of the sketch, up to the CR.
+			case 'D':
+				length = m_pending.find('\r');
+				if(std::string::npos == length)
+					return false;
+				if('D' == command and 'E' == m_pending[1])
+					errors.push_back(m_pending.substr(3, length - 3));
+				++length;
+				break;
+			case 'O': // open: the length (of all of it) and the channel, then the name. Commands get no answer.
+				if(m_pending.size() < 2 or m_pending.size() < uint8_t(m_pending[1]))
+					return false;
+				length = uint8_t(m_pending[1]);
+				if(CBM::CMD_CHANNEL == m_pending[2])
+					break;
+				m_name = m_pending.substr(3, length - 3);
+				m_readPos = 0;
+				m_isReading = false;
+				if(CBM::WRITEPRG_CHANNEL == m_pending[2]) {
+					// SAVE, answered with the error code.
+					files[m_name].clear();
+					write(std::string(">") + char(CBM::ErrOK) + '\r');
+					break;
+				}
+				write(std::string(">") + char(files.count(m_name) ? O_FILE : O_NOTHING) + '\r');
+				break;
+			case 'W': // bytes of the file being saved: the length (of all of it), then the bytes.
+				if(m_pending.size() < 2 or m_pending.size() < uint8_t(m_pending[1]))
+					return false;
+				length = uint8_t(m_pending[1]);
+				files[m_name].append(m_pending, 2, length - 2);
+				break;
+			case 'V': // the bus replay, in responses of whole entries.
+			{
+				const size_t replayLength = std::min(busReplay.size(), size_t(MAX_BUS_REPLAY_BYTES));
+				const bool isLast = replayLength == busReplay.size();
+				write(std::string(1, isLast ? 'E' : 'B') + char(replayLength) + busReplay.substr(0, replayLength));
+				busReplay.erase(0, replayLength);
+				break;
+			}
+			case 'S': // size of the open file.
+				write(std::string("S") + char(files[m_name].size() >> 8) + char(files[m_name].size()));
+				break;
+			case 'F': // windowed read: packet size and window, then a credit ('R') for every drained packet.
+				if(m_pending.size() < 3)
+					return false;
+				length = 3;
+				m_packetSize = uint8_t(m_pending[1]);
+				m_credits = uint8_t(m_pending[2]);
+				m_isReading = true;
+				break;
+			case 'R':
+				++m_credits;
+				break;
+			case 'X': // the read is given up, acknowledged after the packets sent.
+				m_isReading = false;
+				write(std::string("X") + '\0');
+				break;
+			case 'C': // close, answered with no name.
+				write(std::string("N") + '\0');
+				m_isReading = false;
+				break;
+			default:
+				printf("Unexpected byte from the Arduino: 0x%02x\n", uint8_t(command));
+				break;
+		}
+		++numRequests[command];
+		m_pending.erase(0, length);
+		sendPackets();
+		return true;
+	}
+
+	// As many packets of the open file as there are credits for, the last one as 'E'.
+	void sendPackets()
+	{
+		const std::string& file(files[m_name]);
+		while(m_isReading and m_credits) {
+			const size_t length = std::min(size_t(m_packetSize - 2), file.size() - m_readPos);
+			const bool isLast = m_readPos + length == file.size();
+			write(std::string(1, isLast ? 'E' : 'B') + char(length) + file.substr(m_readPos, length));
+			m_readPos += length;
+			--m_credits;
+			m_isReading = not isLast;
+		}
+	}
+
+	uint64_t m_now;
+	bool m_isConnected;
+	std::string m_pending;
+	// Answers on their way, when they go on the line.
+	std::deque<std::pair<uint64_t, std::string> > m_responses;
+	std::string m_name;
+	uint8_t m_packetSize;
+	unsigned m_credits;
+	size_t m_readPos;
+	bool m_isReading;
+};
+
+
+// Sent and received bytes, with the bus stuck: the driver gives up after the timeout and leaves the bus alone.
+void testTimeout(IEC& iec)
+{
+	for(int holdData = 1; holdData >= 0; --holdData) {
+		StuckC64 c64(holdData);
+		mockAddPeripheral(&c64);
+		settle(10);
+		const uint64_t start = mockNanos();
+		bool failed;
+		if(holdData)
+			failed = not iec.send('A');
+		else {
+			iec.receive();
+			failed = iec.state() bitand IEC::errorFlag;
+		}
+		const uint64_t nanos = mockNanos() - start;
+		mockRemovePeripheral(&c64);
+
+		printf("%s timed out after %.1f ms\n", holdData ? "send" : "receive", nanos / 1e6);
+		check(failed and (iec.state() bitand IEC::errorFlag), "a stuck bus sets the error flag");
+		check(nanos >= MIN_TIMEOUT_NANOS and nanos < MAX_TIMEOUT_NANOS, "the timeout is 65000 polls of 3 us");
+		check(not mockSketchPulls(DEFAULT_CLOCK_PIN) and not mockSketchPulls(DEFAULT_DATA_PIN),
+					"the lines are released on a timeout");
+	}
+} // testTimeout
+
+
+// Sends bytes to a C64 that said TALK: each bit is held for TIMING_BIT, the listener is never kept waiting long
+// enough to take a byte for the last one, and the last one is.
+void testSend(IEC& iec)
+{
+	const std::string data("HELLO");
+	ListeningC64 c64;
+	LineRecorder recorder;
+	mockAddPeripheral(&c64);
+	mockAddPeripheral(&recorder);
+	const uint64_t deadline = mockNanos() + 1000000000ULL;
+	uint64_t start = 0, end = 0;
+	bool sent = false;
+	while(not c64.isDone() and mockNanos() < deadline) {
+		IEC::ATNCmd cmd;
+		if(IEC::ATN_CMD_TALK not_eq iec.checkATN(cmd))
+			continue;
+		sent = true;
+		start = mockNanos();
+		for(size_t i = 0; sent and i < data.size(); ++i)
+			sent = i + 1 < data.size() ? iec.send(data[i]) : iec.sendEOI(data[i]);
+		end = mockNanos();
+	}
+	mockRemovePeripheral(&recorder);
+	mockRemovePeripheral(&c64);
+
+	check(sent and c64.success, "the bytes are sent");
+	check(c64.received == data, "the bytes arrive as sent");
+	bool eoiLast = c64.eois.size() == data.size();
+	for(size_t i = 0; eoiLast and i < data.size(); ++i)
+		eoiLast = c64.eois[i] == (i + 1 == data.size());
+	check(eoiLast, "only the last byte is taken as EOI");
+
+	// The driver releases the clock once when ready to send each byte and then for each bit, the bits are valid
+	// from that to pulling it again.
+	uint64_t minValid = ~0ULL, maxValid = 0;
+	size_t numReleases = 0;
+	uint64_t released = recorder.find(DEFAULT_CLOCK_PIN, true, false, start);
+	while(released) {
+		const uint64_t pulled = recorder.find(DEFAULT_CLOCK_PIN, true, true, released);
+		if(not pulled or pulled > end)
+			break;
+		if(numReleases++ % 9) {
+			const uint64_t nanos = pulled - released;
+			minValid = nanos < minValid ? nanos : minValid;
+			maxValid = nanos > maxValid ? nanos : maxValid;
+		}
+		released = recorder.find(DEFAULT_CLOCK_PIN, true, false, pulled);
+	}
+	printf("send: %u clock releases, bits valid for %.1f to %.1f us\n", unsigned(numReleases), minValid / 1e3,
+				 maxValid / 1e3);
+	check(numReleases == 9 * data.size(), "each byte is clocked with eight bits");
+	check(minValid >= TIMING_BIT * 1000 and maxValid <= (TIMING_BIT + 2) * 1000, "the bits are valid for TIMING_BIT");
+} // testSend
+
+
+// The C64 opens a channel, sends to it and closes it: the driver answers ATN in time and gets the commands and
+// bytes right, EOI included.
+void testReceive(IEC& iec)
+{
+	TalkingC64 c64;
+	c64.data = "PAYLOAD";
+	LineRecorder recorder;
+	mockAddPeripheral(&c64);
+	mockAddPeripheral(&recorder);
+
+	std::vector<std::string> commands;
+	std::string received;
+	std::vector<bool> eois;
+	const uint64_t deadline = mockNanos() + 1000000000ULL;
+	while(not c64.isDone() and mockNanos() < deadline) {
+		IEC::ATNCmd cmd;
+		switch(iec.checkATN(cmd)) {
+			case IEC::ATN_CMD:
+				commands.push_back(std::string(1, char(cmd.code)) + std::string((const char*)cmd.str, cmd.strLen));
+				break;
+			case IEC::ATN_CMD_LISTEN:
+				commands.push_back(std::string(1, char(cmd.code)));
+				do {
+					received.push_back(char(iec.receive()));
+					eois.push_back(iec.state() bitand IEC::eoiFlag);
+				} while(not (iec.state() bitand (IEC::eoiFlag bitor IEC::errorFlag)));
+				break;
+			case IEC::ATN_ERROR:
+				commands.push_back("error");
+				break;
+			default:
+				break;
+		}
+	}
+	mockRemovePeripheral(&recorder);
+	mockRemovePeripheral(&c64);
+
+	check(c64.isDone() and c64.success, "the C64 finds the drive and gets rid of its bytes");
+	check(3 == commands.size() and "\xF2TEST" == commands[0] and "\x62" == commands[1] and "\xE2" == commands[2],
+				"OPEN, LISTEN and CLOSE are received");
+	check(received == c64.data, "the bytes arrive as sent");
+	bool eoiLast = eois.size() == c64.data.size();
+	for(size_t i = 0; eoiLast and i < eois.size(); ++i)
+		eoiLast = eois[i] == (i + 1 == eois.size());
+	check(eoiLast, "only the last byte is taken as EOI");
+
+	// Every ATN is answered by holding DATA, the drive polls for it between the other work of the sketch.
+	uint64_t maxResponse = 0;
+	size_t numAtn = 0;
+	uint64_t atn = recorder.find(DEFAULT_ATN_PIN, false, true, 0);
+	while(atn) {
+		// Still holding it from the byte before will do.
+		uint64_t nanos = 0;
+		if(not recorder.isPulled(DEFAULT_DATA_PIN, true, atn)) {
+			const uint64_t data = recorder.find(DEFAULT_DATA_PIN, true, true, atn);
+			nanos = data ? data - atn : ~0ULL;
+		}
+		maxResponse = nanos > maxResponse ? nanos : maxResponse;
+		++numAtn;
+		atn = recorder.find(DEFAULT_ATN_PIN, false, true, atn + 1);
+	}
+	printf("receive: %u ATN sequences answered within %.1f us\n", unsigned(numAtn), maxResponse / 1e3);
+	check(numAtn >= 4, "each ATN sequence is seen");
+	check(maxResponse < ATN_RESPONSE_NANOS, "ATN is answered before the C64 takes the drive as not present");
+} // testReceive
+
+
+// Sends bytes to a JiffyDOS C64 that said TALK: the drive answers the detection, and puts the bit pairs and the EOI
+// state on the lines at the JiffyDOS times.
+void testJiffySend(IEC& iec)
+{
+	const std::string data("JIFFY");
+	ListeningC64 c64;
+	c64.setJiffyDos(true);
+	LineRecorder recorder;
+	mockAddPeripheral(&c64);
+	mockAddPeripheral(&recorder);
+	const uint64_t deadline = mockNanos() + 1000000000ULL;
+	uint64_t start = 0, end = 0;
+	bool sent = false;
+	while(not c64.isDone() and mockNanos() < deadline) {
+		IEC::ATNCmd cmd;
+		if(IEC::ATN_CMD_TALK not_eq iec.checkATN(cmd))
+			continue;
+		sent = true;
+		start = mockNanos();
+		for(size_t i = 0; sent and i < data.size(); ++i)
+			sent = i + 1 < data.size() ? iec.send(data[i]) : iec.sendEOI(data[i]);
+		end = mockNanos();
+	}
+	mockRemovePeripheral(&recorder);
+	mockRemovePeripheral(&c64);
+
+	size_t numChanges;
+	const uint64_t error = jiffyTimingError(recorder, c64.jiffyByteStarts(), JIFFY_SEND_TIMES[4] + 2, JIFFY_SEND_TIMES,
+																					sizeof(JIFFY_SEND_TIMES) / sizeof(JIFFY_SEND_TIMES[0]), numChanges);
+	printf("jiffy send: %.1f us per byte, %u line changes up to %.1f us off the bit times\n",
+				 (end - start) / 1e3 / data.size(), unsigned(numChanges), error / 1e3);
+	checkJiffyDetection(c64);
+	check(sent and c64.success, "the bytes are sent with JiffyDOS");
+	check(c64.received == data and c64.jiffyByteStarts().size() == data.size(), "the JiffyDOS bytes arrive as sent");
+	bool eoiLast = c64.eois.size() == data.size();
+	for(size_t i = 0; eoiLast and i < data.size(); ++i)
+		eoiLast = c64.eois[i] == (i + 1 == data.size());
+	check(eoiLast, "only the last JiffyDOS byte is taken as EOI");
+	check(numChanges and error <= JIFFY_TOLERANCE_NANOS, "the bit pairs are sent at the JiffyDOS times");
+} // testJiffySend
+
+
+// A JiffyDOS C64 opens a channel, sends to it and closes it: the drive gets the commands and the bytes sent the
+// JiffyDOS way, and accepts each at the JiffyDOS time.
+void testJiffyReceive(IEC& iec)
+{
+	TalkingC64 c64;
+	c64.setJiffyDos(true);
+	c64.data = "JIFFYDOS";
+	LineRecorder recorder;
+	mockAddPeripheral(&c64);
+	mockAddPeripheral(&recorder);
+
+	std::vector<std::string> commands;
+	std::string received;
+	std::vector<bool> eois;
+	const uint64_t deadline = mockNanos() + 1000000000ULL;
+	while(not c64.isDone() and mockNanos() < deadline) {
+		IEC::ATNCmd cmd;
+		switch(iec.checkATN(cmd)) {
+			case IEC::ATN_CMD:
+				commands.push_back(std::string(1, char(cmd.code)) + std::string((const char*)cmd.str, cmd.strLen));
+				break;
+			case IEC::ATN_CMD_LISTEN:
+				commands.push_back(std::string(1, char(cmd.code)));
+				do {
+					received.push_back(char(iec.receive()));
+					eois.push_back(iec.state() bitand IEC::eoiFlag);
+				} while(not (iec.state() bitand (IEC::eoiFlag bitor IEC::errorFlag)));
+				break;
+			case IEC::ATN_ERROR:
+				commands.push_back("error");
+				break;
+			default:
+				break;
+		}
+	}
+	mockRemovePeripheral(&recorder);
+	mockRemovePeripheral(&c64);
+
+	// The name of the OPEN and the bytes.
+	const size_t numBytes = 4 + c64.data.size();
+	size_t numChanges;
+	const uint64_t error = jiffyTimingError(recorder, c64.jiffyByteStarts(), JIFFY_ACCEPT + 2, &JIFFY_ACCEPT, 1,
+																					numChanges);
+	printf("jiffy receive: %u bytes accepted up to %.1f us off the JiffyDOS time\n", unsigned(numChanges), error / 1e3);
+	checkJiffyDetection(c64);
+	check(c64.isDone() and c64.success, "the JiffyDOS C64 gets rid of its bytes");
+	check(3 == commands.size() and "\xF2TEST" == commands[0] and "\x62" == commands[1] and "\xE2" == commands[2],
+				"OPEN, LISTEN and CLOSE are received from the JiffyDOS C64");
+	check(received == c64.data and c64.jiffyByteStarts().size() == numBytes, "the JiffyDOS bytes arrive as sent");
+	bool eoiLast = eois.size() == c64.data.size();
+	for(size_t i = 0; eoiLast and i < eois.size(); ++i)
+		eoiLast = eois[i] == (i + 1 == eois.size());
+	check(eoiLast, "only the last JiffyDOS byte is taken as EOI");
+	check(numChanges == numBytes and error <= JIFFY_TOLERANCE_NANOS, "each JiffyDOS byte is accepted in time");
+} // testJiffyReceive
+
+
+
+// A LOAD that the C64 stops taking bytes of after a few, and then one of the whole file.
+class StallingC64 : public ScriptedC64
+{
+public:
+	std::string stalled;
+	std::string loaded;
+	bool success;
+
+	StallingC64()
+		: success(false)
+	{}
+
+protected:
+	void run()
+	{
+		// Right after a credit went back. Long enough for the drive to give up on the byte, it then stops the transfer and
+		// drains the serial line.
+		success = load(stalled, 258) and stalled.size() == 258;
+		wait(10000);
+		success = load(loaded, 0) and success;
+	}
+
+private:
+	// Up to EOI, or just the first bytes and then holding DATA for half a second.
+	bool load(std::string& data, size_t stallAfter)
+	{
+		if(not open(0, "STALL") or not talk(0x60))
+			return false;
+		bool eoi = false;
+		while(not eoi) {
+			uint8_t byte;
+			if(not receiveByte(byte, eoi))
+				return false;
+			data.push_back(char(byte));
+			if(data.size() == stallAfter) {
+				wait(500000);
+				break;
+			}
+			wait(60);
+		}
+		return untalk() and close(0);
+	}
+};
+
+
+// The sketch serving a LOAD from the host: the whole file arrives, with the serial transfer overlapping the bus.
+// Returns the bytes per second.
+double testLoad(FileHost& host)
+{
+	std::string file;
+	for(unsigned i = 0; i < 5000; ++i)
+		file.push_back(char(i * 7 + i / 256));
+	host.files["FILE"] = file;
+
+	C64Bus c64(DEFAULT_ATN_PIN, DEFAULT_CLOCK_PIN, DEFAULT_DATA_PIN, DEVICE_NUMBER);
+	c64.addJob(C64Bus::Load, "FILE");
+	c64.addJob(C64Bus::Load, "NONE");
+	mockAddPeripheral(&c64);
+	const uint64_t deadline = mockNanos() + 60000000000ULL;
+	while(not c64.isDone() and mockNanos() < deadline)
+		loop();
+	mockRemovePeripheral(&c64);
+
+	const C64Bus::Job& job = c64.jobs()[0];
+	const double micros = (job.endNanos - job.startNanos) / 1e3;
+	printf("load: %u bytes in %.0f us (%.0f bytes/s), %u credits returned\n", unsigned(job.data.size()), micros,
+				 job.data.size() * 1e6 / micros, host.numRequests['R']);
+	check(c64.isDone() and job.success, "the file is loaded");
+	check(std::string(job.data.begin(), job.data.end()) == file, "the file arrives as served");
+	check(not c64.jobs()[1].success, "a missing file isn't");
+	return job.data.size() * 1e6 / micros;
+} // testLoad
+
+
+// The C64 stops taking bytes during a LOAD: the sketch stops the host streaming and drains the serial line up to its
+// acknowledgement, so that nothing of the transfer gets in the way of the next one. The host answers late, packets
+// for the credits returned before the drive gave up arrive after that.
+void testStalledLoad(FileHost& host)
+{
+	// Bytes the sketch takes for the start of an answer, if any of them are left over.
+	host.files["STALL"] = std::string(5000, '>');
+	StallingC64 c64;
+	const unsigned numAborts = host.numRequests['X'];
+	host.latencyNanos = 250000000;
+	mockAddPeripheral(&c64);
+	const uint64_t deadline = mockNanos() + 60000000000ULL;
+	while(not c64.isDone() and mockNanos() < deadline)
+		loop();
+	mockRemovePeripheral(&c64);
+	host.latencyNanos = 0;
+
+	printf("stalled load: %u bytes, then %u bytes loaded\n", unsigned(c64.stalled.size()), unsigned(c64.loaded.size()));
+	check(c64.isDone() and c64.success, "the C64 gets through both LOADs");
+	check(1 == host.numRequests['X'] - numAborts, "the stalled transfer is stopped");
+	check(c64.loaded == host.files["STALL"], "the next LOAD gets the whole file");
+	check(host.errors.empty(), "the sketch finds the acknowledgement");
+	for(size_t i = 0; i < host.errors.size(); ++i)
+		printf("%s\n", host.errors[i].c_str());
+} // testStalledLoad
+
+
+// Reads a file a byte at a time with a pause after each, as a GET# loop in BASIC does.
+class SlowC64 : public ScriptedC64
+{
+public:
+	std::string loaded;
+	bool success;
+
+	SlowC64()
+		: success(false)
+	{}
+
+protected:
+	void run()
+	{
+		success = open(0, "SLOW") and talk(0x60);
+		bool eoi = false;
+		while(success and not eoi) {
+			uint8_t byte;
+			success = receiveByte(byte, eoi);
+			loaded.push_back(char(byte));
+			wait(10000);
+		}
+		success = success and untalk() and close(0);
+	}
+};
+
+
+// The CBM takes its time for every byte: the packets the host streams ahead wait in the UART's receive ring meanwhile,
+// all of them must fit.
+void testSlowLoad(FileHost& host)
+{
+	std::string file;
+	for(unsigned i = 0; i < 400; ++i)
+		file.push_back(char(i * 13));
+	host.files["SLOW"] = file;
+	const size_t numDropped = mockSerialDropped();
+
+	SlowC64 c64;
+	mockAddPeripheral(&c64);
+	const uint64_t deadline = mockNanos() + 60000000000ULL;
+	while(not c64.isDone() and mockNanos() < deadline)
+		loop();
+	mockRemovePeripheral(&c64);
+
+	printf("slow load: %u bytes loaded, %u serial bytes dropped\n", unsigned(c64.loaded.size()),
+				 unsigned(mockSerialDropped() - numDropped));
+	check(c64.isDone() and c64.success, "the slow C64 gets through the LOAD");
+	check(mockSerialDropped() == numDropped, "no serial byte is dropped while the CBM takes its time");
+	check(c64.loaded == file, "the file arrives as served");
+} // testSlowLoad
+
+
+// The same LOAD from a JiffyDOS C64: the sketch sends it with the JiffyDOS LOAD protocol, at its bit times, and faster
+// than the standard one.
+void testJiffyLoad(FileHost& host, double standardRate)
+{
+	C64Bus c64(DEFAULT_ATN_PIN, DEFAULT_CLOCK_PIN, DEFAULT_DATA_PIN, DEVICE_NUMBER);
+	c64.setJiffyDos(true);
+	c64.addJob(C64Bus::Load, "FILE");
+	c64.addJob(C64Bus::Load, "NONE");
+	LineRecorder recorder;
+	mockAddPeripheral(&c64);
+	mockAddPeripheral(&recorder);
+	const uint64_t deadline = mockNanos() + 60000000000ULL;
+	while(not c64.isDone() and mockNanos() < deadline)
+		loop();
+	mockRemovePeripheral(&recorder);
+	mockRemovePeripheral(&c64);
+
+	const C64Bus::Job& job = c64.jobs()[0];
+	const double micros = (job.endNanos - job.startNanos) / 1e3;
+	const double rate = job.data.size() * 1e6 / micros;
+	size_t numChanges;
+	const uint64_t error = jiffyTimingError(recorder, c64.jiffyByteStarts(), JIFFY_SEND_TIMES[4] + 2, JIFFY_SEND_TIMES,
+																					sizeof(JIFFY_SEND_TIMES) / sizeof(JIFFY_SEND_TIMES[0]), numChanges);
+	printf("jiffy load: %u bytes in %.0f us (%.0f bytes/s), %u line changes up to %.1f us off the bit times\n",
+				 unsigned(job.data.size()), micros, rate, unsigned(numChanges), error / 1e3);
+	check(c64.isDone() and job.success, "the file is loaded with JiffyDOS");
+	check(std::string(job.data.begin(), job.data.end()) == host.files["FILE"], "the file arrives as served with JiffyDOS");
+	check(not c64.jobs()[1].success, "a missing file isn't with JiffyDOS");
+	check(numChanges and error <= JIFFY_TOLERANCE_NANOS, "the LOAD bit pairs are sent at the JiffyDOS times");
+	check(rate > standardRate, "JiffyDOS loads faster than the standard protocol");
+} // testJiffyLoad
+
+
+// A JiffyDOS C64 saves a file: it arrives at the host, every byte accepted at the JiffyDOS time.
+void testJiffySave(FileHost& host)
+{
+	std::vector<uint8_t> file;
+	for(unsigned i = 0; i < 3000; ++i)
+		file.push_back(uint8_t(i * 11 + i / 256));
+	C64Bus c64(DEFAULT_ATN_PIN, DEFAULT_CLOCK_PIN, DEFAULT_DATA_PIN, DEVICE_NUMBER);
+	c64.setJiffyDos(true);
+	c64.addJob(C64Bus::Save, "SAVED", file);
+	LineRecorder recorder;
+	mockAddPeripheral(&c64);
+	mockAddPeripheral(&recorder);
+	const uint64_t deadline = mockNanos() + 60000000000ULL;
+	while(not c64.isDone() and mockNanos() < deadline)
+		loop();
+	mockRemovePeripheral(&recorder);
+	mockRemovePeripheral(&c64);
+
+	const C64Bus::Job& job = c64.jobs()[0];
+	const double micros = (job.endNanos - job.startNanos) / 1e3;
+	size_t numChanges;
+	const uint64_t error = jiffyTimingError(recorder, c64.jiffyByteStarts(), JIFFY_ACCEPT + 2, &JIFFY_ACCEPT, 1,
+																					numChanges);
+	printf("jiffy save: %u bytes in %.0f us (%.0f bytes/s), accepted up to %.1f us off the JiffyDOS time\n",
+				 unsigned(file.size()), micros, file.size() * 1e6 / micros, error / 1e3);
+	check(c64.isDone() and job.success, "the file is saved with JiffyDOS");
+	check(host.files["SAVED"] == std::string(file.begin(), file.end()), "the saved file arrives at the host");
+	check(numChanges == c64.jiffyByteStarts().size() and error <= JIFFY_TOLERANCE_NANOS,
+				"each saved byte is accepted in time");
+} // testJiffySave
+
+
+// Sends a command starting drive code, then leaves the bus alone for a while.
+class ExecutingC64 : public ScriptedC64
+{
+public:
+	bool success;
+
+	ExecutingC64()
+		: success(false)
+	{}
+
+protected:
+	void run()
+	{
+		success = open(CBM::CMD_CHANNEL, std::string("M-E\x00\x05", 5));
+		wait(100000);
+	}
+};
+
+
+// Within the few microseconds the sketch takes around a change of the lines.
+bool isAbout(uint64_t nanos, uint64_t micros)
+{
+	return nanos + 5000 > micros * 1000 and nanos < micros * 1000 + 5000;
+} // isAbout
+
+
+void addReplayEntry(std::string& replay, unsigned micros, uint8_t lines)
+{
+	replay.push_back(char(micros bitand 0xFF));
+	replay.push_back(char(micros >> 8));
+	replay.push_back(char(lines));
+} // addReplayEntry
+
+
+// The sketch replays on the bus what the drive code did on the host's emulated 1541, right after the command.
+void testBusReplay(FileHost& host)
+{
+	host.busReplay.clear();
+	addReplayEntry(host.busReplay, 1000, BUS_REPLAY_CLOCK);
+	addReplayEntry(host.busReplay, 500, BUS_REPLAY_CLOCK bitor BUS_REPLAY_DATA);
+	addReplayEntry(host.busReplay, 200, 0);
+	// More than fits in one response.
+	const unsigned numToggles = MAX_BUS_REPLAY_BYTES / BUS_REPLAY_ENTRY_SIZE;
+	for(unsigned i = 0; i < numToggles; ++i)
+		addReplayEntry(host.busReplay, 100, i bitand 1 ? 0 : BUS_REPLAY_DATA);
+	const unsigned numReplays = host.numRequests['V'];
+
+	ExecutingC64 c64;
+	LineRecorder recorder;
+	mockAddPeripheral(&recorder);
+	mockAddPeripheral(&c64);
+	const uint64_t deadline = mockNanos() + 10000000000ULL;
+	while(not c64.isDone() and mockNanos() < deadline)
+		loop();
+	mockRemovePeripheral(&c64);
+	mockRemovePeripheral(&recorder);
+
+	const uint64_t clockPulled = recorder.find(DEFAULT_CLOCK_PIN, true, true, 0);
+	const uint64_t dataPulled = recorder.find(DEFAULT_DATA_PIN, true, true, clockPulled);
+	const uint64_t released = recorder.find(DEFAULT_CLOCK_PIN, true, false, clockPulled);
+	unsigned numDataPulls = 0;
+	for(uint64_t from = clockPulled; 0 not_eq (from = recorder.find(DEFAULT_DATA_PIN, true, true, from)); ++from)
+		++numDataPulls;
+	printf("bus replay: DATA pulled %.1f us after CLOCK, both released %.1f us later, %u pulls of DATA\n",
+				 (dataPulled - clockPulled) / 1e3, (released - dataPulled) / 1e3, numDataPulls);
+	check(c64.isDone() and c64.success, "the C64 sends the command");
+	check(2 == host.numRequests['V'] - numReplays and host.busReplay.empty(), "the whole replay is asked for");
+	check(clockPulled and isAbout(dataPulled - clockPulled, 500) and isAbout(released - dataPulled, 200),
+				"the lines change in time");
+	check(1 + (numToggles + 1) / 2 == numDataPulls, "every change is replayed");
+	check(not mockSketchPulls(DEFAULT_CLOCK_PIN) and not mockSketchPulls(DEFAULT_DATA_PIN),
+				"the lines are released after the replay");
+} // testBusReplay
+} // unnamed namespace
+
+
+int main()
+{
+	mockSetPacing(false);
+	IEC iec(DEVICE_NUMBER);
+	iec.init();
+
+	testTimeout(iec);
+	testSend(iec);
+	testReceive(iec);
+	testJiffySend(iec);
+	testJiffyReceive(iec);
+
+	// Then all of the sketch, the way it runs on the Arduino.
+	FileHost host;
+	mockAddPeripheral(&host);
+	setup();
+	const double standardRate = testLoad(host);
+	testStalledLoad(host);
+	testSlowLoad(host);
+	testJiffyLoad(host, standardRate);
+	testJiffySave(host);
+	testBusReplay(host);
+	mockRemovePeripheral(&host);
+
+	if(s_numFailed)
+		printf("%d checks failed.\n", s_numFailed);
+	else
+		printf("All checks passed.\n");
+	return s_numFailed ? 1 : 0;
+} // main
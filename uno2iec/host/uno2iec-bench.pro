@@ -0,0 +1,35 @@
+#-------------------------------------------------
+#
+# uno2iec-bench: The Arduino sketch on the mock Arduino core with a simulated C64 on its IEC lines and the core
+# library's Interface on its serial line, timing LOADs, SAVEs and directory listings in simulated time. Unix only.
+#
+#-------------------------------------------------
+
+QT       = core
+
+TARGET = uno2iec-bench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../../uno2iec-common.pri)
+include(../../uno2iec-core.pri)
+
+# The sketch sources are built by qmake instead of the Arduino tools, the sketch's own CONSOLE_DEBUG is left off.
+DEFINES -= CONSOLE_DEBUG
+DEFINES += UNDER_QT
+# The mock Arduino.h must be found instead of any installed Arduino core.
+INCLUDEPATH = $$PWD $$PWD/.. $$INCLUDEPATH
+
+SOURCES += \
+				firmware.cpp \
+				mockarduino.cpp \
+				c64bus.cpp \
+				hostlink.cpp \
+				bench.cpp
+
+HEADERS += \
+				Arduino.h \
+				mockarduino.h \
+				c64bus.h \
+				hostlink.h
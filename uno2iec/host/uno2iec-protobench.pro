@@ -0,0 +1,33 @@
+#-------------------------------------------------
+#
+# uno2iec-protobench: A software Arduino stand-in on the mock Arduino core speaking the serial protocol to the core
+# library's Interface through a pseudo terminal pair, timing LOADs, SAVEs and directory listings over a made up corpus
+# of PRG files and D64/T64 images in wall clock time. Unix only.
+#
+#-------------------------------------------------
+
+QT       = core
+
+TARGET = uno2iec-protobench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../../uno2iec-common.pri)
+include(../../uno2iec-core.pri)
+
+# The mock core is built by qmake instead of the Arduino tools, the sketch's own CONSOLE_DEBUG is left off.
+DEFINES -= CONSOLE_DEBUG
+DEFINES += UNDER_QT
+# The mock Arduino.h must be found instead of any installed Arduino core.
+INCLUDEPATH = $$PWD $$PWD/.. $$INCLUDEPATH
+
+SOURCES += \
+				mockarduino.cpp \
+				hostlink.cpp \
+				protobench.cpp
+
+HEADERS += \
+				Arduino.h \
+				mockarduino.h \
+				hostlink.h
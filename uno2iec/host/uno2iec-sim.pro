@@ -0,0 +1,46 @@
+#-------------------------------------------------
+#
+# uno2iec-sim: The Arduino sketch built for the host against a mock Arduino core (virtual clock, simulated pins and
+# a pseudo terminal as the serial port). No Qt involved, unix only.
+#
+#-------------------------------------------------
+
+QT =
+CONFIG += console
+CONFIG -= qt app_bundle
+
+TARGET = uno2iec-sim
+TEMPLATE = app
+
+# The sketch sources are built by qmake instead of the Arduino tools.
+DEFINES += UNDER_QT
+# The mock Arduino.h must be found instead of any installed Arduino core.
+INCLUDEPATH = $$PWD $$PWD/..
+QMAKE_CXXFLAGS += -std=gnu++0x
+
+CONFIG(debug, debug|release) {
+		REL = debug
+} else {
+		REL = release
+}
+
+OBJECTS_DIR = $$quote($${REL}/.obj)
+DESTDIR = $$quote($${REL})
+
+SOURCES += \
+				../iec_driver.cpp \
+				../interface.cpp \
+				../log.cpp \
+				sketch.cpp \
+				mockarduino.cpp \
+				main.cpp
+
+HEADERS += \
+				../iec_driver.h \
+				../iec_hal.h \
+				../interface.h \
+				../log.h \
+				../global_defines.h \
+				../cbmdefines.h \
+				Arduino.h \
+				mockarduino.h
@@ -0,0 +1,49 @@
+#-------------------------------------------------
+#
+# uno2iec-test: Checks of the IEC driver's bus timing (ATN response, bit timing, EOI, timeouts, JiffyDOS) and of the
+# sketch serving LOADs and SAVEs, against a simulated C64 on the mock Arduino core and a media host stand-in on its serial line, in
+# simulated time. No Qt involved, unix only. Exits with 1 if any check failed.
+#
+#-------------------------------------------------
+
+QT =
+CONFIG += console
+CONFIG -= qt app_bundle
+
+TARGET = uno2iec-test
+TEMPLATE = app
+
+# The sketch sources are built by qmake instead of the Arduino tools.
+DEFINES += UNDER_QT
+# The mock Arduino.h must be found instead of any installed Arduino core.
+INCLUDEPATH = $$PWD $$PWD/..
+QMAKE_CXXFLAGS += -std=gnu++0x
+
+CONFIG(debug, debug|release) {
+		REL = debug
+} else {
+		REL = release
+}
+
+OBJECTS_DIR = $$quote($${REL}/.obj)
+DESTDIR = $$quote($${REL})
+
+SOURCES += \
+				../iec_driver.cpp \
+				../interface.cpp \
+				../log.cpp \
+				sketch.cpp \
+				mockarduino.cpp \
+				c64bus.cpp \
+				test.cpp
+
+HEADERS += \
+				../iec_driver.h \
+				../iec_hal.h \
+				../interface.h \
+				../log.h \
+				../global_defines.h \
+				../cbmdefines.h \
+				Arduino.h \
+				mockarduino.h \
+				c64bus.h
@@ -22,6 +22,67 @@ using namespace CBM;
 
 // Version 0.5 equivalent timings: 70, 5, 200, 20, 20, 50, 100, 100
 
+#ifdef USE_JIFFYDOS
+// JiffyDOS timing consts. The bit times are in tenths of microseconds counted from the edge starting the byte.
+#define JIFFY_DETECT_DELAY  2180 // CBM holds clock before the last ATN bit (0.1 us)
+#define JIFFY_DETECT_ACK    101  // our data pulse answering it             (us)
+#define JIFFY_SEND_EOI      520  // EOI / not EOI after the 4 bit pairs     (0.1 us)
+#define JIFFY_RECEIVE_EOI   730  // EOI / not EOI after the 4 bit pairs     (0.1 us)
+#define JIFFY_HOLD          10   // hold time after each byte               (us)
+
+// Sending, the bit pairs are put on (clock, data) at these times: (0, 1), (2, 3), (4, 5), (6, 7). Released = 1.
+static const word jiffySendTimes[4] = { 100, 200, 310, 410 };
+// Receiving, the bit pairs are sampled at these times: (4, 5), (6, 7), (3, 1), (2, 0). Pulled = 1.
+static const word jiffyReceiveTimes[4] = { 185, 385, 525, 645 };
+static const byte jiffyReceiveClockBits[4] = { 1 << 4, 1 << 6, 1 << 3, 1 << 2 };
+static const byte jiffyReceiveDataBits[4] = { 1 << 5, 1 << 7, 1 << 1, 1 << 0 };
+
+// Time base for the bit timing. On AVR Timer1 runs free at F_CPU / 8 (half a microsecond per tick at 16 MHz), since
+// micros() only has a resolution of 4 us. Elsewhere (e.g. a simulation of the driver) micros() is used.
+#ifdef TCNT1
+#define JIFFY_TICKS(tenthsMicros) ((word)(((ulong)(tenthsMicros) * (F_CPU / 1000000UL)) / 80))
+
+static inline void jiffyStartTimer()
+{
+	TCNT1 = 0;
+} // jiffyStartTimer
+
+
+static inline boolean jiffyElapsed(word tenthsMicros)
+{
+	return TCNT1 >= JIFFY_TICKS(tenthsMicros);
+} // jiffyElapsed
+#else
+static ulong jiffyStartMicros;
+
+static inline void jiffyStartTimer()
+{
+	jiffyStartMicros = micros();
+} // jiffyStartTimer
+
+
+static inline boolean jiffyElapsed(word tenthsMicros)
+{
+	return (micros() - jiffyStartMicros) * 10 >= tenthsMicros;
+} // jiffyElapsed
+#endif
+
+static inline void jiffyWaitUntil(word tenthsMicros)
+{
+	while(not jiffyElapsed(tenthsMicros));
+} // jiffyWaitUntil
+
+// An interrupt in the middle of the bit pairs would spoil the timing, so they are sent with interrupts held off. That
+// is below 100 us per byte, the UART doesn't lose anything meanwhile.
+#ifdef SREG
+#define JIFFY_ENTER_CRITICAL() byte oldSREG = SREG; noInterrupts()
+#define JIFFY_LEAVE_CRITICAL() SREG = oldSREG
+#else
+#define JIFFY_ENTER_CRITICAL() noInterrupts()
+#define JIFFY_LEAVE_CRITICAL() interrupts()
+#endif
+#endif
+
 // TIMING TESTING:
 //
 // The consts: 70,20,200,20,20,50,100,100 has been tested without debug print
@@ -30,21 +91,18 @@ using namespace CBM;
 //
 
 
-// The IEC bus pin configuration on the Arduino side
-// NOTE: Deprecated: Only startup values used in ctor, this will be defined from host side.
-#define DEFAULT_ATN_PIN 5
-#define DEFAULT_DATA_PIN 3
-#define DEFAULT_CLOCK_PIN 4
-#define DEFAULT_SRQIN_PIN 6
-#define DEFAULT_RESET_PIN 7
-
 // See timeoutWait below.
 #define TIMEOUT  65000
 
 IEC::IEC(byte deviceNumber) :
 	m_state(noFlags), m_deviceNumber(deviceNumber),
 	m_atnPin(DEFAULT_ATN_PIN), m_dataPin(DEFAULT_DATA_PIN),
-	m_clockPin(DEFAULT_CLOCK_PIN), /*m_srqInPin(DEFAULT_SRQIN_PIN),*/ m_resetPin(DEFAULT_RESET_PIN)
+	m_clockPin(DEFAULT_CLOCK_PIN), /*m_srqInPin(DEFAULT_SRQIN_PIN),*/ m_resetPin(DEFAULT_RESET_PIN),
+	m_atn(DEFAULT_ATN_PIN), m_data(DEFAULT_DATA_PIN), m_clock(DEFAULT_CLOCK_PIN), m_reset(DEFAULT_RESET_PIN),
+	m_fastPins(true)
+#ifdef USE_JIFFYDOS
+,m_jiffyFlags(0)
+#endif
 #ifdef DEBUGLINES
 ,m_lastMillis(0)
 #endif
@@ -52,14 +110,14 @@ IEC::IEC(byte deviceNumber) :
 } // ctor
 
 
-byte IEC::timeoutWait(byte waitBit, boolean whileHigh)
+byte IEC::timeoutWait(IECLine waitLine, boolean whileHigh)
 {
 	word t = 0;
 	boolean c;
 
 	while(t < TIMEOUT) {
 		// Check the waiting condition:
-		c = readPIN(waitBit);
+		c = readPIN(waitLine);
 
 		if(whileHigh)
 			c = not c;
@@ -67,7 +125,7 @@ byte IEC::timeoutWait(byte waitBit, boolean whileHigh)
 		if(c)
 			return false;
 
-		delayMicroseconds(2); // The aim is to make the loop at least 3 us
+		delayMicroseconds(3); // The aim is to make the loop at least 3 us
 		t++;
 	}
 
@@ -98,8 +156,26 @@ byte IEC::receiveByte(void)
 {
 	m_state = noFlags;
 
+#ifdef USE_JIFFYDOS
+	// A JiffyDOS talker sends the data bytes the fast way, but it may assert ATN instead (e.g. for UNLISTEN).
+	if((m_jiffyFlags bitand jiffyActive) and readATN()) {
+		// Say we're ready, the talker releasing the clock then starts the byte.
+		writeCLOCK(false);
+		writeDATA(false);
+		if(jiffyWaitFor(lineClock, true))
+			return receiveJiffyByte();
+		if(readATN()) {
+			// Timeout, go to inactive state with error flag the same as timeoutWait().
+			m_state = errorFlag;
+			return 0;
+		}
+		// Acknowledge the ATN and receive the standard way.
+		writeDATA(true);
+	}
+#endif
+
 	// Wait for talker ready
-	if(timeoutWait(m_clockPin, false))
+	if(timeoutWait(lineClock, false))
 		return 0;
 
 	// Say we're ready
@@ -122,7 +198,7 @@ byte IEC::receiveByte(void)
 		writeDATA(false);
 
 		// but still wait for clk
-		if(timeoutWait(m_clockPin, true))
+		if(timeoutWait(lineClock, true))
 			return 0;
 	}
 
@@ -134,10 +210,15 @@ byte IEC::receiveByte(void)
 	// Get the bits, sampling on clock rising edge:
 	for(n = 0; n < 8; n++) {
 		data >>= 1;
-		if(timeoutWait(m_clockPin, false))
+#ifdef USE_JIFFYDOS
+		// Before the last bit, data holds the first seven bits of the byte.
+		if(7 == n and (m_state bitand atnFlag))
+			detectJiffy(data);
+#endif
+		if(timeoutWait(lineClock, false))
 			return 0;
 		data or_eq (readDATA() ? (1 << 7) : 0);
-		if(timeoutWait(m_clockPin, true))
+		if(timeoutWait(lineClock, true))
 			return 0;
 	}
 
@@ -154,15 +235,20 @@ byte IEC::receiveByte(void)
 //
 boolean IEC::sendByte(byte data, boolean signalEOI)
 {
+#ifdef USE_JIFFYDOS
+	if(m_jiffyFlags bitand jiffyActive)
+		return sendJiffyByte(data, signalEOI);
+#endif
+
 	// Listener must have accepted previous data
-	if(timeoutWait(m_dataPin, true))
+	if(timeoutWait(lineData, true))
 		return false;
 
 	// Say we're ready
 	writeCLOCK(false);
 
 	// Wait for listener to be ready
-	if(timeoutWait(m_dataPin, false))
+	if(timeoutWait(lineData, false))
 		return false;
 
 	if(signalEOI) {
@@ -172,10 +258,10 @@ boolean IEC::sendByte(byte data, boolean signalEOI)
 		delayMicroseconds(TIMING_EOI_WAIT);
 
 		// get eoi acknowledge:
-		if(timeoutWait(m_dataPin, true))
+		if(timeoutWait(lineData, true))
 			return false;
 
-		if(timeoutWait(m_dataPin, false))
+		if(timeoutWait(lineData, false))
 			return false;
 	}
 
@@ -205,7 +291,7 @@ boolean IEC::sendByte(byte data, boolean signalEOI)
 	delayMicroseconds(TIMING_STABLE_WAIT);
 
 	// Wait for listener to accept data
-	if(timeoutWait(m_dataPin, true))
+	if(timeoutWait(lineData, true))
 		return false;
 
 	return true;
@@ -216,7 +302,7 @@ boolean IEC::sendByte(byte data, boolean signalEOI)
 boolean IEC::turnAround(void)
 {
 	// Wait until clock is released
-	if(timeoutWait(m_clockPin, false))
+	if(timeoutWait(lineClock, false))
 		return false;
 
 	writeDATA(false);
@@ -238,13 +324,134 @@ boolean IEC::undoTurnAround(void)
 	delayMicroseconds(TIMING_BIT);
 
 	// wait until the computer releases the clock line
-	if(timeoutWait(m_clockPin, true))
+	if(timeoutWait(lineClock, true))
 		return false;
 
 	return true;
 } // undoTurnAround
 
 
+#ifdef USE_JIFFYDOS
+// A JiffyDOS CBM holds the clock for a while before the last bit of each byte under ATN. If the byte is a LISTEN or TALK
+// to us, pulsing the data line meanwhile tells it that we speak JiffyDOS too.
+// Source: sd2iec and http://home.arcor.de/jochen.adler/ip-jiffy.htm
+void IEC::detectJiffy(byte partialCmd)
+{
+	jiffyStartTimer();
+	while(not readCLOCK()) {
+		if(jiffyElapsed(JIFFY_DETECT_DELAY)) {
+			if((ATN_CODE_LISTEN bitor m_deviceNumber) == partialCmd or (ATN_CODE_TALK bitor m_deviceNumber) == partialCmd) {
+				writeDATA(true);
+				delayMicroseconds(JIFFY_DETECT_ACK);
+				writeDATA(false);
+				m_jiffyFlags or_eq jiffyActive;
+			}
+			// The rest of the waiting for the last bit is up to the caller.
+			return;
+		}
+	}
+} // detectJiffy
+
+
+// Waits until the line is at the level, without any delays since the bit timing counts from this moment.
+// Returns false on timeout or if the CBM asserts ATN.
+boolean IEC::jiffyWaitFor(IECLine line, boolean level)
+{
+	word t = 0;
+	while(readPIN(line) not_eq level) {
+		if(not readATN() or ++t >= TIMEOUT)
+			return false;
+	}
+	return true;
+} // jiffyWaitFor
+
+
+// JiffyDOS receive byte, called at the moment the talker released the clock.
+//
+// Might set flags in iec_state
+byte IEC::receiveJiffyByte(void)
+{
+	byte data = 0;
+	JIFFY_ENTER_CRITICAL();
+	jiffyStartTimer();
+	for(byte n = 0; n < 4; n++) {
+		jiffyWaitUntil(jiffyReceiveTimes[n]);
+		if(not readCLOCK())
+			data or_eq jiffyReceiveClockBits[n];
+		if(not readDATA())
+			data or_eq jiffyReceiveDataBits[n];
+	}
+
+	// A released clock after the bits means this is the last byte.
+	jiffyWaitUntil(JIFFY_RECEIVE_EOI);
+	if(readCLOCK())
+		m_state or_eq eoiFlag;
+
+	// Signal we accepted data:
+	writeDATA(true);
+	JIFFY_LEAVE_CRITICAL();
+	delayMicroseconds(JIFFY_HOLD);
+
+	return data;
+} // receiveJiffyByte
+
+
+// JiffyDOS send byte
+//
+// Each byte is started by the listener, in byte mode by releasing the data line and in LOAD mode by pulling it.
+// In LOAD mode the listener doesn't accept the bytes, and the not EOI signal after a byte (clock held) tells it to wait
+// for the clock to be released before asking for the next: our next byte may have to come from the host first.
+boolean IEC::sendJiffyByte(byte data, boolean signalEOI)
+{
+	const boolean loadMode = m_jiffyFlags bitand jiffyLoad;
+	writeCLOCK(false);
+	writeDATA(false);
+	// allow for slow rise time
+	delayMicroseconds(3);
+
+	boolean started = jiffyWaitFor(lineData, true);
+	if(started and loadMode)
+		started = jiffyWaitFor(lineData, false);
+	if(not started) {
+		// Timeout or ATN, give up this transfer.
+		m_state = errorFlag;
+		return false;
+	}
+
+	JIFFY_ENTER_CRITICAL();
+	jiffyStartTimer();
+	for(byte n = 0; n < 4; n++) {
+		jiffyWaitUntil(jiffySendTimes[n]);
+		writeCLOCK(not (data bitand 1));
+		writeDATA(not (data bitand 2));
+		data >>= 2;
+	}
+
+	jiffyWaitUntil(JIFFY_SEND_EOI);
+	// EOI: clock released and data pulled, otherwise the other way around.
+	writeCLOCK(not signalEOI);
+	writeDATA(signalEOI);
+	JIFFY_LEAVE_CRITICAL();
+
+	// Wait for listener to accept data. Not when signalling EOI: reading DATA would release it before the listener has
+	// seen it, the hold time below is for that.
+	if(not loadMode and not signalEOI) {
+		delayMicroseconds(3);
+		word t = 0;
+		while(readDATA() and readATN())
+			if(++t >= TIMEOUT) {
+				// The listener never took the byte, same as a timeout in the standard protocol.
+				m_state = errorFlag;
+				return false;
+			}
+	}
+	delayMicroseconds(JIFFY_HOLD);
+
+	return readATN();
+} // sendJiffyByte
+#endif
+
+
 /******************************************************************************
  *                                                                             *
  *                               Public functions                              *
@@ -266,6 +473,10 @@ IEC::ATNCheck IEC::checkATN(ATNCmd& cmd)
 		// Attention line is active, go to listener mode and get message. Being fast with the next two lines here is CRITICAL!
 		writeDATA(true);
 		writeCLOCK(false);
+#ifdef USE_JIFFYDOS
+		// JiffyDOS is negotiated anew with every LISTEN or TALK.
+		m_jiffyFlags = 0;
+#endif
 		delayMicroseconds(TIMING_ATN_PREDELAY);
 
 		// Get first ATN byte, it is either LISTEN or TALK
@@ -315,6 +526,13 @@ IEC::ATNCheck IEC::checkATN(ATNCmd& cmd)
 			c = (ATNCommand)receiveByte();
 			if(m_state bitand errorFlag)
 				return ATN_ERROR;
+#ifdef USE_JIFFYDOS
+			// A JiffyDOS LOAD talks the file opened on channel 0 through channel 1, using the LOAD protocol.
+			if((m_jiffyFlags bitand jiffyActive) and (ATN_CODE_DATA bitor 1) == c) {
+				m_jiffyFlags or_eq jiffyLoad;
+				c = ATN_CODE_DATA;
+			}
+#endif
 			cmd.code = c;
 
 			while(not readATN()) {
@@ -450,6 +668,15 @@ boolean IEC::init()
 	m_lastMillis = millis();
 #endif
 
+#if defined(USE_JIFFYDOS) and defined(TCNT1)
+	// Timer1 in normal mode, free running at F_CPU / 8.
+	TCCR1A = 0;
+	TCCR1B = _BV(CS11);
+#endif
+#ifdef USE_JIFFYDOS
+	m_jiffyFlags = 0;
+#endif
+
 	// Set port low, we don't need internal pullup
 	// and DDR input such that we release all signals
 	//  IEC_PORT and_eq compl(IEC_BIT_ATN bitor IEC_BIT_CLOCK bitor IEC_BIT_DATA);
@@ -492,6 +719,16 @@ void IEC::testOUTPUTS()
 #endif
 
 
+boolean IEC::driveLines(boolean clock, boolean data)
+{
+	if(not readATN())
+		return false;
+	writeCLOCK(clock);
+	writeDATA(data);
+	return true;
+} // driveLines
+
+
 byte IEC::deviceNumber() const
 {
 	return m_deviceNumber;
@@ -511,6 +748,12 @@ void IEC::setPins(byte atn, byte clock, byte data, byte srqIn, byte reset)
 	m_dataPin = data;
 	m_resetPin = reset;
 	m_srqInPin = srqIn;
+	m_atn.set(atn);
+	m_clock.set(clock);
+	m_data.set(data);
+	m_reset.set(reset);
+	m_fastPins = DEFAULT_ATN_PIN == atn and DEFAULT_CLOCK_PIN == clock and DEFAULT_DATA_PIN == data
+			and DEFAULT_RESET_PIN == reset;
 } // setPins
 
 
@@ -4,6 +4,16 @@
 #include <Arduino.h>
 #include "global_defines.h"
 #include "cbmdefines.h"
+#include "iec_hal.h"
+
+// The IEC bus pin configuration on the Arduino side
+// NOTE: Only startup values, the pins are given by the host at connect. As long as these same pins are used (the host
+// defaults), the lines are accessed as compile time pins.
+#define DEFAULT_ATN_PIN 5
+#define DEFAULT_DATA_PIN 3
+#define DEFAULT_CLOCK_PIN 4
+#define DEFAULT_SRQIN_PIN 6
+#define DEFAULT_RESET_PIN 7
 
 
 class IEC
@@ -87,6 +97,10 @@ public:
 	//
 	byte receive();
 
+	// Pulls (true) or releases CLOCK and DATA for drive code run on the media host, see Interface::replayBus(). Leaves
+	// them (false) while the CBM pulls ATN, the bus is the CBM's then. checkATN() releases them when the bus is idle.
+	boolean driveLines(boolean clock, boolean data);
+
 	byte deviceNumber() const;
 	void setDeviceNumber(const byte deviceNumber);
 	void setPins(byte atn, byte clock, byte data, byte srqIn, byte reset);
@@ -99,38 +113,56 @@ public:
 #endif
 
 private:
-	byte timeoutWait(byte waitBit, boolean whileHigh);
+	// The lines that can be waited for.
+	enum IECLine {
+		lineATN,
+		lineClock,
+		lineData
+	};
+
+	byte timeoutWait(IECLine waitLine, boolean whileHigh);
 	byte receiveByte(void);
 	boolean sendByte(byte data, boolean signalEOI);
 	boolean turnAround(void);
 	boolean undoTurnAround(void);
+#ifdef USE_JIFFYDOS
+	void detectJiffy(byte partialCmd);
+	boolean jiffyWaitFor(IECLine line, boolean level);
+	byte receiveJiffyByte(void);
+	boolean sendJiffyByte(byte data, boolean signalEOI);
+#endif
 
 	// false = LOW, true == HIGH
-	inline boolean readPIN(byte pinNumber)
+	inline boolean readPIN(IECLine line)
 	{
-		// To be able to read line we must be set to input, not driving.
-		pinMode(pinNumber, INPUT);
-		return digitalRead(pinNumber) ? true : false;
+		switch(line) {
+			case lineATN:
+				return readATN();
+			case lineClock:
+				return readCLOCK();
+			default:
+				return readDATA();
+		}
 	}
 
 	inline boolean readATN()
 	{
-		return readPIN(m_atnPin);
+		return iecRead<DEFAULT_ATN_PIN>(m_fastPins, m_atn);
 	}
 
 	inline boolean readDATA()
 	{
-		return readPIN(m_dataPin);
+		return iecRead<DEFAULT_DATA_PIN>(m_fastPins, m_data);
 	}
 
 	inline boolean readCLOCK()
 	{
-		return readPIN(m_clockPin);
+		return iecRead<DEFAULT_CLOCK_PIN>(m_fastPins, m_clock);
 	}
 
 	inline boolean readRESET()
 	{
-		return !readPIN(m_resetPin);
+		return !iecRead<DEFAULT_RESET_PIN>(m_fastPins, m_reset);
 	}
 
 //	inline boolean readSRQIN()
@@ -139,25 +171,19 @@ private:
 //	}
 
 	// true == PULL == HIGH, false == RELEASE == LOW
-	inline void writePIN(byte pinNumber, boolean state)
-	{
-		pinMode(pinNumber, state ? OUTPUT : INPUT);
-		digitalWrite(pinNumber, state ? LOW : HIGH);
-	}
-
 	inline void writeATN(boolean state)
 	{
-		writePIN(m_atnPin, state);
+		iecWrite<DEFAULT_ATN_PIN>(m_fastPins, m_atn, state);
 	}
 
 	inline void writeDATA(boolean state)
 	{
-		writePIN(m_dataPin, state);
+		iecWrite<DEFAULT_DATA_PIN>(m_fastPins, m_data, state);
 	}
 
 	inline void writeCLOCK(boolean state)
 	{
-		writePIN(m_clockPin, state);
+		iecWrite<DEFAULT_CLOCK_PIN>(m_fastPins, m_clock, state);
 	}
 
 	// communication must be reset
@@ -169,6 +195,19 @@ private:
 	byte m_clockPin;
 	byte m_srqInPin;
 	byte m_resetPin;
+	IECPin m_atn;
+	IECPin m_data;
+	IECPin m_clock;
+	IECPin m_reset;
+	// True when the pins are the DEFAULT_*_PIN ones, they are then accessed as compile time pins.
+	boolean m_fastPins;
+#ifdef USE_JIFFYDOS
+	enum JiffyFlags {
+		jiffyActive = (1 << 0), // the CBM has been answered that we speak JiffyDOS, valid until the next ATN.
+		jiffyLoad   = (1 << 1)  // talking a file with the JiffyDOS LOAD protocol.
+	};
+	byte m_jiffyFlags;
+#endif
 };
 
 #endif
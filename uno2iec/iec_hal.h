@@ -0,0 +1,164 @@
+#ifndef IEC_HAL_H
+#define IEC_HAL_H
+
+#include <Arduino.h>
+#include "global_defines.h"
+
+// Pin access for the IEC bus lines. The lines are open collector: a line is pulled by driving the pin low and released
+// by making it an input again (with the pull-up enabled), reading a line releases it first.
+//
+// Backends:
+// - ATmega328 (Uno, Nano): compile time pins (IECFastPin), the port and bit are constants so every access is a single
+//   sbi/cbi/sbic instruction. Used for the pins the sketch is built with.
+// - AVR: runtime pins (IECPin) with the port registers and bit mask looked up once when the pin is assigned. This is
+//   the fallback when the host configures other pins at connect.
+// - Anything else: runtime pins through the plain Arduino API (pinMode, digitalRead, digitalWrite), this is also what
+//   a host compiled build of the driver uses against a mock Arduino core.
+//
+// No interrupt handler of the sketch touches the port registers, so the read-modify-write accesses are not protected.
+
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__) || defined(__AVR_ATmega168__)
+#define IEC_HAL_FAST_PINS
+#endif
+
+#ifdef IEC_HAL_FAST_PINS
+// Arduino pin number to port: D0-D7 on PORTD, D8-D13 on PORTB and A0-A5 (14-19) on PORTC.
+template <byte Pin>
+class IECFastPin
+{
+	static inline volatile uint8_t& in()
+	{
+		return Pin < 8 ? PIND : (Pin < 14 ? PINB : PINC);
+	}
+
+	static inline volatile uint8_t& out()
+	{
+		return Pin < 8 ? PORTD : (Pin < 14 ? PORTB : PORTC);
+	}
+
+	static inline volatile uint8_t& ddr()
+	{
+		return Pin < 8 ? DDRD : (Pin < 14 ? DDRB : DDRC);
+	}
+
+	enum { mask = 1 << (Pin < 8 ? Pin : (Pin < 14 ? Pin - 8 : Pin - 14)) };
+
+public:
+	// false = LOW, true == HIGH
+	static inline boolean read()
+	{
+		ddr() and_eq compl mask;
+		out() and_eq compl mask;
+		return in() bitand mask;
+	}
+
+	// true == PULL == LOW, false == RELEASE == HIGH
+	static inline void write(boolean pull)
+	{
+		if(pull) {
+			// Clear the output before it is enabled, the line must never be driven high.
+			out() and_eq compl mask;
+			ddr() or_eq mask;
+		}
+		else {
+			ddr() and_eq compl mask;
+			out() or_eq mask;
+		}
+	}
+};
+#endif
+
+
+class IECPin
+{
+public:
+	IECPin(byte pin)
+	{
+		set(pin);
+	}
+
+	void set(byte pin)
+	{
+#ifdef __AVR__
+		const byte port = digitalPinToPort(pin);
+		m_mask = digitalPinToBitMask(pin);
+		m_pIn = portInputRegister(port);
+		m_pOut = portOutputRegister(port);
+		m_pDdr = portModeRegister(port);
+#else
+		m_pin = pin;
+#endif
+	}
+
+	// false = LOW, true == HIGH
+	inline boolean read() const
+	{
+#ifdef __AVR__
+		*m_pDdr and_eq compl m_mask;
+		*m_pOut and_eq compl m_mask;
+		return *m_pIn bitand m_mask;
+#else
+		pinMode(m_pin, INPUT);
+		return digitalRead(m_pin) ? true : false;
+#endif
+	}
+
+	// true == PULL == LOW, false == RELEASE == HIGH
+	inline void write(boolean pull) const
+	{
+#ifdef __AVR__
+		if(pull) {
+			*m_pOut and_eq compl m_mask;
+			*m_pDdr or_eq m_mask;
+		}
+		else {
+			*m_pDdr and_eq compl m_mask;
+			*m_pOut or_eq m_mask;
+		}
+#else
+		pinMode(m_pin, pull ? OUTPUT : INPUT);
+		digitalWrite(m_pin, pull ? LOW : HIGH);
+#endif
+	}
+
+private:
+#ifdef __AVR__
+	byte m_mask;
+	volatile uint8_t* m_pIn;
+	volatile uint8_t* m_pOut;
+	volatile uint8_t* m_pDdr;
+#else
+	byte m_pin;
+#endif
+};
+
+
+// Line access through the compile time pin if the runtime pin is known to be the same one (fast is then true).
+template <byte Pin>
+inline boolean iecRead(boolean fast, const IECPin& pin)
+{
+#ifdef IEC_HAL_FAST_PINS
+	if(fast)
+		return IECFastPin<Pin>::read();
+#else
+	(void)fast;
+#endif
+	return pin.read();
+}
+
+
+template <byte Pin>
+inline void iecWrite(boolean fast, const IECPin& pin, boolean pull)
+{
+#ifdef IEC_HAL_FAST_PINS
+	if(fast) {
+		IECFastPin<Pin>::write(pull);
+		return;
+	}
+#else
+	(void)fast;
+#endif
+	pin.write(pull);
+}
+
+#endif // IEC_HAL_H
@@ -41,10 +41,51 @@ namespace {
 // Buffer for incoming and outgoing serial bytes and other stuff.
 char serCmdIOBuf[MAX_BYTES_PER_REQUEST];
 
+// Windowed file streaming: Size of each host packet including its two heading bytes, and the number of packets the host
+// may send ahead of our credits. All packets in flight must fit in serCmdIOBuf, which is the receiving ring during a transfer.
+#ifdef EXPERIMENTAL_SPEED_FIX
+// The packets arrive while we wait for the CBM in m_iec.send(), which takes as long as the CBM likes (a GET# loop in
+// BASIC). Only the UART's receive ring takes them meanwhile and it drops what doesn't fit, so all packets in flight must
+// fit in it (it holds SERIAL_RX_BUFFER_SIZE - 1 bytes).
+#define STREAM_PACKET_SIZE 31
+#define STREAM_WINDOW 2
+#if defined(SERIAL_RX_BUFFER_SIZE) and STREAM_PACKET_SIZE * STREAM_WINDOW > SERIAL_RX_BUFFER_SIZE - 1
+#error "The stream window doesn't fit in the UART's receive ring."
+#endif
+#else
+// Interrupts are off while talking to the CBM, so nothing may arrive meanwhile: one packet at a time, stop-and-wait.
+#define STREAM_PACKET_SIZE 66
+#define STREAM_WINDOW 1
+#endif
+#if MAX_BYTES_PER_REQUEST not_eq 256
+#error "The stream ring indexes rely on a 256 byte serial buffer."
+#elif STREAM_PACKET_SIZE * STREAM_WINDOW > MAX_BYTES_PER_REQUEST
+#error "The stream window doesn't fit in the serial buffer."
+#endif
+
 #ifdef USE_LED_DISPLAY
 byte scrollBuffer[50];
 #endif
 
+#if MAX_BUS_REPLAY_BYTES > MAX_BYTES_PER_REQUEST / 2
+#error "A bus replay response must not overwrite the ATN command in the upper half of the serial buffer."
+#endif
+
+
+// Commands that start drive code: M-E, B-E and the USER commands U3 to U8 (also spelled out, USER3).
+boolean isExecuteCommand(const IEC::ATNCmd& cmd)
+{
+	const byte* str = cmd.str;
+	if(cmd.strLen >= 3 and ('M' == str[0] or 'B' == str[0]) and '-' == str[1] and 'E' == str[2])
+		return true;
+	byte digit = 0;
+	if(cmd.strLen >= 5 and 'U' == str[0] and 'S' == str[1] and 'E' == str[2] and 'R' == str[3])
+		digit = str[4];
+	else if(cmd.strLen >= 2 and 'U' == str[0])
+		digit = str[1];
+	return digit >= '3' and digit <= '8';
+} // isExecuteCommand
+
 } // unnamed namespace
 
 
@@ -70,98 +111,108 @@ void Interface::reset(void)
 } // reset
 
 
-void Interface::sendStatus(void)
+word Interface::receiveHostBytes(void)
 {
-	byte i, readResult;
-	COMPORT.write('E'); // ask for error string from the last queued error.
-	COMPORT.write(m_queuedError);
-
+	word length;
 	// first sync the response.
 	do {
-		readResult = COMPORT.readBytes(serCmdIOBuf, 1);
-	} while(readResult not_eq 1 or serCmdIOBuf[0] not_eq ':');
-	// get the string.
-	readResult = COMPORT.readBytesUntil('\r', serCmdIOBuf, sizeof(serCmdIOBuf));
-	if(not readResult)
-		return; // something went wrong with result from host.
-
-	// Length does not include the CR, write all but the last one should be with EOI.
-	for(i = 0; i < readResult - 2; ++i)
+		length = COMPORT.readBytes(serCmdIOBuf, 1);
+	} while(length not_eq 1 or serCmdIOBuf[0] not_eq ':');
+	// Response: :<length><bytes>, a length of 0 means 256 bytes.
+	if(1 not_eq COMPORT.readBytes(serCmdIOBuf, 1))
+		return 0; // something went wrong with result from host.
+	length = (byte)serCmdIOBuf[0];
+	if(not length)
+		length = sizeof(serCmdIOBuf);
+	if(length not_eq COMPORT.readBytes(serCmdIOBuf, length))
+		return 0;
+	return length;
+} // receiveHostBytes
+
+
+void Interface::sendStatus(void)
+{
+	word i, length;
+	// Ask for what reading the command channel gives: the status message, or the bytes of the last memory read (M-R).
+	// One round trip, the host keeps the queued error.
+	COMPORT.write('T');
+	length = receiveHostBytes();
+	if(not length)
+		return;
+
+	// write all but the last one, that one should be with EOI.
+	for(i = 0; i < length - 1; ++i)
 		m_iec.send(serCmdIOBuf[i]);
 	// ...and last byte in string as with EOI marker.
 	m_iec.sendEOI(serCmdIOBuf[i]);
 } // sendStatus
 
 
-// send single basic line, including heading basic pointer and terminating zero.
-void Interface::sendLine(byte len, char* text, word& basicPtr)
+void Interface::sendChannel(byte chan)
 {
-	byte i;
-
-	// Increment next line pointer
-	// note: minus two here because the line number is included in the array already.
-	basicPtr += len + 5 - 2;
-
-	// Send that pointer
-	m_iec.send(basicPtr bitand 0xFF);
-	m_iec.send(basicPtr >> 8);
-
-	// Send line number
-//	m_iec.send(lineNo bitand 0xFF);
-//	m_iec.send(lineNo >> 8);
+	word i, length;
+	// The host sends the buffer of the channel from its pointer to the end of the data.
+	COMPORT.write('G');
+	COMPORT.write(chan);
+	length = receiveHostBytes();
+	if(not length)
+		return;
+
+	// The CBM may take fewer (GET# takes one byte at a time), so the host is told how far to move the pointer.
+	for(i = 0; i < length - 1; ++i)
+		if(not m_iec.send(serCmdIOBuf[i]))
+			break;
+	if(i == length - 1 and m_iec.sendEOI(serCmdIOBuf[i]))
+		++i;
+	if(i) {
+		COMPORT.write('A');
+		COMPORT.write(chan);
+		COMPORT.write((byte)i); // 256 as 0.
+	}
+} // sendChannel
 
-	// Send line contents
-	for(i = 0; i < len; i++)
-		m_iec.send(text[i]);
 
-	// Finish line
-	m_iec.send(0);
-} // sendLine
+void Interface::receiveChannel(byte chan)
+{
+	// The bytes go to the buffer of the channel at its pointer, no response.
+	serCmdIOBuf[0] = 'P';
+	serCmdIOBuf[2] = chan;
+	receiveToHost(3);
+} // receiveChannel
 
 
 void Interface::sendListing()
 {
-	// Reset basic memory pointer:
-	word basicPtr = C64_BASIC_START;
 	noInterrupts();
 	// Send load address
 	m_iec.send(C64_BASIC_START bitand 0xff);
 	m_iec.send((C64_BASIC_START >> 8) bitand 0xff);
 	interrupts();
-	// This will be slightly tricker: Need to specify the line sending protocol between Host and Arduino.
-	// Call the listing function
+	// The host packs as many BASIC lines as fits in a response, including the link pointers, so we only have to pass the
+	// bytes on to the CBM. A batch may end in the middle of a line, the next one simply continues it.
 	byte resp;
 	do {
-		COMPORT.write('L'); // initiate request.
-		COMPORT.readBytes(serCmdIOBuf, 2);
+		COMPORT.write('M'); // initiate request.
+		byte len = COMPORT.readBytes(serCmdIOBuf, 2);
 		resp = serCmdIOBuf[0];
-		if('L' == resp) { // Host system will give us something else if we're at last line to send.
-			// get the length as one byte: This is kind of specific: For listings we allow 256 bytes length. Period.
-			byte len = serCmdIOBuf[1];
-			// WARNING: Here we might need to read out the data in portions. The serCmdIOBuf might just be too small
-			// for very long lines.
-			byte actual = COMPORT.readBytes(serCmdIOBuf, len);
-			if(len == actual) {
-				// send the bytes directly to CBM!
-				noInterrupts();
-				sendLine(len, serCmdIOBuf, basicPtr);
-				interrupts();
-			}
-			else {
-				resp = 'E'; // just to end the pain. We're out of sync or somthin'
-				sprintf_P(serCmdIOBuf, (PGM_P)F("Expected: %d chars, got %d."), len, actual);
-				Log(Error, FAC_IFACE, serCmdIOBuf);
-			}
+		if(2 not_eq len or ('M' not_eq resp and 'm' not_eq resp)) { // 'm' is the last batch.
+			strcpy_P(serCmdIOBuf, (PGM_P)F("Got unexp. listing resp."));
+			Log(Error, FAC_IFACE, serCmdIOBuf);
+			break;
 		}
-		else {
-			if('l' not_eq resp) {
-				sprintf_P(serCmdIOBuf, (PGM_P)F("Ending at char: %d."), resp);
-				Log(Error, FAC_IFACE, serCmdIOBuf);
-				COMPORT.readBytes(serCmdIOBuf, sizeof(serCmdIOBuf));
-				Log(Error, FAC_IFACE, serCmdIOBuf);
-			}
+		len = serCmdIOBuf[1];
+		byte actual = COMPORT.readBytes(serCmdIOBuf, len);
+		if(len not_eq actual) {
+			sprintf_P(serCmdIOBuf, (PGM_P)F("Expected: %d chars, got %d."), len, actual);
+			Log(Error, FAC_IFACE, serCmdIOBuf);
+			break; // just to end the pain. We're out of sync or somthin'
 		}
-	} while('L' == resp); // keep looping for more lines as long as we got an 'L' indicating we haven't reached end.
+		// send the bytes directly to CBM!
+		noInterrupts();
+		for(byte i = 0; i < len; ++i)
+			m_iec.send(serCmdIOBuf[i]);
+		interrupts();
+	} while('M' == resp); // keep looping for more lines as long as we got an 'M' indicating we haven't reached end.
 
 	// End program with two zeros after last line. Last zero goes out as EOI.
 	noInterrupts();
@@ -174,7 +225,6 @@ void Interface::sendListing()
 void Interface::sendFile()
 {
 	// Send file bytes, such that the last one is sent with EOI.
-	byte resp;
 	COMPORT.write('S'); // ask for file size.
 	byte len = COMPORT.readBytes(serCmdIOBuf, 3);
 	// it is supposed to answer with S<highByte><LowByte>
@@ -186,69 +236,93 @@ void Interface::sendFile()
 		m_pDisplay->resetPercentage(totalSize);
 #endif
 
-	bool success = true;
-	// Initial request for a bunch of bytes, here we specify the read size for every subsequent 'R' command.
-	// This begins the transfer "game".
-	COMPORT.write('N');											// ask for a byte/bunch of bytes
-	COMPORT.write(MAX_BYTES_PER_REQUEST);		// specify the arduino serial library buffer limit for best performance / throughput.
-	do {
-		len = COMPORT.readBytes(serCmdIOBuf, 2); // read the ack type ('B' or 'E')
-		if(2 not_eq len) {
-			strcpy_P(serCmdIOBuf, (PGM_P)F("2 Host bytes expected, stopping"));
-			Log(Error, FAC_IFACE, serCmdIOBuf);
-			success = false;
-			break;
+	// Begin the windowed transfer: tell the host the packet size and how many packets it may push ahead of us.
+	// From here the host keeps the serial line busy on its own, we only hand back a credit ('R') for each drained packet.
+	COMPORT.write('F');
+	COMPORT.write(STREAM_PACKET_SIZE);
+	COMPORT.write(STREAM_WINDOW);
+
+	// serCmdIOBuf is used as a ring buffer here, the byte sized indexes wrap around by themselves.
+	byte head = 0, tail = 0;
+	byte resp = 0, remaining = 0;
+	boolean success = true, inPacket = false, lastPacket = false;
+	ulong lastReceived = millis();
+	while(success) {
+		// Move whatever the serial line has delivered into our ring. With the EXPERIMENTAL_SPEED_FIX interrupts are kept
+		// enabled while talking to the CBM so that the UART keeps receiving meanwhile, this is what makes serial and IEC
+		// transfers overlap.
+		while(COMPORT.available()) {
+			serCmdIOBuf[head++] = COMPORT.read();
+			lastReceived = millis();
 		}
-		resp = serCmdIOBuf[0];
-		len = serCmdIOBuf[1];
-		if('B' == resp or 'E' == resp) {
-			byte actual = COMPORT.readBytes(serCmdIOBuf, len);
-			if(actual not_eq len) {
-				strcpy_P(serCmdIOBuf, (PGM_P)F("Host bytes expected, stopping"));
-				success = false;
+		byte buffered = head - tail;
+		if(not inPacket) {
+			if(buffered < 2) {
+				if(millis() - lastReceived > SERIAL_TIMEOUT_MSECS) {
+					strcpy_P(serCmdIOBuf, (PGM_P)F("2 Host bytes expected, stopping"));
+					Log(Error, FAC_IFACE, serCmdIOBuf);
+					success = false;
+				}
+				continue;
+			}
+			resp = serCmdIOBuf[tail++];
+			remaining = serCmdIOBuf[tail++];
+			if('B' not_eq resp and 'E' not_eq resp) {
+				strcpy_P(serCmdIOBuf, (PGM_P)F("Got unexp. cmd resp.char."));
 				Log(Error, FAC_IFACE, serCmdIOBuf);
+				success = false;
 				break;
 			}
+			lastPacket = 'E' == resp;
+			inPacket = 0 not_eq remaining;
+			if(not inPacket) {
+				if(lastPacket)
+					break;
+				COMPORT.write('R');
+			}
+		}
 #ifdef EXPERIMENTAL_SPEED_FIX
-			if('E' not_eq resp) // if not received the final buffer, initiate a new buffer request while we're feeding the CBM.
-				COMPORT.write('R'); // ask for a byte/bunch of bytes
+		else if(buffered) {
+#else
+		else if(buffered >= remaining) { // the whole packet is in, nothing more is sent before our credit.
 #endif
-			// so we get some bytes, send them to CBM.
-			for(byte i = 0; success and i < len; ++i) { // End if sending to CBM fails.
+			byte data = serCmdIOBuf[tail++];
+			--remaining;
 #ifndef EXPERIMENTAL_SPEED_FIX
-				noInterrupts();
+			noInterrupts();
 #endif
-				if(resp == 'E' and i == len - 1)
-					success = m_iec.sendEOI(serCmdIOBuf[i]); // indicate end of file.
-				else
-					success = m_iec.send(serCmdIOBuf[i]);
+			if(lastPacket and not remaining)
+				success = m_iec.sendEOI(data); // indicate end of file.
+			else
+				success = m_iec.send(data);
 #ifndef EXPERIMENTAL_SPEED_FIX
-				interrupts();
+			interrupts();
 #endif
-				++bytesDone;
+			++bytesDone;
 
 #ifdef USE_LED_DISPLAY
-				// Every xx bytes received, update the percentage.
-				if(not (bytesDone % 32) and 0 not_eq m_pDisplay)
-					m_pDisplay->showPercentage(bytesDone);
+			// Every xx bytes received, update the percentage.
+			if(not (bytesDone % 32) and 0 not_eq m_pDisplay)
+				m_pDisplay->showPercentage(bytesDone);
 #endif
+			if(not remaining) {
+				if(lastPacket)
+					break;
+				// The packet is drained, so there is room for one more in the ring: return the credit to the host.
+				COMPORT.write('R');
+				inPacket = false;
 			}
-#ifndef EXPERIMENTAL_SPEED_FIX
-			if('E' not_eq resp) // if not received the final buffer, initiate a new buffer request while we're feeding the CBM.
-				COMPORT.write('R'); // ask for a byte/bunch of bytes
-#endif
 		}
-		else {
-			strcpy_P(serCmdIOBuf, (PGM_P)F("Got unexp. cmd resp.char."));
+		else if(millis() - lastReceived > SERIAL_TIMEOUT_MSECS) {
+			strcpy_P(serCmdIOBuf, (PGM_P)F("Host bytes expected, stopping"));
 			Log(Error, FAC_IFACE, serCmdIOBuf);
 			success = false;
 		}
-	} while(resp == 'B' and success); // keep asking for more as long as we don't get the 'E' or something else (indicating out of sync).
-	// If something failed and we have serial bytes in recieve queue we need to flush it out.
-	if(not success and COMPORT.available()) {
-		while(COMPORT.available())
-			COMPORT.read();
 	}
+	// If something failed the host may still have a window of packets on their way, and it would keep sending on the credits
+	// it has. Tell it to stop and drain up to its acknowledgement, which comes after those packets.
+	if(not success)
+		abortStream(inPacket ? remaining : 0, head, tail);
 #ifdef USE_LED_DISPLAY
 	if(0 not_eq m_pDisplay)
 		m_pDisplay->showPercentage(bytesDone);
@@ -260,13 +334,59 @@ void Interface::sendFile()
 } // sendFile
 
 
+void Interface::abortStream(byte skip, byte head, byte tail)
+{
+	COMPORT.write('X');
+	// Skip the rest of the current packet and the packets following it. The acknowledgement is framed like a packet:
+	// 'X' and a zero count. Having lost track of the packets it is looked for byte by byte, and if the host doesn't answer
+	// (an older one) we give up when the line has been quiet for the serial timeout.
+	boolean inHeader = false, acknowledged = false;
+	byte resp = 0;
+	ulong lastReceived = millis();
+	while(not acknowledged and millis() - lastReceived <= SERIAL_TIMEOUT_MSECS) {
+		if(head == tail) {
+			if(COMPORT.available()) {
+				serCmdIOBuf[head++] = COMPORT.read();
+				lastReceived = millis();
+			}
+			continue;
+		}
+		byte data = serCmdIOBuf[tail++];
+		if(skip)
+			--skip;
+		else if(not inHeader) {
+			resp = data;
+			inHeader = true;
+		}
+		else if('B' == resp or 'E' == resp) {
+			skip = data;
+			inHeader = false;
+		}
+		else if('X' == resp and 0 == data)
+			acknowledged = true;
+		else
+			resp = data;
+	}
+	if(not acknowledged) {
+		strcpy_P(serCmdIOBuf, (PGM_P)F("No stream abort ack."));
+		Log(Error, FAC_IFACE, serCmdIOBuf);
+	}
+} // abortStream
+
+
 void Interface::saveFile()
 {
-	boolean done = false;
-	// Recieve bytes until a EOI is detected
 	serCmdIOBuf[0] = 'W';
+	receiveToHost(2);
+} // saveFile
+
+
+void Interface::receiveToHost(byte headerLength)
+{
+	boolean done = false;
+	// Recieve bytes until a EOI is detected, each buffer full is sent with the request header set up by the caller.
 	do {
-		byte bytesInBuffer = 2;
+		byte bytesInBuffer = headerLength;
 		do {
 			noInterrupts();
 			serCmdIOBuf[bytesInBuffer++] = m_iec.receive();
@@ -278,7 +398,7 @@ void Interface::saveFile()
 		COMPORT.write((const byte*)serCmdIOBuf, bytesInBuffer);
 		COMPORT.flush();
 	} while(not done);
-} // saveFile
+} // receiveToHost
 
 
 byte Interface::handler(void)
@@ -326,20 +446,32 @@ byte Interface::handler(void)
 
 			case IEC::ATN_CODE_DATA:  // data channel opened
 				if(retATN == IEC::ATN_CMD_TALK) {
-					 // when the CMD channel is read (status), we first need to issue the host request. The data channel is opened directly.
+					// when the CMD channel is read (status), the host sends what to give back in one response.
 					if(CMD_CHANNEL == chan)
-						handleATNCmdCodeOpen(m_cmd); // This is typically an empty command,
-					handleATNCmdCodeDataTalk(chan); // ...but we do expect a response from PC that we can send back to CBM.
+						sendStatus();
+					else if(chan > WRITEPRG_CHANNEL)
+						sendChannel(chan);
+					else
+						handleATNCmdCodeDataTalk(); // The data channel is opened directly.
+				}
+				else if(retATN == IEC::ATN_CMD_LISTEN) {
+					if(chan > WRITEPRG_CHANNEL)
+						receiveChannel(chan);
+					else
+						handleATNCmdCodeDataListen();
 				}
-				else if(retATN == IEC::ATN_CMD_LISTEN)
-					handleATNCmdCodeDataListen();
 				else if(retATN == IEC::ATN_CMD) // Here we are sending a command to PC and executing it, but not sending response
 					handleATNCmdCodeOpen(m_cmd);	// back to CBM, the result code of the command is however buffered on the PC side.
 				break;
 
 			case IEC::ATN_CODE_CLOSE:
-				// handle close with host.
-				handleATNCmdClose();
+				// handle close with host, the direct access channels without a response.
+				if(chan > WRITEPRG_CHANNEL and CMD_CHANNEL not_eq chan) {
+					COMPORT.write('K');
+					COMPORT.write(chan);
+				}
+				else
+					handleATNCmdClose();
 				break;
 
 			case IEC::ATN_CODE_LISTEN:
@@ -455,10 +587,44 @@ void Interface::handleATNCmdCodeOpen(IEC::ATNCmd& cmd)
 	serCmdIOBuf[1] = length;
 	// NOTE: Host side handles BOTH file open command AND the command channel command (from the cmd.code).
 	COMPORT.write((const byte*)serCmdIOBuf, length);
+	// Drive code runs on the host as the command is handled there, what it did on the bus is replayed right after.
+	if(CMD_CHANNEL == (cmd.code bitand 0xF) and isExecuteCommand(cmd))
+		replayBus();
 } // handleATNCmdCodeOpen
 
 
-void Interface::handleATNCmdCodeDataTalk(byte chan)
+// Drives CLOCK and DATA the way the drive code run on the host's emulated 1541 did (protocol v8). The host sends it in
+// responses of entries of a wait in microseconds and the lines pulled after it. The code ran without seeing the CBM,
+// so this is open loop, and the wait for the next response isn't in the timing. The lines are released again as soon
+// as the bus is idle.
+void Interface::replayBus()
+{
+	byte resp;
+	do {
+		COMPORT.write('V');
+		// Response: B or E (last one), length, entries.
+		if(2 not_eq COMPORT.readBytes(serCmdIOBuf, 2))
+			return;
+		resp = serCmdIOBuf[0];
+		const byte length = serCmdIOBuf[1];
+		if(('B' not_eq resp and 'E' not_eq resp) or length > MAX_BUS_REPLAY_BYTES) {
+			strcpy_P(serCmdIOBuf, (PGM_P)F("Got unexp. replay resp."));
+			Log(Error, FAC_IFACE, serCmdIOBuf);
+			return;
+		}
+		if(length not_eq COMPORT.readBytes(serCmdIOBuf, length))
+			return;
+		for(byte i = 0; i + BUS_REPLAY_ENTRY_SIZE <= length; i += BUS_REPLAY_ENTRY_SIZE) {
+			delayMicroseconds(byte(serCmdIOBuf[i]) bitor (word(byte(serCmdIOBuf[i + 1])) << 8));
+			const byte lines = serCmdIOBuf[i + 2];
+			if(not m_iec.driveLines(lines bitand BUS_REPLAY_CLOCK, lines bitand BUS_REPLAY_DATA))
+				return;
+		}
+	} while('E' not_eq resp);
+} // replayBus
+
+
+void Interface::handleATNCmdCodeDataTalk()
 {
 	byte lengthOrResult;
 	boolean wasSuccess = false;
@@ -485,44 +651,35 @@ void Interface::handleATNCmdCodeDataTalk(byte chan)
 			else
 				Log(Error, FAC_IFACE, serCmdIOBuf);
 		}
-		if(CMD_CHANNEL == chan) {
-			m_queuedError = wasSuccess ? lengthOrResult : ErrSerialComm;
-			// Send status message
-			sendStatus();
-			// go back to OK state, we have dispatched the error to IEC host now.
-			m_queuedError = ErrOK;
-		}
-		else {
-			m_openState = wasSuccess ? lengthOrResult : O_NOTHING;
+		m_openState = wasSuccess ? lengthOrResult : O_NOTHING;
 
-			switch(m_openState) {
-			case O_INFO:
-				// Reset and send SD card info
-				reset();
-				sendListing();
-				break;
+		switch(m_openState) {
+		case O_INFO:
+			// Reset and send SD card info
+			reset();
+			sendListing();
+			break;
 
-			case O_FILE_ERR:
-				// FIXME: interface with Host for error info.
-				//sendListing(/*&send_file_err*/);
-				m_iec.sendFNF();
-				break;
+		case O_FILE_ERR:
+			// FIXME: interface with Host for error info.
+			//sendListing(/*&send_file_err*/);
+			m_iec.sendFNF();
+			break;
 
-			case O_NOTHING:
-				// Say file not found
-				m_iec.sendFNF();
-				break;
+		case O_NOTHING:
+			// Say file not found
+			m_iec.sendFNF();
+			break;
 
-			case O_FILE:
-				// Send program file
-				sendFile();
-				break;
+		case O_FILE:
+			// Send program file
+			sendFile();
+			break;
 
-			case O_DIR:
-				// Send listing
-				sendListing();
-				break;
-			}
+		case O_DIR:
+			// Send listing
+			sendListing();
+			break;
 		}
 	}
 //	Log(Information, FAC_IFACE, serCmdIOBuf);
@@ -30,9 +30,6 @@ enum OpenState {
 	O_SAVE_REPLACE	// Save-with-replace is requested
 };
 
-// The base pointer of basic.
-#define C64_BASIC_START 0x0801
-
 class Interface
 {
 public:
@@ -57,16 +54,24 @@ private:
 	void reset(void);
 	void saveFile();
 	void sendFile();
+	// Stops a windowed transfer of sendFile, the ring buffer indexes are where it stopped.
+	void abortStream(byte skip, byte head, byte tail);
 	void sendListing(/*PFUNC_SEND_LISTING sender*/);
 	void sendStatus(void);
+	// Channels 2-14, opened for direct access ("#"): the host keeps their buffers.
+	void sendChannel(byte chan);
+	void receiveChannel(byte chan);
+	// Helpers of the above: the bytes of a ':' response, and the bytes from the CBM to send after a request header.
+	word receiveHostBytes(void);
+	void receiveToHost(byte headerLength);
 	bool removeFilePrefix(void);
-	void sendLine(byte len, char* text, word &basicPtr);
 
 	// handler helpers.
 	void handleATNCmdCodeOpen(IEC::ATNCmd &cmd);
-	void handleATNCmdCodeDataTalk(byte chan);
+	void handleATNCmdCodeDataTalk();
 	void handleATNCmdCodeDataListen();
 	void handleATNCmdClose();
+	void replayBus();
 
 	void updateDateTime();
 
@@ -0,0 +1,140 @@
+//
+// Title	: uno2iecd - console host main
+//
+// Serves the Arduino from the core library without any UI, for headless (e.g. Raspberry Pi) setups.
+// Defaults are taken from the settings saved by the GUI application, command line options override them.
+//
+// DISCLAIMER:
+// The author is in no way responsible for any problems or damage caused by
+// using this code. Use at your own risk.
+//
+// LICENSE:
+// This code is distributed under the GNU Public License
+// which can be found at http://www.gnu.org/licenses/gpl.txt
+//
+
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QSettings>
+#include <QTextStream>
+#include <QDir>
+#include <stdio.h>
+
+#include "version.h"
+#include "serialhost.hpp"
+#include "logger.hpp"
+
+using namespace Logging;
+
+namespace {
+
+// Log transport writing every log line to stderr.
+class ConsoleLog : public ILogTransport
+{
+public:
+	ConsoleLog() : m_out(stderr)
+	{}
+
+	void appendTime(const QString& dateTime)
+	{
+		m_out << dateTime;
+	}
+
+	void appendLevelAndFacility(LogLevelE level, const QString& levelFacility)
+	{
+		Q_UNUSED(level);
+		m_out << ' ' << levelFacility << ' ';
+	}
+
+	void appendMessage(const QString& msg)
+	{
+		m_out << msg << endl;
+	}
+
+private:
+	QTextStream m_out;
+};
+
+} // unnamed namespace
+
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication a(argc, argv);
+
+	a.setOrganizationName(VER_COMPANYNAME_STR);
+	a.setOrganizationDomain(VER_COMPANYDOMAIN_STR);
+	a.setApplicationName(VER_PRODUCTNAME_STR);
+
+	ConsoleLog consoleLog;
+	loggerInstance().addTransport(&consoleLog);
+
+	QSettings sets;
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Console host serving CBM images and files to the uno2iec Arduino.");
+	parser.addHelpOption();
+	QCommandLineOption portOption(QStringList() << "p" << "port", "Serial port the Arduino is connected to.", "name",
+																sets.value("portName", "ttyAMA0").toString());
+	QCommandLineOption baudOption(QStringList() << "b" << "baud", "Serial port baud rate.", "rate",
+																sets.value("baudRate", QString::number(DEFAULT_BAUDRATE)).toString());
+	QCommandLineOption dirOption(QStringList() << "d" << "directory", "Directory with the images and programs to serve.", "path",
+															 sets.value("imageDirectory", QDir::currentPath()).toString());
+	QCommandLineOption filtersOption("filters", "Comma separated file filters for the directory listing.", "filters",
+																	 sets.value("imageFilters", "*.D64,*.D71,*.D81,*.G64,*.T64,*.M2I,*.PRG,*.P00,*.SID").toString());
+	QCommandLineOption showDirsOption("show-dirs", "List directories too.");
+	QCommandLineOption deviceOption(QStringList() << "n" << "device", "CBM device number.", "number",
+																	sets.value("deviceNumber", QString::number(DEFAULT_DEVICE_NUMBER)).toString());
+	QCommandLineOption atnOption("atn-pin", "Arduino ATN pin.", "pin", sets.value("atnPin", QString::number(DEFAULT_ATN_PIN)).toString());
+	QCommandLineOption clockOption("clock-pin", "Arduino CLOCK pin.", "pin", sets.value("clockPin", QString::number(DEFAULT_CLOCK_PIN)).toString());
+	QCommandLineOption dataOption("data-pin", "Arduino DATA pin.", "pin", sets.value("dataPin", QString::number(DEFAULT_DATA_PIN)).toString());
+	QCommandLineOption resetOption("reset-pin", "Arduino RESET pin.", "pin", sets.value("resetPin", QString::number(DEFAULT_RESET_PIN)).toString());
+	QCommandLineOption srqInOption("srqin-pin", "Arduino SRQ IN pin.", "pin", sets.value("srqInPin", QString::number(DEFAULT_SRQIN_PIN)).toString());
+	QCommandLineOption writeProtectOption("write-protect", "Refuse all writes from the CBM.");
+	QCommandLineOption cacheOption("cache-mb", "Memory cap for cached images in megabytes.", "megabytes",
+																 sets.value("imageCacheMegabytes", 64).toString());
+	parser.addOption(portOption);
+	parser.addOption(baudOption);
+	parser.addOption(dirOption);
+	parser.addOption(filtersOption);
+	parser.addOption(showDirsOption);
+	parser.addOption(deviceOption);
+	parser.addOption(atnOption);
+	parser.addOption(clockOption);
+	parser.addOption(dataOption);
+	parser.addOption(resetOption);
+	parser.addOption(srqInOption);
+	parser.addOption(writeProtectOption);
+	parser.addOption(cacheOption);
+	parser.process(a);
+
+	Logging::loggerInstance().loadFilters(sets);
+
+	const QString imageDirectory(parser.value(dirOption));
+	QDir::setCurrent(imageDirectory);
+
+	SerialHost host;
+	host.setImageCacheBytes(parser.value(cacheOption).toLongLong() * 1024 * 1024);
+	SerialHost::DeviceConfig config;
+	config.deviceNumber = parser.value(deviceOption).toUShort();
+	config.atnPin = parser.value(atnOption).toUShort();
+	config.clockPin = parser.value(clockOption).toUShort();
+	config.dataPin = parser.value(dataOption).toUShort();
+	config.resetPin = parser.value(resetOption).toUShort();
+	config.srqInPin = parser.value(srqInOption).toUShort();
+	host.setDeviceConfig(config);
+	host.setWriteProtected(parser.isSet(writeProtectOption) or sets.value("diskWriteProtected", false).toBool());
+	host.setImageFilters(parser.value(filtersOption), parser.isSet(showDirsOption) or sets.value("showDirectories", false).toBool());
+	host.changeNativeFSDirectory(imageDirectory);
+
+	if(not host.openPort(parser.value(portOption), parser.value(baudOption).toUInt()))
+		return 1;
+	if(host.setupResetLine())
+		host.resetArduino();
+	Log("MAIN", success, QString("uno2iecd started, using port %1 @ %2, serving %3").arg(host.portName())
+			.arg(QString::number(host.baudRate())).arg(imageDirectory));
+
+	int result = a.exec();
+	loggerInstance().removeTransport(&consoleLog);
+	return result;
+} // main
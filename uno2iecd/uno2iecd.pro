@@ -0,0 +1,17 @@
+#-------------------------------------------------
+#
+# uno2iecd: Console (headless) host for the Arduino, no QtWidgets needed.
+#
+#-------------------------------------------------
+
+QT       = core
+
+TARGET = uno2iecd
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../uno2iec-common.pri)
+include(../uno2iec-core.pri)
+
+SOURCES += main.cpp
@@ -0,0 +1,254 @@
+#include "via6522.hpp"
+
+namespace {
+
+const uchar ACR_T1_FREE_RUN = 0x40;
+const uchar PCR_CA1_POSITIVE_EDGE = 0x01;
+const quint64 COUNTER_WRAP = 0x10000;
+
+} // unnamed namespace
+
+
+Via6522::Via6522()
+	: m_cycle(0)
+{
+	reset();
+} // ctor
+
+
+void Via6522::reset()
+{
+	// Like the RESET line: registers cleared, the timers and their latches keep running.
+	for(int port = PortA; port <= PortB; ++port) {
+		m_outputs[port] = 0;
+		m_ddr[port] = 0;
+		m_inputs[port] = 0xFF;
+	}
+	m_t1Latch = 0xFFFF;
+	m_t2LatchLow = 0xFF;
+	m_t1Underflow = m_cycle + COUNTER_WRAP;
+	m_t2Underflow = m_cycle + COUNTER_WRAP;
+	m_t1Armed = m_t2Armed = false;
+	m_sr = m_acr = m_pcr = m_ifr = m_ier = 0;
+	m_ca1 = true;
+	clearPortWrites();
+} // reset
+
+
+void Via6522::clearPortWrites()
+{
+	PortWrite change;
+	while(m_portWrites.pop(change));
+	m_droppedPortWrites = 0;
+} // clearPortWrites
+
+
+void Via6522::advanceTo(quint64 cycle)
+{
+	if(cycle <= m_cycle)
+		return;
+	m_cycle = cycle;
+
+	if(cycle >= m_t1Underflow) {
+		if(m_t1Armed)
+			m_ifr or_eq IrqT1;
+		// Free running T1 reloads from the latch (a period of latch + 2 cycles) and keeps interrupting, one shot T1
+		// rolls over and counts on from 0xFFFF silently.
+		if(m_acr bitand ACR_T1_FREE_RUN) {
+			const quint64 period = quint64(m_t1Latch) + 2;
+			m_t1Underflow += ((cycle - m_t1Underflow) / period + 1) * period;
+		}
+		else {
+			m_t1Armed = false;
+			m_t1Underflow += ((cycle - m_t1Underflow) / COUNTER_WRAP + 1) * COUNTER_WRAP;
+		}
+	}
+	if(cycle >= m_t2Underflow) {
+		if(m_t2Armed)
+			m_ifr or_eq IrqT2;
+		m_t2Armed = false;
+		m_t2Underflow += ((cycle - m_t2Underflow) / COUNTER_WRAP + 1) * COUNTER_WRAP;
+	}
+} // advanceTo
+
+
+quint64 Via6522::nextEvent() const
+{
+	quint64 next = ~quint64(0);
+	if(m_t1Armed)
+		next = m_t1Underflow;
+	if(m_t2Armed and m_t2Underflow < next)
+		next = m_t2Underflow;
+	return next;
+} // nextEvent
+
+
+ushort Via6522::t1Counter(quint64 cycle) const
+{
+	return ushort(m_t1Underflow - 1 - cycle);
+} // t1Counter
+
+
+ushort Via6522::t2Counter(quint64 cycle) const
+{
+	return ushort(m_t2Underflow - 1 - cycle);
+} // t2Counter
+
+
+uchar Via6522::read(uchar reg, quint64 cycle)
+{
+	advanceTo(cycle);
+	const uchar value = peek(reg);
+	// Reading the port registers and the low counter bytes acknowledges their interrupts.
+	switch(reg bitand 0x0F) {
+		case RegORB:
+			m_ifr and_eq ~(IrqCb1 bitor IrqCb2);
+			break;
+		case RegORA:
+			m_ifr and_eq ~(IrqCa1 bitor IrqCa2);
+			break;
+		case RegT1CL:
+			m_ifr and_eq ~IrqT1;
+			break;
+		case RegT2CL:
+			m_ifr and_eq ~IrqT2;
+			break;
+	}
+	return value;
+} // read
+
+
+uchar Via6522::peek(uchar reg) const
+{
+	switch(reg bitand 0x0F) {
+		case RegORB:
+			return readPort(PortB);
+		case RegORA:
+		case RegORANoHandshake:
+			return readPort(PortA);
+		case RegDDRB:
+			return m_ddr[PortB];
+		case RegDDRA:
+			return m_ddr[PortA];
+		case RegT1CL:
+			return t1Counter(m_cycle) bitand 0xFF;
+		case RegT1CH:
+			return t1Counter(m_cycle) >> 8;
+		case RegT1LL:
+			return m_t1Latch bitand 0xFF;
+		case RegT1LH:
+			return m_t1Latch >> 8;
+		case RegT2CL:
+			return t2Counter(m_cycle) bitand 0xFF;
+		case RegT2CH:
+			return t2Counter(m_cycle) >> 8;
+		case RegSR:
+			return m_sr;
+		case RegACR:
+			return m_acr;
+		case RegPCR:
+			return m_pcr;
+		case RegIFR:
+			return m_ifr bitor (irq() ? IrqAny : 0);
+		default: // RegIER
+			return m_ier bitor IrqAny;
+	}
+} // peek
+
+
+void Via6522::write(uchar reg, uchar value, quint64 cycle)
+{
+	advanceTo(cycle);
+	switch(reg bitand 0x0F) {
+		case RegORB:
+			m_ifr and_eq ~(IrqCb1 bitor IrqCb2);
+			writePort(PortB, value, false, cycle);
+			break;
+		case RegORA:
+			m_ifr and_eq ~(IrqCa1 bitor IrqCa2);
+			// Fall through.
+		case RegORANoHandshake:
+			writePort(PortA, value, false, cycle);
+			break;
+		case RegDDRB:
+			writePort(PortB, value, true, cycle);
+			break;
+		case RegDDRA:
+			writePort(PortA, value, true, cycle);
+			break;
+		case RegT1CL:
+		case RegT1LL:
+			m_t1Latch = (m_t1Latch bitand 0xFF00) bitor value;
+			break;
+		case RegT1CH:
+			// Loads the counter from the latch and starts it.
+			m_t1Latch = (m_t1Latch bitand 0x00FF) bitor (ushort(value) << 8);
+			m_t1Underflow = cycle + m_t1Latch + 1;
+			m_t1Armed = true;
+			m_ifr and_eq ~IrqT1;
+			break;
+		case RegT1LH:
+			m_t1Latch = (m_t1Latch bitand 0x00FF) bitor (ushort(value) << 8);
+			m_ifr and_eq ~IrqT1;
+			break;
+		case RegT2CL:
+			m_t2LatchLow = value;
+			break;
+		case RegT2CH:
+			m_t2Underflow = cycle + ((ushort(value) << 8) bitor m_t2LatchLow) + 1;
+			m_t2Armed = true;
+			m_ifr and_eq ~IrqT2;
+			break;
+		case RegSR:
+			m_sr = value;
+			break;
+		case RegACR:
+			m_acr = value;
+			break;
+		case RegPCR:
+			m_pcr = value;
+			break;
+		case RegIFR:
+			m_ifr and_eq ~value;
+			break;
+		default: // RegIER
+			if(value bitand IrqAny)
+				m_ier or_eq value bitand 0x7F;
+			else
+				m_ier and_eq ~value;
+			break;
+	}
+} // write
+
+
+void Via6522::setCa1(bool level, quint64 cycle)
+{
+	advanceTo(cycle);
+	if(level == m_ca1)
+		return;
+	m_ca1 = level;
+	if(level == bool(m_pcr bitand PCR_CA1_POSITIVE_EDGE))
+		m_ifr or_eq IrqCa1;
+} // setCa1
+
+
+uchar Via6522::readPort(Port port) const
+{
+	return (m_outputs[port] bitand m_ddr[port]) bitor (m_inputs[port] bitand ~m_ddr[port]);
+} // readPort
+
+
+void Via6522::writePort(Port port, uchar value, bool isDirection, quint64 cycle)
+{
+	const uchar before = portOutput(port);
+	if(isDirection)
+		m_ddr[port] = value;
+	else
+		m_outputs[port] = value;
+	const uchar after = portOutput(port);
+	if(after not_eq before) {
+		const PortWrite change = { cycle, uchar(port), after };
+		if(not m_portWrites.push(change))
+			++m_droppedPortWrites;
+	}
+} // writePort
@@ -0,0 +1,133 @@
+#ifndef VIA6522_HPP
+#define VIA6522_HPP
+
+#include <QtGlobal>
+
+#include "spscqueue.hpp"
+
+// The 6522 VIA as the 1541 has two of: Ports with data direction, the two timers, the interrupt flag and enable
+// registers, CA1 edges. Emulated lazily: the timers are brought up to date when a register is accessed or the owner
+// advances them, nothing runs per cycle. The owner asks for the next timer event to know how far the CPU may run
+// before the IRQ line has to be looked at again.
+// Not emulated: the shift register (only stored), CA2/CB1/CB2 handshaking, pulse counting by T2 and the PB7 output.
+class Via6522
+{
+public:
+	enum Register {
+		RegORB = 0,
+		RegORA,
+		RegDDRB,
+		RegDDRA,
+		RegT1CL,
+		RegT1CH,
+		RegT1LL,
+		RegT1LH,
+		RegT2CL,
+		RegT2CH,
+		RegSR,
+		RegACR,
+		RegPCR,
+		RegIFR,
+		RegIER,
+		RegORANoHandshake
+	};
+
+	enum InterruptFlags {
+		IrqCa2 = 0x01,
+		IrqCa1 = 0x02,
+		IrqSr = 0x04,
+		IrqCb2 = 0x08,
+		IrqCb1 = 0x10,
+		IrqT2 = 0x20,
+		IrqT1 = 0x40,
+		IrqAny = 0x80
+	};
+
+	enum Port {
+		PortA,
+		PortB
+	};
+
+	// A change of the levels the VIA drives on a port, lines set as inputs float high.
+	struct PortWrite
+	{
+		quint64 cycle;
+		uchar port;
+		uchar value;
+	};
+
+	// Room for the port changes not taken yet, one less than this. Drive code that keeps toggling a port (e.g. a loader
+	// waiting on the CBM) can't make them pile up, the ones that don't fit are only counted.
+	static const int PORT_WRITES_CAPACITY = 2048;
+
+	Via6522();
+
+	void reset();
+	uchar read(uchar reg, quint64 cycle);
+	// The register as the CPU would read it at the cycle of the last access, without acknowledging interrupts.
+	uchar peek(uchar reg) const;
+	void write(uchar reg, uchar value, quint64 cycle);
+
+	// Brings the timers up to the cycle, setting the interrupt flags of those that ran out.
+	void advanceTo(quint64 cycle);
+	// The cycle of the next timer event that can raise an interrupt flag, the largest quint64 if there is none.
+	quint64 nextEvent() const;
+	bool irq() const
+	{
+		return 0 not_eq (m_ifr bitand m_ier bitand 0x7F);
+	}
+
+	// Levels on the port lines from the outside, seen on the lines set as inputs.
+	void setPortInput(Port port, uchar value)
+	{
+		m_inputs[port] = value;
+	}
+	// Levels driven by the VIA, inputs floating high.
+	uchar portOutput(Port port) const
+	{
+		return m_outputs[port] bitor ~m_ddr[port];
+	}
+	// The CA1 line: an edge in the direction selected by PCR sets its interrupt flag.
+	void setCa1(bool level, quint64 cycle);
+
+	// The oldest port change not taken yet, false if there is none.
+	bool takePortWrite(PortWrite& change)
+	{
+		return m_portWrites.pop(change);
+	}
+	// Changes dropped since the last clearPortWrites() because the queue was full.
+	uint droppedPortWrites() const
+	{
+		return m_droppedPortWrites;
+	}
+	void clearPortWrites();
+
+private:
+	uchar readPort(Port port) const;
+	void writePort(Port port, uchar value, bool isDirection, quint64 cycle);
+	// Counter values at the cycle (the timers are up to date).
+	ushort t1Counter(quint64 cycle) const;
+	ushort t2Counter(quint64 cycle) const;
+
+	uchar m_outputs[2];
+	uchar m_ddr[2];
+	uchar m_inputs[2];
+	ushort m_t1Latch;
+	uchar m_t2LatchLow;
+	// The cycle the counter runs out at (reads 0xFFFF) next, and whether that sets the interrupt flag.
+	quint64 m_t1Underflow;
+	bool m_t1Armed;
+	quint64 m_t2Underflow;
+	bool m_t2Armed;
+	uchar m_sr;
+	uchar m_acr;
+	uchar m_pcr;
+	uchar m_ifr;
+	uchar m_ier;
+	bool m_ca1;
+	quint64 m_cycle;
+	SpscQueue<PortWrite, PORT_WRITES_CAPACITY> m_portWrites;
+	uint m_droppedPortWrites;
+};
+
+#endif // VIA6522_HPP